@@ -0,0 +1,85 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+//
+// Run a program and report its wall-clock time and peak memory usage.
+//
+// Usage: measure REPORT_FILE TIMEOUT_SECONDS PROGRAM [ARGS...]
+//
+// The report is a line "<nanoseconds> <peak RSS in KiB> <timed out (0/1)>".
+// We can't measure this from the benchmark script directly because Linux
+// attributes the peak memory of the process that forks to the child, and the
+// Python interpreter is larger than most targets.
+//
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static pid_t child;
+static volatile sig_atomic_t timed_out;
+
+static void handle_alarm(int signal) {
+  (void)signal;
+  timed_out = 1;
+  kill(child, SIGKILL);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    fprintf(stderr, "Usage: %s REPORT_FILE TIMEOUT_SECONDS PROGRAM [ARGS...]\n",
+            argv[0]);
+    return 2;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  child = fork();
+  if (child < 0) {
+    perror("fork");
+    return 2;
+  }
+  if (child == 0) {
+    execvp(argv[3], argv + 3);
+    perror("execvp");
+    _exit(127);
+  }
+
+  signal(SIGALRM, handle_alarm);
+  alarm(atoi(argv[2]));
+
+  int status;
+  struct rusage usage;
+  while (wait4(child, &status, 0, &usage) < 0) {
+    // Interrupted by the alarm
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  FILE *report = fopen(argv[1], "w");
+  if (report == NULL) {
+    perror("fopen");
+    return 2;
+  }
+  fprintf(report, "%lld %ld %d\n",
+          (long long)(end.tv_sec - start.tv_sec) * 1000000000LL +
+              (end.tv_nsec - start.tv_nsec),
+          usage.ru_maxrss, (int)timed_out);
+  fclose(report);
+  return 0;
+}
@@ -0,0 +1,303 @@
+#!/usr/bin/env python3
+
+# This file is part of SymCC.
+#
+# SymCC is free software: you can redistribute it and/or modify it under the
+# terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+# WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+# A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along with
+# SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+"""End-to-end throughput benchmark of SymCC.
+
+Build each target natively and with SymCC, run both on the target's seed
+corpus, and report throughput, slowdown, solver time, memory and generated
+inputs per target and backend as JSON. Binaries compiled with SymCC don't
+depend on the backend, so we run the same binary against each runtime
+directory that we're given (see docs/Benchmarks.txt).
+"""
+
+import argparse
+import datetime
+import json
+import math
+import os
+import platform
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+BENCHMARK_DIR = os.path.dirname(os.path.abspath(__file__))
+SOURCE_DIR = os.path.dirname(BENCHMARK_DIR)
+
+# The targets: name -> (source file, seed directory)
+TARGETS = {
+    "libc_harness": (
+        os.path.join(SOURCE_DIR, "libc_harness", "test", "test.c"),
+        os.path.join(SOURCE_DIR, "libc_harness", "test", "corpus"),
+    ),
+    "json": (
+        os.path.join(BENCHMARK_DIR, "targets", "json.c"),
+        os.path.join(BENCHMARK_DIR, "seeds", "json"),
+    ),
+    "png": (
+        os.path.join(BENCHMARK_DIR, "targets", "png.c"),
+        os.path.join(BENCHMARK_DIR, "seeds", "png"),
+    ),
+    "elf": (
+        os.path.join(BENCHMARK_DIR, "targets", "elf.c"),
+        os.path.join(BENCHMARK_DIR, "seeds", "elf"),
+    ),
+}
+
+# Older versions of the QSYM backend only report their solver time like this
+# (see also parse_solver_time in the fuzzing helper).
+QSYM_SOLVER_TIME = re.compile(rb'^\s*\[STAT\] SMT:.*"solving_time": (\d+)', re.M)
+
+# The simple backend doesn't write test cases but logs each one it finds.
+SIMPLE_NEW_INPUT = b"Found diverging input"
+
+
+class Execution:
+    """The outcome of running a program once."""
+
+    def __init__(self, seconds, max_rss_kib, timed_out, stderr):
+        self.seconds = seconds
+        self.max_rss_kib = max_rss_kib
+        self.timed_out = timed_out
+        self.stderr = stderr
+
+
+def run(measure, command, input_path, env, timeout):
+    """Run the command with the file as standard input and measure it."""
+    with open(input_path, "rb") as stdin, tempfile.TemporaryFile() as stderr, \
+            tempfile.NamedTemporaryFile("r") as report:
+        subprocess.run(
+            [measure, report.name, str(math.ceil(timeout))] + command,
+            stdin=stdin,
+            stdout=subprocess.DEVNULL,
+            stderr=stderr,
+            env=env,
+            check=True,
+        )
+        nanoseconds, max_rss_kib, timed_out = report.read().split()
+
+        stderr.seek(0)
+        return Execution(
+            int(nanoseconds) / 1e9, int(max_rss_kib), timed_out == "1", stderr.read()
+        )
+
+
+def build(compiler, source, output):
+    subprocess.run(
+        [compiler, "-O2", source, "-o", output],
+        check=True,
+        stdout=subprocess.DEVNULL,
+    )
+
+
+def seeds(directory):
+    return sorted(
+        os.path.join(directory, name)
+        for name in os.listdir(directory)
+        if os.path.isfile(os.path.join(directory, name))
+    )
+
+
+def benchmark_native(binary, corpus, args):
+    seconds = 0.0
+    env = dict(os.environ)
+    for _ in range(args.repetitions):
+        for seed in corpus:
+            seconds += run(args.measure, [binary], seed, env, args.timeout).seconds
+    return seconds
+
+
+def solver_seconds(stats_path, stderr):
+    """Determine the solver time of an execution, or None if it's unknown."""
+    try:
+        with open(stats_path) as stats_file:
+            solver = json.load(stats_file)["solver"]
+        if solver["queries"] > 0:
+            return solver["time_ns"] / 1e9
+    except (OSError, ValueError, KeyError):
+        pass
+
+    solver_times = QSYM_SOLVER_TIME.findall(stderr)
+    if solver_times:
+        return int(solver_times[-1]) / 1e6
+    return None
+
+
+def benchmark_symcc(binary, corpus, runtime_dir, work_dir, args):
+    result = {
+        "executions": 0,
+        "timeouts": 0,
+        "seconds": 0.0,
+        "solver_seconds": None,
+        "peak_rss_kib": 0,
+        "generated_inputs": 0,
+    }
+
+    for repetition in range(args.repetitions):
+        for index, seed in enumerate(corpus):
+            output_dir = os.path.join(work_dir, "output-%d-%d" % (repetition, index))
+            os.mkdir(output_dir)
+            stats_path = os.path.join(work_dir, "stats-%d-%d.json" % (repetition, index))
+            env = dict(os.environ)
+            env.update(
+                {
+                    "SYMCC_OUTPUT_DIR": output_dir,
+                    "SYMCC_STATS_FILE": stats_path,
+                    "LD_LIBRARY_PATH": runtime_dir,
+                }
+            )
+
+            execution = run(args.measure, [binary], seed, env, args.timeout)
+            result["executions"] += 1
+            result["timeouts"] += int(execution.timed_out)
+            result["seconds"] += execution.seconds
+            result["peak_rss_kib"] = max(result["peak_rss_kib"], execution.max_rss_kib)
+
+            seconds = solver_seconds(stats_path, execution.stderr)
+            if seconds is not None:
+                result["solver_seconds"] = (result["solver_seconds"] or 0.0) + seconds
+
+            generated = len(os.listdir(output_dir))
+            if generated == 0:
+                generated = execution.stderr.count(SIMPLE_NEW_INPUT)
+            result["generated_inputs"] += generated
+            shutil.rmtree(output_dir)
+            if os.path.exists(stats_path):
+                os.remove(stats_path)
+
+    return result
+
+
+def git_commit():
+    try:
+        return subprocess.run(
+            ["git", "-C", SOURCE_DIR, "rev-parse", "HEAD"],
+            check=True,
+            capture_output=True,
+            text=True,
+        ).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def ratio(numerator, denominator):
+    if numerator is None or not denominator:
+        return None
+    return numerator / denominator
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--symcc", required=True, help="the SymCC compiler wrapper")
+    parser.add_argument("--clang", required=True, help="the compiler for native builds")
+    parser.add_argument(
+        "--runtime",
+        action="append",
+        required=True,
+        metavar="BACKEND=DIR",
+        help="a backend's name and the directory of its libSymRuntime.so "
+        "(may be given several times)",
+    )
+    parser.add_argument(
+        "--target",
+        action="append",
+        choices=sorted(TARGETS),
+        help="run only the given target (may be given several times)",
+    )
+    parser.add_argument(
+        "--repetitions",
+        type=int,
+        default=3,
+        help="how often to run each seed (default %(default)s)",
+    )
+    parser.add_argument(
+        "--timeout",
+        type=float,
+        default=60,
+        help="the timeout per execution in seconds (default %(default)s)",
+    )
+    parser.add_argument("--output", help="the JSON file to write (default stdout)")
+    args = parser.parse_args()
+
+    runtimes = []
+    for runtime in args.runtime:
+        name, sep, directory = runtime.partition("=")
+        if not sep:
+            parser.error("--runtime expects BACKEND=DIR, got " + runtime)
+        runtimes.append((name, os.path.abspath(directory)))
+
+    results = []
+    with tempfile.TemporaryDirectory(prefix="symcc-benchmark-") as work_dir:
+        args.measure = os.path.join(work_dir, "measure")
+        build(args.clang, os.path.join(BENCHMARK_DIR, "measure.c"), args.measure)
+
+        for target in args.target or sorted(TARGETS):
+            source, seed_dir = TARGETS[target]
+            corpus = seeds(seed_dir)
+            native = os.path.join(work_dir, target + ".native")
+            instrumented = os.path.join(work_dir, target + ".symcc")
+            print("Building %s" % target, file=sys.stderr)
+            build(args.clang, source, native)
+            build(args.symcc, source, instrumented)
+
+            native_seconds = benchmark_native(native, corpus, args)
+            for backend, runtime_dir in runtimes:
+                print("Running %s with the %s backend" % (target, backend), file=sys.stderr)
+                result = benchmark_symcc(instrumented, corpus, runtime_dir, work_dir, args)
+                seconds = result["seconds"]
+                results.append(
+                    {
+                        "target": target,
+                        "backend": backend,
+                        "seeds": len(corpus),
+                        "executions": result["executions"],
+                        "timeouts": result["timeouts"],
+                        "native_seconds": native_seconds,
+                        "instrumented_seconds": seconds,
+                        "executions_per_second": ratio(result["executions"], seconds),
+                        "slowdown": ratio(seconds, native_seconds),
+                        "solver_seconds": result["solver_seconds"],
+                        "solver_time_share": ratio(result["solver_seconds"], seconds),
+                        "peak_rss_kib": result["peak_rss_kib"],
+                        "generated_inputs": result["generated_inputs"],
+                        "generated_inputs_per_second": ratio(
+                            result["generated_inputs"], seconds
+                        ),
+                    }
+                )
+
+    report = {
+        "format_version": 1,
+        "commit": git_commit(),
+        "date": datetime.datetime.now(datetime.timezone.utc).isoformat(),
+        "host": platform.node(),
+        "repetitions": args.repetitions,
+        "results": results,
+    }
+
+    if args.output:
+        with open(args.output, "w") as output:
+            json.dump(report, output, indent=2)
+            output.write("\n")
+        print("Results written to " + args.output, file=sys.stderr)
+    else:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+
+
+if __name__ == "__main__":
+    main()
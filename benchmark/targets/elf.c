@@ -0,0 +1,98 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+//
+// A reader of 64-bit little-endian ELF headers and program headers from
+// standard input.
+//
+
+#include <elf.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_INPUT 4096
+
+static unsigned char input[MAX_INPUT];
+static size_t length;
+
+int main(void) {
+  ssize_t n;
+  while (length < MAX_INPUT &&
+         (n = read(STDIN_FILENO, input + length, MAX_INPUT - length)) > 0)
+    length += n;
+
+  Elf64_Ehdr header;
+  if (length < sizeof(header)) {
+    printf("too short\n");
+    return 1;
+  }
+  memcpy(&header, input, sizeof(header));
+
+  if (memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 ||
+      header.e_ident[EI_CLASS] != ELFCLASS64 ||
+      header.e_ident[EI_DATA] != ELFDATA2LSB ||
+      header.e_ident[EI_VERSION] != EV_CURRENT) {
+    printf("not a 64-bit little-endian ELF file\n");
+    return 1;
+  }
+
+  switch (header.e_type) {
+  case ET_REL:
+  case ET_EXEC:
+  case ET_DYN:
+  case ET_CORE:
+    break;
+  default:
+    printf("unknown type %u\n", header.e_type);
+    return 1;
+  }
+
+  if (header.e_machine != EM_X86_64 && header.e_machine != EM_AARCH64) {
+    printf("unsupported machine %u\n", header.e_machine);
+    return 1;
+  }
+
+  if (header.e_phnum == 0) {
+    printf("no program headers\n");
+    return 0;
+  }
+  if (header.e_phentsize != sizeof(Elf64_Phdr) || header.e_phoff > length ||
+      header.e_phnum > (length - header.e_phoff) / sizeof(Elf64_Phdr)) {
+    printf("bad program header table\n");
+    return 1;
+  }
+
+  unsigned loads = 0;
+  for (unsigned i = 0; i < header.e_phnum; i++) {
+    Elf64_Phdr phdr;
+    memcpy(&phdr, input + header.e_phoff + i * sizeof(phdr), sizeof(phdr));
+    if (phdr.p_type == PT_LOAD) {
+      if (phdr.p_filesz > phdr.p_memsz ||
+          (phdr.p_align > 1 && (phdr.p_align & (phdr.p_align - 1)) != 0) ||
+          (phdr.p_align > 1 &&
+           phdr.p_vaddr % phdr.p_align != phdr.p_offset % phdr.p_align)) {
+        printf("bad segment %u\n", i);
+        return 1;
+      }
+      loads++;
+    } else if (phdr.p_type == PT_INTERP &&
+               phdr.p_offset + phdr.p_filesz <= length) {
+      printf("interpreter at offset %lu\n", (unsigned long)phdr.p_offset);
+    }
+  }
+
+  printf("%u loadable segments\n", loads);
+  return 0;
+}
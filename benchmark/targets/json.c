@@ -0,0 +1,199 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+//
+// A validating JSON parser that counts the values in a document read from
+// standard input.
+//
+
+#include <stddef.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define MAX_INPUT 4096
+#define MAX_DEPTH 32
+
+static char input[MAX_INPUT];
+static size_t length, position;
+static unsigned values;
+
+static int parse_value(unsigned depth);
+
+static void skip_whitespace(void) {
+  while (position < length &&
+         (input[position] == ' ' || input[position] == '\t' ||
+          input[position] == '\n' || input[position] == '\r'))
+    position++;
+}
+
+static int expect(char c) {
+  skip_whitespace();
+  if (position < length && input[position] == c) {
+    position++;
+    return 1;
+  }
+  return 0;
+}
+
+static int is_hex(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+         (c >= 'A' && c <= 'F');
+}
+
+static int parse_string(void) {
+  if (!expect('"'))
+    return 0;
+  while (position < length) {
+    char c = input[position++];
+    if (c == '"')
+      return 1;
+    if ((unsigned char)c < 0x20)
+      return 0;
+    if (c != '\\')
+      continue;
+
+    if (position >= length)
+      return 0;
+    switch (input[position++]) {
+    case '"':
+    case '\\':
+    case '/':
+    case 'b':
+    case 'f':
+    case 'n':
+    case 'r':
+    case 't':
+      break;
+    case 'u':
+      for (int i = 0; i < 4; i++) {
+        if (position >= length || !is_hex(input[position++]))
+          return 0;
+      }
+      break;
+    default:
+      return 0;
+    }
+  }
+  return 0;
+}
+
+static int parse_digits(void) {
+  size_t start = position;
+  while (position < length && input[position] >= '0' && input[position] <= '9')
+    position++;
+  return position > start;
+}
+
+static int parse_number(void) {
+  if (position < length && input[position] == '-')
+    position++;
+  if (position < length && input[position] == '0')
+    position++;
+  else if (!parse_digits())
+    return 0;
+
+  if (position < length && input[position] == '.') {
+    position++;
+    if (!parse_digits())
+      return 0;
+  }
+
+  if (position < length && (input[position] == 'e' || input[position] == 'E')) {
+    position++;
+    if (position < length && (input[position] == '+' || input[position] == '-'))
+      position++;
+    if (!parse_digits())
+      return 0;
+  }
+  return 1;
+}
+
+static int parse_literal(const char *literal) {
+  for (; *literal != '\0'; literal++) {
+    if (position >= length || input[position++] != *literal)
+      return 0;
+  }
+  return 1;
+}
+
+static int parse_array(unsigned depth) {
+  if (!expect('['))
+    return 0;
+  if (expect(']'))
+    return 1;
+  do {
+    if (!parse_value(depth + 1))
+      return 0;
+  } while (expect(','));
+  return expect(']');
+}
+
+static int parse_object(unsigned depth) {
+  if (!expect('{'))
+    return 0;
+  if (expect('}'))
+    return 1;
+  do {
+    if (!parse_string() || !expect(':') || !parse_value(depth + 1))
+      return 0;
+  } while (expect(','));
+  return expect('}');
+}
+
+static int parse_value(unsigned depth) {
+  if (depth > MAX_DEPTH)
+    return 0;
+
+  skip_whitespace();
+  if (position >= length)
+    return 0;
+
+  values++;
+  switch (input[position]) {
+  case '{':
+    return parse_object(depth);
+  case '[':
+    return parse_array(depth);
+  case '"':
+    return parse_string();
+  case 't':
+    return parse_literal("true");
+  case 'f':
+    return parse_literal("false");
+  case 'n':
+    return parse_literal("null");
+  default:
+    return parse_number();
+  }
+}
+
+int main(void) {
+  ssize_t n;
+  while (length < MAX_INPUT &&
+         (n = read(STDIN_FILENO, input + length, MAX_INPUT - length)) > 0)
+    length += n;
+
+  if (!parse_value(0)) {
+    printf("invalid at offset %zu\n", position);
+    return 1;
+  }
+  skip_whitespace();
+  if (position != length) {
+    printf("trailing data at offset %zu\n", position);
+    return 1;
+  }
+
+  printf("%u values\n", values);
+  return 0;
+}
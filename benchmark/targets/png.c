@@ -0,0 +1,128 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+//
+// A reader of the PNG signature and chunk headers (with CRCs) from standard
+// input, validating the IHDR chunk.
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_INPUT 4096
+
+static uint8_t input[MAX_INPUT];
+static size_t length;
+
+static uint32_t read_be32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t crc32(const uint8_t *data, size_t size) {
+  uint32_t crc = 0xffffffff;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+static int check_ihdr(const uint8_t *data, uint32_t size) {
+  if (size != 13)
+    return 0;
+
+  uint32_t width = read_be32(data), height = read_be32(data + 4);
+  uint8_t depth = data[8], color = data[9];
+  if (width == 0 || height == 0 || width > 0x7fffffff || height > 0x7fffffff)
+    return 0;
+
+  switch (color) {
+  case 0: // grayscale
+    if (depth != 1 && depth != 2 && depth != 4 && depth != 8 && depth != 16)
+      return 0;
+    break;
+  case 3: // palette
+    if (depth != 1 && depth != 2 && depth != 4 && depth != 8)
+      return 0;
+    break;
+  case 2: // RGB
+  case 4: // grayscale with alpha
+  case 6: // RGBA
+    if (depth != 8 && depth != 16)
+      return 0;
+    break;
+  default:
+    return 0;
+  }
+
+  // Compression, filter and interlace method
+  if (data[10] != 0 || data[11] != 0 || data[12] > 1)
+    return 0;
+
+  printf("%ux%u, depth %u, color type %u\n", width, height, depth, color);
+  return 1;
+}
+
+int main(void) {
+  static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n',
+                                       0x1a, '\n'};
+
+  ssize_t n;
+  while (length < MAX_INPUT &&
+         (n = read(STDIN_FILENO, input + length, MAX_INPUT - length)) > 0)
+    length += n;
+
+  if (length < sizeof(signature) || memcmp(input, signature, 8) != 0) {
+    printf("not a PNG file\n");
+    return 1;
+  }
+
+  size_t offset = sizeof(signature);
+  unsigned chunks = 0;
+  while (offset + 12 <= length) {
+    uint32_t size = read_be32(input + offset);
+    const uint8_t *type = input + offset + 4;
+    if (size > length - offset - 12) {
+      printf("truncated chunk\n");
+      return 1;
+    }
+
+    if (read_be32(type + 4 + size) != crc32(type, 4 + size)) {
+      printf("bad CRC in chunk %u\n", chunks);
+      return 1;
+    }
+
+    if (chunks == 0 && memcmp(type, "IHDR", 4) != 0) {
+      printf("first chunk must be IHDR\n");
+      return 1;
+    }
+    if (memcmp(type, "IHDR", 4) == 0 &&
+        (chunks != 0 || !check_ihdr(type + 4, size))) {
+      printf("bad IHDR\n");
+      return 1;
+    }
+
+    chunks++;
+    offset += 12 + size;
+    if (memcmp(type, "IEND", 4) == 0)
+      break;
+  }
+
+  printf("%u chunks\n", chunks);
+  return 0;
+}
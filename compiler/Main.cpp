@@ -13,11 +13,18 @@
 // SymCC. If not, see <https://www.gnu.org/licenses/>.
 
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Pass.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Transforms/InstCombine/InstCombine.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Scalar/GVN.h>
 
 #if LLVM_VERSION_MAJOR >= 13
 #include <llvm/Passes/PassBuilder.h>
 #include <llvm/Passes/PassPlugin.h>
+#include <llvm/Transforms/Scalar/LICM.h>
+#include <llvm/Transforms/Scalar/LoopPassManager.h>
+#include <llvm/Transforms/Scalar/SimplifyCFG.h>
 
 #if LLVM_VERSION_MAJOR >= 14
 #include <llvm/Passes/OptimizationLevel.h>
@@ -26,24 +33,47 @@ using OptimizationLevel = llvm::PassBuilder::OptimizationLevel;
 #endif
 #endif
 
+#include <cstdlib>
+#include <cstring>
+
 #include "Pass.h"
 
 using namespace llvm;
 
+/// Decide whether to instrument at the end of the optimizer pipeline.
+///
+/// By default, we run just before the vectorizer; with
+/// SYMCC_LATE_INSTRUMENTATION=1, we move to the very end of the pipeline, so
+/// that we instrument vectorized and fully simplified code.
+static bool instrumentLate() {
+  const char *setting = std::getenv("SYMCC_LATE_INSTRUMENTATION");
+  return setting != nullptr && std::strcmp(setting, "1") == 0;
+}
+
 //
 // Legacy pass registration (up to LLVM 13)
 //
 
-void addSymbolizeLegacyPass(const PassManagerBuilder & /* unused */,
+void addSymbolizeLegacyPass(const PassManagerBuilder &builder,
                             legacy::PassManagerBase &PM) {
   PM.add(new SymbolizeLegacyPass());
+
+  // Clean up the instrumentation (see the new pass manager below).
+  if (builder.OptLevel > 0) {
+    PM.add(createInstructionCombiningPass());
+    PM.add(createCFGSimplificationPass());
+    PM.add(createGVNPass());
+    PM.add(createLICMPass());
+  }
 }
 
 // Make the pass known to opt.
 static RegisterPass<SymbolizeLegacyPass> X("symbolize", "Symbolization Pass");
 // Tell frontends to run the pass automatically.
-static struct RegisterStandardPasses Y(PassManagerBuilder::EP_VectorizerStart,
-                                       addSymbolizeLegacyPass);
+static struct RegisterStandardPasses
+    Y(instrumentLate() ? PassManagerBuilder::EP_OptimizerLast
+                       : PassManagerBuilder::EP_VectorizerStart,
+      addSymbolizeLegacyPass);
 static struct RegisterStandardPasses
     Z(PassManagerBuilder::EP_EnabledOnOptLevel0, addSymbolizeLegacyPass);
 
@@ -53,22 +83,53 @@ static struct RegisterStandardPasses
 
 #if LLVM_VERSION_MAJOR >= 13
 
+static void addSymbolizeFunctionPasses(FunctionPassManager &PM,
+                                       OptimizationLevel level) {
+  PM.addPass(SymbolizePass());
+
+  // The instrumentation (including the inlined run-time helpers) is inserted
+  // after most of the optimizer has run, so we schedule a few passes to clean
+  // it up: combine and fold the concreteness checks, merge the resulting
+  // blocks, remove redundant loads of parameter expressions and
+  // shadow-directory entries, and hoist invariant ones out of loops.
+  if (level == OptimizationLevel::O0)
+    return;
+  PM.addPass(InstCombinePass());
+  PM.addPass(SimplifyCFGPass());
+  PM.addPass(GVNPass());
+#if LLVM_VERSION_MAJOR >= 15
+  PM.addPass(createFunctionToLoopPassAdaptor(LICMPass(LICMOptions()),
+                                             /* UseMemorySSA */ true));
+#else
+  PM.addPass(
+      createFunctionToLoopPassAdaptor(LICMPass(), /* UseMemorySSA */ true));
+#endif
+}
+
 PassPluginLibraryInfo getSymbolizePluginInfo() {
   return {LLVM_PLUGIN_API_VERSION, "Symbolization Pass", LLVM_VERSION_STRING,
           [](PassBuilder &PB) {
             // We need to act on the entire module as well as on each function.
             // Those actions are independent from each other, so we register a
             // module pass at the start of the pipeline and a function pass just
-            // before the vectorizer. (There doesn't seem to be a way to run
-            // module passes at the start of the vectorizer, hence the split.)
+            // before the vectorizer or at the very end. (There doesn't seem to
+            // be a way to run module passes at the start of the vectorizer,
+            // hence the split.)
             PB.registerPipelineStartEPCallback(
                 [](ModulePassManager &PM, OptimizationLevel) {
                   PM.addPass(SymbolizePass());
                 });
-            PB.registerVectorizerStartEPCallback(
-                [](FunctionPassManager &PM, OptimizationLevel) {
-                  PM.addPass(SymbolizePass());
-                });
+            if (instrumentLate()) {
+              PB.registerOptimizerLastEPCallback(
+                  [](ModulePassManager &PM, OptimizationLevel level) {
+                    FunctionPassManager FPM;
+                    addSymbolizeFunctionPasses(FPM, level);
+                    PM.addPass(
+                        createModuleToFunctionPassAdaptor(std::move(FPM)));
+                  });
+            } else {
+              PB.registerVectorizerStartEPCallback(addSymbolizeFunctionPasses);
+            }
           }};
 }
 
@@ -14,12 +14,30 @@
 
 #include "Pass.h"
 
+#include <llvm/ADT/SetVector.h>
+#include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Analysis/CFG.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/Dominators.h>
 #include <llvm/IR/InstIterator.h>
+#include <llvm/IR/IntrinsicInst.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/SpecialCaseList.h>
+#if LLVM_VERSION_MAJOR >= 10
+#include <llvm/Support/VirtualFileSystem.h>
+#endif
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Cloning.h>
 #include <llvm/Transforms/Utils/ModuleUtils.h>
 
+#include <cstdlib>
+#include <memory>
+
 #include "Runtime.h"
 #include "Symbolizer.h"
 
@@ -40,6 +58,102 @@ namespace {
 
 static constexpr char kSymCtorName[] = "__sym_ctor";
 
+/// The user's selection of functions to instrument.
+///
+/// Allowlist and denylist use the format of the sanitizers' special-case lists
+/// (i.e., "fun:" and "src:" entries with glob patterns), while the list of hot
+/// functions contains exact names, so that it can be generated from a profile
+/// with many entries. See docs/Configuration.txt for details.
+class InstrumentationFilter {
+public:
+  InstrumentationFilter()
+      : allowlist(loadSpecialCaseList("SYMCC_INSTRUMENT_ALLOWLIST")),
+        denylist(loadSpecialCaseList("SYMCC_INSTRUMENT_DENYLIST")) {
+    loadHotFunctions();
+  }
+
+  bool shouldInstrument(const Function &F) const {
+    auto name = F.getName();
+    auto matches = [&](const SpecialCaseList &list) {
+      return list.inSection("symcc", "fun", name) ||
+             list.inSection("symcc", "src", F.getParent()->getSourceFileName());
+    };
+
+    if (allowlist != nullptr && !matches(*allowlist))
+      return false;
+    if (denylist != nullptr && matches(*denylist))
+      return false;
+    return hotFunctions.count(name) == 0;
+  }
+
+private:
+  static std::unique_ptr<SpecialCaseList>
+  loadSpecialCaseList(const char *variable) {
+    const char *path = std::getenv(variable);
+    if (path == nullptr || *path == '\0')
+      return nullptr;
+
+    std::string error;
+#if LLVM_VERSION_MAJOR >= 10
+    auto list =
+        SpecialCaseList::create({path}, *vfs::getRealFileSystem(), error);
+#else
+    auto list = SpecialCaseList::create({path}, error);
+#endif
+    if (list == nullptr)
+      errs() << "Warning: ignoring " << variable << ": " << error << '\n';
+    return list;
+  }
+
+  void loadHotFunctions() {
+    const char *path = std::getenv("SYMCC_HOT_FUNCTIONS");
+    if (path == nullptr || *path == '\0')
+      return;
+
+    auto buffer = MemoryBuffer::getFile(path);
+    if (!buffer) {
+      errs() << "Warning: failed to read the hot functions from " << path
+             << ": " << buffer.getError().message() << '\n';
+      return;
+    }
+
+    // Each line starts with a function name; we ignore the rest of the line
+    // (e.g., sample counts) as well as empty lines and comments.
+    SmallVector<StringRef, 0> lines;
+    (*buffer)->getBuffer().split(lines, '\n');
+    for (auto line : lines) {
+      auto name = getToken(line).first;
+      if (!name.empty() && !name.startswith("#"))
+        hotFunctions.insert(name);
+    }
+  }
+
+  std::unique_ptr<SpecialCaseList> allowlist, denylist;
+  StringSet<> hotFunctions;
+};
+
+bool shouldInstrument(const Function &F) {
+  static const InstrumentationFilter filter;
+  return filter.shouldInstrument(F);
+}
+
+/// Determine whether an instruction needs instrumentation in code that treats
+/// all values as concrete.
+///
+/// Such code still has to clear the shadow of the memory that it writes, and it
+/// has to follow the parameter and return-value protocol of the run-time
+/// library (passing null expressions), so that symbolic code around it doesn't
+/// pick up stale expressions.
+bool needsConcreteInstrumentation(Instruction &I) {
+  if (isa<StoreInst>(I) || isa<ReturnInst>(I))
+    return true;
+
+  if (auto *call = dyn_cast<CallBase>(&I))
+    return !isa<IntrinsicInst>(call) || call->mayWriteToMemory();
+
+  return false;
+}
+
 bool instrumentModule(Module &M) {
   DEBUG(errs() << "Symbolizer module instrumentation\n");
 
@@ -51,6 +165,10 @@ bool instrumentModule(Module &M) {
       function.setName(name + "_symbolized");
   }
 
+  // Make the fast paths of the run-time library available for inlining.
+  if (linkInlineRuntimeHelpers(M))
+    DEBUG(errs() << "Linked the inlinable run-time helpers\n");
+
   // Insert a constructor that initializes the runtime and any globals.
   Function *ctor;
   std::tie(ctor, std::ignore) = createSanitizerCtorAndInitFunctions(
@@ -60,30 +178,328 @@ bool instrumentModule(Module &M) {
   return true;
 }
 
+/// Determine whether a basic block can run in a concrete copy of its function.
+///
+/// Code that doesn't read memory or call other functions can only observe
+/// symbolic data through the values that flow into it.
+bool canRunConcretely(BasicBlock &B) {
+  if (B.hasAddressTaken())
+    return false;
+
+  for (auto &I : B) {
+    if (I.mayReadFromMemory() || I.isAtomic())
+      return false;
+
+    // Calls would need the parameter and return-value protocol of the
+    // run-time library; memory intrinsics would need the shadow.
+    if (auto *call = dyn_cast<CallBase>(&I)) {
+      if (!isa<IntrinsicInst>(call) || call->mayWriteToMemory())
+        return false;
+    }
+  }
+
+  return true;
+}
+
+/// Determine whether a function qualifies for a concrete fast path.
+///
+/// If all parameters of such a function are concrete, we can run an
+/// uninstrumented copy of the function instead of the symbolic version.
+bool canUseConcreteFastPath(Function &F) {
+  if (std::all_of(F.arg_begin(), F.arg_end(),
+                  [](Argument &arg) { return arg.user_empty(); }))
+    return false;
+
+  return std::all_of(F.begin(), F.end(),
+                     [](BasicBlock &B) { return canRunConcretely(B); });
+}
+
+/// A loop header where the symbolic version of a function can switch to the
+/// concrete copy.
+struct ConcreteLoopSwitch {
+  BasicBlock *header;
+
+  /// The blocks that are reachable from the header.
+  SmallPtrSet<BasicBlock *, 16> region;
+
+  /// The values that the region uses but the copy doesn't compute itself;
+  /// their expressions decide whether we can switch.
+  SmallVector<Value *, 8> liveValues;
+};
+
+/// Find the loops where a function that doesn't qualify for a concrete fast
+/// path can switch to concrete code.
+///
+/// If nothing that is reachable from a loop header reads memory or calls other
+/// functions, then the loop and everything after it are concrete whenever the
+/// values that flow into the header are. We only consider outermost loops
+/// whose header isn't reachable from another such loop: then no copied block
+/// precedes a switch, and the copy can use the values computed before it.
+std::vector<ConcreteLoopSwitch> findConcreteLoopSwitches(Function &F) {
+  DominatorTree dominatorTree(F);
+  LoopInfo loopInfo(dominatorTree);
+
+  std::vector<ConcreteLoopSwitch> candidates;
+  for (auto *loop : loopInfo) {
+    ConcreteLoopSwitch candidate{loop->getHeader(), {}, {}};
+    SmallVector<BasicBlock *, 16> worklist{candidate.header};
+    bool canSwitch = true;
+    while (canSwitch && !worklist.empty()) {
+      auto *B = worklist.pop_back_val();
+      if (!candidate.region.insert(B).second)
+        continue;
+
+      canSwitch = canRunConcretely(*B);
+      worklist.append(succ_begin(B), succ_end(B));
+    }
+
+    if (canSwitch)
+      candidates.push_back(std::move(candidate));
+  }
+
+  std::vector<ConcreteLoopSwitch> switches;
+  for (auto &candidate : candidates) {
+    if (std::none_of(candidates.begin(), candidates.end(),
+                     [&](const ConcreteLoopSwitch &other) {
+                       return &other != &candidate &&
+                              other.region.count(candidate.header);
+                     }))
+      switches.push_back(std::move(candidate));
+  }
+
+  return switches;
+}
+
+/// Add concrete copies of the given blocks to their function.
+///
+/// Uses of values from outside the copied blocks keep referring to the
+/// originals, and PHI nodes in the copy drop their incoming values from
+/// outside. The function collects the cloned blocks in the given set and the
+/// mapping from original to copied values in the value map.
+void cloneConcreteBlocks(ArrayRef<BasicBlock *> blocks,
+                         ValueToValueMapTy &valueMap,
+                         SmallPtrSetImpl<BasicBlock *> &concreteBlocks) {
+  auto &F = *blocks.front()->getParent();
+  SmallVector<BasicBlock *, 0> clonedBlocks;
+  for (auto *B : blocks) {
+    auto *clone = CloneBasicBlock(B, valueMap, ".concrete", &F);
+    valueMap[B] = clone;
+    clonedBlocks.push_back(clone);
+    concreteBlocks.insert(clone);
+  }
+  remapInstructionsInBlocks(clonedBlocks, valueMap);
+
+  for (auto *clone : clonedBlocks) {
+    for (auto &phi : clone->phis()) {
+      for (unsigned incoming = phi.getNumIncomingValues(); incoming-- > 0;) {
+        if (!concreteBlocks.count(phi.getIncomingBlock(incoming)))
+          phi.removeIncomingValue(incoming, /* DeletePHIIfEmpty */ false);
+      }
+    }
+  }
+}
+
+/// Add a concrete copy of the function's body.
+///
+/// We split the entry block after the static allocas, so that both versions
+/// share them, and clone all other blocks. The entry block ends up as a
+/// dispatch block that unconditionally jumps to the original (i.e., soon to be
+/// symbolic) code; it's up to the symbolizer to insert the actual check. The
+/// function returns the entry of the concrete copy and collects all cloned
+/// blocks in the given set.
+BasicBlock *createConcreteCopy(Function &F,
+                               SmallPtrSetImpl<BasicBlock *> &concreteBlocks) {
+  auto &dispatch = F.getEntryBlock();
+  auto splitPoint = dispatch.getFirstInsertionPt();
+  while (isa<AllocaInst>(*splitPoint))
+    ++splitPoint;
+  SplitBlock(&dispatch, &*splitPoint);
+
+  SmallVector<BasicBlock *, 0> originalBlocks;
+  for (auto &B : F) {
+    if (&B != &dispatch)
+      originalBlocks.push_back(&B);
+  }
+
+  ValueToValueMapTy valueMap;
+  cloneConcreteBlocks(originalBlocks, valueMap, concreteBlocks);
+  return cast<BasicBlock>(valueMap[originalBlocks.front()]);
+}
+
+/// Add a concrete copy of everything that is reachable from the given loop
+/// headers.
+///
+/// The headers' copies receive the values of the original PHI nodes from the
+/// original headers, which are going to branch to them (see
+/// Symbolizer::insertConcreteLoopSwitch). For each switch, we record the
+/// values that must be concrete for the copy to take over.
+void createConcreteLoopCopy(std::vector<ConcreteLoopSwitch> &switches,
+                            ValueToValueMapTy &valueMap,
+                            SmallPtrSetImpl<BasicBlock *> &concreteBlocks) {
+  SetVector<BasicBlock *> originalBlocks;
+  for (auto &loopSwitch : switches) {
+    for (auto &B : *loopSwitch.header->getParent()) {
+      if (loopSwitch.region.count(&B))
+        originalBlocks.insert(&B);
+    }
+  }
+
+  for (auto &loopSwitch : switches) {
+    SetVector<Value *> liveValues;
+    for (auto *B : loopSwitch.region) {
+      for (auto &I : *B) {
+        auto *phi = dyn_cast<PHINode>(&I);
+        for (unsigned index = 0; index < I.getNumOperands(); index++) {
+          // The copy drops incoming values from blocks that it doesn't
+          // contain.
+          if (phi != nullptr &&
+              !originalBlocks.count(phi->getIncomingBlock(index)))
+            continue;
+
+          auto *operand = I.getOperand(index);
+          auto *operandInst = dyn_cast<Instruction>(operand);
+          if (isa<Argument>(operand) ||
+              (operandInst != nullptr &&
+               (!originalBlocks.count(operandInst->getParent()) ||
+                (isa<PHINode>(operandInst) &&
+                 operandInst->getParent() == loopSwitch.header))))
+            liveValues.insert(operand);
+        }
+      }
+    }
+    loopSwitch.liveValues.assign(liveValues.begin(), liveValues.end());
+  }
+
+  cloneConcreteBlocks(originalBlocks.getArrayRef(), valueMap, concreteBlocks);
+
+  for (auto &loopSwitch : switches) {
+    for (auto &phi : loopSwitch.header->phis())
+      cast<PHINode>(valueMap[&phi])->addIncoming(&phi, loopSwitch.header);
+  }
+}
+
+/// Inline the calls to run-time helpers that linkInlineRuntimeHelpers has
+/// added to the module.
+void inlineRuntimeHelpers(Function &F) {
+  SmallVector<CallInst *, 0> helperCalls;
+  for (auto &I : instructions(F)) {
+    if (auto *call = dyn_cast<CallInst>(&I)) {
+      auto *callee = call->getCalledFunction();
+      if (callee != nullptr && !callee->isDeclaration() &&
+          isInlineRuntimeHelper(*callee))
+        helperCalls.push_back(call);
+    }
+  }
+
+  for (auto *call : helperCalls) {
+    InlineFunctionInfo inlineInfo;
+#if LLVM_VERSION_MAJOR >= 11
+    bool success = InlineFunction(*call, inlineInfo).isSuccess();
+#else
+    bool success = InlineFunction(call, inlineInfo);
+#endif
+    if (!success)
+      errs() << "Warning: failed to inline a run-time helper into "
+             << F.getName() << '\n';
+  }
+}
+
 bool instrumentFunction(Function &F) {
   auto functionName = F.getName();
-  if (functionName == kSymCtorName)
+  if (functionName == kSymCtorName || isInlineRuntimeHelper(F))
     return false;
 
+  Symbolizer symbolizer(*F.getParent());
+
+  if (!shouldInstrument(F)) {
+    DEBUG(errs() << "Instrumenting excluded function ");
+    DEBUG(errs().write_escaped(functionName) << " as concrete code\n");
+
+    SmallVector<Instruction *, 0> interfaceInstructions;
+    for (auto &I : instructions(F)) {
+      if (needsConcreteInstrumentation(I))
+        interfaceInstructions.push_back(&I);
+    }
+
+    for (auto *I : interfaceInstructions)
+      symbolizer.visit(I);
+
+    symbolizer.shortCircuitExpressionUses();
+    symbolizer.guardNotifications(F);
+    inlineRuntimeHelpers(F);
+    assert(!verifyFunction(F, &errs()) &&
+           "SymbolizePass produced invalid bitcode");
+    return true;
+  }
+
   DEBUG(errs() << "Symbolizing function ");
   DEBUG(errs().write_escaped(functionName) << '\n');
 
+  SmallPtrSet<BasicBlock *, 8> concreteBlocks;
+  BasicBlock *concreteEntry = nullptr;
+  std::vector<ConcreteLoopSwitch> loopSwitches;
+  ValueToValueMapTy loopValueMap;
+  if (canUseConcreteFastPath(F)) {
+    DEBUG(errs() << "Adding a concrete fast path\n");
+    concreteEntry = createConcreteCopy(F, concreteBlocks);
+  } else {
+    loopSwitches = findConcreteLoopSwitches(F);
+    if (!loopSwitches.empty()) {
+      DEBUG(errs() << "Adding a concrete copy for " << loopSwitches.size()
+                   << " loop(s)\n");
+      createConcreteLoopCopy(loopSwitches, loopValueMap, concreteBlocks);
+    }
+  }
+
+  if (!concreteBlocks.empty()) {
+    // The concrete copy only needs to keep the shadow memory and the return
+    // expression up to date. We instrument it before handling the arguments,
+    // so that all values in the copy are treated as concrete.
+    for (auto *B : concreteBlocks) {
+      for (auto &I : *B) {
+        if (needsConcreteInstrumentation(I))
+          symbolizer.visit(I);
+      }
+    }
+  }
+
   SmallVector<Instruction *, 0> allInstructions;
   allInstructions.reserve(F.getInstructionCount());
-  for (auto &I : instructions(F))
-    allInstructions.push_back(&I);
+  for (auto &I : instructions(F)) {
+    if (!concreteBlocks.count(I.getParent()))
+      allInstructions.push_back(&I);
+  }
 
-  Symbolizer symbolizer(*F.getParent());
   symbolizer.symbolizeFunctionArguments(F);
+  if (concreteEntry != nullptr)
+    symbolizer.insertConcreteFastPathCheck(F.getEntryBlock(), concreteEntry);
 
-  for (auto &basicBlock : F)
-    symbolizer.insertBasicBlockNotification(basicBlock);
+  // Backends that request sparse notifications only hear about the function
+  // entry and the targets of back edges (i.e., the loop headers).
+  SmallVector<std::pair<const BasicBlock *, const BasicBlock *>, 8> backEdges;
+  FindFunctionBackedges(F, backEdges);
+  SmallPtrSet<const BasicBlock *, 8> sparseBlocks{&F.getEntryBlock()};
+  for (auto &edge : backEdges)
+    sparseBlocks.insert(edge.second);
+
+  for (auto &basicBlock : F) {
+    if (!concreteBlocks.count(&basicBlock))
+      symbolizer.insertBasicBlockNotification(
+          basicBlock, sparseBlocks.count(&basicBlock) != 0);
+  }
 
   for (auto *instPtr : allInstructions)
     symbolizer.visit(instPtr);
 
+  for (auto &loopSwitch : loopSwitches)
+    symbolizer.insertConcreteLoopSwitch(
+        *loopSwitch.header, cast<BasicBlock>(loopValueMap[loopSwitch.header]),
+        loopSwitch.liveValues);
+
   symbolizer.finalizePHINodes();
   symbolizer.shortCircuitExpressionUses();
+  symbolizer.guardNotifications(F);
+  inlineRuntimeHelpers(F);
 
   // DEBUG(errs() << F << '\n');
   assert(!verifyFunction(F, &errs()) &&
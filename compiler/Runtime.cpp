@@ -14,14 +14,24 @@
 
 #include "Runtime.h"
 
+#include <cstdlib>
+#include <cstring>
 #include <llvm/ADT/StringSet.h>
 #include <llvm/Config/llvm-config.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
 
 using namespace llvm;
 
 namespace {
 
+constexpr char kInlineHelperPrefix[] = "_sym_inline_";
+
 template <typename... ArgsTy>
 SymFnT import(llvm::Module &M, llvm::StringRef name, llvm::Type *ret,
               ArgsTy... args) {
@@ -32,6 +42,27 @@ SymFnT import(llvm::Module &M, llvm::StringRef name, llvm::Type *ret,
 #endif
 }
 
+/// Like import, but use the inlinable helper for the function if the module
+/// contains one (see linkInlineRuntimeHelpers).
+template <typename... ArgsTy>
+SymFnT importInlinable(llvm::Module &M, llvm::StringRef name, llvm::Type *ret,
+                       ArgsTy... args) {
+  assert(name.startswith("_sym_") && "Run-time functions start with _sym_");
+  auto *helper = M.getFunction(
+      (Twine(kInlineHelperPrefix) + name.drop_front(strlen("_sym_"))).str());
+  if (helper != nullptr && !helper->isDeclaration()) {
+    auto *expectedType = FunctionType::get(
+        ret, {static_cast<llvm::Type *>(args)...}, /* isVarArg */ false);
+    if (helper->getFunctionType() == expectedType)
+      return helper;
+
+    errs() << "Warning: the inlinable helper for " << name
+           << " has the wrong type; using the library function\n";
+  }
+
+  return import(M, name, ret, args...);
+}
+
 } // namespace
 
 Runtime::Runtime(Module &M) {
@@ -70,6 +101,17 @@ Runtime::Runtime(Module &M) {
   buildBoolOr = import(M, "_sym_build_bool_or", ptrT, ptrT, ptrT);
   buildBoolXor = import(M, "_sym_build_bool_xor", ptrT, ptrT, ptrT);
   buildBoolToBit = import(M, "_sym_build_bool_to_bit", ptrT, ptrT);
+  buildCtpop = import(M, "_sym_build_ctpop", ptrT, ptrT);
+  buildCtlz = import(M, "_sym_build_ctlz", ptrT, ptrT);
+  buildCttz = import(M, "_sym_build_cttz", ptrT, ptrT);
+  buildFunnelShiftLeft =
+      import(M, "_sym_build_funnel_shift_left", ptrT, ptrT, ptrT, ptrT);
+  buildFunnelShiftRight =
+      import(M, "_sym_build_funnel_shift_right", ptrT, ptrT, ptrT, ptrT);
+  buildUnsignedMin = import(M, "_sym_build_unsigned_min", ptrT, ptrT, ptrT);
+  buildUnsignedMax = import(M, "_sym_build_unsigned_max", ptrT, ptrT, ptrT);
+  buildSignedMin = import(M, "_sym_build_signed_min", ptrT, ptrT, ptrT);
+  buildSignedMax = import(M, "_sym_build_signed_max", ptrT, ptrT, ptrT);
   pushPathConstraint = import(M, "_sym_push_path_constraint", voidT, ptrT, IRB.getInt1Ty(), intPtrType);
   pushSwitchConstraint = import(M, "_sym_push_switch_constraint", voidT, ptrT, IRB.getInt1Ty(), intPtrType, intPtrType, intPtrType);
 
@@ -81,11 +123,12 @@ Runtime::Runtime(Module &M) {
   concretizeSize = import(M, "_sym_concretize_size", ptrT, ptrT, intPtrType, intPtrType);
 
   setParameterExpression =
-      import(M, "_sym_set_parameter_expression", voidT, int8T, ptrT);
+      importInlinable(M, "_sym_set_parameter_expression", voidT, int8T, ptrT);
   getParameterExpression =
-      import(M, "_sym_get_parameter_expression", ptrT, int8T);
-  setReturnExpression = import(M, "_sym_set_return_expression", voidT, ptrT);
-  getReturnExpression = import(M, "_sym_get_return_expression", ptrT);
+      importInlinable(M, "_sym_get_parameter_expression", ptrT, int8T);
+  setReturnExpression =
+      importInlinable(M, "_sym_set_return_expression", voidT, ptrT);
+  getReturnExpression = importInlinable(M, "_sym_get_return_expression", ptrT);
 
 #define LOAD_BINARY_OPERATOR_HANDLER(constant, name)                           \
   binaryOperatorHandlers[Instruction::constant] =                              \
@@ -114,6 +157,20 @@ Runtime::Runtime(Module &M) {
 
 #undef LOAD_BINARY_OPERATOR_HANDLER
 
+#define LOAD_SIGNED_OPERATOR_HANDLERS(table, constant, name, suffix)         \
+  table[Instruction::constant][0] =                                            \
+      import(M, "_sym_build_unsigned_" #name #suffix, ptrT, ptrT, ptrT);       \
+  table[Instruction::constant][1] =                                            \
+      import(M, "_sym_build_signed_" #name #suffix, ptrT, ptrT, ptrT);
+
+  LOAD_SIGNED_OPERATOR_HANDLERS(overflowCheckHandlers, Add, add, _overflow)
+  LOAD_SIGNED_OPERATOR_HANDLERS(overflowCheckHandlers, Sub, sub, _overflow)
+  LOAD_SIGNED_OPERATOR_HANDLERS(overflowCheckHandlers, Mul, mul, _overflow)
+  LOAD_SIGNED_OPERATOR_HANDLERS(saturatingOperatorHandlers, Add, add, _sat)
+  LOAD_SIGNED_OPERATOR_HANDLERS(saturatingOperatorHandlers, Sub, sub, _sat)
+
+#undef LOAD_SIGNED_OPERATOR_HANDLERS
+
 #define LOAD_COMPARISON_HANDLER(constant, name)                                \
   comparisonHandlers[CmpInst::constant] =                                      \
       import(M, "_sym_build_" #name, ptrT, ptrT, ptrT);
@@ -172,14 +229,14 @@ Runtime::Runtime(Module &M) {
                     ptrT, // concrete_src,
                     intPtrType); // concrete_size
   readMemory =
-      import(M, "_sym_read_memory",
+      importInlinable(M, "_sym_read_memory",
       ptrT,         // retval: expression returned from read
       ptrT,         // symbolic address
       intPtrType,   // concrete address
       intPtrType,   // concrete size
       int8T);       // bool little_endian
 
-  writeMemory = import(M, "_sym_write_memory",
+  writeMemory = importInlinable(M, "_sym_write_memory",
     voidT,        // retval: void
     ptrT,         // symbolic_address_expr
     ptrT,         // symbolic_value_expr
@@ -190,10 +247,20 @@ Runtime::Runtime(Module &M) {
       import(M, "_sym_build_insert", ptrT, ptrT, ptrT, IRB.getInt64Ty(), int8T);
   buildExtract = import(M, "_sym_build_extract", ptrT, ptrT, IRB.getInt64Ty(),
                         IRB.getInt64Ty(), int8T);
+  concatHelper = import(M, "_sym_concat_helper", ptrT, ptrT, ptrT);
+  extractHelper = import(M, "_sym_extract_helper", ptrT, ptrT, intPtrType,
+                         intPtrType);
 
   notifyCall = import(M, "_sym_notify_call", voidT, intPtrType);
   notifyRet = import(M, "_sym_notify_ret", voidT, intPtrType);
   notifyBasicBlock = import(M, "_sym_notify_basic_block", voidT, intPtrType);
+
+  // The backend never changes its choice of notifications, so we declare the
+  // variable constant; this lets the optimizer reuse loads across calls.
+  backendNotifications =
+      M.getOrInsertGlobal("_sym_backend_notifications", IRB.getInt32Ty());
+  if (auto *global = dyn_cast<GlobalVariable>(backendNotifications))
+    global->setConstant(true);
 }
 
 /// Decide whether a function is called symbolically.
@@ -214,3 +281,56 @@ bool isInterceptedFunction(const Function &f) {
 
   return (kInterceptedFunctions.count(f.getName()) > 0);
 }
+
+bool linkInlineRuntimeHelpers(Module &M) {
+  const char *path = std::getenv("SYMCC_RUNTIME_BITCODE");
+  if (path == nullptr || *path == '\0')
+    return false;
+
+  SMDiagnostic error;
+  auto helpers = parseIRFile(path, error, M.getContext());
+  if (helpers == nullptr) {
+    errs() << "Warning: failed to load the run-time helpers from " << path
+           << ": " << error.getMessage() << '\n';
+    return false;
+  }
+
+  // The helpers are compiled for a specific target; linking them into a
+  // module for another one (e.g., 64-bit helpers into a 32-bit module) would
+  // produce broken code.
+  if (helpers->getDataLayout() != M.getDataLayout() ||
+      helpers->getTargetTriple() != M.getTargetTriple()) {
+    errs() << "Warning: the run-time helpers in " << path
+           << " were compiled for a different target; not inlining them\n";
+    return false;
+  }
+
+  // Make the helpers private to the module, so that each object file can have
+  // its own copy. (This is what clang does for -mlink-builtin-bitcode.)
+  if (Linker::linkModules(M, std::move(helpers), Linker::Flags::None,
+                          [](Module &M, const StringSet<> &linkedNames) {
+                            internalizeModule(M, [&](const GlobalValue &GV) {
+                              return !GV.hasName() ||
+                                     linkedNames.count(GV.getName()) == 0;
+                            });
+                          })) {
+    errs() << "Warning: failed to link the run-time helpers from " << path
+           << '\n';
+    return false;
+  }
+
+  // We call the helpers only after the optimizer has had its chance to delete
+  // unused internal functions, so we need to keep them alive until then.
+  SmallVector<GlobalValue *, 8> helperFunctions;
+  for (auto &F : M.functions()) {
+    if (isInlineRuntimeHelper(F) && !F.isDeclaration())
+      helperFunctions.push_back(&F);
+  }
+  appendToCompilerUsed(M, helperFunctions);
+
+  return true;
+}
+
+bool isInlineRuntimeHelper(const Function &F) {
+  return F.getName().startswith(kInlineHelperPrefix);
+}
@@ -24,6 +24,13 @@
   using SymFnT = llvm::FunctionCallee;
 #endif
 
+/// Flags in _sym_backend_notifications (see runtime/RuntimeCommon.h).
+enum BackendNotification : uint32_t {
+  kNotifyCalls = 1 << 0,
+  kNotifyBasicBlocks = 1 << 1,
+  kNotifySparseBasicBlocks = 1 << 2,
+};
+
 /// Runtime functions
 struct Runtime {
   Runtime(llvm::Module &M);
@@ -50,6 +57,15 @@ struct Runtime {
   SymFnT buildBoolOr{};
   SymFnT buildBoolXor{};
   SymFnT buildBoolToBit{};
+  SymFnT buildCtpop{};
+  SymFnT buildCtlz{};
+  SymFnT buildCttz{};
+  SymFnT buildFunnelShiftLeft{};
+  SymFnT buildFunnelShiftRight{};
+  SymFnT buildUnsignedMin{};
+  SymFnT buildUnsignedMax{};
+  SymFnT buildSignedMin{};
+  SymFnT buildSignedMax{};
   SymFnT pushPathConstraint{};
   SymFnT pushSwitchConstraint{};
   SymFnT concretizePointer{};
@@ -65,10 +81,15 @@ struct Runtime {
   SymFnT writeMemory{};
   SymFnT buildInsert{};
   SymFnT buildExtract{};
+  SymFnT concatHelper{};
+  SymFnT extractHelper{};
   SymFnT notifyCall{};
   SymFnT notifyRet{};
   SymFnT notifyBasicBlock{};
 
+  /// The backend's choice of notifications (_sym_backend_notifications).
+  llvm::Constant *backendNotifications{};
+
   /// Mapping from icmp predicates to the functions that build the corresponding
   /// symbolic expressions.
   std::array<SymFnT, llvm::CmpInst::BAD_ICMP_PREDICATE>
@@ -78,8 +99,30 @@ struct Runtime {
   /// corresponding symbolic expressions.
   std::array<SymFnT, llvm::Instruction::BinaryOpsEnd>
       binaryOperatorHandlers{};
+
+  /// Functions that check whether an addition, subtraction or multiplication
+  /// overflows, indexed by the binary operator and signedness.
+  std::array<std::array<SymFnT, 2>, llvm::Instruction::BinaryOpsEnd>
+      overflowCheckHandlers{};
+
+  /// Functions that build saturating additions and subtractions, indexed like
+  /// overflowCheckHandlers.
+  std::array<std::array<SymFnT, 2>, llvm::Instruction::BinaryOpsEnd>
+      saturatingOperatorHandlers{};
 };
 
 bool isInterceptedFunction(const llvm::Function &f);
 
+/// Link the inlinable run-time helpers into the module.
+///
+/// The helpers (see runtime/InlineHelpers.c) are fast paths of the hottest
+/// run-time functions. We load them from the bitcode file specified in the
+/// environment variable SYMCC_RUNTIME_BITCODE and make them private to the
+/// module; Runtime then uses them instead of the library functions. Returns
+/// whether the helpers are available.
+bool linkInlineRuntimeHelpers(llvm::Module &M);
+
+/// Decide whether a function is one of the inlinable run-time helpers.
+bool isInlineRuntimeHelper(const llvm::Function &F);
+
 #endif
@@ -18,6 +18,7 @@
 #include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/GetElementPtrTypeIterator.h>
+#include <llvm/IR/IntrinsicInst.h>
 #include <llvm/IR/Intrinsics.h>
 #include <llvm/Transforms/Utils/BasicBlockUtils.h>
 
@@ -25,6 +26,37 @@
 
 using namespace llvm;
 
+namespace {
+
+/// Decide whether the solver represents values of the type as bit vectors.
+bool isBitVectorInteger(Type *type) {
+  return type->isIntegerTy() && !type->isIntegerTy(1);
+}
+
+/// Describe an arithmetic intrinsic with overflow check by its operation and
+/// signedness.
+std::optional<std::pair<Instruction::BinaryOps, bool>>
+getOverflowCheckedOperation(Intrinsic::ID id) {
+  switch (id) {
+  case Intrinsic::uadd_with_overflow:
+    return {{Instruction::Add, false}};
+  case Intrinsic::sadd_with_overflow:
+    return {{Instruction::Add, true}};
+  case Intrinsic::usub_with_overflow:
+    return {{Instruction::Sub, false}};
+  case Intrinsic::ssub_with_overflow:
+    return {{Instruction::Sub, true}};
+  case Intrinsic::umul_with_overflow:
+    return {{Instruction::Mul, false}};
+  case Intrinsic::smul_with_overflow:
+    return {{Instruction::Mul, true}};
+  default:
+    return {};
+  }
+}
+
+} // namespace
+
 void Symbolizer::symbolizeFunctionArguments(Function &F) {
   // The main function doesn't receive symbolic arguments.
   if (F.getName() == "main")
@@ -39,9 +71,48 @@ void Symbolizer::symbolizeFunctionArguments(Function &F) {
   }
 }
 
-void Symbolizer::insertBasicBlockNotification(llvm::BasicBlock &B) {
+void Symbolizer::insertBasicBlockNotification(llvm::BasicBlock &B,
+                                              bool inSparseSet) {
   IRBuilder<> IRB(&*B.getFirstInsertionPt());
-  IRB.CreateCall(runtime.notifyBasicBlock, getTargetPreferredInt(&B));
+  auto *call =
+      IRB.CreateCall(runtime.notifyBasicBlock, getTargetPreferredInt(&B));
+  notifications.push_back(
+      {call, inSparseSet ? kNotifyBasicBlocks | kNotifySparseBasicBlocks
+                         : kNotifyBasicBlocks});
+}
+
+void Symbolizer::insertConcreteFastPathCheck(BasicBlock &dispatch,
+                                             BasicBlock *concreteEntry) {
+  auto *branch = cast<BranchInst>(dispatch.getTerminator());
+  assert(branch->isUnconditional() &&
+         "The dispatch block must jump to the symbolic version");
+
+  IRBuilder<> IRB(branch);
+  Value *allConcrete = IRB.getTrue();
+  for (auto &arg : dispatch.getParent()->args()) {
+    if (auto *expr = getSymbolicExpression(&arg))
+      allConcrete = IRB.CreateAnd(allConcrete, IRB.CreateIsNull(expr));
+  }
+
+  ReplaceInstWithInst(branch, BranchInst::Create(concreteEntry,
+                                                 branch->getSuccessor(0),
+                                                 allConcrete));
+}
+
+void Symbolizer::insertConcreteLoopSwitch(BasicBlock &header,
+                                          BasicBlock *concreteHeader,
+                                          ArrayRef<Value *> liveValues) {
+  auto *body = SplitBlock(&header, header.getFirstNonPHI());
+
+  IRBuilder<> IRB(header.getTerminator());
+  Value *allConcrete = IRB.getTrue();
+  for (auto *value : liveValues) {
+    if (auto *expr = getSymbolicExpression(value))
+      allConcrete = IRB.CreateAnd(allConcrete, IRB.CreateIsNull(expr));
+  }
+
+  ReplaceInstWithInst(header.getTerminator(),
+                      BranchInst::Create(concreteHeader, body, allConcrete));
 }
 
 void Symbolizer::finalizePHINodes() {
@@ -81,103 +152,311 @@ void Symbolizer::finalizePHINodes() {
 }
 
 void Symbolizer::shortCircuitExpressionUses() {
-  for (auto &symbolicComputation : expressionUses) {
-    assert(!symbolicComputation.inputs.empty() &&
-           "Symbolic computation has no inputs");
+  for (auto &region : buildComputationRegions()) {
+    if (region.size() == 1)
+      shortCircuitComputation(*region.front());
+    else
+      shortCircuitRegion(region);
+  }
+}
 
-    IRBuilder<> IRB(symbolicComputation.firstInstruction);
+std::vector<Symbolizer::ComputationRegion>
+Symbolizer::buildComputationRegions() {
+  std::vector<ComputationRegion> regions;
+  SmallPtrSet<Instruction *, 32> regionInstructions;
+
+  auto canExtendRegion = [&](const SymbolicComputation &previous,
+                             const SymbolicComputation &next) {
+    // Computations without a result (e.g., pushing path constraints) have
+    // side effects that we must not trigger for concrete data.
+    if (previous.lastInstruction->getType()->isVoidTy() ||
+        next.lastInstruction->getType()->isVoidTy())
+      return false;
+
+    if (previous.lastInstruction->getParent() !=
+            next.firstInstruction->getParent() ||
+        !previous.lastInstruction->comesBefore(next.firstInstruction))
+      return false;
+
+    // Everything in between must be safe to hoist above the region.
+    for (auto *I = previous.lastInstruction->getNextNode();
+         I != next.firstInstruction; I = I->getNextNode()) {
+      if (isa<PHINode>(I) || isa<CallBase>(I) || isa<AllocaInst>(I) ||
+          I->isTerminator() || I->mayReadOrWriteMemory() ||
+          I->mayHaveSideEffects())
+        return false;
+
+      if (std::any_of(I->op_begin(), I->op_end(), [&](Value *operand) {
+            auto *operandInst = dyn_cast<Instruction>(operand);
+            return operandInst && regionInstructions.count(operandInst);
+          }))
+        return false;
+    }
 
-    // Build the check whether any input expression is non-null (i.e., there
-    // is a symbolic input).
-    auto *nullExpression = ConstantPointerNull::get(IRB.getInt8PtrTy());
-    std::vector<Value *> nullChecks;
-    for (const auto &input : symbolicComputation.inputs) {
-      nullChecks.push_back(
-          IRB.CreateICmpEQ(nullExpression, input.getSymbolicOperand()));
-    }
-    auto *allConcrete = nullChecks[0];
-    for (unsigned argIndex = 1; argIndex < nullChecks.size(); argIndex++) {
-      allConcrete = IRB.CreateAnd(allConcrete, nullChecks[argIndex]);
-    }
-
-    // The main branch: if we don't enter here, we can short-circuit the
-    // symbolic computation. Otherwise, we need to check all input expressions
-    // and create an output expression.
-    auto *head = symbolicComputation.firstInstruction->getParent();
-    auto *slowPath = SplitBlock(head, symbolicComputation.firstInstruction);
-    auto *tail = SplitBlock(slowPath,
-                            symbolicComputation.lastInstruction->getNextNode());
-    ReplaceInstWithInst(head->getTerminator(),
-                        BranchInst::Create(tail, slowPath, allConcrete));
-
-    // In the slow case, we need to check each input expression for null
-    // (i.e., the input is concrete) and create an expression from the
-    // concrete value if necessary.
-    auto numUnknownConcreteness = std::count_if(
-        symbolicComputation.inputs.begin(), symbolicComputation.inputs.end(),
-        [&](const Input &input) {
-          return (input.getSymbolicOperand() != nullExpression);
-        });
-    for (unsigned argIndex = 0; argIndex < symbolicComputation.inputs.size();
-         argIndex++) {
-      auto &argument = symbolicComputation.inputs[argIndex];
-      auto *originalArgExpression = argument.getSymbolicOperand();
-      auto *argCheckBlock = symbolicComputation.firstInstruction->getParent();
-
-      // We only need a run-time check for concreteness if the argument isn't
-      // known to be concrete at compile time already. However, there is one
-      // exception: if the computation only has a single argument of unknown
-      // concreteness, then we know that it must be symbolic since we ended up
-      // in the slow path. Therefore, we can skip expression generation in
-      // that case.
-      bool needRuntimeCheck = originalArgExpression != nullExpression;
-      if (needRuntimeCheck && (numUnknownConcreteness == 1))
-        continue;
+    return true;
+  };
 
-      if (needRuntimeCheck) {
-        auto *argExpressionBlock = SplitBlockAndInsertIfThen(
-            nullChecks[argIndex], symbolicComputation.firstInstruction,
-            /* unreachable */ false);
-        IRB.SetInsertPoint(argExpressionBlock);
-      } else {
-        IRB.SetInsertPoint(symbolicComputation.firstInstruction);
-      }
+  for (auto &computation : expressionUses) {
+    assert(!computation.inputs.empty() && "Symbolic computation has no inputs");
 
-      auto *newArgExpression =
-          createValueExpression(argument.concreteValue, IRB);
+    if (regions.empty() ||
+        !canExtendRegion(*regions.back().back(), computation)) {
+      regions.emplace_back();
+      regionInstructions.clear();
+    }
 
-      Value *finalArgExpression;
-      if (needRuntimeCheck) {
-        IRB.SetInsertPoint(symbolicComputation.firstInstruction);
-        auto *argPHI = IRB.CreatePHI(IRB.getInt8PtrTy(), 2);
-        argPHI->addIncoming(originalArgExpression, argCheckBlock);
-        argPHI->addIncoming(newArgExpression, newArgExpression->getParent());
-        finalArgExpression = argPHI;
-      } else {
-        finalArgExpression = newArgExpression;
+    regions.back().push_back(&computation);
+    for (auto *I = computation.firstInstruction;; I = I->getNextNode()) {
+      regionInstructions.insert(I);
+      if (I == computation.lastInstruction)
+        break;
+    }
+  }
+
+  return regions;
+}
+
+void Symbolizer::shortCircuitComputation(
+    SymbolicComputation &symbolicComputation) {
+  assert(!symbolicComputation.inputs.empty() &&
+         "Symbolic computation has no inputs");
+
+  IRBuilder<> IRB(symbolicComputation.firstInstruction);
+
+  // Build the check whether any input expression is non-null (i.e., there
+  // is a symbolic input).
+  auto *nullExpression = ConstantPointerNull::get(IRB.getInt8PtrTy());
+  std::vector<Value *> nullChecks;
+  for (const auto &input : symbolicComputation.inputs) {
+    nullChecks.push_back(
+        IRB.CreateICmpEQ(nullExpression, input.getSymbolicOperand()));
+  }
+  auto *allConcrete = nullChecks[0];
+  for (unsigned argIndex = 1; argIndex < nullChecks.size(); argIndex++) {
+    allConcrete = IRB.CreateAnd(allConcrete, nullChecks[argIndex]);
+  }
+
+  // The main branch: if we don't enter here, we can short-circuit the
+  // symbolic computation. Otherwise, we need to check all input expressions
+  // and create an output expression.
+  auto *head = symbolicComputation.firstInstruction->getParent();
+  auto *slowPath = SplitBlock(head, symbolicComputation.firstInstruction);
+  auto *tail = SplitBlock(slowPath,
+                          symbolicComputation.lastInstruction->getNextNode());
+  ReplaceInstWithInst(head->getTerminator(),
+                      BranchInst::Create(tail, slowPath, allConcrete));
+
+  // In the slow case, we need to check each input expression for null
+  // (i.e., the input is concrete) and create an expression from the
+  // concrete value if necessary.
+  auto numUnknownConcreteness = std::count_if(
+      symbolicComputation.inputs.begin(), symbolicComputation.inputs.end(),
+      [&](const Input &input) {
+        return (input.getSymbolicOperand() != nullExpression);
+      });
+  for (unsigned argIndex = 0; argIndex < symbolicComputation.inputs.size();
+       argIndex++) {
+    auto &argument = symbolicComputation.inputs[argIndex];
+    auto *originalArgExpression = argument.getSymbolicOperand();
+    auto *argCheckBlock = symbolicComputation.firstInstruction->getParent();
+
+    // We only need a run-time check for concreteness if the argument isn't
+    // known to be concrete at compile time already. However, there is one
+    // exception: if the computation only has a single argument of unknown
+    // concreteness, then we know that it must be symbolic since we ended up
+    // in the slow path. Therefore, we can skip expression generation in
+    // that case.
+    bool needRuntimeCheck = originalArgExpression != nullExpression;
+    if (needRuntimeCheck && (numUnknownConcreteness == 1))
+      continue;
+
+    if (needRuntimeCheck) {
+      auto *argExpressionBlock = SplitBlockAndInsertIfThen(
+          nullChecks[argIndex], symbolicComputation.firstInstruction,
+          /* unreachable */ false);
+      IRB.SetInsertPoint(argExpressionBlock);
+    } else {
+      IRB.SetInsertPoint(symbolicComputation.firstInstruction);
+    }
+
+    auto *newArgExpression =
+        createValueExpression(argument.concreteValue, IRB);
+
+    Value *finalArgExpression;
+    if (needRuntimeCheck) {
+      IRB.SetInsertPoint(symbolicComputation.firstInstruction);
+      auto *argPHI = IRB.CreatePHI(IRB.getInt8PtrTy(), 2);
+      argPHI->addIncoming(originalArgExpression, argCheckBlock);
+      argPHI->addIncoming(newArgExpression, newArgExpression->getParent());
+      finalArgExpression = argPHI;
+    } else {
+      finalArgExpression = newArgExpression;
+    }
+
+    argument.replaceOperand(finalArgExpression);
+  }
+
+  // Finally, the overall result (if the computation produces one) is null
+  // if we've taken the fast path and the symbolic expression computed above
+  // if short-circuiting wasn't possible.
+  if (!symbolicComputation.lastInstruction->use_empty()) {
+    IRB.SetInsertPoint(&tail->front());
+    auto *finalExpression = IRB.CreatePHI(IRB.getInt8PtrTy(), 2);
+    symbolicComputation.lastInstruction->replaceAllUsesWith(finalExpression);
+    finalExpression->addIncoming(ConstantPointerNull::get(IRB.getInt8PtrTy()),
+                                 head);
+    finalExpression->addIncoming(
+        symbolicComputation.lastInstruction,
+        symbolicComputation.lastInstruction->getParent());
+  }
+}
+
+void Symbolizer::shortCircuitRegion(ArrayRef<SymbolicComputation *> region) {
+  auto *firstInstruction = region.front()->firstInstruction;
+  auto *lastInstruction = region.back()->lastInstruction;
+
+  // Make the region contiguous by hoisting the program's own instructions
+  // (which buildComputationRegions has checked to be pure) above it.
+  SmallPtrSet<Instruction *, 32> regionInstructions;
+  for (unsigned index = 0; index < region.size(); index++) {
+    auto *computation = region[index];
+    if (index > 0) {
+      auto *I = region[index - 1]->lastInstruction->getNextNode();
+      while (I != computation->firstInstruction) {
+        auto *next = I->getNextNode();
+        I->moveBefore(firstInstruction);
+        I = next;
       }
+    }
 
-      argument.replaceOperand(finalArgExpression);
+    for (auto *I = computation->firstInstruction;; I = I->getNextNode()) {
+      regionInstructions.insert(I);
+      if (I == computation->lastInstruction)
+        break;
     }
+  }
+
+  // A single check decides whether any input from outside the region is
+  // symbolic; if not, none of the computations can produce an expression.
+  IRBuilder<> IRB(firstInstruction);
+  auto *nullExpression = ConstantPointerNull::get(IRB.getInt8PtrTy());
+  auto isRegionResult = [&](Value *V) {
+    auto *inst = dyn_cast<Instruction>(V);
+    return inst && regionInstructions.count(inst);
+  };
+
+  SmallPtrSet<Value *, 8> checkedExpressions;
+  Value *allConcrete = IRB.getTrue();
+  for (auto *computation : region) {
+    for (const auto &input : computation->inputs) {
+      auto *expression = input.getSymbolicOperand();
+      if (expression == nullExpression || isRegionResult(expression) ||
+          !checkedExpressions.insert(expression).second)
+        continue;
 
-    // Finally, the overall result (if the computation produces one) is null
-    // if we've taken the fast path and the symbolic expression computed above
-    // if short-circuiting wasn't possible.
-    if (!symbolicComputation.lastInstruction->use_empty()) {
-      IRB.SetInsertPoint(&tail->front());
-      auto *finalExpression = IRB.CreatePHI(IRB.getInt8PtrTy(), 2);
-      symbolicComputation.lastInstruction->replaceAllUsesWith(finalExpression);
-      finalExpression->addIncoming(ConstantPointerNull::get(IRB.getInt8PtrTy()),
-                                   head);
-      finalExpression->addIncoming(
-          symbolicComputation.lastInstruction,
-          symbolicComputation.lastInstruction->getParent());
+      allConcrete = IRB.CreateAnd(allConcrete,
+                                  IRB.CreateICmpEQ(nullExpression, expression));
     }
   }
+
+  auto *head = firstInstruction->getParent();
+  auto *slowPath = SplitBlock(head, firstInstruction);
+  auto *tail = SplitBlock(slowPath, lastInstruction->getNextNode());
+  ReplaceInstWithInst(head->getTerminator(),
+                      BranchInst::Create(tail, slowPath, allConcrete));
+
+  // Results that escape the region are null if we've taken the fast path.
+  SmallVector<PHINode *, 8> resultPHIs;
+  IRB.SetInsertPoint(&tail->front());
+  for (auto *computation : region) {
+    auto *result = computation->lastInstruction;
+    auto isOutsideSlowPath = [slowPath](Use &use) {
+      return cast<Instruction>(use.getUser())->getParent() != slowPath;
+    };
+    if (std::none_of(result->use_begin(), result->use_end(),
+                     isOutsideSlowPath))
+      continue;
+
+    auto *resultPHI = IRB.CreatePHI(result->getType(), 2);
+    result->replaceUsesWithIf(resultPHI, isOutsideSlowPath);
+    resultPHI->addIncoming(ConstantPointerNull::get(IRB.getInt8PtrTy()), head);
+    resultPHI->addIncoming(result, slowPath);
+    resultPHIs.push_back(resultPHI);
+  }
+
+  // In the slow path, every input may still be null: concrete inputs from
+  // outside the region as well as results of computations inside the region
+  // that the backend couldn't express. Hence, we check all of them, without
+  // the shortcuts that shortCircuitComputation takes.
+  for (auto *computation : region) {
+    for (auto &input : computation->inputs) {
+      auto *originalExpression = input.getSymbolicOperand();
+      IRB.SetInsertPoint(computation->firstInstruction);
+
+      if (originalExpression == nullExpression) {
+        input.replaceOperand(createValueExpression(input.concreteValue, IRB));
+        continue;
+      }
+
+      auto *checkBlock = computation->firstInstruction->getParent();
+      auto *needExpression =
+          IRB.CreateICmpEQ(nullExpression, originalExpression);
+      IRB.SetInsertPoint(SplitBlockAndInsertIfThen(
+          needExpression, computation->firstInstruction,
+          /* unreachable */ false));
+      auto *newExpression = createValueExpression(input.concreteValue, IRB);
+
+      IRB.SetInsertPoint(computation->firstInstruction);
+      auto *inputPHI = IRB.CreatePHI(IRB.getInt8PtrTy(), 2);
+      inputPHI->addIncoming(originalExpression, checkBlock);
+      inputPHI->addIncoming(newExpression, newExpression->getParent());
+      input.replaceOperand(inputPHI);
+    }
+  }
+
+  for (auto *resultPHI : resultPHIs)
+    resultPHI->setIncomingBlock(1, lastInstruction->getParent());
+}
+
+void Symbolizer::guardNotifications(Function &F) {
+  if (notifications.empty())
+    return;
+
+  // Splitting the entry block would turn its static allocas into dynamic
+  // ones, so we move them to the top first. (Their operands are constants.)
+  auto &entry = F.getEntryBlock();
+  Instruction *lastAlloca = nullptr;
+  for (auto &I : make_early_inc_range(entry)) {
+    auto *alloca = dyn_cast<AllocaInst>(&I);
+    if (alloca == nullptr || !alloca->isStaticAlloca())
+      continue;
+
+    if (lastAlloca == nullptr)
+      alloca->moveBefore(&*entry.getFirstInsertionPt());
+    else
+      alloca->moveAfter(lastAlloca);
+    lastAlloca = alloca;
+  }
+
+  IRBuilder<> IRB(lastAlloca != nullptr ? lastAlloca->getNextNode()
+                                        : &*entry.getFirstInsertionPt());
+  auto *requested =
+      IRB.CreateLoad(IRB.getInt32Ty(), runtime.backendNotifications);
+
+  for (auto [call, flags] : notifications) {
+    IRB.SetInsertPoint(call);
+    auto *needed = IRB.CreateIsNotNull(IRB.CreateAnd(requested, flags));
+    auto *notify = SplitBlockAndInsertIfThen(needed, call, false);
+    call->moveBefore(notify);
+  }
 }
 
 void Symbolizer::handleIntrinsicCall(CallBase &I) {
   auto *callee = I.getCalledFunction();
+  auto warnUnhandledIntrinsic = [callee]() {
+    errs() << "Warning: unhandled LLVM intrinsic " << callee->getName()
+           << "; the result will be concretized\n";
+  };
 
   switch (callee->getIntrinsicID()) {
   case Intrinsic::lifetime_start:
@@ -258,6 +537,11 @@ void Symbolizer::handleIntrinsicCall(CallBase &I) {
     // Floating-point absolute value; use the runtime to build the
     // corresponding symbolic expression.
 
+    if (I.getType()->isVectorTy()) {
+      warnUnsupportedVectorOperation(I);
+      break;
+    }
+
     IRBuilder<> IRB(&I);
     auto abs = buildRuntimeCall(IRB, runtime.buildFloatAbs, I.getOperand(0));
     registerSymbolicComputation(abs, &I);
@@ -266,12 +550,139 @@ void Symbolizer::handleIntrinsicCall(CallBase &I) {
   case Intrinsic::cttz:
   case Intrinsic::ctpop:
   case Intrinsic::ctlz: {
-    // Various bit-count operations. Expressing these symbolically is
-    // difficult, so for now we just concretize.
+    // Various bit-count operations. The run-time library expresses them with
+    // arithmetic; we ignore the flag of ctlz and cttz that makes a zero input
+    // poison, because the result for zero is well defined symbolically.
+
+    if (!isBitVectorInteger(I.getType())) {
+      errs() << "Warning: losing track of symbolic expressions at bit-count "
+                "operation "
+             << I << "\n";
+      break;
+    }
+
+    SymFnT handler = runtime.buildCtpop;
+    if (callee->getIntrinsicID() == Intrinsic::ctlz)
+      handler = runtime.buildCtlz;
+    else if (callee->getIntrinsicID() == Intrinsic::cttz)
+      handler = runtime.buildCttz;
 
-    errs() << "Warning: losing track of symbolic expressions at bit-count "
-              "operation "
-           << I << "\n";
+    IRBuilder<> IRB(&I);
+    auto count = buildRuntimeCall(IRB, handler, I.getOperand(0));
+    registerSymbolicComputation(count, &I);
+    break;
+  }
+  case Intrinsic::fshl:
+  case Intrinsic::fshr: {
+    // Funnel shifts concatenate two values, shift, and extract one half;
+    // rotations are the special case of identical inputs.
+
+    if (!isBitVectorInteger(I.getType())) {
+      warnUnhandledIntrinsic();
+      break;
+    }
+
+    IRBuilder<> IRB(&I);
+    auto shift = buildRuntimeCall(
+        IRB,
+        (callee->getIntrinsicID() == Intrinsic::fshl)
+            ? runtime.buildFunnelShiftLeft
+            : runtime.buildFunnelShiftRight,
+        {I.getOperand(0), I.getOperand(1), I.getOperand(2)});
+    registerSymbolicComputation(shift, &I);
+    break;
+  }
+#if LLVM_VERSION_MAJOR >= 12
+  case Intrinsic::umin:
+  case Intrinsic::umax:
+  case Intrinsic::smin:
+  case Intrinsic::smax: {
+    if (!isBitVectorInteger(I.getType())) {
+      warnUnhandledIntrinsic();
+      break;
+    }
+
+    SymFnT handler;
+    switch (callee->getIntrinsicID()) {
+    case Intrinsic::umin:
+      handler = runtime.buildUnsignedMin;
+      break;
+    case Intrinsic::umax:
+      handler = runtime.buildUnsignedMax;
+      break;
+    case Intrinsic::smin:
+      handler = runtime.buildSignedMin;
+      break;
+    default:
+      handler = runtime.buildSignedMax;
+      break;
+    }
+
+    IRBuilder<> IRB(&I);
+    auto extremum =
+        buildRuntimeCall(IRB, handler, {I.getOperand(0), I.getOperand(1)});
+    registerSymbolicComputation(extremum, &I);
+    break;
+  }
+  case Intrinsic::abs: {
+    // The absolute value is the maximum of the value and its negation; this
+    // also gives the right result for the minimum value, which has no
+    // positive counterpart. (The second operand only declares that case
+    // poison.)
+
+    auto *value = I.getOperand(0);
+    if (!isBitVectorInteger(I.getType())) {
+      warnUnhandledIntrinsic();
+      break;
+    }
+    if (getSymbolicExpression(value) == nullptr)
+      break;
+
+    IRBuilder<> IRB(&I);
+    auto symbolicComputation = forceBuildRuntimeCall(
+        IRB, runtime.binaryOperatorHandlers[Instruction::Sub],
+        {{ConstantInt::get(I.getType(), 0), true}, {value, true}});
+    symbolicComputation.merge(forceBuildRuntimeCall(
+        IRB, runtime.buildSignedMax,
+        {{symbolicComputation.lastInstruction, false}, {value, true}}));
+    registerSymbolicComputation(symbolicComputation, &I);
+    break;
+  }
+#endif
+  case Intrinsic::uadd_with_overflow:
+  case Intrinsic::sadd_with_overflow:
+  case Intrinsic::usub_with_overflow:
+  case Intrinsic::ssub_with_overflow:
+  case Intrinsic::umul_with_overflow:
+  case Intrinsic::smul_with_overflow:
+    // These return a pair of the result and an overflow flag; we build the
+    // expressions for the members where they are extracted (see
+    // visitExtractValueInst), so the pair itself remains concrete.
+    if (!isBitVectorInteger(I.getOperand(0)->getType()))
+      warnUnhandledIntrinsic();
+    break;
+  case Intrinsic::uadd_sat:
+  case Intrinsic::sadd_sat:
+  case Intrinsic::usub_sat:
+  case Intrinsic::ssub_sat: {
+    // Saturating arithmetic clamps the result to the range of the type.
+
+    if (!isBitVectorInteger(I.getType())) {
+      warnUnhandledIntrinsic();
+      break;
+    }
+
+    auto id = callee->getIntrinsicID();
+    auto opcode = (id == Intrinsic::uadd_sat || id == Intrinsic::sadd_sat)
+                      ? Instruction::Add
+                      : Instruction::Sub;
+    bool isSigned = (id == Intrinsic::sadd_sat || id == Intrinsic::ssub_sat);
+
+    IRBuilder<> IRB(&I);
+    auto result = buildRuntimeCall(
+        IRB, runtime.saturatingOperatorHandlers[opcode][isSigned],
+        {I.getOperand(0), I.getOperand(1)});
+    registerSymbolicComputation(result, &I);
     break;
   }
   case Intrinsic::returnaddress: {
@@ -284,19 +695,132 @@ void Symbolizer::handleIntrinsicCall(CallBase &I) {
   case Intrinsic::bswap: {
     // Bswap changes the endian-ness of integer values.
 
+    if (I.getType()->isVectorTy()) {
+      warnUnsupportedVectorOperation(I);
+      break;
+    }
+
     IRBuilder<> IRB(&I);
     auto swapped = buildRuntimeCall(IRB, runtime.buildBswap, I.getOperand(0));
     registerSymbolicComputation(swapped, &I);
     break;
   }
+#if LLVM_VERSION_MAJOR >= 12
+  case Intrinsic::vector_reduce_add:
+  case Intrinsic::vector_reduce_mul:
+  case Intrinsic::vector_reduce_and:
+  case Intrinsic::vector_reduce_or:
+  case Intrinsic::vector_reduce_xor: {
+    // Reductions combine all elements of a vector with a binary operator,
+    // e.g., in vectorized loops that sum up an array.
+
+    auto *vector = I.getArgOperand(0);
+    if (!isSupportedVectorType(vector->getType())) {
+      warnUnsupportedVectorOperation(I);
+      break;
+    }
+    if (getSymbolicExpression(vector) == nullptr)
+      break;
+
+    Instruction::BinaryOps opcode;
+    switch (callee->getIntrinsicID()) {
+    case Intrinsic::vector_reduce_add:
+      opcode = Instruction::Add;
+      break;
+    case Intrinsic::vector_reduce_mul:
+      opcode = Instruction::Mul;
+      break;
+    case Intrinsic::vector_reduce_and:
+      opcode = Instruction::And;
+      break;
+    case Intrinsic::vector_reduce_or:
+      opcode = Instruction::Or;
+      break;
+    default:
+      opcode = Instruction::Xor;
+      break;
+    }
+
+    IRBuilder<> IRB(&I);
+    auto *previous = I.getPrevNode();
+    SmallVector<Input, kExpectedSymbolicArgumentsPerComputation> inputs;
+    auto numElements =
+        cast<FixedVectorType>(vector->getType())->getNumElements();
+    Value *result = nullptr;
+    for (unsigned i = 0; i < numElements; i++) {
+      auto *element = extractVectorElement(IRB, vector, i, inputs);
+      result = (result == nullptr)
+                   ? element
+                   : IRB.CreateCall(runtime.binaryOperatorHandlers[opcode],
+                                    {result, element});
+    }
+
+    registerVectorComputation(I, previous,
+                              convertBitsToScalar(IRB, result, I.getType()),
+                              inputs);
+    break;
+  }
+#endif
+  case Intrinsic::masked_store: {
+    // A store of selected vector elements. We concretize the stored data, but
+    // we have to clear the shadow of the selected elements like a regular
+    // store would. The other elements keep their expressions.
+
+    IRBuilder<> IRB(&I);
+    auto *data = I.getArgOperand(0);
+    auto *addr = I.getArgOperand(1);
+    auto *mask = I.getArgOperand(3);
+    concretizePointer(IRB, addr);
+    errs() << "Warning: concretizing the data of masked store " << I << '\n';
+
+    auto *symbolicAddr = getSymbolicExpressionOrNull(addr);
+    auto *concreteAddr = IRB.CreatePtrToInt(addr, intPtrType);
+    auto *littleEndian = IRB.getInt8(dataLayout.isLittleEndian() ? 1 : 0);
+    auto *nullExpression = ConstantPointerNull::get(IRB.getInt8PtrTy());
+    auto *vectorType = cast<FixedVectorType>(data->getType());
+    auto *elementType = vectorType->getElementType();
+    auto elementSize = dataLayout.getTypeStoreSize(elementType);
+    if (dataLayout.getTypeSizeInBits(elementType) != elementSize * 8) {
+      // The elements aren't byte-aligned, so we clear the entire vector.
+      IRB.CreateCall(
+          runtime.writeMemory,
+          {symbolicAddr, nullExpression, concreteAddr,
+           ConstantInt::get(intPtrType,
+                            dataLayout.getTypeStoreSize(vectorType)),
+           littleEndian});
+      break;
+    }
+
+    for (unsigned i = 0; i < vectorType->getNumElements(); i++) {
+      auto *selected = IRB.CreateExtractElement(mask, i);
+      Instruction *insertPoint = &I;
+      if (auto *constantSelected = dyn_cast<Constant>(selected)) {
+        if (constantSelected->isNullValue())
+          continue;
+      } else {
+        insertPoint = SplitBlockAndInsertIfThen(selected, &I,
+                                                /* unreachable */ false);
+      }
+
+      IRBuilder<> elementIRB(insertPoint);
+      elementIRB.CreateCall(
+          runtime.writeMemory,
+          {symbolicAddr, nullExpression,
+           elementIRB.CreateAdd(concreteAddr,
+                                ConstantInt::get(intPtrType, i * elementSize)),
+           ConstantInt::get(intPtrType, elementSize), littleEndian});
+      // Splitting moves the store to a new block.
+      IRB.SetInsertPoint(&I);
+    }
+    break;
+  }
   case Intrinsic::assume: {
     // Assume is a hint for the optimizer; we just ignore it.
     // TODO: this leads to undefined behavior if not true, we should add a path constraint here.
     break;
   }
   default:
-    errs() << "Warning: unhandled LLVM intrinsic " << callee->getName()
-           << "; the result will be concretized\n";
+    warnUnhandledIntrinsic();
     break;
   }
 }
@@ -319,9 +843,13 @@ void Symbolizer::handleFunctionCall(CallBase &I, Instruction *returnPoint) {
   }
 
   IRBuilder<> IRB(returnPoint);
-  IRB.CreateCall(runtime.notifyRet, getTargetPreferredInt(&I));
+  notifications.push_back(
+      {IRB.CreateCall(runtime.notifyRet, getTargetPreferredInt(&I)),
+       kNotifyCalls});
   IRB.SetInsertPoint(&I);
-  IRB.CreateCall(runtime.notifyCall, getTargetPreferredInt(&I));
+  notifications.push_back(
+      {IRB.CreateCall(runtime.notifyCall, getTargetPreferredInt(&I)),
+       kNotifyCalls});
 
   if (callee == nullptr)
     concretizePointer(IRB, I.getCalledOperand());
@@ -350,9 +878,29 @@ void Symbolizer::handleFunctionCall(CallBase &I, Instruction *returnPoint) {
 void Symbolizer::visitBinaryOperator(BinaryOperator &I) {
   // Binary operators propagate into the symbolic expression.
 
-  IRBuilder<> IRB(&I);
   SymFnT handler = runtime.binaryOperatorHandlers.at(I.getOpcode());
 
+  if (I.getType()->isVectorTy()) {
+    // Vector operations work element by element. Boolean elements are single
+    // bits in vector expressions, so we don't need the special case below.
+    // Floating-point arithmetic isn't supported by all backends, and
+    // concatenating missing element expressions would fail.
+    if (!isSupportedVectorType(I.getType()) ||
+        !I.getType()->getScalarType()->isIntegerTy()) {
+      warnUnsupportedVectorOperation(I);
+      return;
+    }
+
+    buildVectorElementwise(
+        I, {I.getOperand(0), I.getOperand(1)},
+        [&](IRBuilder<> &IRB, unsigned, ArrayRef<Value *> elements) {
+          return IRB.CreateCall(handler, {elements[0], elements[1]});
+        });
+    return;
+  }
+
+  IRBuilder<> IRB(&I);
+
   // Special case: the run-time library distinguishes between "and" and "or"
   // on Boolean values and bit vectors.
   if (I.getOperand(0)->getType() == IRB.getInt1Ty()) {
@@ -384,6 +932,25 @@ void Symbolizer::visitSelectInst(SelectInst &I) {
   // negated) condition to the path constraints and copy the symbolic
   // expression over from the chosen argument.
 
+  if (I.getCondition()->getType()->isVectorTy()) {
+    // A vector condition selects element by element. We don't add path
+    // constraints for the individual elements, i.e., the condition is
+    // concretized.
+    if (!isSupportedVectorType(I.getType())) {
+      warnUnsupportedVectorOperation(I);
+      return;
+    }
+
+    buildVectorElementwise(
+        I, {I.getTrueValue(), I.getFalseValue()},
+        [&](IRBuilder<> &IRB, unsigned index, ArrayRef<Value *> elements) {
+          return IRB.CreateSelect(
+              IRB.CreateExtractElement(I.getCondition(), index), elements[0],
+              elements[1]);
+        });
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto runtimeCall = buildRuntimeCall(IRB, runtime.pushPathConstraint,
                                       {{I.getCondition(), true},
@@ -403,9 +970,30 @@ void Symbolizer::visitCmpInst(CmpInst &I) {
   // ICmp is integer comparison, FCmp compares floating-point values; we
   // simply include either in the resulting expression.
 
-  IRBuilder<> IRB(&I);
   SymFnT handler = runtime.comparisonHandlers.at(I.getPredicate());
   assert(handler && "Unable to handle icmp/fcmp variant");
+
+  if (I.getType()->isVectorTy()) {
+    // Compare element by element and turn the resulting Boolean expressions
+    // into bits. As with binary operators, we don't support floating-point
+    // elements.
+    if (!isSupportedVectorType(I.getOperand(0)->getType()) ||
+        I.isFPPredicate()) {
+      warnUnsupportedVectorOperation(I);
+      return;
+    }
+
+    buildVectorElementwise(
+        I, {I.getOperand(0), I.getOperand(1)},
+        [&](IRBuilder<> &IRB, unsigned, ArrayRef<Value *> elements) {
+          return IRB.CreateCall(
+              runtime.buildBoolToBit,
+              IRB.CreateCall(handler, {elements[0], elements[1]}));
+        });
+    return;
+  }
+
+  IRBuilder<> IRB(&I);
   auto runtimeCall =
       buildRuntimeCall(IRB, handler, {I.getOperand(0), I.getOperand(1)});
   registerSymbolicComputation(runtimeCall, &I);
@@ -480,6 +1068,16 @@ void Symbolizer::visitLoadInst(LoadInst &I) {
   concretizePointer(IRB, addr);
 
   auto *dataType = I.getType();
+  if (dataType->isVectorTy() &&
+      (!isSupportedVectorType(dataType) ||
+       dataLayout.getTypeSizeInBits(dataType) !=
+           dataLayout.getTypeStoreSizeInBits(dataType))) {
+    // Vectors that don't fill their bytes (e.g., vectors of Booleans) are
+    // concretized; the expressions in memory describe bytes, not elements.
+    warnUnsupportedVectorOperation(I);
+    return;
+  }
+
   auto *data = IRB.CreateCall(
       runtime.readMemory,
       {pointer_expr,
@@ -505,7 +1103,15 @@ void Symbolizer::visitStoreInst(StoreInst &I) {
 
   auto *data = getSymbolicExpressionOrNull(I.getValueOperand());
   auto *dataType = I.getValueOperand()->getType();
-  if (dataType->isFloatingPointTy()) {
+  if (dataType->isVectorTy() &&
+      (!isSupportedVectorType(dataType) ||
+       dataLayout.getTypeSizeInBits(dataType) !=
+           dataLayout.getTypeStoreSizeInBits(dataType))) {
+    // See visitLoadInst; we still need to clear the shadow.
+    warnUnsupportedVectorOperation(I);
+    data = ConstantPointerNull::get(IRB.getInt8PtrTy());
+  }
+  if (dataType->isFloatingPointTy() && !isa<ConstantPointerNull>(data)) {
     data = IRB.CreateCall(runtime.buildFloatToBits, data);
   }
 
@@ -524,6 +1130,11 @@ void Symbolizer::visitGetElementPtrInst(GetElementPtrInst &I) {
   // symbolic expression of the original pointer and duplicate its
   // computations at the symbolic level.
 
+  if (I.getType()->isVectorTy()) {
+    warnUnsupportedVectorOperation(I);
+    return;
+  }
+
   // If everything is compile-time concrete, we don't need to emit code.
   if (getSymbolicExpression(I.getPointerOperand()) == nullptr &&
       std::all_of(I.idx_begin(), I.idx_end(), [this](Value *index) {
@@ -542,14 +1153,20 @@ void Symbolizer::visitGetElementPtrInst(GetElementPtrInst &I) {
     return;
   }
 
+  // We split the offset into a concrete part and symbolic terms. The concrete
+  // part comprises struct members, constant indices and indices that are
+  // known to be concrete; we compute it with regular instructions, folding
+  // constants at compile time, and add it to the address in a single step.
+  // Only indices with symbolic expressions are scaled at the symbolic level.
+
   IRBuilder<> IRB(&I);
-  SymbolicComputation symbolicComputation;
-  Value *currentAddress = I.getPointerOperand();
+  APInt constantOffset(ptrBits, 0);
+  Value *concreteOffset = nullptr;
+  SmallVector<std::pair<Value *, uint64_t>, 2> symbolicTerms;
 
   for (auto type_it = gep_type_begin(I), type_end = gep_type_end(I);
        type_it != type_end; ++type_it) {
     auto *index = type_it.getOperand();
-    std::pair<Value *, bool> addressContribution;
 
     // There are two cases for the calculation:
     // 1. If the indexed type is a struct, we need to add the offset of the
@@ -561,55 +1178,115 @@ void Symbolizer::visitGetElementPtrInst(GetElementPtrInst &I) {
       // (https://llvm.org/docs/LangRef.html#getelementptr-instruction).
 
       unsigned memberIndex = cast<ConstantInt>(index)->getZExtValue();
-      unsigned memberOffset =
+      constantOffset +=
           dataLayout.getStructLayout(structType)->getElementOffset(memberIndex);
-      addressContribution = {ConstantInt::get(intPtrType, memberOffset), true};
-    } else {
-      if (auto *ci = dyn_cast<ConstantInt>(index);
-          ci != nullptr && ci->isZero()) {
-        // Fast path: an index of zero means that no calculations are
-        // performed.
-        continue;
-      }
-
-      // TODO optimize? If the index is constant, we can perform the
-      // multiplication ourselves instead of having the solver do it. Also, if
-      // the element size is 1, we can omit the multiplication.
-
-      unsigned elementSize =
-          dataLayout.getTypeAllocSize(type_it.getIndexedType());
-      if (auto indexWidth = index->getType()->getIntegerBitWidth();
-          indexWidth != ptrBits) {
-        symbolicComputation.merge(forceBuildRuntimeCall(
-            IRB, runtime.buildSExt,
-            {{index, true},
-             {ConstantInt::get(IRB.getInt8Ty(), ptrBits - indexWidth),
-              false}}));
-        symbolicComputation.merge(forceBuildRuntimeCall(
-            IRB, runtime.binaryOperatorHandlers[Instruction::Mul],
-            {{symbolicComputation.lastInstruction, false},
-             {ConstantInt::get(intPtrType, elementSize), true}}));
-      } else {
-        symbolicComputation.merge(forceBuildRuntimeCall(
-            IRB, runtime.binaryOperatorHandlers[Instruction::Mul],
-            {{index, true},
-             {ConstantInt::get(intPtrType, elementSize), true}}));
-      }
+      continue;
+    }
 
-      addressContribution = {symbolicComputation.lastInstruction, false};
+    uint64_t elementSize =
+        dataLayout.getTypeAllocSize(type_it.getIndexedType());
+    if (auto *ci = dyn_cast<ConstantInt>(index)) {
+      constantOffset += ci->getValue().sextOrTrunc(ptrBits) * elementSize;
+    } else if (getSymbolicExpression(index) == nullptr) {
+      auto *term = IRB.CreateMul(IRB.CreateSExtOrTrunc(index, intPtrType),
+                                 ConstantInt::get(intPtrType, elementSize));
+      concreteOffset = (concreteOffset == nullptr)
+                           ? term
+                           : IRB.CreateAdd(concreteOffset, term);
+    } else {
+      symbolicTerms.emplace_back(index, elementSize);
     }
+  }
+
+  if (!constantOffset.isNullValue()) {
+    auto *constant = ConstantInt::get(intPtrType, constantOffset);
+    concreteOffset = (concreteOffset == nullptr)
+                         ? constant
+                         : IRB.CreateAdd(concreteOffset, constant);
+  }
 
+  SymbolicComputation symbolicComputation;
+  Value *currentAddress = I.getPointerOperand();
+  auto addToAddress = [&](std::pair<Value *, bool> offset) {
     symbolicComputation.merge(forceBuildRuntimeCall(
         IRB, runtime.binaryOperatorHandlers[Instruction::Add],
-        {addressContribution,
+        {offset,
          {currentAddress, (currentAddress == I.getPointerOperand())}}));
     currentAddress = symbolicComputation.lastInstruction;
+  };
+
+  for (auto [index, elementSize] : symbolicTerms) {
+    std::pair<Value *, bool> term = {index, true};
+    if (auto indexWidth = index->getType()->getIntegerBitWidth();
+        indexWidth != ptrBits) {
+      symbolicComputation.merge(forceBuildRuntimeCall(
+          IRB, runtime.buildSExt,
+          {term,
+           {ConstantInt::get(IRB.getInt8Ty(), ptrBits - indexWidth), false}}));
+      term = {symbolicComputation.lastInstruction, false};
+    }
+
+    // Scale the index by the element size; we can omit the multiplication
+    // for single bytes, and we shift for other powers of two.
+    if (elementSize != 1) {
+      bool isPowerOfTwo = isPowerOf2_64(elementSize);
+      symbolicComputation.merge(forceBuildRuntimeCall(
+          IRB,
+          runtime.binaryOperatorHandlers[isPowerOfTwo ? Instruction::Shl
+                                                      : Instruction::Mul],
+          {term,
+           {ConstantInt::get(intPtrType,
+                             isPowerOfTwo ? Log2_64(elementSize) : elementSize),
+            true}}));
+      term = {symbolicComputation.lastInstruction, false};
+    }
+
+    addToAddress(term);
+  }
+
+  if (concreteOffset != nullptr)
+    addToAddress({concreteOffset, true});
+
+  if (symbolicComputation.lastInstruction == nullptr) {
+    // All offsets cancel out.
+    if (auto *expr = getSymbolicExpression(I.getPointerOperand()))
+      symbolicExpressions[&I] = expr;
+    return;
   }
 
   registerSymbolicComputation(symbolicComputation, &I);
 }
 
 void Symbolizer::visitBitCastInst(BitCastInst &I) {
+  auto *srcTy = I.getSrcTy();
+  auto *destTy = I.getDestTy();
+  if (srcTy->isVectorTy() || destTy->isVectorTy()) {
+    // Vector expressions are just the vector's bits, so we only need to
+    // convert scalar floating-point values.
+    if ((srcTy->isVectorTy() && !isSupportedVectorType(srcTy)) ||
+        (destTy->isVectorTy() && !isSupportedVectorType(destTy)) ||
+        srcTy->isIntegerTy(1) || destTy->isIntegerTy(1)) {
+      warnUnsupportedVectorOperation(I);
+      return;
+    }
+
+    IRBuilder<> IRB(&I);
+    if (srcTy->isFloatingPointTy()) {
+      auto conversion = buildRuntimeCall(IRB, runtime.buildFloatToBits,
+                                         {{I.getOperand(0), true}});
+      registerSymbolicComputation(conversion, &I);
+    } else if (destTy->isFloatingPointTy()) {
+      auto conversion =
+          buildRuntimeCall(IRB, runtime.buildBitsToFloat,
+                           {{I.getOperand(0), true},
+                            {IRB.getInt1(destTy->isDoubleTy()), false}});
+      registerSymbolicComputation(conversion, &I);
+    } else if (auto *expr = getSymbolicExpression(I.getOperand(0))) {
+      symbolicExpressions[&I] = expr;
+    }
+    return;
+  }
+
   if (I.getSrcTy()->isIntegerTy() && I.getDestTy()->isFloatingPointTy()) {
     IRBuilder<> IRB(&I);
     auto conversion =
@@ -635,6 +1312,22 @@ void Symbolizer::visitBitCastInst(BitCastInst &I) {
 }
 
 void Symbolizer::visitTruncInst(TruncInst &I) {
+  if (auto *vectorType = dyn_cast<VectorType>(I.getDestTy())) {
+    if (!isSupportedVectorType(vectorType)) {
+      warnUnsupportedVectorOperation(I);
+      return;
+    }
+
+    buildVectorElementwise(
+        I, I.getOperand(0),
+        [&](IRBuilder<> &IRB, unsigned, ArrayRef<Value *> elements) {
+          return IRB.CreateCall(
+              runtime.buildTrunc,
+              {elements[0], IRB.getInt8(vectorType->getScalarSizeInBits())});
+        });
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto trunc = buildRuntimeCall(
       IRB, runtime.buildTrunc,
@@ -644,18 +1337,33 @@ void Symbolizer::visitTruncInst(TruncInst &I) {
 }
 
 void Symbolizer::visitIntToPtrInst(IntToPtrInst &I) {
+  if (I.getType()->isVectorTy()) {
+    resizeVectorElements(I);
+    return;
+  }
+
   if (auto *expr = getSymbolicExpression(I.getOperand(0)))
     symbolicExpressions[&I] = expr;
   // TODO handle truncation and zero extension
 }
 
 void Symbolizer::visitPtrToIntInst(PtrToIntInst &I) {
+  if (I.getType()->isVectorTy()) {
+    resizeVectorElements(I);
+    return;
+  }
+
   if (auto *expr = getSymbolicExpression(I.getOperand(0)))
     symbolicExpressions[&I] = expr;
   // TODO handle truncation and zero extension
 }
 
 void Symbolizer::visitSIToFPInst(SIToFPInst &I) {
+  if (I.getType()->isVectorTy()) {
+    warnUnsupportedVectorOperation(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto conversion =
       buildRuntimeCall(IRB, runtime.buildIntToFloat,
@@ -666,6 +1374,11 @@ void Symbolizer::visitSIToFPInst(SIToFPInst &I) {
 }
 
 void Symbolizer::visitUIToFPInst(UIToFPInst &I) {
+  if (I.getType()->isVectorTy()) {
+    warnUnsupportedVectorOperation(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto conversion =
       buildRuntimeCall(IRB, runtime.buildIntToFloat,
@@ -676,6 +1389,11 @@ void Symbolizer::visitUIToFPInst(UIToFPInst &I) {
 }
 
 void Symbolizer::visitFPExtInst(FPExtInst &I) {
+  if (I.getType()->isVectorTy()) {
+    warnUnsupportedVectorOperation(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto conversion =
       buildRuntimeCall(IRB, runtime.buildFloatToFloat,
@@ -685,6 +1403,11 @@ void Symbolizer::visitFPExtInst(FPExtInst &I) {
 }
 
 void Symbolizer::visitFPTruncInst(FPTruncInst &I) {
+  if (I.getType()->isVectorTy()) {
+    warnUnsupportedVectorOperation(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto conversion =
       buildRuntimeCall(IRB, runtime.buildFloatToFloat,
@@ -694,6 +1417,11 @@ void Symbolizer::visitFPTruncInst(FPTruncInst &I) {
 }
 
 void Symbolizer::visitFPToSI(FPToSIInst &I) {
+  if (I.getType()->isVectorTy()) {
+    warnUnsupportedVectorOperation(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto conversion = buildRuntimeCall(
       IRB, runtime.buildFloatToSignedInt,
@@ -703,6 +1431,11 @@ void Symbolizer::visitFPToSI(FPToSIInst &I) {
 }
 
 void Symbolizer::visitFPToUI(FPToUIInst &I) {
+  if (I.getType()->isVectorTy()) {
+    warnUnsupportedVectorOperation(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto conversion = buildRuntimeCall(
       IRB, runtime.buildFloatToUnsignedInt,
@@ -718,8 +1451,6 @@ void Symbolizer::visitCastInst(CastInst &I) {
     return;
   }
 
-  IRBuilder<> IRB(&I);
-
   SymFnT target;
 
   switch (I.getOpcode()) {
@@ -733,6 +1464,26 @@ void Symbolizer::visitCastInst(CastInst &I) {
     llvm_unreachable("Unknown cast opcode");
   }
 
+  if (auto *vectorType = dyn_cast<VectorType>(I.getDestTy())) {
+    // Boolean elements are bits in vector expressions, so they can be
+    // extended like any other integer.
+    if (!isSupportedVectorType(vectorType)) {
+      warnUnsupportedVectorOperation(I);
+      return;
+    }
+
+    auto extraBits = vectorType->getScalarSizeInBits() -
+                     I.getSrcTy()->getScalarSizeInBits();
+    buildVectorElementwise(
+        I, I.getOperand(0),
+        [&](IRBuilder<> &IRB, unsigned, ArrayRef<Value *> elements) {
+          return IRB.CreateCall(target, {elements[0], IRB.getInt8(extraBits)});
+        });
+    return;
+  }
+
+  IRBuilder<> IRB(&I);
+
   // LLVM bitcode represents Boolean values as i1. In Z3, those are a not a
   // bit-vector sort, so trying to cast one into a bit vector of any length
   // raises an error. The run-time library provides a dedicated conversion
@@ -796,6 +1547,27 @@ void Symbolizer::visitInsertValueInst(InsertValueInst &I) {
 
 void Symbolizer::visitExtractValueInst(ExtractValueInst &I) {
   IRBuilder<> IRB(&I);
+
+  if (auto *call = dyn_cast<CallInst>(I.getAggregateOperand());
+      call != nullptr && call->getCalledFunction() != nullptr) {
+    // For arithmetic with overflow check, we compute the requested member
+    // directly (see handleIntrinsicCall).
+    if (auto operation = getOverflowCheckedOperation(
+            call->getCalledFunction()->getIntrinsicID())) {
+      if (!isBitVectorInteger(call->getArgOperand(0)->getType()))
+        return;
+
+      auto [opcode, isSigned] = *operation;
+      auto member = buildRuntimeCall(
+          IRB,
+          (I.getIndices()[0] == 0)
+              ? runtime.binaryOperatorHandlers[opcode]
+              : runtime.overflowCheckHandlers[opcode][isSigned],
+          {call->getArgOperand(0), call->getArgOperand(1)});
+      registerSymbolicComputation(member, &I);
+      return;
+    }
+  }
   auto extract = buildRuntimeCall(
       IRB, runtime.buildExtract,
       {{I.getAggregateOperand(), true},
@@ -807,6 +1579,149 @@ void Symbolizer::visitExtractValueInst(ExtractValueInst &I) {
   registerSymbolicComputation(extract, &I);
 }
 
+void Symbolizer::visitExtractElementInst(ExtractElementInst &I) {
+  auto *vectorType = I.getVectorOperandType();
+  if (!isSupportedVectorType(vectorType)) {
+    warnUnsupportedVectorOperation(I);
+    return;
+  }
+
+  if (getSymbolicExpression(I.getVectorOperand()) == nullptr)
+    return;
+
+  IRBuilder<> IRB(&I);
+  auto *previous = I.getPrevNode();
+  SmallVector<Input, kExpectedSymbolicArgumentsPerComputation> inputs;
+
+  CallInst *bits;
+  if (auto *ci = dyn_cast<ConstantInt>(I.getIndexOperand())) {
+    bits = extractVectorElement(IRB, I.getVectorOperand(), ci->getZExtValue(),
+                                inputs);
+  } else {
+    // We use the concrete index; out-of-range indices produce poison, so we
+    // can extract whatever we like in that case.
+    auto numElements = cast<FixedVectorType>(vectorType)->getNumElements();
+    auto *index = IRB.CreateZExtOrTrunc(I.getIndexOperand(), intPtrType);
+    index = IRB.CreateSelect(
+        IRB.CreateICmpULT(index, ConstantInt::get(intPtrType, numElements)),
+        index, ConstantInt::get(intPtrType, 0));
+    if (!dataLayout.isLittleEndian())
+      index = IRB.CreateSub(ConstantInt::get(intPtrType, numElements - 1),
+                            index);
+    auto *lowBit = IRB.CreateMul(
+        index, ConstantInt::get(intPtrType, dataLayout.getTypeSizeInBits(
+                                                I.getType())));
+    bits = extractVectorElement(IRB, I.getVectorOperand(), lowBit, inputs);
+  }
+
+  registerVectorComputation(I, previous,
+                            convertBitsToScalar(IRB, bits, I.getType()),
+                            inputs);
+}
+
+void Symbolizer::visitInsertElementInst(InsertElementInst &I) {
+  if (!isSupportedVectorType(I.getType())) {
+    warnUnsupportedVectorOperation(I);
+    return;
+  }
+
+  auto *vector = I.getOperand(0);
+  auto *element = I.getOperand(1);
+  auto *index = I.getOperand(2);
+  if (getSymbolicExpression(vector) == nullptr &&
+      getSymbolicExpression(element) == nullptr)
+    return;
+
+  IRBuilder<> IRB(&I);
+  auto *previous = I.getPrevNode();
+  SmallVector<Input, kExpectedSymbolicArgumentsPerComputation> inputs;
+
+  // Convert the new element to bits. Integers don't need a conversion, but we
+  // extract all their bits anyway so that there is a single user of the
+  // element's expression that we can redirect if the element is concrete.
+  auto *elementType = element->getType();
+  auto *elementExpr = getSymbolicExpressionOrNull(element);
+  CallInst *elementBits;
+  if (elementType->isFloatingPointTy()) {
+    elementBits = IRB.CreateCall(runtime.buildFloatToBits, elementExpr);
+  } else if (elementType->isIntegerTy(1)) {
+    elementBits = IRB.CreateCall(runtime.buildBoolToBit, elementExpr);
+  } else {
+    elementBits = IRB.CreateCall(
+        runtime.extractHelper,
+        {elementExpr,
+         ConstantInt::get(intPtrType,
+                          dataLayout.getTypeSizeInBits(elementType) - 1),
+         ConstantInt::get(intPtrType, 0)});
+  }
+  inputs.push_back({element, 0, elementBits});
+
+  auto *constantIndex = dyn_cast<ConstantInt>(index);
+  SmallVector<Value *, 8> elements;
+  for (unsigned i = 0, e = cast<FixedVectorType>(I.getType())->getNumElements();
+       i < e; i++) {
+    if (constantIndex != nullptr) {
+      elements.push_back(constantIndex->equalsInt(i)
+                             ? elementBits
+                             : extractVectorElement(IRB, vector, i, inputs));
+    } else {
+      elements.push_back(IRB.CreateSelect(
+          IRB.CreateICmpEQ(index, ConstantInt::get(index->getType(), i)),
+          elementBits, extractVectorElement(IRB, vector, i, inputs)));
+    }
+  }
+
+  registerVectorComputation(I, previous, concatVectorElements(IRB, elements),
+                            inputs);
+}
+
+void Symbolizer::visitShuffleVectorInst(ShuffleVectorInst &I) {
+  auto *vectorType = cast<VectorType>(I.getType());
+  if (!isSupportedVectorType(vectorType) ||
+      !isSupportedVectorType(I.getOperand(0)->getType())) {
+    warnUnsupportedVectorOperation(I);
+    return;
+  }
+
+  SmallVector<int, 8> mask;
+  I.getShuffleMask(mask);
+  auto numSourceElements =
+      cast<FixedVectorType>(I.getOperand(0)->getType())->getNumElements();
+
+  // Only build an expression if one of the selected elements is symbolic.
+  if (std::none_of(mask.begin(), mask.end(), [&](int maskElement) {
+        if (maskElement < 0)
+          return false;
+        return getSymbolicExpression(I.getOperand(
+                   unsigned(maskElement) < numSourceElements ? 0 : 1)) !=
+               nullptr;
+      }))
+    return;
+
+  IRBuilder<> IRB(&I);
+  auto *previous = I.getPrevNode();
+  SmallVector<Input, kExpectedSymbolicArgumentsPerComputation> inputs;
+  auto elementBits = dataLayout.getTypeSizeInBits(vectorType->getElementType());
+
+  SmallVector<Value *, 8> elements;
+  for (int maskElement : mask) {
+    if (maskElement < 0) {
+      // An undefined element; any value will do.
+      elements.push_back(IRB.CreateCall(
+          runtime.buildInteger, {IRB.getInt64(0), IRB.getInt8(elementBits)}));
+    } else if (unsigned(maskElement) < numSourceElements) {
+      elements.push_back(
+          extractVectorElement(IRB, I.getOperand(0), maskElement, inputs));
+    } else {
+      elements.push_back(extractVectorElement(
+          IRB, I.getOperand(1), maskElement - numSourceElements, inputs));
+    }
+  }
+
+  registerVectorComputation(I, previous, concatVectorElements(IRB, elements),
+                            inputs);
+}
+
 void Symbolizer::visitSwitchInst(SwitchInst &I) {
   // Switch compares a value against a set of integer constants; duplicate
   // constants are not allowed
@@ -868,26 +1783,24 @@ CallInst *Symbolizer::createValueExpression(Value *V, IRBuilder<> &IRB) {
   }
 
   if (valueType->isIntegerTy()) {
-    auto bits = valueType->getPrimitiveSizeInBits();
-    if (bits == 1) {
+    if (valueType->getPrimitiveSizeInBits() == 1) {
       // Special case: LLVM uses the type i1 to represent Boolean values, but
       // for Z3 we have to create expressions of a separate sort.
       return IRB.CreateCall(runtime.buildBool, {V});
-    } else if (bits <= 64) {
-      return IRB.CreateCall(runtime.buildInteger,
-                            {IRB.CreateZExtOrBitCast(V, IRB.getInt64Ty()),
-                             IRB.getInt8(valueType->getPrimitiveSizeInBits())});
-    } else {
-      // Anything up to the maximum supported 128 bits. Those integers are a bit
-      // tricky because the symbolic backends don't support them per se. We have
-      // a special function in the run-time library that handles them, usually
-      // by assembling expressions from smaller chunks.
-      return IRB.CreateCall(
-          runtime.buildInteger128,
-          {IRB.CreateTrunc(IRB.CreateLShr(V, ConstantInt::get(valueType, 64)),
-                           IRB.getInt64Ty()),
-           IRB.CreateTrunc(V, IRB.getInt64Ty())});
     }
+
+    return createBitVectorExpression(V, IRB);
+  }
+
+  if (auto *vectorType = dyn_cast<FixedVectorType>(valueType)) {
+    // The expression describes the bits of the vector (see
+    // isSupportedVectorType), so we just need an integer.
+    auto *bits = V;
+    if (vectorType->getElementType()->isPointerTy())
+      bits = IRB.CreatePtrToInt(
+          bits, FixedVectorType::get(intPtrType, vectorType->getNumElements()));
+    auto *integerType = IRB.getIntNTy(dataLayout.getTypeSizeInBits(vectorType));
+    return createBitVectorExpression(IRB.CreateBitCast(bits, integerType), IRB);
   }
 
   if (valueType->isFloatingPointTy()) {
@@ -930,6 +1843,192 @@ CallInst *Symbolizer::createValueExpression(Value *V, IRBuilder<> &IRB) {
   llvm_unreachable("Unhandled type for constant expression");
 }
 
+CallInst *Symbolizer::createBitVectorExpression(Value *V, IRBuilder<> &IRB) {
+  auto *valueType = V->getType();
+  auto bits = valueType->getPrimitiveSizeInBits();
+
+  if (bits <= 64) {
+    return IRB.CreateCall(runtime.buildInteger,
+                          {IRB.CreateZExtOrBitCast(V, IRB.getInt64Ty()),
+                           IRB.getInt8(bits)});
+  }
+
+  if (bits == 128) {
+    // Integers of 128 bits are a bit tricky because the symbolic backends
+    // don't support them per se. We have a special function in the run-time
+    // library that handles them, usually by assembling expressions from
+    // smaller chunks.
+    return IRB.CreateCall(
+        runtime.buildInteger128,
+        {IRB.CreateTrunc(IRB.CreateLShr(V, ConstantInt::get(valueType, 64)),
+                         IRB.getInt64Ty()),
+         IRB.CreateTrunc(V, IRB.getInt64Ty())});
+  }
+
+  // Other wide integers (e.g., vectors in registers) are assembled from
+  // chunks of at most 64 bits, starting with the least significant one.
+  CallInst *result = nullptr;
+  for (unsigned offset = 0; offset < bits; offset += 64) {
+    auto chunkBits = std::min(64u, unsigned(bits) - offset);
+    auto *chunk = IRB.CreateTrunc(
+        IRB.CreateLShr(V, ConstantInt::get(valueType, offset)),
+        IRB.getIntNTy(chunkBits));
+    auto *chunkExpr = IRB.CreateCall(
+        runtime.buildInteger, {IRB.CreateZExtOrBitCast(chunk, IRB.getInt64Ty()),
+                               IRB.getInt8(chunkBits)});
+    result = (result == nullptr)
+                 ? chunkExpr
+                 : IRB.CreateCall(runtime.concatHelper, {chunkExpr, result});
+  }
+
+  return result;
+}
+
+bool Symbolizer::isSupportedVectorType(Type *type) const {
+  auto *vectorType = dyn_cast<FixedVectorType>(type);
+  if (vectorType == nullptr)
+    return false;
+
+  auto *elementType = vectorType->getElementType();
+  return (elementType->isIntegerTy() &&
+          elementType->getIntegerBitWidth() <= 128) ||
+         elementType->isFloatTy() || elementType->isDoubleTy() ||
+         elementType->isPointerTy();
+}
+
+CallInst *Symbolizer::extractVectorElement(IRBuilder<> &IRB, Value *vector,
+                                           Value *lowBit,
+                                           SmallVectorImpl<Input> &inputs) {
+  auto *elementType = cast<VectorType>(vector->getType())->getElementType();
+  auto *highBit = IRB.CreateAdd(
+      lowBit, ConstantInt::get(intPtrType,
+                               dataLayout.getTypeSizeInBits(elementType) - 1));
+  auto *extract = IRB.CreateCall(
+      runtime.extractHelper,
+      {getSymbolicExpressionOrNull(vector), highBit, lowBit});
+  inputs.push_back({vector, 0, extract});
+  return extract;
+}
+
+CallInst *Symbolizer::extractVectorElement(IRBuilder<> &IRB, Value *vector,
+                                           unsigned index,
+                                           SmallVectorImpl<Input> &inputs) {
+  auto *vectorType = cast<FixedVectorType>(vector->getType());
+  unsigned position = dataLayout.isLittleEndian()
+                          ? index
+                          : vectorType->getNumElements() - 1 - index;
+  return extractVectorElement(
+      IRB, vector,
+      ConstantInt::get(intPtrType,
+                       position * dataLayout.getTypeSizeInBits(
+                                      vectorType->getElementType())),
+      inputs);
+}
+
+Value *Symbolizer::concatVectorElements(IRBuilder<> &IRB,
+                                        ArrayRef<Value *> elements) {
+  // Concatenation puts the first argument into the most significant bits, so
+  // we start with the last element on little-endian targets.
+  Value *result = nullptr;
+  auto append = [&](Value *element) {
+    result = (result == nullptr)
+                 ? element
+                 : IRB.CreateCall(runtime.concatHelper, {result, element});
+  };
+
+  if (dataLayout.isLittleEndian()) {
+    for (auto *element : llvm::reverse(elements))
+      append(element);
+  } else {
+    for (auto *element : elements)
+      append(element);
+  }
+
+  return result;
+}
+
+void Symbolizer::buildVectorElementwise(
+    Instruction &I, ArrayRef<Value *> operands,
+    function_ref<Value *(IRBuilder<> &, unsigned, ArrayRef<Value *>)>
+        buildElement) {
+  if (std::all_of(operands.begin(), operands.end(), [this](Value *operand) {
+        return getSymbolicExpression(operand) == nullptr;
+      }))
+    return;
+
+  IRBuilder<> IRB(&I);
+  auto *previous = I.getPrevNode();
+  SmallVector<Input, kExpectedSymbolicArgumentsPerComputation> inputs;
+
+  SmallVector<Value *, 8> elements;
+  SmallVector<Value *, 2> operandElements;
+  for (unsigned i = 0, e = cast<FixedVectorType>(I.getType())->getNumElements();
+       i < e; i++) {
+    operandElements.clear();
+    for (auto *operand : operands)
+      operandElements.push_back(extractVectorElement(IRB, operand, i, inputs));
+    elements.push_back(buildElement(IRB, i, operandElements));
+  }
+
+  registerVectorComputation(I, previous, concatVectorElements(IRB, elements),
+                            inputs);
+}
+
+void Symbolizer::resizeVectorElements(CastInst &I) {
+  if (!isSupportedVectorType(I.getSrcTy()) ||
+      !isSupportedVectorType(I.getDestTy())) {
+    warnUnsupportedVectorOperation(I);
+    return;
+  }
+
+  auto srcBits = dataLayout.getTypeSizeInBits(
+      cast<VectorType>(I.getSrcTy())->getElementType());
+  auto destBits = dataLayout.getTypeSizeInBits(
+      cast<VectorType>(I.getDestTy())->getElementType());
+  if (srcBits == destBits) {
+    if (auto *expr = getSymbolicExpression(I.getOperand(0)))
+      symbolicExpressions[&I] = expr;
+    return;
+  }
+
+  // Unlike for scalars, we can't ignore the difference in width because it
+  // would shift the positions of the elements.
+  buildVectorElementwise(
+      I, I.getOperand(0),
+      [&](IRBuilder<> &IRB, unsigned, ArrayRef<Value *> elements) {
+        if (destBits < srcBits)
+          return IRB.CreateCall(runtime.buildTrunc,
+                                {elements[0], IRB.getInt8(destBits)});
+        return IRB.CreateCall(runtime.buildZExt,
+                              {elements[0], IRB.getInt8(destBits - srcBits)});
+      });
+}
+
+Value *Symbolizer::convertBitsToScalar(IRBuilder<> &IRB, Value *bits,
+                                       Type *scalarType) {
+  if (scalarType->isFloatingPointTy())
+    return IRB.CreateCall(runtime.buildBitsToFloat,
+                          {bits, IRB.getInt1(scalarType->isDoubleTy())});
+
+  if (scalarType->isIntegerTy(1))
+    return IRB.CreateCall(
+        runtime.comparisonHandlers[CmpInst::ICMP_EQ],
+        {bits, IRB.CreateCall(runtime.buildInteger,
+                              {IRB.getInt64(1), IRB.getInt8(1)})});
+
+  return bits;
+}
+
+void Symbolizer::registerVectorComputation(Instruction &I,
+                                           Instruction *previous,
+                                           Value *result,
+                                           ArrayRef<Input> inputs) {
+  auto *first = (previous != nullptr) ? previous->getNextNode()
+                                      : &I.getParent()->front();
+  registerSymbolicComputation(
+      SymbolicComputation(first, cast<Instruction>(result), inputs), &I);
+}
+
 Symbolizer::SymbolicComputation
 Symbolizer::forceBuildRuntimeCall(IRBuilder<> &IRB, SymFnT function,
                                   ArrayRef<std::pair<Value *, bool>> args) {
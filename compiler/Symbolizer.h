@@ -36,7 +36,28 @@ public:
 
   /// Insert a call to the run-time library to notify it of the basic block
   /// entry.
-  void insertBasicBlockNotification(llvm::BasicBlock &B);
+  ///
+  /// Blocks in the sparse set (i.e., function entries and loop headers) are
+  /// also reported to backends that request sparse notifications.
+  void insertBasicBlockNotification(llvm::BasicBlock &B, bool inSparseSet);
+
+  /// Select between the symbolic and the concrete version of a function.
+  ///
+  /// The dispatch block must end in an unconditional branch to the entry of
+  /// the symbolic version; we make it branch to the concrete version instead
+  /// if the expressions of all parameters are null at run time. Call this
+  /// after symbolizeFunctionArguments.
+  void insertConcreteFastPathCheck(llvm::BasicBlock &dispatch,
+                                   llvm::BasicBlock *concreteEntry);
+
+  /// Switch from the symbolic version of a loop to the concrete copy.
+  ///
+  /// We split the header after its PHI nodes and branch to the copy of the
+  /// header if the expressions of all given values are null at run time. Call
+  /// this after processing all instructions but before finalizePHINodes.
+  void insertConcreteLoopSwitch(llvm::BasicBlock &header,
+                                llvm::BasicBlock *concreteHeader,
+                                llvm::ArrayRef<llvm::Value *> liveValues);
 
   /// Finish the processing of PHI nodes.
   ///
@@ -93,8 +114,21 @@ public:
   ///
   /// The resulting code is much longer but avoids solver calls for all
   /// operations without symbolic data.
+  ///
+  /// Consecutive computations in a basic block that are only separated by
+  /// pure instructions of the program share a single check, though: we hoist
+  /// the program's instructions above the group and branch once around all
+  /// of the group's computations (see shortCircuitRegion).
   void shortCircuitExpressionUses();
 
+  /// Execute notifications only if the backend requests them.
+  ///
+  /// We check _sym_backend_notifications before each call to a notification
+  /// function, so that backends without call-stack tracking don't pay for a
+  /// call into the library at every basic block. This splits basic blocks, so
+  /// call it after all other instrumentation.
+  void guardNotifications(llvm::Function &F);
+
   void handleIntrinsicCall(llvm::CallBase &I);
   void handleInlineAssembly(llvm::CallInst &I);
   void handleFunctionCall(llvm::CallBase &I, llvm::Instruction *returnPoint);
@@ -128,6 +162,9 @@ public:
   void visitPHINode(llvm::PHINode &I);
   void visitInsertValueInst(llvm::InsertValueInst &I);
   void visitExtractValueInst(llvm::ExtractValueInst &I);
+  void visitExtractElementInst(llvm::ExtractElementInst &I);
+  void visitInsertElementInst(llvm::InsertElementInst &I);
+  void visitShuffleVectorInst(llvm::ShuffleVectorInst &I);
   void visitSwitchInst(llvm::SwitchInst &I);
   void visitUnreachableInst(llvm::UnreachableInst &);
   void visitInstruction(llvm::Instruction &I);
@@ -192,9 +229,95 @@ private:
     }
   };
 
+  /// A group of symbolic computations that share a concreteness check.
+  using ComputationRegion = llvm::SmallVector<SymbolicComputation *, 4>;
+
+  /// Group the recorded expression uses into regions.
+  ///
+  /// A computation joins the region of its predecessor if both produce an
+  /// expression, they're in the same basic block, and the instructions in
+  /// between can be hoisted above the region.
+  std::vector<ComputationRegion> buildComputationRegions();
+
+  /// Short-circuit a single computation (see shortCircuitExpressionUses).
+  void shortCircuitComputation(SymbolicComputation &symbolicComputation);
+
+  /// Short-circuit a region of several computations.
+  ///
+  /// If all inputs from outside the region are concrete, we skip the entire
+  /// region; otherwise, we run all of its computations, creating expressions
+  /// for any input that turns out to be concrete.
+  void shortCircuitRegion(llvm::ArrayRef<SymbolicComputation *> region);
+
   /// Create an expression that represents the concrete value.
   llvm::CallInst *createValueExpression(llvm::Value *V, llvm::IRBuilder<> &IRB);
 
+  /// Create a bit-vector expression for a concrete integer of any width.
+  llvm::CallInst *createBitVectorExpression(llvm::Value *V,
+                                            llvm::IRBuilder<> &IRB);
+
+  /// Decide whether we can represent values of the given type as vectors.
+  ///
+  /// The expression of a vector is a single bit vector that describes the
+  /// vector as if it were bit-cast to an integer: on little-endian targets,
+  /// element i occupies the bits starting at i times the element width, and
+  /// on big-endian targets the elements are counted from the most significant
+  /// bits. This is exactly the layout in memory, so vector loads and stores
+  /// don't need any conversion. Floating-point elements are represented by
+  /// their bits, and Boolean elements by a single bit each.
+  bool isSupportedVectorType(llvm::Type *type) const;
+
+  /// Warn that we can't handle a vector operation; the result is concretized.
+  void warnUnsupportedVectorOperation(llvm::Instruction &I) const {
+    llvm::errs() << "Warning: unsupported vector operation " << I
+                 << "; the result will be concretized\n";
+  }
+
+  /// Extract the bits of one element from the expression of a vector.
+  ///
+  /// The vector is recorded as an input of the computation, with the
+  /// extraction as its user. The low bit is an integer of type intPtrType.
+  llvm::CallInst *extractVectorElement(llvm::IRBuilder<> &IRB,
+                                       llvm::Value *vector,
+                                       llvm::Value *lowBit,
+                                       llvm::SmallVectorImpl<Input> &inputs);
+
+  /// Same as above for an element at a constant index.
+  llvm::CallInst *extractVectorElement(llvm::IRBuilder<> &IRB,
+                                       llvm::Value *vector, unsigned index,
+                                       llvm::SmallVectorImpl<Input> &inputs);
+
+  /// Assemble a vector expression from the bits of its elements.
+  llvm::Value *concatVectorElements(llvm::IRBuilder<> &IRB,
+                                    llvm::ArrayRef<llvm::Value *> elements);
+
+  /// Build a vector operation element by element.
+  ///
+  /// For each element of the result, the callback receives the index and the
+  /// bits of the corresponding elements of the vector operands, and it returns
+  /// the bits of the result element.
+  void buildVectorElementwise(
+      llvm::Instruction &I, llvm::ArrayRef<llvm::Value *> operands,
+      llvm::function_ref<llvm::Value *(llvm::IRBuilder<> &, unsigned,
+                                       llvm::ArrayRef<llvm::Value *>)>
+          buildElement);
+
+  /// Handle casts between vectors of integers and vectors of pointers.
+  void resizeVectorElements(llvm::CastInst &I);
+
+  /// Convert the bits of a vector element to the expression of a scalar.
+  llvm::Value *convertBitsToScalar(llvm::IRBuilder<> &IRB, llvm::Value *bits,
+                                   llvm::Type *scalarType);
+
+  /// Register a vector computation that was inserted right before I.
+  ///
+  /// The computation consists of all instructions after "previous" (or from
+  /// the beginning of the block if "previous" is null) up to the result.
+  void registerVectorComputation(llvm::Instruction &I,
+                                 llvm::Instruction *previous,
+                                 llvm::Value *result,
+                                 llvm::ArrayRef<Input> inputs);
+
   /// Get the (already created) symbolic expression for a value.
   llvm::Value *getSymbolicExpression(llvm::Value *V) {
     auto exprIt = symbolicExpressions.find(V);
@@ -344,6 +467,10 @@ private:
   /// Therefore, we keep a record of all the places that construct expressions
   /// and insert the fast path later.
   std::vector<SymbolicComputation> expressionUses;
+
+  /// The calls to notification functions, along with the flags in
+  /// _sym_backend_notifications that enable them (see guardNotifications).
+  llvm::SmallVector<std::pair<llvm::CallInst *, uint32_t>, 0> notifications;
 };
 
 #endif
@@ -0,0 +1,36 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef BACKENDLOCK_H
+#define BACKENDLOCK_H
+
+#include <mutex>
+
+/// The solvers and the backends' expression bookkeeping are not thread-safe,
+/// so every backend entry point that touches them runs under this lock. It is
+/// recursive because builders call each other (and the generic builders in
+/// RuntimeCommon.cpp call back into the backend).
+extern std::recursive_mutex g_backend_mutex;
+
+/// Hold the backend lock for the lifetime of the object.
+class BackendLock {
+public:
+  BackendLock() { g_backend_mutex.lock(); }
+  ~BackendLock() { g_backend_mutex.unlock(); }
+
+  BackendLock(const BackendLock &) = delete;
+  BackendLock &operator=(const BackendLock &) = delete;
+};
+
+#endif
@@ -37,6 +37,20 @@ bool checkFlagString(std::string value) {
   throw std::runtime_error(msg.str());
 }
 
+unsigned parseCount(const char *variable, const char *value) {
+  try {
+    auto result = std::stoul(value);
+    if (result <= std::numeric_limits<unsigned>::max())
+      return result;
+  } catch (std::logic_error &) {
+  }
+
+  std::stringstream msg;
+  msg << "The value of " << variable << " must be a number between 0 and "
+      << std::numeric_limits<unsigned>::max();
+  throw std::runtime_error(msg.str());
+}
+
 } // namespace
 
 Config g_config;
@@ -91,4 +105,51 @@ void loadConfig() {
       throw std::runtime_error(msg.str());
     }
   }
+
+  auto *controlFd = getenv("SYMCC_CONTROL_FD");
+  if (controlFd != nullptr) {
+    try {
+      g_config.controlFd = std::stoi(controlFd);
+    } catch (std::logic_error &) {
+      std::stringstream msg;
+      msg << "Can't convert " << controlFd << " to a file descriptor";
+      throw std::runtime_error(msg.str());
+    }
+  }
+
+  auto *outputRingFd = getenv("SYMCC_OUTPUT_RING_FD");
+  if (outputRingFd != nullptr) {
+    try {
+      g_config.outputRingFd = std::stoi(outputRingFd);
+    } catch (std::logic_error &) {
+      std::stringstream msg;
+      msg << "Can't convert " << outputRingFd << " to a file descriptor";
+      throw std::runtime_error(msg.str());
+    }
+  }
+
+  auto *forkServer = getenv("SYMCC_FORK_SERVER");
+  if (forkServer != nullptr)
+    g_config.forkServer = checkFlagString(forkServer);
+
+  auto *explorationForks = getenv("SYMCC_EXPLORE");
+  if (explorationForks != nullptr)
+    g_config.explorationForks = parseCount("SYMCC_EXPLORE", explorationForks);
+
+  auto *explorationLimit = getenv("SYMCC_EXPLORE_LIMIT");
+  if (explorationLimit != nullptr)
+    g_config.explorationLimit =
+        parseCount("SYMCC_EXPLORE_LIMIT", explorationLimit);
+
+  auto *traceFile = getenv("SYMCC_TRACE_FILE");
+  if (traceFile != nullptr)
+    g_config.traceFile = traceFile;
+
+  auto *statsFile = getenv("SYMCC_STATS_FILE");
+  if (statsFile != nullptr)
+    g_config.statsFile = statsFile;
+
+  auto *liveStats = getenv("SYMCC_LIVE_STATS");
+  if (liveStats != nullptr)
+    g_config.liveStats = checkFlagString(liveStats);
 }
@@ -65,12 +65,49 @@ struct Config {
   /// 2GB on most workloads because requiring that amount of memory per core
   /// participating in the analysis seems reasonable.
   size_t garbageCollectionThreshold = 5'000'000;
+
+  /// The file descriptor of the channel to a driver process, or -1 if there
+  /// is none.
+  ///
+  /// A driver (such as the fuzzing helper) uses the channel to hand inputs to
+  /// a long-running process, e.g., in persistent mode (see symcc_reset).
+  int controlFd = -1;
+
+  /// The file descriptor of the memory for the output ring, or -1 if test
+  /// cases go to files in the output directory (see OutputRing.h).
+  int outputRingFd = -1;
+
+  /// Do we run as a fork server on the control channel?
+  ///
+  /// Instead of executing the program once, the process forks a child per
+  /// input that the driver requests (see ForkServer.h).
+  bool forkServer = false;
+
+  /// The maximum number of processes exploring in parallel, or 0 to disable
+  /// exploration by snapshot and fork (see Exploration.h).
+  unsigned explorationForks = 0;
+
+  /// The maximum number of executions during exploration.
+  unsigned explorationLimit = 1000;
+
+  /// The file to record the execution trace in, or empty to disable
+  /// recording (see Trace.h).
+  std::string traceFile = "";
+
+  /// The file to write statistics to, or empty to disable statistics (see
+  /// Stats.h).
+  std::string statsFile = "";
+
+  /// Do we publish statistics in shared memory while the program runs (see
+  /// StatsPage.h)?
+  bool liveStats = false;
 };
 
 /// The global configuration object.
 ///
 /// It should be initialized once before we start executing the program and
-/// never changed afterwards.
+/// never changed afterwards, except that a driver may assign a new output
+/// directory with each input.
 extern Config g_config;
 
 /// Populate g_config from the environment.
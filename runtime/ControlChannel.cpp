@@ -0,0 +1,65 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "ControlChannel.h"
+
+#include <cerrno>
+
+#include <unistd.h>
+
+#include "Config.h"
+
+namespace {
+
+/// Read a newline-terminated line from the channel, dropping the newline.
+///
+/// We read byte by byte because the requests are tiny, and nothing may remain
+/// buffered in the process when it forks.
+bool readLine(std::string &line) {
+  line.clear();
+  while (true) {
+    char c;
+    auto result = read(g_config.controlFd, &c, 1);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0)
+      return false;
+    if (c == '\n')
+      return true;
+    line.push_back(c);
+  }
+}
+
+} // namespace
+
+bool haveControlChannel() { return g_config.controlFd >= 0; }
+
+bool receiveControlRequest(ControlRequest &request) {
+  return readLine(request.inputFile) && readLine(request.outputDir);
+}
+
+void sendControlStatus(int status) {
+  auto message = std::to_string(status) + '\n';
+  const char *data = message.data();
+  size_t remaining = message.size();
+  while (remaining > 0) {
+    auto result = write(g_config.controlFd, data, remaining);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0)
+      return; // The driver is gone; it will notice that we are, too.
+    data += result;
+    remaining -= result;
+  }
+}
@@ -0,0 +1,54 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef CONTROLCHANNEL_H
+#define CONTROLCHANNEL_H
+
+#include <string>
+
+//
+// The channel between the runtime and a driver process (e.g., the fuzzing
+// helper) that hands inputs to a long-running instance of the target program.
+// The driver passes the channel's file descriptor in SYMCC_CONTROL_FD. It then
+// sends a request per input, consisting of two lines: the name of the file
+// with the input, and the directory for the test cases generated from it. The
+// runtime answers each request with a line containing a decimal status code
+// once it is done with the input. (A fork server additionally announces the
+// process ID of the child for each input; see ForkServer.h.) Closing the
+// channel tells the runtime to stop.
+//
+
+/// A request from the driver to process an input.
+struct ControlRequest {
+  /// The file that contains the input.
+  std::string inputFile;
+
+  /// The directory for the test cases generated from the input.
+  std::string outputDir;
+};
+
+/// Determine whether a driver controls this process.
+bool haveControlChannel();
+
+/// Wait for the next request from the driver.
+///
+/// Return false if the driver has closed the channel.
+bool receiveControlRequest(ControlRequest &request);
+
+/// Report to the driver that we're done with the current request.
+///
+/// The fork server also uses this to send the child's process ID.
+void sendControlStatus(int status);
+
+#endif
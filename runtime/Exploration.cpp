@@ -0,0 +1,328 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "Exploration.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <queue>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Config.h"
+#include "ForkServer.h"
+#include "OutputRing.h"
+
+namespace {
+
+/// An input waiting for execution.
+struct QueuedInput {
+  /// The number of executions that led to this input (0 for the original one).
+  unsigned generation;
+
+  /// A unique identifier; the order of identifiers is the order of discovery.
+  unsigned id;
+
+  /// The file containing the input.
+  std::string file;
+
+  /// Order the queue such that inputs of earlier generations come first, and
+  /// otherwise earlier discoveries.
+  bool operator<(const QueuedInput &other) const {
+    return std::tie(generation, id) > std::tie(other.generation, other.id);
+  }
+};
+
+bool explorationStarted = false;
+
+/// A new input that an exploring child hands to the scheduler.
+struct ExplorationRequest {
+  /// The generation of the child's own input.
+  unsigned generation;
+
+  /// The child and the number of the input among those it has found; together,
+  /// they name the file with the input.
+  pid_t pid;
+  unsigned number;
+};
+
+/// The scheduler's work directory.
+std::string workDir;
+
+/// The pipe on which children send requests to the scheduler; children only
+/// keep the write end.
+int requestPipe[2] = {-1, -1};
+
+/// The pipe on which the scheduler's SIGCHLD handler wakes up its main loop.
+int childExitPipe[2] = {-1, -1};
+
+/// In an exploring child, the generation of its input; the number of inputs
+/// that it has handed to the scheduler so far.
+std::optional<unsigned> childGeneration;
+unsigned childRequests = 0;
+
+std::string foundInputFile(pid_t pid, unsigned number) {
+  return workDir + "/found-" + std::to_string(pid) + "-" +
+         std::to_string(number);
+}
+
+void handleChildExit(int) {
+  int savedErrno = errno;
+  char byte = 0;
+  // If the pipe is full, the scheduler is going to wake up anyway.
+  (void)!write(childExitPipe[1], &byte, sizeof(byte));
+  errno = savedErrno;
+}
+
+void writeFile(const std::string &file, const std::string &contents) {
+  std::ofstream stream(file, std::ios::binary);
+  stream.write(contents.data(), contents.size());
+  if (!stream)
+    std::cerr << "Warning: failed to write " << file << std::endl;
+}
+
+/// List the files in the given directory.
+std::vector<std::string> listDirectory(const std::string &directory) {
+  std::vector<std::string> result;
+  auto *dir = opendir(directory.c_str());
+  if (dir == nullptr)
+    return result;
+
+  while (auto *entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name != "." && name != "..")
+      result.push_back(directory + "/" + name);
+  }
+
+  closedir(dir);
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+/// Terminate the scheduler like the execution on the original input did.
+[[noreturn]] void exitLike(int status) {
+  if (WIFSIGNALED(status)) {
+    signal(WTERMSIG(status), SIG_DFL);
+    raise(WTERMSIG(status));
+  }
+
+  _exit(WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+}
+
+} // namespace
+
+std::string readExplorationInput(const std::string &file) {
+  std::ifstream stream(file, std::ios::binary);
+  return {std::istreambuf_iterator<char>(stream),
+          std::istreambuf_iterator<char>()};
+}
+
+std::optional<std::string>
+startExploration(const std::function<std::string()> &readInitialInput) {
+  if (g_config.explorationForks == 0 || std::exchange(explorationStarted, true))
+    return std::nullopt;
+
+  char workDirTemplate[] = "/tmp/symcc-explore-XXXXXX";
+  if (mkdtemp(workDirTemplate) == nullptr) {
+    perror("Failed to create a directory for exploration");
+    return std::nullopt;
+  }
+
+  if (pipe2(requestPipe, O_CLOEXEC) != 0 ||
+      pipe2(childExitPipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+    perror("Failed to create the pipes for exploration");
+    rmdir(workDirTemplate);
+    return std::nullopt;
+  }
+  // Children only write requests, so the scheduler can read without blocking
+  // and use poll to wait.
+  fcntl(requestPipe[0], F_SETFL, O_NONBLOCK);
+
+  struct sigaction childExitAction = {}, previousChildExitAction;
+  childExitAction.sa_handler = handleChildExit;
+  childExitAction.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+  sigemptyset(&childExitAction.sa_mask);
+  sigaction(SIGCHLD, &childExitAction, &previousChildExitAction);
+
+  workDir = workDirTemplate;
+  std::string privateBitmap;
+  if (g_config.aflCoverageMap.empty()) {
+    // Let the children share their coverage, so that they don't all generate
+    // inputs for the same branches.
+    privateBitmap = workDir + "/bitmap";
+    g_config.aflCoverageMap = privateBitmap;
+  }
+
+  // Don't let the children inherit buffered output.
+  fflush(nullptr);
+
+  auto initialInput = readInitialInput();
+  std::priority_queue<QueuedInput> queue;
+  queue.push({0, 0, workDir + "/input-0"});
+  writeFile(queue.top().file, initialInput);
+
+  std::unordered_set<size_t> seen{std::hash<std::string>{}(initialInput)};
+  std::map<pid_t, QueuedInput> live;
+  unsigned nextId = 1, executions = 0, testCases = 0;
+  int initialStatus = 0;
+
+  // Queue a test case that a child of the given generation has found, unless
+  // we've seen it before.
+  auto queueTestCase = [&](const std::string &file, unsigned generation) {
+    auto contents = readExplorationInput(file);
+    if (!seen.insert(std::hash<std::string>{}(contents)).second) {
+      unlink(file.c_str());
+      return;
+    }
+
+    saveTestCase(contents);
+    testCases++;
+
+    auto queuedFile = workDir + "/input-" + std::to_string(nextId);
+    rename(file.c_str(), queuedFile.c_str());
+    queue.push({generation + 1, nextId++, queuedFile});
+  };
+
+  while (true) {
+    while (!queue.empty() && live.size() < g_config.explorationForks &&
+           executions < g_config.explorationLimit) {
+      auto input = queue.top();
+      queue.pop();
+      auto childOutputDir = workDir + "/output-" + std::to_string(input.id);
+      mkdir(childOutputDir.c_str(), 0700);
+
+      auto pid = forkExecution(childOutputDir);
+      if (pid == 0) {
+        sigaction(SIGCHLD, &previousChildExitAction, nullptr);
+        close(requestPipe[0]);
+        close(childExitPipe[0]);
+        close(childExitPipe[1]);
+        childGeneration = input.generation;
+
+        if (input.id != 0) {
+          // Only the execution on the original input produces output.
+          int devNull = open("/dev/null", O_WRONLY);
+          dup2(devNull, STDOUT_FILENO);
+          close(devNull);
+        }
+
+        return input.file;
+      }
+
+      live.emplace(pid, std::move(input));
+      executions++;
+    }
+
+    for (auto it = live.begin(); it != live.end();) {
+      auto status = waitForExecution(it->first, false);
+      if (!status) {
+        ++it;
+        continue;
+      }
+
+      auto input = std::move(it->second);
+      it = live.erase(it);
+      if (input.id == 0)
+        initialStatus = *status;
+
+      // Backends that write test cases themselves leave them in the output
+      // directory.
+      auto childOutputDir = workDir + "/output-" + std::to_string(input.id);
+      for (const auto &file : listDirectory(childOutputDir))
+        queueTestCase(file, input.generation);
+
+      rmdir(childOutputDir.c_str());
+      unlink(input.file.c_str());
+    }
+
+    // Children hand us new inputs as soon as the solver finds them (see
+    // offerExplorationInput), so that we can start exploring them while the
+    // children are still running. We read the requests after collecting
+    // terminated children, so that we don't miss the last requests of a child.
+    ExplorationRequest requests[64];
+    ssize_t length;
+    while ((length = read(requestPipe[0], requests, sizeof(requests))) > 0) {
+      for (size_t i = 0; i < length / sizeof(ExplorationRequest); i++)
+        queueTestCase(foundInputFile(requests[i].pid, requests[i].number),
+                      requests[i].generation);
+    }
+
+    if (!queue.empty() && live.size() < g_config.explorationForks &&
+        executions < g_config.explorationLimit)
+      continue;
+    if (live.empty())
+      break;
+
+    pollfd events[] = {{requestPipe[0], POLLIN, 0},
+                       {childExitPipe[0], POLLIN, 0}};
+    if (poll(events, 2, -1) < 0 && errno != EINTR) {
+      perror("Failed to wait for exploration");
+      break;
+    }
+
+    char buffer[64];
+    while (read(childExitPipe[0], buffer, sizeof(buffer)) > 0)
+      ;
+  }
+
+  while (!queue.empty()) {
+    unlink(queue.top().file.c_str());
+    queue.pop();
+  }
+  if (!privateBitmap.empty())
+    unlink(privateBitmap.c_str());
+  rmdir(workDir.c_str());
+
+  std::cerr << "Explored " << executions << " input(s), generating "
+            << testCases << " new test case(s)" << std::endl;
+  exitLike(initialStatus);
+}
+
+bool offerExplorationInput(const std::string &testCase) {
+  if (!childGeneration)
+    return false;
+
+  ExplorationRequest request{*childGeneration, getpid(), childRequests++};
+  writeFile(foundInputFile(request.pid, request.number), testCase);
+
+  // Requests are much smaller than PIPE_BUF, so the write is atomic.
+  while (write(requestPipe[1], &request, sizeof(request)) < 0) {
+    if (errno != EINTR) {
+      perror("Failed to send a new input to the exploration scheduler");
+      unlink(foundInputFile(request.pid, request.number).c_str());
+      return false;
+    }
+  }
+
+  return true;
+}
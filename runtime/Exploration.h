@@ -0,0 +1,67 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef EXPLORATION_H
+#define EXPLORATION_H
+
+#include <functional>
+#include <optional>
+#include <string>
+
+//
+// Exploration by snapshot and fork
+//
+// Normally, each execution of the target program follows a single path, and
+// exploring the new inputs that the solver generates requires a new execution
+// for each of them. In exploration mode, the process takes a snapshot when the
+// program first consumes its symbolic input: it becomes a scheduler that forks
+// a child per input to explore, starting with the original one. Children
+// inherit everything computed up to that point (and the runtime's state)
+// copy-on-write, and they continue on their own input.
+//
+// Whenever the solver finds a new input at a path constraint of a child, the
+// child hands it to the scheduler (see offerExplorationInput), which forks a
+// new child from the snapshot right away, while the first one continues. We
+// can't fork the child itself at the branch: its concrete state has been
+// computed from the old input, so patching the input bytes in memory wouldn't
+// make it consistent with the new one. Test cases that a backend writes to the
+// output directory itself are picked up when the child terminates.
+//
+// The scheduler drops duplicate inputs, copies new ones to the output
+// directory and queues them for execution, bounding the number of live
+// children and the total number of executions (see SYMCC_EXPLORE and
+// SYMCC_EXPLORE_LIMIT). Inputs of earlier generations go first.
+//
+
+/// Take the snapshot and start exploring if the configuration asks for it.
+///
+/// The function returns nothing if exploration is disabled or has already
+/// started. Otherwise, the calling process turns into the scheduler and never
+/// returns; the function returns in the children, providing the name of the
+/// file with the input that they should work on. The callback provides the
+/// original input; it is only called if the exploration starts.
+std::optional<std::string>
+startExploration(const std::function<std::string()> &readInitialInput);
+
+/// Hand a new test case to the scheduler if we're exploring.
+///
+/// Returns false if the calling process isn't one of the children that explore
+/// an input, in which case the caller has to save the test case itself.
+bool offerExplorationInput(const std::string &testCase);
+
+/// Read an input file for exploration.
+std::string readExplorationInput(const std::string &file);
+
+#endif
@@ -0,0 +1,101 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "ForkServer.h"
+
+#include <cerrno>
+#include <cstdio>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <Runtime.h>
+
+#include "BackendLock.h"
+#include "Config.h"
+#include "ControlChannel.h"
+#include "LibcWrappers.h"
+#include "OutputRing.h"
+
+void runForkServer() {
+  if (!g_config.forkServer || !haveControlChannel())
+    return;
+
+  while (true) {
+    ControlRequest request;
+    if (!receiveControlRequest(request)) {
+      // The driver is done. The program hasn't started yet, so there is
+      // nothing to clean up (and no destructor or exit handler should run).
+      _exit(0);
+    }
+
+    auto ringPosition = outputRingPosition();
+    auto pid = forkExecution(request.outputDir);
+    if (pid == 0) {
+      // The child executes the program on the requested input. The channel
+      // belongs to the server, so a persistent loop in the program just runs
+      // once (see symcc_reset).
+      close(g_config.controlFd);
+      g_config.controlFd = -1;
+      g_config.forkServer = false;
+      resetLibcWrappers(request.inputFile);
+      return;
+    }
+
+    sendControlStatus(pid);
+    auto status = *waitForExecution(pid);
+
+    // The child may have been killed at any point, so we collect its test
+    // cases here rather than in the child. Its own copy of the known test
+    // cases is gone with it, so we learn the ones that it pushed to the ring.
+    rememberRingTestCases(ringPosition);
+    collectTestCases(request.outputDir);
+    sendControlStatus(status);
+  }
+}
+
+pid_t forkExecution(const std::string &outputDir) {
+  auto pid = fork();
+  if (pid < 0) {
+    perror("Failed to fork an execution");
+    _exit(-1);
+  }
+
+  if (pid == 0) {
+    BackendLock lock;
+    g_config.outputDir = outputDir;
+    // Give the backend a chance to pick up the new output directory and the
+    // current coverage map.
+    _sym_reset_backend();
+  }
+
+  return pid;
+}
+
+std::optional<int> waitForExecution(pid_t pid, bool block) {
+  int status;
+  while (true) {
+    auto result = waitpid(pid, &status, block ? 0 : WNOHANG);
+    if (result == pid)
+      return status;
+    if (result == 0)
+      return std::nullopt;
+    if (errno != EINTR) {
+      perror("Failed to wait for an execution");
+      _exit(-1);
+    }
+  }
+}
@@ -0,0 +1,54 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef FORKSERVER_H
+#define FORKSERVER_H
+
+#include <optional>
+#include <string>
+
+#include <sys/types.h>
+
+/// Turn the process into a fork server if the configuration asks for one.
+///
+/// The backends call this at the end of _sym_initialize, i.e., before the
+/// target program's main function runs. The fork server waits for requests on
+/// the control channel (see ControlChannel.h) and forks a child per input; only
+/// the children return from this function, ready to execute the program on the
+/// requested input. For each request, the server first sends the child's
+/// process ID to the driver, so that it can kill the child on timeout, and
+/// then the child's wait status. The server exits when the driver closes the
+/// channel.
+///
+/// Initializing the runtime (in particular, creating the solver) is expensive
+/// compared to executing many programs, and forking allows us to pay the cost
+/// only once.
+void runForkServer();
+
+/// Fork a child that executes the program and writes its test cases to the
+/// given directory.
+///
+/// Like fork, the function returns the child's process ID in the parent and 0
+/// in the child, where the backend has already picked up the output directory
+/// and the current coverage map. If forking fails, the process exits.
+pid_t forkExecution(const std::string &outputDir);
+
+/// Wait for a child that forkExecution created.
+///
+/// Returns the child's wait status, or nothing if the child is still running
+/// and we aren't supposed to block.
+std::optional<int> waitForExecution(pid_t pid, bool block = true);
+
+#endif
@@ -14,6 +14,7 @@
 
 #include "GarbageCollection.h"
 
+#include <algorithm>
 #include <vector>
 
 #include <Runtime.h>
@@ -26,6 +27,11 @@ void registerExpressionRegion(ExpressionRegion r) {
   expressionRegions.push_back(std::move(r));
 }
 
+void clearExpressionRegions() {
+  for (auto &r : expressionRegions)
+    std::fill(r.first, r.first + r.second, nullptr);
+}
+
 std::set<SymExpr> collectReachableExpressions() {
   std::set<SymExpr> reachableExpressions;
   auto collectReachableExpressions = [&](ExpressionRegion r) {
@@ -41,6 +47,7 @@ std::set<SymExpr> collectReachableExpressions() {
     collectReachableExpressions(r);
   }
 
+  std::lock_guard<std::mutex> lock(g_shadow_pages_mutex);
   for (const auto &mapping : g_shadow_pages) {
     collectReachableExpressions({mapping.second, kPageSize});
   }
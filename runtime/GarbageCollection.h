@@ -28,6 +28,9 @@ using ExpressionRegion = std::pair<SymExpr *, size_t>;
 /// expressions.
 void registerExpressionRegion(ExpressionRegion r);
 
+/// Set all expressions in the registered regions to null.
+void clearExpressionRegions();
+
 /// Return the set of currently reachable symbolic expressions.
 std::set<SymExpr> collectReachableExpressions();
 
@@ -0,0 +1,101 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+//
+// Inlinable versions of the hottest run-time functions.
+//
+// This file is compiled to bitcode rather than into the run-time library; the
+// compiler pass links it into each instrumented module (see
+// linkInlineRuntimeHelpers in compiler/Runtime.cpp) and inlines the helpers at
+// their call sites. Each helper _sym_inline_X must have the same signature as
+// the compiler's declaration of _sym_X, and it must behave exactly like it.
+// Anything beyond a fast path is left to the library.
+//
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void *SymExpr;
+#include "InlineHelpers.h"
+#include "RuntimeCommon.h"
+
+#define SYM_INLINE __attribute__((always_inline))
+
+/// Check whether memory is concrete, using only the shadow directory.
+///
+/// A false result means that we don't know; the caller must defer to the
+/// library.
+static inline SYM_INLINE bool isKnownConcrete(uintptr_t addr, size_t length) {
+  uintptr_t page = addr >> SYM_SHADOW_PAGE_BITS;
+  if (length == 0 || page != ((addr + length - 1) >> SYM_SHADOW_PAGE_BITS) ||
+      (page >> (SYM_SHADOW_ROOT_BITS + SYM_SHADOW_LEAF_BITS)) != 0)
+    return false;
+
+  SymExpr **leaf = __atomic_load_n(
+      &_sym_shadow_directory[page >> SYM_SHADOW_LEAF_BITS], __ATOMIC_ACQUIRE);
+  if (leaf == NULL)
+    return true;
+  SymExpr *pageShadow = __atomic_load_n(
+      &leaf[page & ((1 << SYM_SHADOW_LEAF_BITS) - 1)], __ATOMIC_ACQUIRE);
+  if (pageShadow == NULL)
+    return true;
+
+  SymExpr *shadow = pageShadow + (addr & (SYM_SHADOW_PAGE_SIZE - 1));
+  for (size_t i = 0; i < length; i++) {
+    if (shadow[i] != NULL)
+      return false;
+  }
+  return true;
+}
+
+SYM_INLINE SymExpr _sym_inline_get_parameter_expression(uint8_t index) {
+  return _sym_function_arguments[index];
+}
+
+SYM_INLINE void _sym_inline_set_parameter_expression(uint8_t index,
+                                                     SymExpr expr) {
+  _sym_notify_param_expr(index, expr);
+  _sym_function_arguments[index] = expr;
+}
+
+SYM_INLINE SymExpr _sym_inline_get_return_expression(void) {
+  SymExpr result = _sym_return_value;
+  _sym_return_value = NULL;
+  return result;
+}
+
+SYM_INLINE void _sym_inline_set_return_expression(SymExpr expr) {
+  if (expr != NULL)
+    _sym_notify_ret_expr(expr);
+  _sym_return_value = expr;
+}
+
+SYM_INLINE SymExpr _sym_inline_read_memory(SymExpr addr_expr, uintptr_t addr,
+                                           size_t length,
+                                           uint8_t little_endian) {
+  if (addr_expr == NULL && isKnownConcrete(addr, length))
+    return NULL;
+
+  return _sym_read_memory(addr_expr, (uint8_t *)addr, length, little_endian);
+}
+
+SYM_INLINE void _sym_inline_write_memory(SymExpr addr_expr, SymExpr expr,
+                                         uintptr_t addr, size_t length,
+                                         uint8_t little_endian) {
+  if (addr_expr == NULL && expr == NULL && isKnownConcrete(addr, length))
+    return;
+
+  _sym_write_memory(addr_expr, expr, (uint8_t *)addr, length, little_endian);
+}
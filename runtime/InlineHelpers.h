@@ -0,0 +1,68 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef INLINEHELPERS_H
+#define INLINEHELPERS_H
+
+//
+// State that the run-time library shares with the helpers in InlineHelpers.c.
+// The compiler pass links those helpers into each instrumented module and
+// inlines them, so everything here is part of the interface between compiled
+// programs and the library. This header must remain valid C; include it after
+// SymExpr has been defined (e.g., via Runtime.h).
+//
+
+#ifdef __cplusplus
+#include <cstdint>
+extern "C" {
+#else
+#include <stdint.h>
+#endif
+
+#define SYM_MAX_FUNCTION_ARGUMENTS 256
+#define SYM_SHADOW_PAGE_SIZE 4096
+#define SYM_SHADOW_PAGE_BITS 12
+
+// The shadow directory covers the lower 2^SYM_SHADOW_ADDRESS_BITS bytes of the
+// address space, which is where user space lives on common 64-bit platforms.
+#if UINTPTR_MAX > 0xffffffffu
+#define SYM_SHADOW_ADDRESS_BITS 48
+#else
+#define SYM_SHADOW_ADDRESS_BITS 32
+#endif
+#define SYM_SHADOW_LEAF_BITS                                                   \
+  ((SYM_SHADOW_ADDRESS_BITS - SYM_SHADOW_PAGE_BITS) / 2)
+#define SYM_SHADOW_ROOT_BITS                                                   \
+  (SYM_SHADOW_ADDRESS_BITS - SYM_SHADOW_PAGE_BITS - SYM_SHADOW_LEAF_BITS)
+
+/// Per-thread storage for function parameters and the return value.
+extern __thread SymExpr _sym_return_value;
+extern __thread SymExpr _sym_function_arguments[SYM_MAX_FUNCTION_ARGUMENTS];
+
+/// The directory of shadow pages.
+///
+/// This is a two-level table indexed by page number, much like a page table:
+/// the root holds pointers to leaf tables, and each leaf holds a pointer to the
+/// shadow of each of its pages. A null pointer means that the page (or all
+/// pages of the leaf) has no shadow, i.e., is concrete. Entries never change
+/// once set, so readers just need acquire loads, and writers publish new
+/// entries with compare-and-swap; no access takes a lock. Pages beyond the
+/// directory's range are only known to the library (see Shadow.h).
+extern SymExpr **_sym_shadow_directory[1 << SYM_SHADOW_ROOT_BITS];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -12,7 +12,9 @@
 // You should have received a copy of the GNU General Public License along with
 // SymCC. If not, see <https://www.gnu.org/licenses/>.
 
+#include <atomic>
 #include <cassert>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -28,6 +30,8 @@
 #include <unistd.h>
 
 #include "Config.h"
+#include "Exploration.h"
+#include "LibcWrappers.h"
 #include "Shadow.h"
 #include <Runtime.h>
 
@@ -38,8 +42,14 @@ namespace {
 /// The file descriptor referring to the symbolic input.
 int inputFileDescriptor = -1;
 
-/// The current position in the (symbolic) input.
-uint64_t inputOffset = 0;
+/// The current position in the (symbolic) input. Threads reading the input
+/// concurrently each claim their own range of offsets.
+std::atomic<uint64_t> inputOffset{0};
+
+/// The file that this process opens instead of the input file, either because
+/// the driver sent a new input (see symcc_reset) or during exploration (see
+/// Exploration.h).
+std::string redirectedInputFile;
 
 /// Tell the solver to try an alternative value than the given one.
 template <typename V, typename F>
@@ -75,6 +85,48 @@ void maybeSetInputFile(const char *path, int fd) {
   inputOffset = 0;
 }
 
+/// Start exploring before the program first reads symbolic input from stdin.
+void maybeStartExploration(int fd) {
+  if (fd != inputFileDescriptor ||
+      !std::holds_alternative<StdinInput>(g_config.input))
+    return;
+
+  auto input = startExploration([] {
+    std::string contents;
+    char buffer[4096];
+    ssize_t length;
+    while ((length = read(STDIN_FILENO, buffer, sizeof(buffer))) != 0) {
+      if (length < 0) {
+        if (errno == EINTR)
+          continue;
+        break;
+      }
+      contents.append(buffer, length);
+    }
+    return contents;
+  });
+  if (input)
+    resetLibcWrappers(*input);
+}
+
+/// Start exploring before the program opens the input file, and make sure
+/// that the program opens the current input instead.
+const char *maybeRedirectInputFile(const char *path) {
+  auto *fileInput = std::get_if<FileInput>(&g_config.input);
+  if (fileInput == nullptr ||
+      strstr(path, fileInput->fileName.c_str()) == nullptr)
+    return path;
+
+  auto input = startExploration([path] {
+    return readExplorationInput(
+        redirectedInputFile.empty() ? path : redirectedInputFile);
+  });
+  if (input)
+    redirectedInputFile = std::move(*input);
+
+  return redirectedInputFile.empty() ? path : redirectedInputFile.c_str();
+}
+
 } // namespace
 
 void initLibcWrappers() {
@@ -84,6 +136,31 @@ void initLibcWrappers() {
   }
 }
 
+void resetLibcWrappers(const std::string &inputFile) {
+  inputOffset = 0;
+
+  if (!std::holds_alternative<StdinInput>(g_config.input)) {
+    inputFileDescriptor = -1;
+    // The program opens the input file by its configured name again.
+    if (std::holds_alternative<FileInput>(g_config.input))
+      redirectedInputFile = inputFile;
+    return;
+  }
+
+  int fd = open(inputFile.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Warning: failed to open the new input " << inputFile << ": "
+              << strerror(errno) << std::endl;
+    return;
+  }
+
+  dup2(fd, STDIN_FILENO);
+  close(fd);
+  // Drop anything that stdio still buffers from the previous input.
+  fseek(stdin, 0, SEEK_SET);
+  clearerr(stdin);
+}
+
 extern "C" {
 
 void *SYM(malloc)(size_t size) {
@@ -124,7 +201,7 @@ void *SYM(mmap)(void *addr, size_t len, int prot, int flags, int fildes,
 }
 
 int SYM(open)(const char *path, int oflag, mode_t mode) {
-  auto result = open(path, oflag, mode);
+  auto result = open(maybeRedirectInputFile(path), oflag, mode);
   _sym_set_return_expression(nullptr);
 
   if (result >= 0)
@@ -137,6 +214,7 @@ ssize_t SYM(read)(int fildes, void *buf, size_t nbyte) {
   _sym_concretize_pointer(_sym_get_parameter_expression(1), buf, (uintptr_t)SYM(read));
   _sym_concretize_size(_sym_get_parameter_expression(2), nbyte, (uintptr_t)SYM(read));
 
+  maybeStartExploration(fildes);
   auto result = read(fildes, buf, nbyte);
   _sym_set_return_expression(nullptr);
 
@@ -145,8 +223,7 @@ ssize_t SYM(read)(int fildes, void *buf, size_t nbyte) {
 
   if (fildes == inputFileDescriptor) {
     // Reading symbolic input.
-    _sym_make_symbolic(buf, result, inputOffset);
-    inputOffset += result;
+    _sym_make_symbolic(buf, result, inputOffset.fetch_add(result));
   } else if (!isConcrete(buf, result)) {
     ReadWriteShadow shadow(buf, result);
     std::fill(shadow.begin(), shadow.end(), nullptr);
@@ -198,7 +275,7 @@ uint32_t SYM(lseek)(int fd, uint32_t offset, int whence) {
 }
 
 FILE *SYM(fopen)(const char *pathname, const char *mode) {
-  auto *result = fopen(pathname, mode);
+  auto *result = fopen(maybeRedirectInputFile(pathname), mode);
   _sym_set_return_expression(nullptr);
 
   if (result != nullptr)
@@ -208,7 +285,7 @@ FILE *SYM(fopen)(const char *pathname, const char *mode) {
 }
 
 FILE *SYM(fopen64)(const char *pathname, const char *mode) {
-  auto *result = fopen64(pathname, mode);
+  auto *result = fopen64(maybeRedirectInputFile(pathname), mode);
   _sym_set_return_expression(nullptr);
 
   if (result != nullptr)
@@ -222,13 +299,14 @@ size_t SYM(fread)(void *ptr, size_t size, size_t nmemb, FILE *stream) {
   _sym_concretize_size(_sym_get_parameter_expression(1), size, (uintptr_t)SYM(fread));
   _sym_concretize_size(_sym_get_parameter_expression(2), nmemb, (uintptr_t)SYM(fread));
 
+  maybeStartExploration(fileno(stream));
   auto result = fread(ptr, size, nmemb, stream);
   _sym_set_return_expression(nullptr);
 
   if (fileno(stream) == inputFileDescriptor) {
     // Reading symbolic input.
-    _sym_make_symbolic(ptr, result * size, inputOffset);
-    inputOffset += result * size;
+    _sym_make_symbolic(ptr, result * size,
+                       inputOffset.fetch_add(result * size));
   } else if (!isConcrete(ptr, result * size)) {
     ReadWriteShadow shadow(ptr, result * size);
     std::fill(shadow.begin(), shadow.end(), nullptr);
@@ -241,14 +319,14 @@ char *SYM(fgets)(char *str, int n, FILE *stream) {
   _sym_concretize_pointer(_sym_get_parameter_expression(0), str, (uintptr_t)SYM(fgets));
   _sym_concretize_size(_sym_get_parameter_expression(1), n, (uintptr_t)SYM(fgets));
 
+  maybeStartExploration(fileno(stream));
   auto result = fgets(str, n, stream);
   _sym_set_return_expression(_sym_get_parameter_expression(0));
 
   if (fileno(stream) == inputFileDescriptor) {
     // Reading symbolic input.
     const auto length = sizeof(char) * strlen(str);
-    _sym_make_symbolic(str, length, inputOffset);
-    inputOffset += length;
+    _sym_make_symbolic(str, length, inputOffset.fetch_add(length));
   } else if (!isConcrete(str, sizeof(char) * strlen(str))) {
     ReadWriteShadow shadow(str, sizeof(char) * strlen(str));
     std::fill(shadow.begin(), shadow.end(), nullptr);
@@ -321,6 +399,7 @@ int SYM(fseeko64)(FILE *stream, uint64_t offset, int whence) {
 }
 
 int SYM(getc)(FILE *stream) {
+  maybeStartExploration(fileno(stream));
   auto result = getc(stream);
   if (result == EOF) {
     _sym_set_return_expression(nullptr);
@@ -337,6 +416,7 @@ int SYM(getc)(FILE *stream) {
 }
 
 int SYM(fgetc)(FILE *stream) {
+  maybeStartExploration(fileno(stream));
   auto result = fgetc(stream);
   if (result == EOF) {
     _sym_set_return_expression(nullptr);
@@ -15,10 +15,20 @@
 #ifndef LIBCWRAPPERS_H
 #define LIBCWRAPPERS_H
 
+#include <string>
+
 /// Initialize the libc wrappers.
 ///
 /// The configuration needs to be loaded so that we can apply settings related
 /// to symbolic input.
 void initLibcWrappers();
 
+/// Start over with symbolic input from the given file.
+///
+/// The input offset goes back to zero. If symbolic data comes from standard
+/// input, we redirect standard input to the file; if it comes from a file, the
+/// program opens the given file when it opens the configured input file.
+/// Symbolic data from memory is up to the program (see symcc_make_symbolic).
+void resetLibcWrappers(const std::string &inputFile);
+
 #endif
@@ -0,0 +1,210 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "OutputRing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <unordered_set>
+#include <utility>
+
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Config.h"
+#include "Exploration.h"
+
+namespace {
+
+/// The mapped ring, or null if we don't have one.
+OutputRingHeader *ringHeader = nullptr;
+
+/// The data area of the mapped ring.
+uint8_t *ringData = nullptr;
+
+/// Have we tried to map the ring yet?
+bool ringMapped = false;
+
+/// The number of test cases that saveTestCase has written to files.
+unsigned numTestCaseFiles = 0;
+
+/// Hashes of the test cases that we've passed on so far.
+std::unordered_set<size_t> knownTestCases;
+
+/// The files that saveTestCase has written; collectTestCases leaves them for
+/// the driver.
+std::unordered_set<std::string> savedFiles;
+
+bool isNewTestCase(const std::string &data) {
+  return knownTestCases.insert(std::hash<std::string>{}(data)).second;
+}
+
+/// Map the ring that the driver passed us, unless we've done so before.
+///
+/// Children inherit the mapping when we fork.
+bool mapOutputRing() {
+  if (std::exchange(ringMapped, true))
+    return ringHeader != nullptr;
+
+  if (g_config.outputRingFd < 0)
+    return false;
+
+  struct stat info;
+  if (fstat(g_config.outputRingFd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) <= kOutputRingDataOffset) {
+    std::cerr << "Warning: the output ring is unusable; writing test cases to "
+                 "files instead"
+              << std::endl;
+    return false;
+  }
+
+  auto *memory = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, g_config.outputRingFd, 0);
+  if (memory == MAP_FAILED) {
+    perror("Failed to map the output ring");
+    return false;
+  }
+
+  auto *header = static_cast<OutputRingHeader *>(memory);
+  if (header->capacity == 0 ||
+      header->capacity > info.st_size - kOutputRingDataOffset) {
+    std::cerr << "Warning: the output ring has an invalid capacity; writing "
+                 "test cases to files instead"
+              << std::endl;
+    munmap(memory, info.st_size);
+    return false;
+  }
+
+  ringHeader = header;
+  ringData = static_cast<uint8_t *>(memory) + kOutputRingDataOffset;
+  return true;
+}
+
+/// Copy data into the ring at the given position, wrapping around if needed.
+void copyToRing(uint64_t position, const void *data, size_t length) {
+  auto offset = position % ringHeader->capacity;
+  auto first = std::min<uint64_t>(length, ringHeader->capacity - offset);
+  memcpy(ringData + offset, data, first);
+  memcpy(ringData, static_cast<const uint8_t *>(data) + first, length - first);
+}
+
+/// Copy data out of the ring at the given position, wrapping around if needed.
+void copyFromRing(uint64_t position, void *data, size_t length) {
+  auto offset = position % ringHeader->capacity;
+  auto first = std::min<uint64_t>(length, ringHeader->capacity - offset);
+  memcpy(data, ringData + offset, first);
+  memcpy(static_cast<uint8_t *>(data) + first, ringData, length - first);
+}
+
+/// Append a record to the ring; return false if there is no space for it.
+bool pushToRing(const std::string &data) {
+  if (!mapOutputRing() || data.size() > std::numeric_limits<uint32_t>::max())
+    return false;
+
+  uint32_t length = data.size();
+  auto head = ringHeader->head.load(std::memory_order_relaxed);
+  auto tail = ringHeader->tail.load(std::memory_order_acquire);
+  if (ringHeader->capacity - (head - tail) < sizeof(length) + length)
+    return false;
+
+  copyToRing(head, &length, sizeof(length));
+  copyToRing(head + sizeof(length), data.data(), length);
+  ringHeader->head.store(head + sizeof(length) + length,
+                         std::memory_order_release);
+  return true;
+}
+
+std::string readFile(const std::string &file) {
+  std::ifstream stream(file, std::ios::binary);
+  return {std::istreambuf_iterator<char>(stream),
+          std::istreambuf_iterator<char>()};
+}
+
+} // namespace
+
+void saveTestCase(const std::string &data) {
+  if (!isNewTestCase(data) || offerExplorationInput(data) || pushToRing(data))
+    return;
+
+  std::stringstream name;
+  name << g_config.outputDir << "/" << std::setw(6) << std::setfill('0')
+       << numTestCaseFiles++;
+  std::ofstream stream(name.str(), std::ios::binary);
+  stream.write(data.data(), data.size());
+  if (!stream)
+    std::cerr << "Warning: failed to write " << name.str() << std::endl;
+  savedFiles.insert(name.str());
+}
+
+void collectTestCases(const std::string &directory) {
+  auto *dir = opendir(directory.c_str());
+  if (dir == nullptr)
+    return;
+
+  while (auto *entry = readdir(dir)) {
+    if (entry->d_name[0] == '.')
+      continue;
+
+    auto file = directory + "/" + entry->d_name;
+    if (savedFiles.count(file) != 0)
+      continue;
+
+    auto data = readFile(file);
+    // If there is no space in the ring, the driver will find the test case
+    // in the directory.
+    if (!isNewTestCase(data) || pushToRing(data))
+      unlink(file.c_str());
+  }
+
+  closedir(dir);
+}
+
+uint64_t outputRingPosition() {
+  return mapOutputRing() ? ringHeader->head.load(std::memory_order_acquire)
+                         : 0;
+}
+
+void rememberRingTestCases(uint64_t since) {
+  if (!mapOutputRing())
+    return;
+
+  // Only the child has written since, and the driver doesn't modify the
+  // records when it consumes them, so they're all still intact.
+  auto head = ringHeader->head.load(std::memory_order_acquire);
+  if (head - since > ringHeader->capacity)
+    return;
+
+  std::string data;
+  for (auto position = since; head - position >= sizeof(uint32_t);) {
+    uint32_t length;
+    copyFromRing(position, &length, sizeof(length));
+    position += sizeof(length);
+    if (head - position < length)
+      break;
+
+    data.resize(length);
+    copyFromRing(position, data.data(), length);
+    position += length;
+    isNewTestCase(data);
+  }
+}
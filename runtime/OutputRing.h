@@ -0,0 +1,85 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef OUTPUTRING_H
+#define OUTPUTRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//
+// A ring buffer in shared memory that carries generated test cases to a driver
+// process (e.g., the fuzzing helper), so that the driver doesn't have to
+// collect them from individual files. The driver passes a file descriptor for
+// the memory (typically a memfd) in SYMCC_OUTPUT_RING_FD.
+//
+// The memory starts with an OutputRingHeader, followed by the data area at
+// offset kOutputRingDataOffset. Each record consists of the length of a test
+// case as a 32-bit integer in native byte order, followed by the test case;
+// records wrap around at the end of the data area. The runtime is the only
+// writer and advances the head after writing a record; the driver advances the
+// tail after consuming records. Test cases that don't fit stay in (or go to)
+// the output directory, so the driver needs to check both.
+//
+
+/// The header of the shared memory.
+struct OutputRingHeader {
+  /// The size of the data area in bytes (set by the driver).
+  uint64_t capacity;
+
+  /// The total number of bytes written so far.
+  std::atomic<uint64_t> head;
+
+  /// The total number of bytes consumed so far.
+  std::atomic<uint64_t> tail;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "The output ring must be shareable across processes");
+
+/// The offset of the data area in the shared memory.
+constexpr size_t kOutputRingDataOffset = 64;
+
+/// Save a generated test case, preferably in the output ring.
+///
+/// Without a ring, or if the ring is full, we write the test case to a file in
+/// the output directory. We drop test cases that this process has saved or
+/// collected before, including those that a fork server learned from its
+/// previous children. During exploration, the test case goes to the scheduler
+/// instead (see Exploration.h).
+void saveTestCase(const std::string &data);
+
+/// Collect the test cases that the backend wrote to files in the given
+/// directory.
+///
+/// Only backends that write test cases themselves (i.e., the Rust backend)
+/// leave files for us to collect, along with saveTestCase when the ring was
+/// full.
+///
+/// We delete duplicates of test cases that this process has seen before (for
+/// a fork server, that includes the test cases of all previous inputs), and
+/// we move the others to the output ring. Files that don't fit in the ring
+/// remain in the directory, and so do the files that saveTestCase wrote.
+void collectTestCases(const std::string &directory);
+
+/// Return the current head of the output ring (or 0 if there is none).
+uint64_t outputRingPosition();
+
+/// Remember the test cases that a child has pushed to the output ring since
+/// the given position, so that we drop them if a later child finds them again.
+void rememberRingTestCases(uint64_t since);
+
+#endif
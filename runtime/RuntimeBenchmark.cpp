@@ -0,0 +1,501 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+//
+// Microbenchmarks of the runtime's hot paths
+//
+// The benchmarks call the runtime directly, the way instrumented code does,
+// and measure the time per call. Each benchmark runs for increasing numbers
+// of iterations until it takes at least the minimum time; benchmarks with an
+// expensive setup (like garbage collection over millions of expressions) run
+// exactly once. Since the program links against the runtime library of the
+// configured backend, building it once per backend compares the backends.
+//
+// Run the program with "-h" for its options.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <Runtime.h>
+
+#include "Config.h"
+#include "GarbageCollection.h"
+#include "RuntimeCommon.h"
+#include "Shadow.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// The timer and iteration count of a running benchmark.
+class State {
+public:
+  explicit State(uint64_t iterations) : iterations(iterations) {}
+
+  /// Advance the benchmark's loop; the time between the first and the last
+  /// call is what we measure.
+  bool keepRunning() {
+    if (done == 0 && !running)
+      resumeTiming();
+    if (done < iterations) {
+      done++;
+      return true;
+    }
+    pauseTiming();
+    return false;
+  }
+
+  /// Exclude the following code from the measurement.
+  void pauseTiming() {
+    if (running)
+      elapsed += Clock::now() - start;
+    running = false;
+  }
+
+  void resumeTiming() {
+    start = Clock::now();
+    running = true;
+  }
+
+  /// Report throughput in bytes per second.
+  void setBytesPerIteration(uint64_t bytes) { bytesPerIteration = bytes; }
+
+  double seconds() const {
+    return std::chrono::duration<double>(elapsed).count();
+  }
+
+  const uint64_t iterations;
+  uint64_t bytesPerIteration = 0;
+
+private:
+  uint64_t done = 0;
+  bool running = false;
+  Clock::time_point start;
+  Clock::duration elapsed{0};
+};
+
+struct Benchmark {
+  std::string name;
+  std::function<void(State &)> run;
+
+  /// Run exactly once instead of scaling the number of iterations.
+  bool once = false;
+};
+
+struct Options {
+  double minSeconds = 0.5;
+  std::regex filter{".*"};
+  bool list = false;
+};
+
+/// The number of symbolic input bytes that the benchmarks use.
+constexpr size_t kInputBytes = 64;
+
+/// Clean up after a benchmark, like symcc_reset does between executions.
+void resetRuntime() {
+  _sym_reset_backend();
+  resetShadowMemory();
+  clearExpressionRegions();
+}
+
+/// A page-aligned buffer, so that the benchmarks cover a predictable number of
+/// shadow pages.
+class Buffer {
+public:
+  explicit Buffer(size_t size) : size(size) {
+    if (posix_memalign(reinterpret_cast<void **>(&data), kPageSize, size) != 0)
+      throw std::bad_alloc();
+    std::fill(data, data + size, 0);
+  }
+
+  ~Buffer() { free(data); }
+
+  Buffer(const Buffer &) = delete;
+  Buffer &operator=(const Buffer &) = delete;
+
+  uint8_t *data;
+  const size_t size;
+};
+
+/// How much of a buffer is symbolic.
+enum class Density {
+  /// No shadow at all (the fast path).
+  Concrete,
+
+  /// Shadow pages exist but contain only null expressions.
+  Shadowed,
+
+  /// One in 16 bytes is symbolic.
+  Sparse,
+
+  /// Every byte is symbolic.
+  Symbolic
+};
+
+const char *densityName(Density density) {
+  switch (density) {
+  case Density::Concrete:
+    return "concrete";
+  case Density::Shadowed:
+    return "shadowed";
+  case Density::Sparse:
+    return "sparse";
+  case Density::Symbolic:
+    return "symbolic";
+  default:
+    return "unknown";
+  }
+}
+
+const Density kDensities[] = {Density::Concrete, Density::Shadowed,
+                              Density::Sparse, Density::Symbolic};
+
+void makeSymbolic(const Buffer &buffer, Density density) {
+  if (density == Density::Concrete)
+    return;
+
+  ReadWriteShadow shadow(buffer.data, buffer.size);
+  size_t i = 0;
+  for (auto &byteExpr : shadow) {
+    bool symbolic = (density == Density::Symbolic) ||
+                    (density == Density::Sparse && i % 16 == 0);
+    byteExpr = symbolic ? _sym_get_input_byte(i % kInputBytes, buffer.data[i])
+                        : nullptr;
+    i++;
+  }
+}
+
+/// An expression of the given width in bytes that depends on the input.
+SymExpr symbolicValue(size_t width) {
+  auto *byteExpr = _sym_get_input_byte(0, 0);
+  return width == 1 ? byteExpr : _sym_build_zext(byteExpr, 8 * (width - 1));
+}
+
+constexpr size_t kMemoryBufferSize = 1 << 20;
+const size_t kWidths[] = {1, 2, 4, 8, 16};
+
+void addMemoryBenchmarks(std::vector<Benchmark> &benchmarks) {
+  for (auto density : kDensities) {
+    for (auto width : kWidths) {
+      auto suffix =
+          "/" + std::to_string(width) + "/" + std::string(densityName(density));
+
+      benchmarks.push_back({"read_memory" + suffix, [=](State &state) {
+                              Buffer buffer(kMemoryBufferSize);
+                              makeSymbolic(buffer, density);
+                              size_t offset = 0;
+                              while (state.keepRunning()) {
+                                _sym_read_memory(nullptr, buffer.data + offset,
+                                                 width, true);
+                                offset = (offset + width) % buffer.size;
+                              }
+                            }});
+
+      benchmarks.push_back(
+          {"write_memory_concrete" + suffix, [=](State &state) {
+             Buffer buffer(kMemoryBufferSize);
+             size_t offset = 0;
+             while (state.keepRunning()) {
+               // Concrete writes make the shadow concrete, so we need to
+               // restore it from time to time.
+               if (offset == 0) {
+                 state.pauseTiming();
+                 makeSymbolic(buffer, density);
+                 state.resumeTiming();
+               }
+               _sym_write_memory(nullptr, nullptr, buffer.data + offset, width,
+                                 true);
+               offset = (offset + width) % buffer.size;
+             }
+           }});
+
+      benchmarks.push_back(
+          {"write_memory_symbolic" + suffix, [=](State &state) {
+             Buffer buffer(kMemoryBufferSize);
+             makeSymbolic(buffer, density);
+             auto *value = symbolicValue(width);
+             size_t offset = 0;
+             while (state.keepRunning()) {
+               _sym_write_memory(nullptr, value, buffer.data + offset, width,
+                                 true);
+               offset = (offset + width) % buffer.size;
+             }
+           }});
+    }
+  }
+
+  for (size_t size : {size_t(1) << 16, size_t(1) << 20, size_t(1) << 24}) {
+    for (auto density : {Density::Concrete, Density::Sparse}) {
+      benchmarks.push_back(
+          {"memcpy/" + std::to_string(size) + "/" + densityName(density),
+           [=](State &state) {
+             Buffer source(size), destination(size);
+             makeSymbolic(source, density);
+             state.setBytesPerIteration(size);
+             while (state.keepRunning())
+               _sym_memcpy(nullptr, nullptr, nullptr, destination.data,
+                           source.data, size);
+           }});
+    }
+  }
+
+  for (size_t size : {size_t(8), size_t(1) << 12, size_t(1) << 16,
+                      size_t(1) << 20}) {
+    for (auto density : {Density::Concrete, Density::Shadowed}) {
+      benchmarks.push_back(
+          {"is_concrete/" + std::to_string(size) + "/" + densityName(density),
+           [=](State &state) {
+             Buffer buffer(std::max(size, size_t(kPageSize)));
+             makeSymbolic(buffer, density);
+             state.setBytesPerIteration(size);
+             bool result = true;
+             while (state.keepRunning())
+               result &= isConcrete(buffer.data, size);
+             if (!result)
+               std::cerr << "Warning: unexpected symbolic data" << std::endl;
+           }});
+    }
+  }
+}
+
+constexpr size_t kMaxGarbageCollectionCount = 20'000'000;
+
+void addGarbageCollectionBenchmarks(std::vector<Benchmark> &benchmarks) {
+  for (size_t count : {size_t(1'000'000), size_t(5'000'000),
+                       kMaxGarbageCollectionCount}) {
+    benchmarks.push_back(
+        {"collect_garbage/" + std::to_string(count),
+         [=](State &state) {
+           // One in ten expressions remains reachable through a registered
+           // region. We can't unregister regions, so all runs share one.
+           static std::vector<SymExpr> reachable;
+           if (reachable.empty()) {
+             reachable.resize(kMaxGarbageCollectionCount / 10);
+             registerExpressionRegion({reachable.data(), reachable.size()});
+           }
+
+           state.pauseTiming();
+           auto *x = symbolicValue(8);
+           for (size_t i = 0; i < count; i++) {
+             auto *expr = _sym_build_add(x, _sym_build_integer(i, 64));
+             if (i % 10 == 0)
+               reachable[i / 10] = expr;
+           }
+
+           auto oldThreshold = g_config.garbageCollectionThreshold;
+           g_config.garbageCollectionThreshold = 0;
+           while (state.keepRunning())
+             _sym_collect_garbage();
+           g_config.garbageCollectionThreshold = oldThreshold;
+         },
+         true});
+  }
+}
+
+void addExpressionBenchmarks(std::vector<Benchmark> &benchmarks) {
+  benchmarks.push_back({"build_integer", [](State &state) {
+                          uint64_t i = 0;
+                          while (state.keepRunning())
+                            _sym_build_integer(i++, 64);
+                        }});
+
+  benchmarks.push_back({"build_add", [](State &state) {
+                          auto *x = symbolicValue(8);
+                          uint64_t i = 0;
+                          while (state.keepRunning())
+                            _sym_build_add(x, _sym_build_integer(i++, 64));
+                        }});
+
+  benchmarks.push_back({"build_add_cached", [](State &state) {
+                          auto *x = symbolicValue(8);
+                          auto *y = _sym_build_integer(42, 64);
+                          while (state.keepRunning())
+                            _sym_build_add(x, y);
+                        }});
+
+  benchmarks.push_back(
+      {"build_compare", [](State &state) {
+         auto *x = symbolicValue(4);
+         uint64_t i = 0;
+         while (state.keepRunning())
+           _sym_build_unsigned_less_than(x, _sym_build_integer(i++, 32));
+       }});
+
+  benchmarks.push_back({"build_read_4_bytes", [](State &state) {
+                          // What _sym_read_memory does for an int.
+                          SymExpr bytes[4];
+                          for (size_t i = 0; i < 4; i++)
+                            bytes[i] = _sym_get_input_byte(i, 0);
+                          while (state.keepRunning()) {
+                            auto *result = bytes[0];
+                            for (size_t i = 1; i < 4; i++)
+                              result = _sym_concat_helper(bytes[i], result);
+                          }
+                        }});
+
+  benchmarks.push_back(
+      {"build_extract", [](State &state) {
+         auto *x = symbolicValue(8);
+         size_t i = 0;
+         while (state.keepRunning()) {
+           _sym_extract_helper(x, 8 * (i + 1) - 1, 8 * i);
+           i = (i + 1) % 8;
+         }
+       }});
+}
+
+void addPathConstraintBenchmarks(std::vector<Benchmark> &benchmarks) {
+  benchmarks.push_back({"push_path_constraint/true", [](State &state) {
+                          auto *constraint = _sym_build_true();
+                          uintptr_t site = 0;
+                          while (state.keepRunning())
+                            _sym_push_path_constraint(constraint, 1, site++);
+                        }});
+
+  benchmarks.push_back(
+      {"push_path_constraint/tautology", [](State &state) {
+         // Trivially true only after simplification.
+         auto *x = symbolicValue(4);
+         auto *constraint = _sym_build_equal(x, x);
+         uintptr_t site = 0;
+         while (state.keepRunning())
+           _sym_push_path_constraint(constraint, 1, site++);
+       }});
+}
+
+std::vector<Benchmark> allBenchmarks() {
+  std::vector<Benchmark> benchmarks;
+  addMemoryBenchmarks(benchmarks);
+  addExpressionBenchmarks(benchmarks);
+  addPathConstraintBenchmarks(benchmarks);
+  addGarbageCollectionBenchmarks(benchmarks);
+  return benchmarks;
+}
+
+/// Run a benchmark until it takes long enough to be measured reliably; return
+/// the state of the last run.
+State runBenchmark(const Benchmark &benchmark, const Options &options) {
+  uint64_t iterations = 1;
+  while (true) {
+    State state(iterations);
+    benchmark.run(state);
+    resetRuntime();
+
+    if (benchmark.once || state.seconds() >= options.minSeconds ||
+        iterations >= (uint64_t(1) << 40))
+      return state;
+
+    // Aim a bit beyond the minimum time, but don't grow too fast if the
+    // previous run was too short to predict anything.
+    double scale = state.seconds() > 0
+                       ? 1.4 * options.minSeconds / state.seconds()
+                       : 100.0;
+    iterations = std::max(iterations + 1,
+                          uint64_t(iterations * std::min(scale, 100.0)));
+  }
+}
+
+std::string formatTime(double seconds) {
+  char buffer[32];
+  if (seconds >= 1)
+    snprintf(buffer, sizeof(buffer), "%.2f s", seconds);
+  else if (seconds >= 1e-3)
+    snprintf(buffer, sizeof(buffer), "%.2f ms", seconds * 1e3);
+  else if (seconds >= 1e-6)
+    snprintf(buffer, sizeof(buffer), "%.2f us", seconds * 1e6);
+  else
+    snprintf(buffer, sizeof(buffer), "%.2f ns", seconds * 1e9);
+  return buffer;
+}
+
+void usage(const char *program) {
+  std::cerr << "Usage: " << program << " [-l] [-f REGEX] [-t SECONDS]"
+            << std::endl
+            << std::endl
+            << "  -l          List the benchmarks instead of running them"
+            << std::endl
+            << "  -f REGEX    Run only the benchmarks whose names match"
+            << std::endl
+            << "  -t SECONDS  Minimum time per benchmark (default 0.5)"
+            << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "lf:t:h")) != -1) {
+    switch (opt) {
+    case 'l':
+      options.list = true;
+      break;
+    case 'f':
+      options.filter = std::regex(optarg);
+      break;
+    case 't':
+      options.minSeconds = atof(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  std::vector<Benchmark> selected;
+  for (auto &benchmark : allBenchmarks()) {
+    if (std::regex_search(benchmark.name, options.filter))
+      selected.push_back(std::move(benchmark));
+  }
+
+  if (options.list) {
+    for (auto &benchmark : selected)
+      std::cout << benchmark.name << std::endl;
+    return 0;
+  }
+
+  _sym_initialize();
+
+  printf("%-40s %12s %14s %14s\n", "Benchmark", "Time", "Iterations",
+         "Throughput");
+  for (auto &benchmark : selected) {
+    auto state = runBenchmark(benchmark, options);
+    auto perIteration = state.seconds() / state.iterations;
+    std::string throughput;
+    if (state.bytesPerIteration > 0 && perIteration > 0) {
+      char buffer[32];
+      snprintf(buffer, sizeof(buffer), "%.1f MiB/s",
+               state.bytesPerIteration / perIteration / (1 << 20));
+      throughput = buffer;
+    }
+    printf("%-40s %12s %14llu %14s\n", benchmark.name.c_str(),
+           formatTime(perIteration).c_str(),
+           static_cast<unsigned long long>(state.iterations),
+           throughput.c_str());
+    fflush(stdout);
+  }
+
+  return 0;
+}
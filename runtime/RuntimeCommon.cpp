@@ -16,28 +16,36 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
+#include <cstring>
+#include <iterator>
 #include <numeric>
+#include <optional>
 #include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 #include <variant>
 
+#include "BackendLock.h"
 #include "Config.h"
+#include "ControlChannel.h"
+#include "Exploration.h"
 #include "GarbageCollection.h"
+#include "InlineHelpers.h"
+#include "LibcWrappers.h"
+#include "OutputRing.h"
 #include "RuntimeCommon.h"
 #include "Shadow.h"
 
-namespace {
-
-constexpr int kMaxFunctionArguments = 256;
-
-/// Global storage for function parameters and the return value.
-SymExpr g_return_value;
-std::array<SymExpr, kMaxFunctionArguments> g_function_arguments;
-// TODO make thread-local
+// Each thread passes expressions between caller and callee through its own
+// slots, so concurrent calls can't clobber each other's arguments.
+__thread SymExpr _sym_return_value;
+__thread SymExpr _sym_function_arguments[SYM_MAX_FUNCTION_ARGUMENTS];
 
-} // namespace
+std::recursive_mutex g_backend_mutex;
 
 void _sym_set_return_expression(SymExpr expr) {
   // print out the expression
@@ -45,23 +53,23 @@ void _sym_set_return_expression(SymExpr expr) {
     // printf("return expression: %p\n", expr);
     _sym_notify_ret_expr(expr);
   }
-  g_return_value = expr;
+  _sym_return_value = expr;
 }
 
 SymExpr _sym_get_return_expression(void) {
-  auto *result = g_return_value;
+  auto *result = _sym_return_value;
   // TODO this is a safeguard that can eventually be removed
-  g_return_value = nullptr;
+  _sym_return_value = nullptr;
   return result;
 }
 
 void _sym_set_parameter_expression(uint8_t index, SymExpr expr) {
   _sym_notify_param_expr(index, expr);
-  g_function_arguments[index] = expr;
+  _sym_function_arguments[index] = expr;
 }
 
 SymExpr _sym_get_parameter_expression(uint8_t index) {
-  return g_function_arguments[index];
+  return _sym_function_arguments[index];
 }
 
 void _sym_memcpy(
@@ -221,13 +229,217 @@ SymExpr _sym_build_bswap(SymExpr expr) {
   return _sym_build_extract(expr, 0, bits / 8, true);
 }
 
+//
+// Bit counting, funnel shifts, minimum/maximum and overflow checks
+//
+// None of the backends has native support for these operations, so we expand
+// them into simpler expressions. We avoid if-then-else expressions (which
+// aren't part of the builder interface) by selecting with bit masks.
+//
+
+namespace {
+
+/// Build a constant of the given width (up to 64 significant bits).
+SymExpr buildConstant(uint64_t value, size_t bits) {
+  if (bits <= 64)
+    return _sym_build_integer(value, bits);
+  return _sym_build_zext(_sym_build_integer(value, 64), bits - 64);
+}
+
+/// Build a constant consisting of the given byte in every position.
+SymExpr buildRepeatedByte(uint8_t byte, size_t bits) {
+  uint64_t value = 0x0101010101010101ULL * byte;
+  if (bits < 64)
+    value &= (1ULL << bits) - 1;
+  return buildConstant(value, bits);
+}
+
+/// Select a if the Boolean condition holds and b otherwise.
+SymExpr selectByMask(SymExpr condition, SymExpr a, SymExpr b) {
+  auto bits = _sym_bits_helper(a);
+  auto mask = _sym_build_sext(_sym_build_bool_to_bit(condition), bits - 1);
+  return _sym_build_xor(b, _sym_build_and(_sym_build_xor(a, b), mask));
+}
+
+/// Check the sign bit of a bit vector.
+SymExpr isNegative(SymExpr expr) {
+  return _sym_build_signed_less_than(expr,
+                                     buildConstant(0, _sym_bits_helper(expr)));
+}
+
+/// The value that signed saturating arithmetic produces on overflow, given
+/// the first operand: the minimum for negative numbers, the maximum otherwise.
+SymExpr signedSaturationValue(SymExpr a) {
+  auto bits = _sym_bits_helper(a);
+  auto signedMax = _sym_build_logical_shift_right(
+      _sym_build_not(buildConstant(0, bits)), buildConstant(1, bits));
+  return _sym_build_xor(
+      _sym_build_arithmetic_shift_right(a, buildConstant(bits - 1, bits)),
+      signedMax);
+}
+
+} // namespace
+
+SymExpr _sym_build_ctpop(SymExpr expr) {
+  size_t bits = _sym_bits_helper(expr);
+
+  if (bits == 8 || bits == 16 || bits == 32 || bits == 64) {
+    // The classic parallel bit count: sum up pairs of bits, then nibbles,
+    // then bytes, and finally add all bytes with a multiplication.
+    auto pairs = _sym_build_sub(
+        expr, _sym_build_and(_sym_build_logical_shift_right(
+                                 expr, buildConstant(1, bits)),
+                             buildRepeatedByte(0x55, bits)));
+    auto nibbles = _sym_build_add(
+        _sym_build_and(pairs, buildRepeatedByte(0x33, bits)),
+        _sym_build_and(
+            _sym_build_logical_shift_right(pairs, buildConstant(2, bits)),
+            buildRepeatedByte(0x33, bits)));
+    auto bytes = _sym_build_and(
+        _sym_build_add(nibbles, _sym_build_logical_shift_right(
+                                    nibbles, buildConstant(4, bits))),
+        buildRepeatedByte(0x0f, bits));
+    return _sym_build_logical_shift_right(
+        _sym_build_mul(bytes, buildRepeatedByte(0x01, bits)),
+        buildConstant(bits - 8, bits));
+  }
+
+  // Other widths are rare; just add up the individual bits.
+  auto result = _sym_build_zext(_sym_extract_helper(expr, 0, 0), bits - 1);
+  for (size_t i = 1; i < bits; i++) {
+    result = _sym_build_add(
+        result, _sym_build_zext(_sym_extract_helper(expr, i, i), bits - 1));
+  }
+  return result;
+}
+
+SymExpr _sym_build_ctlz(SymExpr expr) {
+  // Set all bits below the most significant one, then count the ones.
+  size_t bits = _sym_bits_helper(expr);
+  auto smeared = expr;
+  for (size_t shift = 1; shift < bits; shift *= 2) {
+    smeared = _sym_build_or(smeared, _sym_build_logical_shift_right(
+                                         smeared, buildConstant(shift, bits)));
+  }
+  return _sym_build_sub(buildConstant(bits, bits), _sym_build_ctpop(smeared));
+}
+
+SymExpr _sym_build_cttz(SymExpr expr) {
+  // The trailing zeros are exactly the bits that are set in ~x & (x - 1).
+  size_t bits = _sym_bits_helper(expr);
+  return _sym_build_ctpop(
+      _sym_build_and(_sym_build_not(expr),
+                     _sym_build_sub(expr, buildConstant(1, bits))));
+}
+
+SymExpr _sym_build_funnel_shift_left(SymExpr a, SymExpr b, SymExpr shift) {
+  // Shifting by the full width yields zero, so a shift of zero just returns a.
+  size_t bits = _sym_bits_helper(a);
+  auto amount = _sym_build_unsigned_rem(shift, buildConstant(bits, bits));
+  return _sym_build_or(
+      _sym_build_shift_left(a, amount),
+      _sym_build_logical_shift_right(
+          b, _sym_build_sub(buildConstant(bits, bits), amount)));
+}
+
+SymExpr _sym_build_funnel_shift_right(SymExpr a, SymExpr b, SymExpr shift) {
+  size_t bits = _sym_bits_helper(a);
+  auto amount = _sym_build_unsigned_rem(shift, buildConstant(bits, bits));
+  return _sym_build_or(
+      _sym_build_shift_left(a,
+                            _sym_build_sub(buildConstant(bits, bits), amount)),
+      _sym_build_logical_shift_right(b, amount));
+}
+
+SymExpr _sym_build_unsigned_min(SymExpr a, SymExpr b) {
+  return selectByMask(_sym_build_unsigned_less_than(a, b), a, b);
+}
+
+SymExpr _sym_build_unsigned_max(SymExpr a, SymExpr b) {
+  return selectByMask(_sym_build_unsigned_greater_than(a, b), a, b);
+}
+
+SymExpr _sym_build_signed_min(SymExpr a, SymExpr b) {
+  return selectByMask(_sym_build_signed_less_than(a, b), a, b);
+}
+
+SymExpr _sym_build_signed_max(SymExpr a, SymExpr b) {
+  return selectByMask(_sym_build_signed_greater_than(a, b), a, b);
+}
+
+SymExpr _sym_build_unsigned_add_overflow(SymExpr a, SymExpr b) {
+  return _sym_build_unsigned_less_than(_sym_build_add(a, b), a);
+}
+
+SymExpr _sym_build_signed_add_overflow(SymExpr a, SymExpr b) {
+  // Overflow happens if the result's sign differs from both operands' signs.
+  auto sum = _sym_build_add(a, b);
+  return isNegative(
+      _sym_build_and(_sym_build_xor(a, sum), _sym_build_xor(b, sum)));
+}
+
+SymExpr _sym_build_unsigned_sub_overflow(SymExpr a, SymExpr b) {
+  return _sym_build_unsigned_less_than(a, b);
+}
+
+SymExpr _sym_build_signed_sub_overflow(SymExpr a, SymExpr b) {
+  // Overflow happens if the operands' signs differ and the result's sign
+  // differs from the first operand's.
+  auto difference = _sym_build_sub(a, b);
+  return isNegative(
+      _sym_build_and(_sym_build_xor(a, b), _sym_build_xor(a, difference)));
+}
+
+SymExpr _sym_build_unsigned_mul_overflow(SymExpr a, SymExpr b) {
+  // Multiply at double width and check the upper half.
+  size_t bits = _sym_bits_helper(a);
+  auto product = _sym_build_mul(_sym_build_zext(a, bits),
+                                _sym_build_zext(b, bits));
+  return _sym_build_not_equal(
+      _sym_extract_helper(product, 2 * bits - 1, bits),
+      buildConstant(0, bits));
+}
+
+SymExpr _sym_build_signed_mul_overflow(SymExpr a, SymExpr b) {
+  // Multiply at double width and check whether the result fits.
+  size_t bits = _sym_bits_helper(a);
+  auto product = _sym_build_mul(_sym_build_sext(a, bits),
+                                _sym_build_sext(b, bits));
+  return _sym_build_not_equal(
+      product, _sym_build_sext(_sym_build_trunc(product, bits), bits));
+}
+
+SymExpr _sym_build_unsigned_add_sat(SymExpr a, SymExpr b) {
+  auto sum = _sym_build_add(a, b);
+  return selectByMask(_sym_build_unsigned_less_than(sum, a),
+                      _sym_build_not(buildConstant(0, _sym_bits_helper(a))),
+                      sum);
+}
+
+SymExpr _sym_build_signed_add_sat(SymExpr a, SymExpr b) {
+  return selectByMask(_sym_build_signed_add_overflow(a, b),
+                      signedSaturationValue(a), _sym_build_add(a, b));
+}
+
+SymExpr _sym_build_unsigned_sub_sat(SymExpr a, SymExpr b) {
+  return selectByMask(_sym_build_unsigned_less_than(a, b),
+                      buildConstant(0, _sym_bits_helper(a)),
+                      _sym_build_sub(a, b));
+}
+
+SymExpr _sym_build_signed_sub_sat(SymExpr a, SymExpr b) {
+  return selectByMask(_sym_build_signed_sub_overflow(a, b),
+                      signedSaturationValue(a), _sym_build_sub(a, b));
+}
+
 struct cached_path_constraint {
   SymExpr constraint;
   int taken;
   uintptr_t site_id;
 };
 
-static std::vector<cached_path_constraint> __cached_switch_case_constraints;
+static thread_local std::vector<cached_path_constraint>
+    __cached_switch_case_constraints;
 void _sym_push_switch_constraint(SymExpr constraint, int taken, uintptr_t site_id,
                                  size_t index, size_t num_cases) {
   if (index == 0) {
@@ -298,12 +510,70 @@ void _sym_make_symbolic(void *data, size_t byte_length, size_t input_offset) {
   });
 }
 
+namespace {
+
+/// The offset of the next input byte made symbolic via symcc_make_symbolic.
+std::atomic<size_t> memoryInputOffset{0};
+
+/// The input that this process works on during exploration (see
+/// Exploration.h); it replaces the contents of the buffers passed to
+/// symcc_make_symbolic.
+std::optional<std::string> exploredInput;
+
+} // namespace
+
 void symcc_make_symbolic(void *start, size_t byte_length) {
   if (!std::holds_alternative<MemoryInput>(g_config.input))
     throw std::runtime_error{"Calls to symcc_make_symbolic aren't allowed when "
                              "SYMCC_MEMORY_INPUT isn't set"};
 
-  static size_t inputOffset = 0; // track the offset across calls
-  _sym_make_symbolic(start, byte_length, inputOffset);
-  inputOffset += byte_length;
+  auto input = startExploration([start, byte_length] {
+    return std::string(static_cast<char *>(start), byte_length);
+  });
+  if (input)
+    exploredInput = readExplorationInput(*input);
+
+  auto offset = memoryInputOffset.fetch_add(byte_length);
+  if (exploredInput.has_value() && offset < exploredInput->size()) {
+    // Patch in our input.
+    memcpy(start, exploredInput->data() + offset,
+           std::min(byte_length, exploredInput->size() - offset));
+  }
+
+  _sym_make_symbolic(start, byte_length, offset);
+}
+
+int symcc_reset(void) {
+  static bool firstIteration = true;
+  bool wasFirstIteration = std::exchange(firstIteration, false);
+
+  if (!haveControlChannel()) {
+    // Without a driver, there is just the input we started with.
+    return wasFirstIteration;
+  }
+
+  if (!wasFirstIteration) {
+    collectTestCases(g_config.outputDir);
+    sendControlStatus(0);
+  }
+
+  ControlRequest request;
+  if (!receiveControlRequest(request))
+    return 0;
+
+  {
+    BackendLock lock;
+    g_config.outputDir = request.outputDir;
+    _sym_reset_backend();
+    resetShadowMemory();
+    clearExpressionRegions();
+  }
+
+  _sym_return_value = nullptr;
+  std::fill(std::begin(_sym_function_arguments),
+            std::end(_sym_function_arguments), nullptr);
+  __cached_switch_case_constraints.clear();
+  memoryInputOffset = 0;
+  resetLibcWrappers(request.inputFile);
+  return 1;
 }
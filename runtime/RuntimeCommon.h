@@ -125,6 +125,32 @@ SymExpr _sym_build_float_to_signed_integer(SymExpr expr, uint8_t bits);
 SymExpr _sym_build_float_to_unsigned_integer(SymExpr expr, uint8_t bits);
 SymExpr _sym_build_bool_to_bit(SymExpr expr);
 
+/*
+ * Bit counting, funnel shifts, minimum/maximum and overflow checks
+ *
+ * These are implemented on top of the other builders, so backends get them for
+ * free. The overflow checks return Boolean expressions.
+ */
+SymExpr _sym_build_ctpop(SymExpr expr);
+SymExpr _sym_build_ctlz(SymExpr expr);
+SymExpr _sym_build_cttz(SymExpr expr);
+SymExpr _sym_build_funnel_shift_left(SymExpr a, SymExpr b, SymExpr shift);
+SymExpr _sym_build_funnel_shift_right(SymExpr a, SymExpr b, SymExpr shift);
+SymExpr _sym_build_unsigned_min(SymExpr a, SymExpr b);
+SymExpr _sym_build_unsigned_max(SymExpr a, SymExpr b);
+SymExpr _sym_build_signed_min(SymExpr a, SymExpr b);
+SymExpr _sym_build_signed_max(SymExpr a, SymExpr b);
+SymExpr _sym_build_unsigned_add_overflow(SymExpr a, SymExpr b);
+SymExpr _sym_build_signed_add_overflow(SymExpr a, SymExpr b);
+SymExpr _sym_build_unsigned_sub_overflow(SymExpr a, SymExpr b);
+SymExpr _sym_build_signed_sub_overflow(SymExpr a, SymExpr b);
+SymExpr _sym_build_unsigned_mul_overflow(SymExpr a, SymExpr b);
+SymExpr _sym_build_signed_mul_overflow(SymExpr a, SymExpr b);
+SymExpr _sym_build_unsigned_add_sat(SymExpr a, SymExpr b);
+SymExpr _sym_build_signed_add_sat(SymExpr a, SymExpr b);
+SymExpr _sym_build_unsigned_sub_sat(SymExpr a, SymExpr b);
+SymExpr _sym_build_signed_sub_sat(SymExpr a, SymExpr b);
+
 /*
  * Bit-array helpers
  */
@@ -230,7 +256,19 @@ SymExpr _sym_build_extract(SymExpr expr, uint64_t offset, uint64_t length,
 
 /*
  * Call-stack tracing
+ *
+ * Instrumented code only calls the notification functions that the backend
+ * requests in _sym_backend_notifications; every backend defines this constant
+ * as a combination of the flags below. With sparse notifications, the backend
+ * hears about function entries and loop headers only.
  */
+enum {
+  SYM_NOTIFY_CALLS = 1 << 0,
+  SYM_NOTIFY_BASIC_BLOCKS = 1 << 1,
+  SYM_NOTIFY_SPARSE_BASIC_BLOCKS = 1 << 2,
+};
+extern const uint32_t _sym_backend_notifications;
+
 void _sym_notify_call(uintptr_t site_id);
 void _sym_notify_ret(uintptr_t site_id);
 void _sym_notify_basic_block(uintptr_t site_id);
@@ -252,11 +290,30 @@ void _sym_collect_garbage(void);
 /*
  * Symbolic input from memory
  *
- * This is the only function in the interface that we expect to be called by
- * users (i.e., calls to it aren't auto-generated by our compiler pass).
+ * This and symcc_reset below are the only functions in the interface that we
+ * expect to be called by users (i.e., calls to them aren't auto-generated by
+ * our compiler pass).
  */
 void symcc_make_symbolic(void *start, size_t byte_length);
 
+/*
+ * Persistent mode
+ *
+ * A program that processes its input in a loop "while (symcc_reset()) {...}"
+ * can analyze many inputs in one process if a driver hands them over (see
+ * ControlChannel.h). Each call forgets all symbolic state and points the
+ * symbolic input at the next input (standard input, or the file that the
+ * program opens under the configured input file's name; with symbolic input
+ * from memory, the program has to fetch the input itself); it returns zero
+ * when there are no more inputs. Without a driver, the loop runs once on the initial input. No other
+ * thread may work with symbolic data while symcc_reset runs.
+ *
+ * Backends implement _sym_reset_backend, which drops all expressions and
+ * solver state.
+ */
+int symcc_reset(void);
+void _sym_reset_backend(void);
+
 #ifdef __cplusplus
 }
 #endif
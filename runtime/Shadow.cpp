@@ -14,4 +14,69 @@
 
 #include "Shadow.h"
 
+#include <cstdlib>
+
+#include "Stats.h"
+
 std::map<uintptr_t, SymExpr *> g_shadow_pages;
+std::mutex g_shadow_pages_mutex;
+SymExpr **_sym_shadow_directory[1 << SYM_SHADOW_ROOT_BITS];
+
+namespace {
+
+/// Install a new zero-initialized table in the given slot unless another thread
+/// has been faster, and return the slot's table.
+template <typename T> T *installTable(T **slot, size_t entries) {
+  auto *table = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+  if (table != nullptr)
+    return table;
+
+  auto *newTable = static_cast<T *>(calloc(entries, sizeof(T)));
+  if (__atomic_compare_exchange_n(slot, &table, newTable, /* weak */ false,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    return newTable;
+
+  free(newTable);
+  return table;
+}
+
+} // namespace
+
+SymExpr *createShadowPage(uintptr_t page) {
+  if (!inShadowDirectory(page)) {
+    std::lock_guard<std::mutex> lock(g_shadow_pages_mutex);
+    auto *&shadow = g_shadow_pages[page];
+    if (shadow == nullptr) {
+      shadow = static_cast<SymExpr *>(calloc(kPageSize, sizeof(SymExpr)));
+      statsShadowPage();
+    }
+    return shadow;
+  }
+
+  auto pageNumber = page >> SYM_SHADOW_PAGE_BITS;
+  auto **leaf = installTable(
+      &_sym_shadow_directory[pageNumber >> SYM_SHADOW_LEAF_BITS],
+      kShadowLeafSize);
+  auto **slot = &leaf[pageNumber & (kShadowLeafSize - 1)];
+  if (auto *shadow = __atomic_load_n(slot, __ATOMIC_ACQUIRE))
+    return shadow;
+
+  // Threads that race to create the shadow all get (and record) the same one.
+  auto *shadow = installTable(slot, kPageSize);
+  std::lock_guard<std::mutex> lock(g_shadow_pages_mutex);
+  if (g_shadow_pages.emplace(page, shadow).second)
+    statsShadowPage();
+  return shadow;
+}
+
+void resetShadowMemory() {
+  std::lock_guard<std::mutex> lock(g_shadow_pages_mutex);
+  for (auto &[page, shadow] : g_shadow_pages)
+    free(shadow);
+  g_shadow_pages.clear();
+
+  for (auto *&leaf : _sym_shadow_directory) {
+    free(leaf);
+    leaf = nullptr;
+  }
+}
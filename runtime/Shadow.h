@@ -20,9 +20,12 @@
 #include <cstring>
 #include <iterator>
 #include <map>
+#include <mutex>
 
 #include <Runtime.h>
 
+#include "InlineHelpers.h"
+
 //
 // This file is dedicated to the management of shadow memory.
 //
@@ -37,7 +40,7 @@
 // iterators therefore expose the shadow in the form of byte expressions.
 //
 
-constexpr uintptr_t kPageSize = 4096;
+constexpr uintptr_t kPageSize = SYM_SHADOW_PAGE_SIZE;
 
 /// Compute the corresponding page address.
 constexpr uintptr_t pageStart(uintptr_t addr) {
@@ -51,7 +54,48 @@ constexpr uintptr_t pageOffset(uintptr_t addr) {
 
 /// A mapping from page addresses to the corresponding shadow regions. Each
 /// shadow is large enough to hold one expression per byte on the shadowed page.
+///
+/// Lookups go through the lock-free shadow directory (see InlineHelpers.h);
+/// the map only serves to enumerate shadows and to hold the shadows of pages
+/// beyond the directory's range. Any access must hold g_shadow_pages_mutex.
 extern std::map<uintptr_t, SymExpr *> g_shadow_pages;
+extern std::mutex g_shadow_pages_mutex;
+
+constexpr uintptr_t kShadowLeafSize = uintptr_t(1) << SYM_SHADOW_LEAF_BITS;
+
+/// Decide whether a page is covered by the shadow directory.
+constexpr bool inShadowDirectory(uintptr_t page) {
+  return ((page >> SYM_SHADOW_PAGE_BITS) >>
+          (SYM_SHADOW_ROOT_BITS + SYM_SHADOW_LEAF_BITS)) == 0;
+}
+
+/// Get the shadow of a page, or null if the page doesn't have one.
+inline SymExpr *lookupShadowPage(uintptr_t page) {
+  if (!inShadowDirectory(page)) {
+    std::lock_guard<std::mutex> lock(g_shadow_pages_mutex);
+    auto shadowPageIt = g_shadow_pages.find(page);
+    return (shadowPageIt != g_shadow_pages.end()) ? shadowPageIt->second
+                                                  : nullptr;
+  }
+
+  auto pageNumber = page >> SYM_SHADOW_PAGE_BITS;
+  auto **leaf = __atomic_load_n(
+      &_sym_shadow_directory[pageNumber >> SYM_SHADOW_LEAF_BITS],
+      __ATOMIC_ACQUIRE);
+  if (leaf == nullptr)
+    return nullptr;
+
+  return __atomic_load_n(&leaf[pageNumber & (kShadowLeafSize - 1)],
+                         __ATOMIC_ACQUIRE);
+}
+
+/// Create the shadow of a page, or return the existing one. This is safe to
+/// call concurrently; all callers get the same shadow.
+SymExpr *createShadowPage(uintptr_t page);
+
+/// Release all shadow pages, making the entire memory concrete. No other thread
+/// may access shadow memory at the same time.
+void resetShadowMemory();
 
 /// An iterator that walks over the shadow bytes corresponding to a memory
 /// region. If there is no shadow for any given memory address, it just returns
@@ -98,9 +142,8 @@ public:
 
 protected:
   static SymExpr *getShadow(uintptr_t address) {
-    if (auto shadowPageIt = g_shadow_pages.find(pageStart(address));
-        shadowPageIt != g_shadow_pages.end())
-      return shadowPageIt->second + pageOffset(address);
+    if (auto *pageShadow = lookupShadowPage(pageStart(address)))
+      return pageShadow + pageOffset(address);
 
     return nullptr;
   }
@@ -156,11 +199,7 @@ protected:
     if (auto *shadow = getShadow(address))
       return shadow;
 
-    auto *newShadow =
-        static_cast<SymExpr *>(malloc(kPageSize * sizeof(SymExpr)));
-    memset(newShadow, 0, kPageSize * sizeof(SymExpr));
-    g_shadow_pages[pageStart(address)] = newShadow;
-    return newShadow + pageOffset(address);
+    return createShadowPage(pageStart(address)) + pageOffset(address);
   }
 };
 
@@ -206,7 +245,7 @@ template <typename T> bool isConcrete(T *addr, size_t nbytes) {
   auto byteBuf = reinterpret_cast<uintptr_t>(addr);
   // printf("isConcrete: %p, %zu\n", addr, nbytes);
   if (pageStart(byteBuf) == pageStart(byteBuf + nbytes) &&
-      !g_shadow_pages.count(pageStart(byteBuf)))
+      lookupShadowPage(pageStart(byteBuf)) == nullptr)
     return true;
 
   ReadOnlyShadow shadow(addr, nbytes);
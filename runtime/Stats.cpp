@@ -0,0 +1,569 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "Stats.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Config.h"
+#include "Shadow.h"
+#include "StatsPage.h"
+
+namespace {
+
+/// The names of the expression-building operations, indexed by TraceOp.
+const char *const kExpressionNames[] = {
+    "integer", "integer128", "float", "null_pointer", "true", "false", "bool",
+    "get_input_byte", "neg", "add", "sub", "mul", "unsigned_div", "signed_div",
+    "unsigned_rem", "signed_rem", "shift_left", "logical_shift_right",
+    "arithmetic_shift_right", "fp_add", "fp_sub", "fp_mul", "fp_div", "fp_rem",
+    "fp_abs", "not", "signed_less_than", "signed_less_equal",
+    "signed_greater_than", "signed_greater_equal", "unsigned_less_than",
+    "unsigned_less_equal", "unsigned_greater_than", "unsigned_greater_equal",
+    "equal", "not_equal", "bool_and", "and", "bool_or", "or", "bool_xor", "xor",
+    "float_ordered_greater_than", "float_ordered_greater_equal",
+    "float_ordered_less_than", "float_ordered_less_equal",
+    "float_ordered_equal", "float_ordered_not_equal", "float_ordered",
+    "float_unordered", "float_unordered_greater_than",
+    "float_unordered_greater_equal", "float_unordered_less_than",
+    "float_unordered_less_equal", "float_unordered_equal",
+    "float_unordered_not_equal", "sext", "zext", "trunc", "int_to_float",
+    "float_to_float", "bits_to_float", "float_to_bits",
+    "float_to_signed_integer", "float_to_unsigned_integer", "bool_to_bit",
+    "concat_helper", "extract_helper",
+};
+
+static_assert(sizeof(kExpressionNames) / sizeof(kExpressionNames[0]) ==
+                  TraceOp_push_path_constraint,
+              "Every expression needs a name");
+
+/// The number of buckets in a histogram; bucket i counts values in
+/// [2^i, 2^(i+1)) microseconds, except that bucket 0 starts at 0.
+constexpr size_t kHistogramBuckets = 32;
+
+/// A counter that only its thread increments but others may read.
+///
+/// A relaxed load and store is much cheaper than an atomic increment.
+class Counter {
+public:
+  void add(uint64_t value = 1) {
+    value_.store(value_.load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+  }
+
+  uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> value_{0};
+};
+
+class Histogram {
+public:
+  void add(std::chrono::nanoseconds duration) {
+    uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                          duration)
+                          .count();
+    size_t bucket = micros == 0 ? 0 : 63 - __builtin_clzll(micros);
+    buckets_[std::min(bucket, kHistogramBuckets - 1)].add();
+  }
+
+  void addTo(std::array<uint64_t, kHistogramBuckets> &sums) const {
+    for (size_t i = 0; i < kHistogramBuckets; i++)
+      sums[i] += buckets_[i].get();
+  }
+
+private:
+  std::array<Counter, kHistogramBuckets> buckets_;
+};
+
+/// What happened at a site.
+struct SiteStats {
+  uint64_t pathConstraints = 0;
+  uint64_t concretizations = 0;
+  uint64_t queries[3] = {0, 0, 0}; // indexed by SolverResult
+  uint64_t solverNanoseconds = 0;
+
+  void addTo(SiteStats &sum) const {
+    sum.pathConstraints += pathConstraints;
+    sum.concretizations += concretizations;
+    for (size_t i = 0; i < 3; i++)
+      sum.queries[i] += queries[i];
+    sum.solverNanoseconds += solverNanoseconds;
+  }
+};
+
+/// The counters of a thread.
+struct ThreadStats {
+  std::array<Counter, TraceOp_push_path_constraint> expressions;
+  Counter shadowPages;
+  Counter pathConstraints;
+  Counter concretizations;
+
+  Counter garbageCollections;
+  Counter garbageCollectionNanoseconds;
+  Histogram garbageCollectionPauses;
+
+  Counter queries[3]; // indexed by SolverResult
+  Counter solverNanoseconds;
+  Histogram solverLatencies;
+
+  /// Sites change rarely compared to the other counters, so a lock that is
+  /// only ever contended while writing the statistics is fine.
+  std::mutex sitesMutex;
+  std::unordered_map<uintptr_t, SiteStats> sites;
+};
+
+bool statsEnabled = false;
+
+// Counters that describe the state of the whole process rather than events in
+// a thread
+std::atomic<uint64_t> liveExpressions{0};
+std::atomic<uint64_t> inputOffset{0};
+std::atomic<uint64_t> solverQueueDepth{0};
+
+/// The counters of all threads that have ever counted anything. We never free
+/// them, so that the counts of finished threads remain.
+std::mutex allStatsMutex;
+std::vector<std::unique_ptr<ThreadStats>> allStats;
+
+thread_local ThreadStats *currentStats = nullptr;
+
+volatile sig_atomic_t dumpRequested = 0;
+
+ThreadStats &threadStats() {
+  if (currentStats == nullptr) {
+    auto stats = std::make_unique<ThreadStats>();
+    currentStats = stats.get();
+    std::lock_guard<std::mutex> lock(allStatsMutex);
+    allStats.push_back(std::move(stats));
+  }
+  return *currentStats;
+}
+
+/// How often we update the live statistics page at most.
+constexpr uint64_t kPublishIntervalNanoseconds = 100'000'000;
+
+/// The live statistics page and the process that it belongs to; a forked
+/// child creates its own. Only the thread that holds publishMutex may write to
+/// the page.
+std::mutex publishMutex;
+StatsPage *page = nullptr;
+pid_t pagePid = 0;
+std::atomic<uint64_t> lastPublishTime{0};
+
+/// The window over which we measure the rate of solver queries (starting with
+/// the next update if rateWindowStart is 0)
+uint64_t rateWindowStart = 0;
+uint64_t rateWindowQueries = 0;
+uint64_t solverQueriesPerSecond = 0;
+
+uint64_t monotonicNanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1'000'000'000 + now.tv_nsec;
+}
+
+std::string pageName(pid_t pid) {
+  return kStatsPagePrefix + std::to_string(pid);
+}
+
+/// Create the live statistics page of the current process, returning nullptr
+/// on failure.
+StatsPage *createPage() {
+  auto name = pageName(getpid());
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror(("Failed to create the statistics page " + name).c_str());
+    return nullptr;
+  }
+
+  void *memory = MAP_FAILED;
+  if (ftruncate(fd, sizeof(StatsPage)) == 0)
+    memory = mmap(nullptr, sizeof(StatsPage), PROT_READ | PROT_WRITE,
+                  MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    perror(("Failed to map the statistics page " + name).c_str());
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+
+  // The fresh page is all zeros, which is a valid state for the sequence lock;
+  // readers ignore it until the magic is there.
+  auto *newPage = static_cast<StatsPage *>(memory);
+  newPage->version = kStatsPageVersion;
+  newPage->size = sizeof(StatsPage);
+  newPage->pid = getpid();
+  newPage->startTime = monotonicNanoseconds();
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  std::copy(std::begin(kStatsPageMagic), std::end(kStatsPageMagic),
+            newPage->magic);
+  return newPage;
+}
+
+void removePage() {
+  std::lock_guard<std::mutex> lock(publishMutex);
+  if (page == nullptr || pagePid != getpid())
+    return;
+
+  munmap(page, sizeof(StatsPage));
+  shm_unlink(pageName(pagePid).c_str());
+  page = nullptr;
+}
+
+void store(uint64_t &field, uint64_t value) {
+  __atomic_store_n(&field, value, __ATOMIC_RELAXED);
+}
+
+/// Update the live statistics page, unless we have done so very recently.
+void publishStats() {
+  if (!g_config.liveStats)
+    return;
+
+  auto now = monotonicNanoseconds();
+  if (now - lastPublishTime.load(std::memory_order_relaxed) <
+      kPublishIntervalNanoseconds)
+    return;
+
+  std::unique_lock<std::mutex> lock(publishMutex, std::try_to_lock);
+  if (!lock.owns_lock())
+    return; // another thread is publishing
+
+  if (pagePid != getpid()) {
+    // We're a new process, and the page (if any) belongs to our parent.
+    if (page != nullptr)
+      munmap(page, sizeof(StatsPage));
+    page = createPage();
+    pagePid = getpid();
+    rateWindowStart = 0;
+    solverQueriesPerSecond = 0;
+  }
+  if (page == nullptr)
+    return;
+
+  lastPublishTime.store(now, std::memory_order_relaxed);
+
+  uint64_t expressionsBuilt = 0, shadowPages = 0, pathConstraints = 0,
+           concretizations = 0, solverQueries = 0, solverNanoseconds = 0,
+           garbageCollections = 0, garbageCollectionNanoseconds = 0;
+  {
+    std::lock_guard<std::mutex> statsLock(allStatsMutex);
+    for (auto &stats : allStats) {
+      for (auto &counter : stats->expressions)
+        expressionsBuilt += counter.get();
+      shadowPages += stats->shadowPages.get();
+      pathConstraints += stats->pathConstraints.get();
+      concretizations += stats->concretizations.get();
+      for (auto &counter : stats->queries)
+        solverQueries += counter.get();
+      solverNanoseconds += stats->solverNanoseconds.get();
+      garbageCollections += stats->garbageCollections.get();
+      garbageCollectionNanoseconds +=
+          stats->garbageCollectionNanoseconds.get();
+    }
+  }
+
+  if (rateWindowStart == 0) {
+    rateWindowStart = now;
+    rateWindowQueries = solverQueries;
+  } else if (now - rateWindowStart >= 1'000'000'000) {
+    solverQueriesPerSecond = (solverQueries - rateWindowQueries) *
+                             1'000'000'000 / (now - rateWindowStart);
+    rateWindowStart = now;
+    rateWindowQueries = solverQueries;
+  }
+
+  // Write under the sequence lock (see StatsPage.h).
+  auto sequence = page->sequence;
+  __atomic_store_n(&page->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  store(page->updateTime, now);
+  store(page->expressionsLive, liveExpressions.load(std::memory_order_relaxed));
+  store(page->expressionsBuilt, expressionsBuilt);
+  store(page->shadowBytes, shadowPages * kPageSize);
+  store(page->pathConstraints, pathConstraints);
+  store(page->concretizations, concretizations);
+  store(page->inputOffset, inputOffset.load(std::memory_order_relaxed));
+  store(page->solverQueueDepth,
+        solverQueueDepth.load(std::memory_order_relaxed));
+  store(page->solverQueries, solverQueries);
+  store(page->solverQueriesPerSecond, solverQueriesPerSecond);
+  store(page->solverTime, solverNanoseconds);
+  store(page->garbageCollections, garbageCollections);
+  store(page->garbageCollectionTime, garbageCollectionNanoseconds);
+
+  __atomic_store_n(&page->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void handleDumpSignal(int) { dumpRequested = 1; }
+
+/// Write the statistics if somebody asked for them, and keep the live
+/// statistics page up to date.
+void checkpoint() {
+  if (dumpRequested) {
+    dumpRequested = 0;
+    dumpStats();
+  }
+  publishStats();
+}
+
+std::string statsFileName() {
+  auto name = g_config.statsFile;
+  auto pid = std::to_string(getpid());
+  for (auto pos = name.find("%p"); pos != std::string::npos;
+       pos = name.find("%p", pos + pid.size()))
+    name.replace(pos, 2, pid);
+  return name;
+}
+
+void writeHistogram(std::ostream &out,
+                    const std::array<uint64_t, kHistogramBuckets> &buckets) {
+  // Omit the empty buckets at the end.
+  auto used = kHistogramBuckets;
+  while (used > 0 && buckets[used - 1] == 0)
+    used--;
+
+  out << "[";
+  for (size_t i = 0; i < used; i++)
+    out << (i > 0 ? ", " : "") << buckets[i];
+  out << "]";
+}
+
+void writeQueries(std::ostream &out, const uint64_t (&queries)[3]) {
+  out << "\"sat\": " << queries[static_cast<int>(SolverResult::Sat)]
+      << ", \"unsat\": " << queries[static_cast<int>(SolverResult::Unsat)]
+      << ", \"unknown\": " << queries[static_cast<int>(SolverResult::Unknown)];
+}
+
+} // namespace
+
+void initStats() {
+  if (!g_config.statsFile.empty()) {
+    statsEnabled = true;
+    signal(SIGUSR2, handleDumpSignal);
+    atexit(dumpStats);
+  }
+
+  if (g_config.liveStats) {
+    statsEnabled = true;
+    atexit(removePage);
+  }
+}
+
+void statsExpression(TraceOp op) {
+  if (statsEnabled)
+    threadStats().expressions[op].add();
+}
+
+void statsInputByte(size_t offset) {
+  if (statsEnabled)
+    inputOffset.store(offset + 1, std::memory_order_relaxed);
+}
+
+void statsLiveExpressions(size_t count) {
+  if (statsEnabled)
+    liveExpressions.store(count, std::memory_order_relaxed);
+}
+
+void statsPathConstraint(uintptr_t siteId) {
+  if (!statsEnabled)
+    return;
+
+  auto &stats = threadStats();
+  stats.pathConstraints.add();
+  {
+    std::lock_guard<std::mutex> lock(stats.sitesMutex);
+    stats.sites[siteId].pathConstraints++;
+  }
+  checkpoint();
+}
+
+void statsConcretization(uintptr_t siteId) {
+  if (!statsEnabled)
+    return;
+
+  auto &stats = threadStats();
+  stats.concretizations.add();
+  {
+    std::lock_guard<std::mutex> lock(stats.sitesMutex);
+    stats.sites[siteId].concretizations++;
+  }
+  checkpoint();
+}
+
+void statsSolverStart() {
+  if (!statsEnabled)
+    return;
+
+  solverQueueDepth.fetch_add(1, std::memory_order_relaxed);
+  // Queries can take a long time, so the page should show this one while the
+  // solver works on it (unless we've published very recently).
+  checkpoint();
+}
+
+void statsSolverSkip() {
+  if (!statsEnabled)
+    return;
+
+  solverQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+  checkpoint();
+}
+
+void statsSolverQuery(uintptr_t siteId, SolverResult result,
+                      std::chrono::nanoseconds latency) {
+  if (!statsEnabled)
+    return;
+
+  solverQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+
+  auto &stats = threadStats();
+  auto index = static_cast<int>(result);
+  stats.queries[index].add();
+  stats.solverNanoseconds.add(latency.count());
+  stats.solverLatencies.add(latency);
+
+  {
+    std::lock_guard<std::mutex> lock(stats.sitesMutex);
+    auto &site = stats.sites[siteId];
+    site.queries[index]++;
+    site.solverNanoseconds += latency.count();
+  }
+  checkpoint();
+}
+
+void statsGarbageCollection(std::chrono::nanoseconds pause) {
+  if (!statsEnabled)
+    return;
+
+  auto &stats = threadStats();
+  stats.garbageCollections.add();
+  stats.garbageCollectionNanoseconds.add(pause.count());
+  stats.garbageCollectionPauses.add(pause);
+  checkpoint();
+}
+
+void statsShadowPage() {
+  if (statsEnabled)
+    threadStats().shadowPages.add();
+}
+
+void dumpStats() {
+  if (g_config.statsFile.empty())
+    return;
+
+  // Add up the threads' counters.
+  std::array<uint64_t, TraceOp_push_path_constraint> expressions{};
+  uint64_t shadowPages = 0, garbageCollections = 0,
+           garbageCollectionNanoseconds = 0, solverNanoseconds = 0;
+  uint64_t queries[3] = {0, 0, 0};
+  std::array<uint64_t, kHistogramBuckets> pauses{}, latencies{};
+  std::unordered_map<uintptr_t, SiteStats> sites;
+  {
+    std::lock_guard<std::mutex> lock(allStatsMutex);
+    for (auto &stats : allStats) {
+      for (size_t i = 0; i < expressions.size(); i++)
+        expressions[i] += stats->expressions[i].get();
+      shadowPages += stats->shadowPages.get();
+      garbageCollections += stats->garbageCollections.get();
+      garbageCollectionNanoseconds +=
+          stats->garbageCollectionNanoseconds.get();
+      stats->garbageCollectionPauses.addTo(pauses);
+      for (size_t i = 0; i < 3; i++)
+        queries[i] += stats->queries[i].get();
+      solverNanoseconds += stats->solverNanoseconds.get();
+      stats->solverLatencies.addTo(latencies);
+
+      std::lock_guard<std::mutex> sitesLock(stats->sitesMutex);
+      for (auto &[siteId, site] : stats->sites)
+        site.addTo(sites[siteId]);
+    }
+  }
+
+  // The most expensive sites first
+  std::vector<std::pair<uintptr_t, SiteStats>> sortedSites(sites.begin(),
+                                                           sites.end());
+  std::sort(sortedSites.begin(), sortedSites.end(),
+            [](const auto &a, const auto &b) {
+              if (a.second.solverNanoseconds != b.second.solverNanoseconds)
+                return a.second.solverNanoseconds > b.second.solverNanoseconds;
+              return a.first < b.first;
+            });
+
+  // Write to a temporary file first, so that readers never see a partial
+  // dump.
+  auto name = statsFileName();
+  auto temporaryName = name + ".tmp";
+  std::ofstream out(temporaryName, std::ios::trunc);
+
+  uint64_t totalExpressions = 0;
+  for (auto count : expressions)
+    totalExpressions += count;
+
+  out << "{\n  \"pid\": " << getpid() << ",\n";
+  out << "  \"expressions\": {\n    \"total\": " << totalExpressions;
+  for (size_t i = 0; i < expressions.size(); i++) {
+    if (expressions[i] > 0)
+      out << ",\n    \"" << kExpressionNames[i] << "\": " << expressions[i];
+  }
+  out << "\n  },\n";
+
+  out << "  \"shadow_pages\": " << shadowPages << ",\n";
+
+  out << "  \"garbage_collection\": {\"count\": " << garbageCollections
+      << ", \"pause_ns\": " << garbageCollectionNanoseconds
+      << ", \"pause_histogram_log2_us\": ";
+  writeHistogram(out, pauses);
+  out << "},\n";
+
+  out << "  \"solver\": {\"queries\": " << queries[0] + queries[1] + queries[2]
+      << ", ";
+  writeQueries(out, queries);
+  out << ", \"time_ns\": " << solverNanoseconds
+      << ", \"latency_histogram_log2_us\": ";
+  writeHistogram(out, latencies);
+  out << "},\n";
+
+  out << "  \"sites\": [";
+  bool first = true;
+  for (auto &[siteId, site] : sortedSites) {
+    out << (first ? "\n" : ",\n") << "    {\"site_id\": " << siteId
+        << ", \"path_constraints\": " << site.pathConstraints
+        << ", \"concretizations\": " << site.concretizations << ", ";
+    writeQueries(out, site.queries);
+    out << ", \"solver_time_ns\": " << site.solverNanoseconds << "}";
+    first = false;
+  }
+  out << (first ? "]\n}\n" : "\n  ]\n}\n");
+
+  out.close();
+  if (!out || rename(temporaryName.c_str(), name.c_str()) != 0)
+    perror(("Failed to write the statistics to " + name).c_str());
+}
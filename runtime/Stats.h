@@ -0,0 +1,97 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "TraceFormat.h"
+
+//
+// Runtime statistics
+//
+// If SYMCC_STATS_FILE is set, the runtime counts the expressions that it
+// builds (by operation), the shadow pages that it allocates, garbage
+// collections and their pauses, and solver queries by result and latency,
+// and it breaks path constraints, concretizations and solver queries down by
+// site ID. It writes the statistics as JSON to the file when the program
+// exits and whenever it receives SIGUSR2 (at the next path constraint,
+// concretization, solver query or garbage collection). A "%p" in the file name
+// stands for the process ID.
+//
+// If SYMCC_LIVE_STATS is set, the runtime additionally publishes the main
+// counters in a shared-memory page (see StatsPage.h for the layout), so that
+// tools like util/symcc-top can watch the program while it runs. It updates
+// the page at most ten times per second at the same points where it checks
+// for SIGUSR2, as well as when the solver starts working on a query.
+//
+// Counters are per thread, so counting is cheap; the threads' counters are
+// only added up when writing the statistics. Expressions, path constraints
+// and concretizations are counted by the recording hooks in Trace.h, so the
+// backends only need to report solver queries, garbage collections and their
+// live expressions. (The Rust-backend wrapper doesn't use the hooks and
+// counts everything itself.)
+//
+// Unless noted otherwise, the functions do nothing if statistics are
+// disabled.
+//
+
+/// The outcome of a solver query.
+enum class SolverResult { Sat, Unsat, Unknown };
+
+/// Set up statistics according to the configuration; call once after
+/// loadConfig.
+void initStats();
+
+/// Count the creation of an expression.
+void statsExpression(TraceOp op);
+
+/// Note that the program has made the input byte at the given offset
+/// symbolic.
+void statsInputByte(size_t offset);
+
+/// Report the number of expressions that the backend keeps alive.
+void statsLiveExpressions(size_t count);
+
+/// Count a path constraint at the given site.
+void statsPathConstraint(uintptr_t siteId);
+
+/// Count a concretization at the given site.
+void statsConcretization(uintptr_t siteId);
+
+/// Note that the solver is about to work on a query. Every call must be
+/// followed by statsSolverQuery or, if the backend decides not to query the
+/// solver after all, by statsSolverSkip.
+void statsSolverStart();
+
+/// Note that the solver didn't need to work on the query after all.
+void statsSolverSkip();
+
+/// Record a solver query on behalf of the given site (0 if unknown).
+void statsSolverQuery(uintptr_t siteId, SolverResult result,
+                      std::chrono::nanoseconds latency);
+
+/// Record a garbage collection.
+void statsGarbageCollection(std::chrono::nanoseconds pause);
+
+/// Count the allocation of a shadow page.
+void statsShadowPage();
+
+/// Write the statistics now.
+void dumpStats();
+
+#endif
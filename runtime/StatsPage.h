@@ -0,0 +1,94 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef STATSPAGE_H
+#define STATSPAGE_H
+
+#include <cstddef>
+#include <cstdint>
+
+//
+// The layout of the live statistics page (see Stats.h)
+//
+// If SYMCC_LIVE_STATS is set, the runtime publishes its counters in the POSIX
+// shared-memory object kStatsPagePrefix followed by the process ID (i.e.,
+// /dev/shm/symcc-stats.<pid> on Linux), where tools like util/symcc-top can
+// read them while the program runs. The page consists of a single StatsPage
+// in native byte order. Readers must check magic, version and size before
+// looking at the counters; new fields are only ever appended, so a reader
+// can accept any size at least as large as the one it knows.
+//
+// The runtime is the only writer, and it protects the counters with a
+// sequence lock: it makes sequence odd before updating the counters and even
+// again afterwards. Readers copy the page and retry if sequence was odd or
+// changed in the meantime.
+//
+// Times are in nanoseconds on the monotonic clock (CLOCK_MONOTONIC), so
+// readers can compare updateTime with their own clock to see how current the
+// page is. Counters accumulate over the lifetime of the process; readers
+// derive rates from the differences between two copies.
+//
+
+/// The name of the shared-memory object without the process ID.
+constexpr char kStatsPagePrefix[] = "/symcc-stats.";
+
+/// The bytes at the start of the page.
+constexpr char kStatsPageMagic[8] = {'S', 'y', 'm', 'S', 't', 'a', 't', 's'};
+
+/// The version of the layout; it only changes if existing fields change.
+constexpr uint32_t kStatsPageVersion = 1;
+
+struct StatsPage {
+  char magic[8];
+  uint32_t version;
+  /// The size of the structure that the writer knows.
+  uint32_t size;
+  uint64_t sequence;
+  uint64_t pid;
+  /// When the process started publishing.
+  uint64_t startTime;
+  /// When the process last updated the page.
+  uint64_t updateTime;
+
+  /// The expressions that the backend keeps alive.
+  uint64_t expressionsLive;
+  /// All expressions built so far, including the collected ones.
+  uint64_t expressionsBuilt;
+  uint64_t shadowBytes;
+  uint64_t pathConstraints;
+  uint64_t concretizations;
+  /// One past the offset of the last input byte made symbolic.
+  uint64_t inputOffset;
+
+  /// The solver queries in progress.
+  uint64_t solverQueueDepth;
+  /// The completed solver queries.
+  uint64_t solverQueries;
+  /// Completed solver queries per second, measured over at least a second.
+  uint64_t solverQueriesPerSecond;
+  uint64_t solverTime;
+  uint64_t garbageCollections;
+  uint64_t garbageCollectionTime;
+};
+
+// The layout is part of the interface, so make sure that it is what readers
+// expect.
+static_assert(offsetof(StatsPage, sequence) == 16, "Unexpected layout");
+static_assert(offsetof(StatsPage, expressionsLive) == 48, "Unexpected layout");
+static_assert(offsetof(StatsPage, solverQueueDepth) == 96,
+              "Unexpected layout");
+static_assert(sizeof(StatsPage) == 144, "Unexpected layout");
+
+#endif
@@ -0,0 +1,284 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "Trace.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef SYMCC_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "Config.h"
+#include "Stats.h"
+
+namespace {
+
+/// The size of the buffer for records that we haven't written yet.
+constexpr size_t kTraceBufferSize = 1 << 16;
+
+enum class TraceState { Unopened, Disabled, Open };
+
+TraceState traceState = TraceState::Unopened;
+
+/// The process that opened the trace; forked children start their own.
+pid_t tracePid = 0;
+
+int traceFd = -1;
+
+#ifdef SYMCC_HAVE_ZLIB
+/// The compressed stream on traceFd, if any.
+gzFile traceGz = nullptr;
+#endif
+
+uint8_t traceBuffer[kTraceBufferSize];
+size_t traceBufferUsed = 0;
+
+/// The trace IDs of the expressions that we've recorded.
+///
+/// Backends may hand out the same expression more than once (or reuse the
+/// memory of a collected expression), so the latest record wins.
+std::unordered_map<SymExpr, uint64_t> traceIds;
+
+uint64_t nextTraceId = 1;
+uintptr_t lastSiteId = 0;
+
+void disableTrace(const char *message) {
+  perror(message);
+  std::cerr << "Warning: not recording the rest of the trace" << std::endl;
+  traceState = TraceState::Disabled;
+}
+
+void writeTrace(const uint8_t *data, size_t length) {
+#ifdef SYMCC_HAVE_ZLIB
+  if (traceGz != nullptr) {
+    if (gzwrite(traceGz, data, length) != static_cast<int>(length))
+      disableTrace("Failed to write the trace");
+    return;
+  }
+#endif
+
+  while (length > 0) {
+    auto written = write(traceFd, data, length);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      disableTrace("Failed to write the trace");
+      return;
+    }
+    data += written;
+    length -= written;
+  }
+}
+
+void flushTrace() {
+  if (traceState == TraceState::Open && traceBufferUsed > 0)
+    writeTrace(traceBuffer, traceBufferUsed);
+  traceBufferUsed = 0;
+}
+
+void closeTrace() {
+  // Forked children must not write what their parent buffered.
+  if (traceState != TraceState::Open || tracePid != getpid())
+    return;
+
+  flushTrace();
+#ifdef SYMCC_HAVE_ZLIB
+  if (traceGz != nullptr) {
+    gzclose(traceGz);
+    traceGz = nullptr;
+    traceFd = -1;
+  }
+#endif
+  if (traceFd >= 0)
+    close(traceFd);
+  traceFd = -1;
+  traceState = TraceState::Disabled;
+}
+
+std::string traceFileName() {
+  auto name = g_config.traceFile;
+  auto pid = std::to_string(getpid());
+  for (auto pos = name.find("%p"); pos != std::string::npos;
+       pos = name.find("%p", pos + pid.size()))
+    name.replace(pos, 2, pid);
+  return name;
+}
+
+/// Make sure that the trace is open in this process; return false if we're
+/// not recording.
+bool openTrace() {
+  if (traceState == TraceState::Open && tracePid == getpid())
+    return true;
+  if (traceState == TraceState::Disabled)
+    return false;
+
+  if (traceState == TraceState::Open) {
+    // We're a forked child. Drop the parent's state without touching its
+    // file; a compressed stream can't be closed without writing to it, so we
+    // just forget about it.
+    close(traceFd);
+    traceFd = -1;
+#ifdef SYMCC_HAVE_ZLIB
+    traceGz = nullptr;
+#endif
+    traceBufferUsed = 0;
+    traceIds.clear();
+    nextTraceId = 1;
+    lastSiteId = 0;
+  }
+
+  traceState = TraceState::Disabled;
+  if (g_config.traceFile.empty())
+    return false;
+
+  auto name = traceFileName();
+  traceFd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (traceFd < 0) {
+    perror(("Failed to open the trace file " + name).c_str());
+    return false;
+  }
+
+  if (name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0) {
+#ifdef SYMCC_HAVE_ZLIB
+    // Favor speed over compression; the trace is written while the program
+    // runs.
+    traceGz = gzdopen(traceFd, "wb1");
+    if (traceGz == nullptr) {
+      std::cerr << "Warning: failed to set up compression; writing the trace "
+                   "uncompressed"
+                << std::endl;
+    }
+#else
+    std::cerr << "Warning: the runtime was built without zlib; writing the "
+                 "trace uncompressed"
+              << std::endl;
+#endif
+  }
+
+  static bool exitHandlerInstalled = false;
+  if (!exitHandlerInstalled) {
+    atexit(closeTrace);
+    exitHandlerInstalled = true;
+  }
+
+  traceState = TraceState::Open;
+  tracePid = getpid();
+  writeTrace(reinterpret_cast<const uint8_t *>(kTraceMagic),
+             sizeof(kTraceMagic));
+  return traceState == TraceState::Open;
+}
+
+/// Get space for a record in the buffer.
+uint8_t *beginRecord(TraceOp op) {
+  if (traceBufferUsed + kMaxTraceRecordSize > kTraceBufferSize)
+    flushTrace();
+
+  auto *out = traceBuffer + traceBufferUsed;
+  *out++ = op;
+  return out;
+}
+
+void endRecord(const uint8_t *end) { traceBufferUsed = end - traceBuffer; }
+
+uint8_t *encodeOperand(uint8_t *out, SymExpr expr) {
+  auto it = traceIds.find(expr);
+  return encodeVarint(out, (expr == nullptr || it == traceIds.end())
+                               ? 0
+                               : nextTraceId - it->second);
+}
+
+uint8_t *encodeSite(uint8_t *out, uintptr_t siteId) {
+  auto delta = static_cast<int64_t>(siteId - lastSiteId);
+  lastSiteId = siteId;
+  return encodeVarint(out, zigzagEncode(delta));
+}
+
+} // namespace
+
+SymExpr traceExpression(TraceOp op, SymExpr result,
+                        std::initializer_list<SymExpr> operands,
+                        std::initializer_list<uint64_t> values) {
+  assert(traceOpIsExpression(op) &&
+         operands.size() == traceOpArity(op).operands &&
+         values.size() == traceOpArity(op).values && "Malformed trace record");
+  if (result == nullptr)
+    return result;
+
+  statsExpression(op);
+  if (op == TraceOp_get_input_byte)
+    statsInputByte(*values.begin());
+  if (!openTrace())
+    return result;
+
+  auto *out = beginRecord(op);
+  for (auto operand : operands)
+    out = encodeOperand(out, operand);
+  for (auto value : values)
+    out = encodeVarint(out, value);
+  endRecord(out);
+
+  traceIds[result] = nextTraceId++;
+  return result;
+}
+
+void tracePathConstraint(SymExpr constraint, bool taken, uintptr_t siteId) {
+  if (constraint == nullptr)
+    return;
+
+  statsPathConstraint(siteId);
+  if (!openTrace())
+    return;
+
+  auto *out = beginRecord(TraceOp_push_path_constraint);
+  out = encodeOperand(out, constraint);
+  out = encodeVarint(out, taken);
+  out = encodeSite(out, siteId);
+  endRecord(out);
+}
+
+void traceConcretization(TraceOp op, SymExpr expr, uint64_t value,
+                         uintptr_t siteId) {
+  assert((op == TraceOp_concretize_pointer || op == TraceOp_concretize_size) &&
+         "Not a concretization");
+  if (expr == nullptr)
+    return;
+
+  statsConcretization(siteId);
+  if (!openTrace())
+    return;
+
+  auto *out = beginRecord(op);
+  out = encodeOperand(out, expr);
+  out = encodeVarint(out, value);
+  out = encodeSite(out, siteId);
+  endRecord(out);
+}
+
+void traceReset() {
+  // A new process doesn't need to mark the beginning.
+  if (traceState != TraceState::Open || tracePid != getpid())
+    return;
+
+  endRecord(beginRecord(TraceOp_reset));
+}
@@ -0,0 +1,65 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <initializer_list>
+
+#include <Runtime.h>
+
+#include "TraceFormat.h"
+
+//
+// Recording of execution traces
+//
+// If SYMCC_TRACE_FILE is set, the backend records every expression, input
+// byte, path constraint and concretization in the file (see TraceFormat.h for
+// the format), so that the constraints can be solved later and elsewhere (see
+// symcc_trace_replay in TraceReplay.cpp). Backends call the functions below
+// after creating an expression or before handling a constraint; the functions
+// also count for the runtime statistics (see Stats.h) and do nothing unless
+// recording or statistics are enabled. If a backend implements an operation in
+// terms of other runtime functions, the trace contains those expressions as
+// well, which is harmless.
+//
+// The recorder buffers records in memory and writes them when the buffer is
+// full and when the program exits. It opens the file with the first record; a
+// "%p" in the file name stands for the process ID, which keeps the traces of
+// forked processes apart (e.g., with a fork server). If the file name ends in
+// ".gz", the trace is compressed (if the runtime was built with zlib).
+//
+// All functions require the backend lock.
+//
+
+/// Record the creation of an expression, returning the expression.
+///
+/// The operands and values must match traceOpArity.
+SymExpr traceExpression(TraceOp op, SymExpr result,
+                        std::initializer_list<SymExpr> operands = {},
+                        std::initializer_list<uint64_t> values = {});
+
+/// Record a path constraint.
+void tracePathConstraint(SymExpr constraint, bool taken, uintptr_t siteId);
+
+/// Record a concretization (TraceOp_concretize_pointer or
+/// TraceOp_concretize_size).
+void traceConcretization(TraceOp op, SymExpr expr, uint64_t value,
+                         uintptr_t siteId);
+
+/// Record the start of a new execution (see symcc_reset).
+void traceReset();
+
+#endif
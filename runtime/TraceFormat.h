@@ -0,0 +1,228 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TRACEFORMAT_H
+#define TRACEFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+//
+// The binary format of execution traces (see Trace.h)
+//
+// A trace starts with kTraceMagic, followed by a sequence of records. Each
+// record is an opcode byte, followed by the IDs of its operand expressions and
+// then its constant values; traceOpArity tells how many of each there are.
+// All numbers are LEB128-style varints.
+//
+// Records of expressions implicitly define the expression's ID: the first
+// expression in the trace has ID 1, the next one 2, and so on. Operands are
+// encoded as the distance from the ID of the next expression, i.e., 1 refers
+// to the previous expression; 0 stands for an operand that the recorder
+// doesn't know (e.g., a concrete value). Site IDs of path constraints and
+// concretizations are encoded as the zigzag-encoded difference from the
+// previous site ID in the trace. A reset starts a new execution on a new input
+// but keeps the expression IDs.
+//
+// Since records are self-delimiting, a reader can make use of a trace that
+// ends abruptly (e.g., because the program crashed).
+//
+
+/// The bytes at the start of every trace, including the format version.
+constexpr char kTraceMagic[8] = {'S', 'y', 'm', 'T', 'r', 'a', 'c', '1'};
+
+/// Record types, named after the runtime functions that produce them.
+///
+/// Unless noted otherwise, the operands and values are those of the function.
+/// The numbering is part of the format; only append.
+enum TraceOp : uint8_t {
+  TraceOp_integer,        // values: value, bits
+  TraceOp_integer128,     // values: high, low
+  TraceOp_float,          // values: bits of the value as a double, is_double
+  TraceOp_null_pointer,   // values: bits
+  TraceOp_true,
+  TraceOp_false,
+  TraceOp_bool,           // values: value
+  TraceOp_get_input_byte, // values: offset, value
+
+  TraceOp_neg,
+  TraceOp_add,
+  TraceOp_sub,
+  TraceOp_mul,
+  TraceOp_unsigned_div,
+  TraceOp_signed_div,
+  TraceOp_unsigned_rem,
+  TraceOp_signed_rem,
+  TraceOp_shift_left,
+  TraceOp_logical_shift_right,
+  TraceOp_arithmetic_shift_right,
+
+  TraceOp_fp_add,
+  TraceOp_fp_sub,
+  TraceOp_fp_mul,
+  TraceOp_fp_div,
+  TraceOp_fp_rem,
+  TraceOp_fp_abs,
+
+  TraceOp_not,
+  TraceOp_signed_less_than,
+  TraceOp_signed_less_equal,
+  TraceOp_signed_greater_than,
+  TraceOp_signed_greater_equal,
+  TraceOp_unsigned_less_than,
+  TraceOp_unsigned_less_equal,
+  TraceOp_unsigned_greater_than,
+  TraceOp_unsigned_greater_equal,
+  TraceOp_equal,
+  TraceOp_not_equal,
+  TraceOp_bool_and,
+  TraceOp_and,
+  TraceOp_bool_or,
+  TraceOp_or,
+  TraceOp_bool_xor,
+  TraceOp_xor,
+
+  TraceOp_float_ordered_greater_than,
+  TraceOp_float_ordered_greater_equal,
+  TraceOp_float_ordered_less_than,
+  TraceOp_float_ordered_less_equal,
+  TraceOp_float_ordered_equal,
+  TraceOp_float_ordered_not_equal,
+  TraceOp_float_ordered,
+  TraceOp_float_unordered,
+  TraceOp_float_unordered_greater_than,
+  TraceOp_float_unordered_greater_equal,
+  TraceOp_float_unordered_less_than,
+  TraceOp_float_unordered_less_equal,
+  TraceOp_float_unordered_equal,
+  TraceOp_float_unordered_not_equal,
+
+  TraceOp_sext,                      // values: bits
+  TraceOp_zext,                      // values: bits
+  TraceOp_trunc,                     // values: bits
+  TraceOp_int_to_float,              // values: is_double, is_signed
+  TraceOp_float_to_float,            // values: to_double
+  TraceOp_bits_to_float,             // values: to_double
+  TraceOp_float_to_bits,
+  TraceOp_float_to_signed_integer,   // values: bits
+  TraceOp_float_to_unsigned_integer, // values: bits
+  TraceOp_bool_to_bit,
+
+  TraceOp_concat_helper,
+  TraceOp_extract_helper, // values: first_bit, last_bit
+
+  // The following records don't define expressions.
+
+  TraceOp_push_path_constraint, // values: taken, site ID
+  TraceOp_concretize_pointer,   // values: pointer, site ID
+  TraceOp_concretize_size,      // values: size, site ID
+  TraceOp_reset,
+
+  TraceOp_count
+};
+
+/// The shape of a record.
+struct TraceOpArity {
+  uint8_t operands;
+  uint8_t values;
+};
+
+constexpr TraceOpArity traceOpArity(TraceOp op) {
+  switch (op) {
+  case TraceOp_true:
+  case TraceOp_false:
+  case TraceOp_reset:
+    return {0, 0};
+  case TraceOp_null_pointer:
+  case TraceOp_bool:
+    return {0, 1};
+  case TraceOp_integer:
+  case TraceOp_integer128:
+  case TraceOp_float:
+  case TraceOp_get_input_byte:
+    return {0, 2};
+  case TraceOp_neg:
+  case TraceOp_fp_abs:
+  case TraceOp_not:
+  case TraceOp_float_to_bits:
+  case TraceOp_bool_to_bit:
+    return {1, 0};
+  case TraceOp_sext:
+  case TraceOp_zext:
+  case TraceOp_trunc:
+  case TraceOp_float_to_float:
+  case TraceOp_bits_to_float:
+  case TraceOp_float_to_signed_integer:
+  case TraceOp_float_to_unsigned_integer:
+    return {1, 1};
+  case TraceOp_int_to_float:
+  case TraceOp_extract_helper:
+  case TraceOp_push_path_constraint:
+  case TraceOp_concretize_pointer:
+  case TraceOp_concretize_size:
+    return {1, 2};
+  default:
+    // Binary operations
+    return {2, 0};
+  }
+}
+
+/// Does the record define an expression?
+constexpr bool traceOpIsExpression(TraceOp op) {
+  return op < TraceOp_push_path_constraint;
+}
+
+/// Does the record carry a site ID (as its last value)?
+constexpr bool traceOpHasSite(TraceOp op) {
+  return op == TraceOp_push_path_constraint ||
+         op == TraceOp_concretize_pointer || op == TraceOp_concretize_size;
+}
+
+/// The maximum encoded size of a record.
+constexpr size_t kMaxTraceRecordSize = 1 + 4 * 10;
+
+/// Encode a varint; return the position after it.
+inline uint8_t *encodeVarint(uint8_t *out, uint64_t value) {
+  while (value >= 0x80) {
+    *out++ = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  *out++ = static_cast<uint8_t>(value);
+  return out;
+}
+
+/// Decode a varint; return the position after it, or null if the input ends
+/// before the varint does.
+inline const uint8_t *decodeVarint(const uint8_t *in, const uint8_t *end,
+                                   uint64_t &value) {
+  value = 0;
+  for (unsigned shift = 0; in != end && shift < 64; shift += 7) {
+    auto byte = *in++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return in;
+  }
+  return nullptr;
+}
+
+inline uint64_t zigzagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+#endif
@@ -0,0 +1,678 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+//
+// Solve the path constraints of recorded execution traces (see Trace.h).
+//
+// The tool rebuilds the expressions of each trace in Z3 and, for every path
+// constraint, looks for an input that takes the other direction while
+// satisfying all earlier constraints (including concretizations), just like
+// the simple backend does during execution. The queries are independent, so
+// worker threads with their own Z3 contexts take them in order; each worker
+// keeps the constraints that it has asserted for an execution and only adds
+// the ones in between. New inputs go to the output directory, without
+// duplicates.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <unistd.h>
+
+#include <z3.h>
+
+#ifdef SYMCC_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "TraceFormat.h"
+
+namespace {
+
+/// An expression in a trace; operands are IDs (0 if unknown).
+struct Node {
+  TraceOp op;
+  uint64_t operands[2];
+  uint64_t values[2];
+};
+
+/// A path constraint or concretization.
+struct Constraint {
+  TraceOp op;
+  uint64_t expr;
+
+  /// Whether the branch was taken, or the concrete value.
+  uint64_t value;
+
+  uintptr_t siteId;
+};
+
+/// The part of a trace between two resets.
+struct Execution {
+  std::vector<Constraint> constraints;
+
+  /// The input bytes that the program read, indexed by offset; bytes that it
+  /// didn't read are zero.
+  std::string input;
+};
+
+struct Trace {
+  std::string fileName;
+
+  /// The expressions, indexed by ID (starting at 1).
+  std::vector<Node> nodes{1};
+
+  std::vector<Execution> executions{1};
+};
+
+/// A query: try to invert one path constraint.
+struct Query {
+  const Trace *trace;
+  const Execution *execution;
+  size_t constraint;
+};
+
+struct Options {
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  std::string outputDir = "/tmp/output";
+  unsigned timeoutMs = 10000;
+};
+
+std::string readFile(const std::string &fileName) {
+#ifdef SYMCC_HAVE_ZLIB
+  // zlib reads uncompressed files transparently.
+  auto *file = gzopen(fileName.c_str(), "rb");
+  if (file == nullptr)
+    throw std::runtime_error("Failed to open " + fileName);
+
+  std::string contents;
+  char buffer[1 << 16];
+  int read;
+  while ((read = gzread(file, buffer, sizeof(buffer))) > 0)
+    contents.append(buffer, read);
+  gzclose(file);
+  if (read < 0)
+    throw std::runtime_error("Failed to read " + fileName);
+  return contents;
+#else
+  std::ifstream stream(fileName, std::ios::binary);
+  if (!stream)
+    throw std::runtime_error("Failed to open " + fileName);
+  return {std::istreambuf_iterator<char>(stream),
+          std::istreambuf_iterator<char>()};
+#endif
+}
+
+Trace parseTrace(const std::string &fileName) {
+  auto contents = readFile(fileName);
+  if (contents.size() < sizeof(kTraceMagic) ||
+      memcmp(contents.data(), kTraceMagic, sizeof(kTraceMagic)) != 0)
+    throw std::runtime_error(fileName + " is not a SymCC trace");
+
+  Trace trace;
+  trace.fileName = fileName;
+  auto *in = reinterpret_cast<const uint8_t *>(contents.data()) +
+             sizeof(kTraceMagic);
+  auto *end = reinterpret_cast<const uint8_t *>(contents.data()) +
+              contents.size();
+  uintptr_t lastSiteId = 0;
+
+  while (in != end) {
+    auto op = static_cast<TraceOp>(*in++);
+    if (op >= TraceOp_count) {
+      std::cerr << "Warning: " << fileName
+                << " contains an unknown record; ignoring the rest" << std::endl;
+      break;
+    }
+
+    auto arity = traceOpArity(op);
+    uint64_t fields[4];
+    bool complete = true;
+    for (unsigned i = 0; i < arity.operands + arity.values; i++) {
+      in = decodeVarint(in, end, fields[i]);
+      if (in == nullptr) {
+        complete = false;
+        break;
+      }
+    }
+    if (!complete) {
+      std::cerr << "Warning: " << fileName << " ends in the middle of a record"
+                << std::endl;
+      break;
+    }
+
+    // Resolve operand distances to IDs.
+    uint64_t nextId = trace.nodes.size();
+    for (unsigned i = 0; i < arity.operands; i++)
+      fields[i] = (fields[i] == 0 || fields[i] >= nextId) ? 0
+                                                          : nextId - fields[i];
+    auto *values = fields + arity.operands;
+    if (traceOpHasSite(op)) {
+      lastSiteId += zigzagDecode(values[1]);
+      values[1] = lastSiteId;
+    }
+
+    auto &execution = trace.executions.back();
+    if (traceOpIsExpression(op)) {
+      Node node{op, {0, 0}, {0, 0}};
+      std::copy(fields, fields + arity.operands, node.operands);
+      std::copy(values, values + arity.values, node.values);
+      trace.nodes.push_back(node);
+
+      if (op == TraceOp_get_input_byte) {
+        auto offset = values[0];
+        if (offset >= execution.input.size())
+          execution.input.resize(offset + 1);
+        execution.input[offset] = static_cast<char>(values[1]);
+      }
+    } else if (op == TraceOp_reset) {
+      trace.executions.emplace_back();
+    } else {
+      execution.constraints.push_back({op, fields[0], values[0], values[1]});
+    }
+  }
+
+  return trace;
+}
+
+/// Remember Z3 errors instead of aborting; we skip the affected query.
+thread_local bool z3ErrorOccurred = false;
+
+void handleZ3Error(Z3_context context, Z3_error_code error) {
+  std::cerr << "Z3 error: " << Z3_get_error_msg(context, error) << std::endl;
+  z3ErrorOccurred = true;
+}
+
+/// The state of a worker thread.
+class Solver {
+public:
+  explicit Solver(const Options &options) {
+    auto *config = Z3_mk_config();
+    Z3_set_param_value(config, "model", "true");
+    Z3_set_param_value(config, "timeout",
+                       std::to_string(options.timeoutMs).c_str());
+    context = Z3_mk_context(config);
+    Z3_del_config(config);
+    Z3_set_error_handler(context, handleZ3Error);
+
+    solver = Z3_mk_solver(context);
+    Z3_solver_inc_ref(context, solver);
+    roundingMode = Z3_mk_fpa_round_nearest_ties_to_even(context);
+  }
+
+  ~Solver() {
+    Z3_solver_dec_ref(context, solver);
+    Z3_del_context(context);
+  }
+
+  Solver(const Solver &) = delete;
+  Solver &operator=(const Solver &) = delete;
+
+  /// Try to invert the query's constraint; return a new input on success.
+  std::optional<std::string> solve(const Query &query) {
+    if (query.trace != trace) {
+      trace = query.trace;
+      asts.assign(trace->nodes.size(), nullptr);
+      built.assign(trace->nodes.size(), false);
+      execution = nullptr;
+    }
+    if (query.execution != execution) {
+      execution = query.execution;
+      asserted = 0;
+      Z3_solver_reset(context, solver);
+    }
+
+    z3ErrorOccurred = false;
+    for (; asserted < query.constraint; asserted++) {
+      if (auto *constraint = pathConstraint(asserted))
+        Z3_solver_assert(context, solver, constraint);
+    }
+
+    auto &constraint = execution->constraints[query.constraint];
+    auto *expr = build(constraint.expr);
+    if (expr == nullptr || z3ErrorOccurred)
+      return {};
+    expr = Z3_simplify(context, expr);
+    if (Z3_is_eq_ast(context, expr, Z3_mk_true(context)) ||
+        Z3_is_eq_ast(context, expr, Z3_mk_false(context)))
+      return {};
+
+    Z3_solver_push(context, solver);
+    Z3_solver_assert(context, solver,
+                     constraint.value ? Z3_mk_not(context, expr) : expr);
+    auto result = Z3_solver_check(context, solver);
+    std::optional<std::string> input;
+    if (result == Z3_L_TRUE && !z3ErrorOccurred)
+      input = extractInput(Z3_solver_get_model(context, solver));
+    else if (result == Z3_L_UNDEF)
+      unknown++;
+    Z3_solver_pop(context, solver, 1);
+    return input;
+  }
+
+  /// The number of queries that the solver couldn't decide.
+  size_t unknown = 0;
+
+private:
+  Z3_context context;
+  Z3_solver solver;
+  Z3_ast roundingMode;
+
+  const Trace *trace = nullptr;
+  std::vector<Z3_ast> asts;
+  std::vector<bool> built;
+
+  const Execution *execution = nullptr;
+
+  /// The number of the execution's constraints in the solver.
+  size_t asserted = 0;
+
+  /// The constraint at the given index in the direction that the execution
+  /// took, or null if we can't express it.
+  Z3_ast pathConstraint(size_t index) {
+    auto &constraint = execution->constraints[index];
+    auto *expr = build(constraint.expr);
+    if (expr == nullptr)
+      return nullptr;
+
+    if (constraint.op == TraceOp_push_path_constraint)
+      return constraint.value ? expr : Z3_mk_not(context, expr);
+
+    auto *sort = Z3_get_sort(context, expr);
+    if (Z3_get_sort_kind(context, sort) != Z3_BV_SORT)
+      return nullptr;
+    return Z3_mk_eq(context, expr,
+                    Z3_mk_unsigned_int64(context, constraint.value, sort));
+  }
+
+  /// Get the Z3 expression for a trace expression, building it (and its
+  /// operands) if necessary.
+  Z3_ast build(uint64_t id) {
+    if (id == 0 || id >= asts.size())
+      return nullptr;
+
+    // Expressions can be deep, so we avoid recursion.
+    std::vector<uint64_t> pending{id};
+    while (!pending.empty()) {
+      auto current = pending.back();
+      if (built[current]) {
+        pending.pop_back();
+        continue;
+      }
+
+      auto &node = trace->nodes[current];
+      bool ready = true;
+      for (unsigned i = 0; i < traceOpArity(node.op).operands; i++) {
+        auto operand = node.operands[i];
+        if (operand != 0 && !built[operand]) {
+          pending.push_back(operand);
+          ready = false;
+        }
+      }
+      if (!ready)
+        continue;
+
+      pending.pop_back();
+      asts[current] = makeAst(node, asts[node.operands[0]],
+                              asts[node.operands[1]]);
+      built[current] = true;
+    }
+
+    return asts[id];
+  }
+
+  Z3_sort bvSort(uint64_t bits) { return Z3_mk_bv_sort(context, bits); }
+
+  Z3_sort floatSort(bool isDouble) {
+    return isDouble ? Z3_mk_fpa_sort_double(context)
+                    : Z3_mk_fpa_sort_single(context);
+  }
+
+  Z3_ast inputByte(uint64_t offset) {
+    auto name = "stdin" + std::to_string(offset);
+    return Z3_mk_const(context, Z3_mk_string_symbol(context, name.c_str()),
+                       bvSort(8));
+  }
+
+  bool isBool(Z3_ast expr) {
+    return Z3_get_sort_kind(context, Z3_get_sort(context, expr)) ==
+           Z3_BOOL_SORT;
+  }
+
+  Z3_ast mkOr(Z3_ast a, Z3_ast b, Z3_ast c = nullptr) {
+    Z3_ast operands[] = {a, b, c};
+    return Z3_mk_or(context, c == nullptr ? 2 : 3, operands);
+  }
+
+  Z3_ast isUnordered(Z3_ast a, Z3_ast b) {
+    return mkOr(Z3_mk_fpa_is_nan(context, a), Z3_mk_fpa_is_nan(context, b));
+  }
+
+  /// Build an expression like the simple backend does.
+  Z3_ast makeAst(const Node &node, Z3_ast a, Z3_ast b) {
+    auto arity = traceOpArity(node.op);
+    if ((arity.operands > 0 && a == nullptr) ||
+        (arity.operands > 1 && b == nullptr))
+      return nullptr;
+
+    auto *ctx = context;
+    auto value = node.values[0];
+    auto value2 = node.values[1];
+
+    switch (node.op) {
+    case TraceOp_integer:
+      return Z3_mk_unsigned_int64(ctx, value, bvSort(value2));
+    case TraceOp_integer128:
+      return Z3_mk_concat(ctx, Z3_mk_unsigned_int64(ctx, value, bvSort(64)),
+                          Z3_mk_unsigned_int64(ctx, value2, bvSort(64)));
+    case TraceOp_float: {
+      double d;
+      memcpy(&d, &value, sizeof(d));
+      return Z3_mk_fpa_numeral_double(ctx, d, floatSort(value2));
+    }
+    case TraceOp_null_pointer:
+      return Z3_mk_unsigned_int64(ctx, 0, bvSort(value));
+    case TraceOp_true:
+      return Z3_mk_true(ctx);
+    case TraceOp_false:
+      return Z3_mk_false(ctx);
+    case TraceOp_bool:
+      return value ? Z3_mk_true(ctx) : Z3_mk_false(ctx);
+    case TraceOp_get_input_byte:
+      return inputByte(value);
+
+    case TraceOp_neg:
+      return Z3_mk_bvneg(ctx, a);
+    case TraceOp_add:
+      return Z3_mk_bvadd(ctx, a, b);
+    case TraceOp_sub:
+      return Z3_mk_bvsub(ctx, a, b);
+    case TraceOp_mul:
+      return Z3_mk_bvmul(ctx, a, b);
+    case TraceOp_unsigned_div:
+      return Z3_mk_bvudiv(ctx, a, b);
+    case TraceOp_signed_div:
+      return Z3_mk_bvsdiv(ctx, a, b);
+    case TraceOp_unsigned_rem:
+      return Z3_mk_bvurem(ctx, a, b);
+    case TraceOp_signed_rem:
+      return Z3_mk_bvsrem(ctx, a, b);
+    case TraceOp_shift_left:
+      return Z3_mk_bvshl(ctx, a, b);
+    case TraceOp_logical_shift_right:
+      return Z3_mk_bvlshr(ctx, a, b);
+    case TraceOp_arithmetic_shift_right:
+      return Z3_mk_bvashr(ctx, a, b);
+
+    case TraceOp_fp_add:
+      return Z3_mk_fpa_add(ctx, roundingMode, a, b);
+    case TraceOp_fp_sub:
+      return Z3_mk_fpa_sub(ctx, roundingMode, a, b);
+    case TraceOp_fp_mul:
+      return Z3_mk_fpa_mul(ctx, roundingMode, a, b);
+    case TraceOp_fp_div:
+      return Z3_mk_fpa_div(ctx, roundingMode, a, b);
+    case TraceOp_fp_rem:
+      return Z3_mk_fpa_rem(ctx, a, b);
+    case TraceOp_fp_abs:
+      return Z3_mk_fpa_abs(ctx, a);
+
+    case TraceOp_not:
+      return isBool(a) ? Z3_mk_not(ctx, a) : Z3_mk_bvnot(ctx, a);
+    case TraceOp_signed_less_than:
+      return Z3_mk_bvslt(ctx, a, b);
+    case TraceOp_signed_less_equal:
+      return Z3_mk_bvsle(ctx, a, b);
+    case TraceOp_signed_greater_than:
+      return Z3_mk_bvsgt(ctx, a, b);
+    case TraceOp_signed_greater_equal:
+      return Z3_mk_bvsge(ctx, a, b);
+    case TraceOp_unsigned_less_than:
+      return Z3_mk_bvult(ctx, a, b);
+    case TraceOp_unsigned_less_equal:
+      return Z3_mk_bvule(ctx, a, b);
+    case TraceOp_unsigned_greater_than:
+      return Z3_mk_bvugt(ctx, a, b);
+    case TraceOp_unsigned_greater_equal:
+      return Z3_mk_bvuge(ctx, a, b);
+    case TraceOp_equal:
+      return Z3_mk_eq(ctx, a, b);
+    case TraceOp_not_equal:
+      return Z3_mk_not(ctx, Z3_mk_eq(ctx, a, b));
+    case TraceOp_bool_and: {
+      Z3_ast operands[] = {a, b};
+      return Z3_mk_and(ctx, 2, operands);
+    }
+    case TraceOp_and:
+      return Z3_mk_bvand(ctx, a, b);
+    case TraceOp_bool_or:
+      return mkOr(a, b);
+    case TraceOp_or:
+      return Z3_mk_bvor(ctx, a, b);
+    case TraceOp_bool_xor:
+      return Z3_mk_xor(ctx, a, b);
+    case TraceOp_xor:
+      return Z3_mk_bvxor(ctx, a, b);
+
+    case TraceOp_float_ordered_greater_than:
+      return Z3_mk_fpa_gt(ctx, a, b);
+    case TraceOp_float_ordered_greater_equal:
+      return Z3_mk_fpa_geq(ctx, a, b);
+    case TraceOp_float_ordered_less_than:
+      return Z3_mk_fpa_lt(ctx, a, b);
+    case TraceOp_float_ordered_less_equal:
+      return Z3_mk_fpa_leq(ctx, a, b);
+    case TraceOp_float_ordered_equal:
+      return Z3_mk_fpa_eq(ctx, a, b);
+    case TraceOp_float_ordered_not_equal:
+      return Z3_mk_not(ctx, Z3_mk_fpa_eq(ctx, a, b));
+    case TraceOp_float_ordered:
+      return Z3_mk_not(ctx, isUnordered(a, b));
+    case TraceOp_float_unordered:
+      return isUnordered(a, b);
+    case TraceOp_float_unordered_greater_than:
+      return mkOr(isUnordered(a, b), Z3_mk_fpa_gt(ctx, a, b));
+    case TraceOp_float_unordered_greater_equal:
+      return mkOr(isUnordered(a, b), Z3_mk_fpa_geq(ctx, a, b));
+    case TraceOp_float_unordered_less_than:
+      return mkOr(isUnordered(a, b), Z3_mk_fpa_lt(ctx, a, b));
+    case TraceOp_float_unordered_less_equal:
+      return mkOr(isUnordered(a, b), Z3_mk_fpa_leq(ctx, a, b));
+    case TraceOp_float_unordered_equal:
+      return mkOr(isUnordered(a, b), Z3_mk_fpa_eq(ctx, a, b));
+    case TraceOp_float_unordered_not_equal:
+      return mkOr(isUnordered(a, b), Z3_mk_not(ctx, Z3_mk_fpa_eq(ctx, a, b)));
+
+    case TraceOp_sext:
+      return Z3_mk_sign_ext(ctx, value, a);
+    case TraceOp_zext:
+      return Z3_mk_zero_ext(ctx, value, a);
+    case TraceOp_trunc:
+      return Z3_mk_extract(ctx, value - 1, 0, a);
+    case TraceOp_int_to_float:
+      return value2
+                 ? Z3_mk_fpa_to_fp_signed(ctx, roundingMode, a, floatSort(value))
+                 : Z3_mk_fpa_to_fp_unsigned(ctx, roundingMode, a,
+                                            floatSort(value));
+    case TraceOp_float_to_float:
+      return Z3_mk_fpa_to_fp_float(ctx, roundingMode, a, floatSort(value));
+    case TraceOp_bits_to_float:
+      return Z3_mk_fpa_to_fp_bv(ctx, a, floatSort(value));
+    case TraceOp_float_to_bits:
+      return Z3_mk_fpa_to_ieee_bv(ctx, a);
+    case TraceOp_float_to_signed_integer:
+      return Z3_mk_fpa_to_sbv(ctx, Z3_mk_fpa_round_toward_zero(ctx), a, value);
+    case TraceOp_float_to_unsigned_integer:
+      return Z3_mk_fpa_to_ubv(ctx, Z3_mk_fpa_round_toward_zero(ctx), a, value);
+    case TraceOp_bool_to_bit:
+      return Z3_mk_ite(ctx, a, Z3_mk_unsigned_int64(ctx, 1, bvSort(1)),
+                       Z3_mk_unsigned_int64(ctx, 0, bvSort(1)));
+
+    case TraceOp_concat_helper:
+      return Z3_mk_concat(ctx, a, b);
+    case TraceOp_extract_helper:
+      return Z3_mk_extract(ctx, value, value2, a);
+
+    default:
+      return nullptr;
+    }
+  }
+
+  /// Patch the execution's input with the values from the model.
+  std::string extractInput(Z3_model model) {
+    Z3_model_inc_ref(context, model);
+    auto input = execution->input;
+    for (size_t offset = 0; offset < input.size(); offset++) {
+      Z3_ast value;
+      uint64_t byte;
+      if (Z3_model_eval(context, model, inputByte(offset), false, &value) &&
+          Z3_get_numeral_uint64(context, value, &byte))
+        input[offset] = static_cast<char>(byte);
+    }
+    Z3_model_dec_ref(context, model);
+    return input;
+  }
+};
+
+/// Collects the results of all workers.
+class Output {
+public:
+  explicit Output(std::string directory) : directory(std::move(directory)) {}
+
+  void save(const std::string &input) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!known.insert(std::hash<std::string>{}(input)).second)
+      return;
+
+    std::stringstream name;
+    name << directory << "/" << std::setw(6) << std::setfill('0') << written++;
+    std::ofstream stream(name.str(), std::ios::binary);
+    stream.write(input.data(), input.size());
+    if (!stream)
+      std::cerr << "Warning: failed to write " << name.str() << std::endl;
+  }
+
+  unsigned written = 0;
+
+private:
+  std::string directory;
+  std::mutex mutex;
+  std::unordered_set<size_t> known;
+};
+
+void usage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " [-j JOBS] [-o OUTPUT_DIR] [-t TIMEOUT_MS] TRACE..." << std::endl
+            << std::endl
+            << "Solve the path constraints in traces recorded with "
+               "SYMCC_TRACE_FILE, writing new"
+            << std::endl
+            << "inputs to OUTPUT_DIR (default /tmp/output)." << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "j:o:t:h")) != -1) {
+    switch (opt) {
+    case 'j':
+      options.jobs = std::max(1, atoi(optarg));
+      break;
+    case 'o':
+      options.outputDir = optarg;
+      break;
+    case 't':
+      options.timeoutMs = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind == argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<Trace> traces;
+  try {
+    for (int i = optind; i < argc; i++)
+      traces.push_back(parseTrace(argv[i]));
+  } catch (std::runtime_error &error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+
+  // Queries of the same execution are adjacent and in order, so that each
+  // worker can keep adding to its path constraints.
+  std::vector<Query> queries;
+  for (auto &trace : traces) {
+    size_t numConstraints = 0;
+    for (auto &execution : trace.executions) {
+      for (size_t i = 0; i < execution.constraints.size(); i++) {
+        if (execution.constraints[i].op == TraceOp_push_path_constraint)
+          queries.push_back({&trace, &execution, i});
+      }
+      numConstraints += execution.constraints.size();
+    }
+    std::cerr << trace.fileName << ": " << trace.nodes.size() - 1
+              << " expressions, " << numConstraints << " constraints in "
+              << trace.executions.size() << " execution(s)" << std::endl;
+  }
+
+  Output output(options.outputDir);
+  std::atomic<size_t> nextQuery{0};
+  std::atomic<size_t> solved{0}, unknown{0};
+  auto work = [&] {
+    Solver solver(options);
+    for (size_t i; (i = nextQuery++) < queries.size();) {
+      if (auto input = solver.solve(queries[i])) {
+        solved++;
+        output.save(*input);
+      }
+    }
+    unknown += solver.unknown;
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < options.jobs; i++)
+    workers.emplace_back(work);
+  work();
+  for (auto &worker : workers)
+    worker.join();
+
+  std::cerr << "Inverted " << solved << " of " << queries.size()
+            << " path constraints (" << unknown << " undecided); "
+            << output.written << " new inputs in " << options.outputDir
+            << std::endl;
+  return 0;
+}
@@ -29,6 +29,7 @@
 #endif
 
 #include <atomic>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <iterator>
@@ -44,10 +45,6 @@
 #include <experimental/filesystem>
 #endif
 
-#ifdef DEBUG_RUNTIME
-#include <chrono>
-#endif
-
 // C
 #include <cstdint>
 #include <cstdio>
@@ -63,9 +60,14 @@
 #include <llvm/ADT/ArrayRef.h>
 
 // Runtime
+#include <BackendLock.h>
 #include <Config.h>
+#include <ForkServer.h>
 #include <LibcWrappers.h>
+#include <OutputRing.h>
 #include <Shadow.h>
+#include <Stats.h>
+#include <Trace.h>
 
 namespace qsym {
 
@@ -99,6 +101,7 @@ SymExpr registerExpression(const qsym::ExprRef &expr) {
     // We don't know this expression yet. Create a copy of the shared pointer to
     // keep the expression alive.
     allocatedExpressions[rawExpr] = expr;
+    statsLiveExpressions(allocatedExpressions.size());
   }
 
   return rawExpr;
@@ -128,6 +131,64 @@ public:
 
     inputs_[offset] = value;
   }
+
+  /// Add a constraint like addJcc.
+  ///
+  /// This is Qsym's addJcc, except that we record every solver query with its
+  /// result in the statistics (Qsym's own version doesn't tell us whether a
+  /// failed query was unsatisfiable or timed out), and that we pass new test
+  /// cases to saveTestCase, which puts them in the output ring if there is one
+  /// instead of writing a file per test case.
+  void addJccAndSave(qsym::ExprRef e, bool taken, uintptr_t siteId) {
+    last_pc_ = siteId;
+    if (e->isConcrete())
+      return;
+
+    // A constant constraint doesn't tell us anything.
+    if (e->kind() == qsym::Bool)
+      return;
+
+    // Qsym skips branches that it has seen too often; a site ID of 0 means
+    // that the constraint belongs to the previous branch.
+    bool isInteresting =
+        (siteId == 0) ? last_interested_ : isInterestingJcc(e, taken, siteId);
+    if (isInteresting)
+      negatePathAndSave(e, taken, siteId);
+    addConstraint(e, taken, isInteresting);
+  }
+
+private:
+  /// Try to negate the constraint under the current path constraints, and
+  /// if that fails, on its own (Qsym's "optimistic solving").
+  void negatePathAndSave(qsym::ExprRef e, bool taken, uintptr_t siteId) {
+    reset();
+    syncConstraints(e);
+    addToSolver(e, !taken);
+    if (solveAndSave(siteId))
+      return;
+
+    reset();
+    addToSolver(e, !taken);
+    solveAndSave(siteId);
+  }
+
+  /// Query the solver and save the test case if there is a solution.
+  bool solveAndSave(uintptr_t siteId) {
+    statsSolverStart();
+    auto start = std::chrono::steady_clock::now();
+    auto result = check();
+    statsSolverQuery(siteId,
+                     result == z3::sat     ? SolverResult::Sat
+                     : result == z3::unsat ? SolverResult::Unsat
+                                           : SolverResult::Unknown,
+                     std::chrono::steady_clock::now() - start);
+    if (result != z3::sat)
+      return false;
+
+    auto values = getConcreteValues();
+    saveTestCase(std::string(values.begin(), values.end()));
+    return true;
+  }
 };
 
 EnhancedQsymSolver *g_enhanced_solver;
@@ -157,17 +218,23 @@ handler()
 }
 
 void _sym_initialize(void) {
+  // Not a BackendLock because we need to release the lock before starting the
+  // fork server (the children couldn't unlock it).
+  std::unique_lock lock{g_backend_mutex};
   if (g_initialized.test_and_set())
     return;
 
   std::set_terminate(handler);
   loadConfig();
+  initStats();
   initLibcWrappers();
   std::cerr << "This is SymCC running with the QSYM backend" << std::endl;
   if (std::holds_alternative<NoInput>(g_config.input)) {
     std::cerr
         << "Performing fully concrete execution (i.e., without symbolic input)"
         << std::endl;
+    lock.unlock();
+    runForkServer();
     return;
   }
 
@@ -185,52 +252,73 @@ void _sym_initialize(void) {
   g_solver = g_enhanced_solver; // for Qsym-internal use
   g_expr_builder = g_config.pruning ? PruneExprBuilder::create()
                                     : SymbolicExprBuilder::create();
+
+  lock.unlock();
+  runForkServer();
 }
 
 SymExpr _sym_build_integer(uint64_t value, uint8_t bits) {
+  BackendLock lock;
   // Qsym's API takes uintptr_t, so we need to be careful when compiling for
   // 32-bit systems: the compiler would helpfully truncate our uint64_t to fit
   // into 32 bits.
+  SymExpr result;
   if constexpr (sizeof(uint64_t) == sizeof(uintptr_t)) {
     // 64-bit case: all good.
-    return registerExpression(g_expr_builder->createConstant(value, bits));
+    result = registerExpression(g_expr_builder->createConstant(value, bits));
   } else {
     // 32-bit case: use the regular API if possible, otherwise create an
     // llvm::APInt.
     if (uintptr_t value32 = value; value32 == value)
-      return registerExpression(g_expr_builder->createConstant(value32, bits));
-
-    return registerExpression(
-        g_expr_builder->createConstant({64, value}, bits));
+      result =
+          registerExpression(g_expr_builder->createConstant(value32, bits));
+    else
+      result = registerExpression(
+          g_expr_builder->createConstant({64, value}, bits));
   }
+  return traceExpression(TraceOp_integer, result, {}, {value, bits});
 }
 
 SymExpr _sym_build_integer128(uint64_t high, uint64_t low) {
+  BackendLock lock;
   std::array<uint64_t, 2> words = {low, high};
-  return registerExpression(g_expr_builder->createConstant({128, words}, 128));
+  auto *result =
+      registerExpression(g_expr_builder->createConstant({128, words}, 128));
+  return traceExpression(TraceOp_integer128, result, {}, {high, low});
 }
 
 SymExpr _sym_build_null_pointer() {
-  return registerExpression(
+  BackendLock lock;
+  auto *result = registerExpression(
       g_expr_builder->createConstant(0, sizeof(uintptr_t) * 8));
+  return traceExpression(TraceOp_null_pointer, result, {},
+                         {sizeof(uintptr_t) * 8});
 }
 
 SymExpr _sym_build_true() {
-  return registerExpression(g_expr_builder->createTrue());
+  BackendLock lock;
+  return traceExpression(TraceOp_true,
+                         registerExpression(g_expr_builder->createTrue()));
 }
 
 SymExpr _sym_build_false() {
-  return registerExpression(g_expr_builder->createFalse());
+  BackendLock lock;
+  return traceExpression(TraceOp_false,
+                         registerExpression(g_expr_builder->createFalse()));
 }
 
 SymExpr _sym_build_bool(bool value) {
-  return registerExpression(g_expr_builder->createBool(value));
+  BackendLock lock;
+  auto *result = registerExpression(g_expr_builder->createBool(value));
+  return traceExpression(TraceOp_bool, result, {}, {value});
 }
 
 #define DEF_BINARY_EXPR_BUILDER(name, qsymName)                                \
   SymExpr _sym_build_##name(SymExpr a, SymExpr b) {                            \
-    return registerExpression(g_expr_builder->create##qsymName(                \
+    BackendLock lock;                                                          \
+    auto *result = registerExpression(g_expr_builder->create##qsymName(        \
         allocatedExpressions.at(a), allocatedExpressions.at(b)));              \
+    return traceExpression(TraceOp_##name, result, {a, b});                    \
   }
 
 DEF_BINARY_EXPR_BUILDER(add, Add)
@@ -266,54 +354,74 @@ DEF_BINARY_EXPR_BUILDER(xor, Xor)
 #undef DEF_BINARY_EXPR_BUILDER
 
 SymExpr _sym_build_neg(SymExpr expr) {
-  return registerExpression(
+  BackendLock lock;
+  auto *result = registerExpression(
       g_expr_builder->createNeg(allocatedExpressions.at(expr)));
+  return traceExpression(TraceOp_neg, result, {expr});
 }
 
 SymExpr _sym_build_not(SymExpr expr) {
-  return registerExpression(
+  BackendLock lock;
+  auto *result = registerExpression(
       g_expr_builder->createNot(allocatedExpressions.at(expr)));
+  return traceExpression(TraceOp_not, result, {expr});
 }
 
 SymExpr _sym_build_sext(SymExpr expr, uint8_t bits) {
-  return registerExpression(g_expr_builder->createSExt(
+  BackendLock lock;
+  auto *result = registerExpression(g_expr_builder->createSExt(
       allocatedExpressions.at(expr), bits + expr->bits()));
+  return traceExpression(TraceOp_sext, result, {expr}, {bits});
 }
 
 SymExpr _sym_build_zext(SymExpr expr, uint8_t bits) {
-  return registerExpression(g_expr_builder->createZExt(
+  BackendLock lock;
+  auto *result = registerExpression(g_expr_builder->createZExt(
       allocatedExpressions.at(expr), bits + expr->bits()));
+  return traceExpression(TraceOp_zext, result, {expr}, {bits});
 }
 
 SymExpr _sym_build_trunc(SymExpr expr, uint8_t bits) {
-  return registerExpression(
+  BackendLock lock;
+  auto *result = registerExpression(
       g_expr_builder->createTrunc(allocatedExpressions.at(expr), bits));
+  return traceExpression(TraceOp_trunc, result, {expr}, {bits});
 }
 
 void _sym_push_path_constraint(SymExpr constraint, int taken,
                                uintptr_t site_id) {
+  BackendLock lock;
   if (constraint == nullptr)
     return;
 
-  g_solver->addJcc(allocatedExpressions.at(constraint), taken != 0, site_id);
+  tracePathConstraint(constraint, taken, site_id);
+  g_enhanced_solver->addJccAndSave(allocatedExpressions.at(constraint),
+                                   taken != 0, site_id);
 }
 void _sym_concretize_pointer(SymExpr expr, const void* p, uintptr_t site_id) {
+  BackendLock lock;
   if (expr == nullptr)
     return;
+  traceConcretization(TraceOp_concretize_pointer, expr, (uintptr_t)p, site_id);
   auto constraint = _sym_build_equal(expr, _sym_build_integer((uintptr_t)p, 64));
-  _sym_push_path_constraint(constraint, 1, site_id);
+  g_enhanced_solver->addJccAndSave(allocatedExpressions.at(constraint), true,
+                                   site_id);
 }
 void _sym_concretize_size(SymExpr expr, size_t sz, uintptr_t site_id) {
+  BackendLock lock;
   if (expr == nullptr)
     return;
+  traceConcretization(TraceOp_concretize_size, expr, sz, site_id);
   auto constraint = _sym_build_equal(expr, _sym_build_integer(sz, 64));
-  _sym_push_path_constraint(constraint, 1, site_id);
+  g_enhanced_solver->addJccAndSave(allocatedExpressions.at(constraint), true,
+                                   site_id);
 }
 
 SymExpr _sym_backend_read_memory(
     SymExpr addr_expr, SymExpr concolic_read_value,
     uint8_t* host_addr, size_t length, bool little_endian)
 {
+  BackendLock lock;
   (void)addr_expr;
   (void)host_addr;
   (void)length;
@@ -325,6 +433,7 @@ void _sym_backend_write_memory(
     SymExpr symbolic_addr_expr, SymExpr written_expr,
     uint8_t *concrete_addr, size_t concrete_length, bool little_endian
 ) {
+  BackendLock lock;
   (void)symbolic_addr_expr;
   (void)written_expr;
   (void)concrete_addr;
@@ -335,6 +444,7 @@ void _sym_backend_memcpy(
     SymExpr sym_dest, SymExpr sym_src, SymExpr sym_len,
     uint8_t* dest, const uint8_t* src, size_t length)
 {
+  BackendLock lock;
   (void)sym_dest;
   (void)sym_src;
   (void)sym_len;
@@ -347,6 +457,7 @@ void _sym_backend_memset(
     SymExpr sym_dest, SymExpr sym_val, SymExpr sym_len,
     uint8_t *memory, int value, size_t length)
 {
+  BackendLock lock;
   (void)sym_dest;
   (void)sym_val;
   (void)sym_len;
@@ -359,6 +470,7 @@ void _sym_backend_memmove(
     SymExpr sym_dest, SymExpr sym_src, SymExpr sym_len,
     uint8_t *dest, const uint8_t *src, size_t length)
 {
+  BackendLock lock;
   (void)sym_dest;
   (void)sym_src;
   (void)sym_len;
@@ -368,25 +480,34 @@ void _sym_backend_memmove(
 }
 
 SymExpr _sym_get_input_byte(size_t offset, uint8_t value) {
+  BackendLock lock;
   g_enhanced_solver->pushInputByte(offset, value);
-  return registerExpression(g_expr_builder->createRead(offset));
+  auto *result = registerExpression(g_expr_builder->createRead(offset));
+  return traceExpression(TraceOp_get_input_byte, result, {}, {offset, value});
 }
 
 SymExpr _sym_concat_helper(SymExpr a, SymExpr b) {
-  return registerExpression(g_expr_builder->createConcat(
+  BackendLock lock;
+  auto *result = registerExpression(g_expr_builder->createConcat(
       allocatedExpressions.at(a), allocatedExpressions.at(b)));
+  return traceExpression(TraceOp_concat_helper, result, {a, b});
 }
 
 SymExpr _sym_extract_helper(SymExpr expr, size_t first_bit, size_t last_bit) {
-  return registerExpression(g_expr_builder->createExtract(
+  BackendLock lock;
+  auto *result = registerExpression(g_expr_builder->createExtract(
       allocatedExpressions.at(expr), last_bit, first_bit - last_bit + 1));
+  return traceExpression(TraceOp_extract_helper, result, {expr},
+                         {first_bit, last_bit});
 }
 
 size_t _sym_bits_helper(SymExpr expr) { return expr->bits(); }
 
 SymExpr _sym_build_bool_to_bit(SymExpr expr) {
-  return registerExpression(
+  BackendLock lock;
+  auto *result = registerExpression(
       g_expr_builder->boolToBit(allocatedExpressions.at(expr), 1));
+  return traceExpression(TraceOp_bool_to_bit, result, {expr});
 }
 
 //
@@ -431,15 +552,23 @@ UNSUPPORTED(SymExpr _sym_build_float_to_unsigned_integer(SymExpr, uint8_t))
 // Call-stack tracing
 //
 
+// QSYM's pruning needs the calling context and the last basic block at each
+// jump site.
+const uint32_t _sym_backend_notifications =
+    SYM_NOTIFY_CALLS | SYM_NOTIFY_BASIC_BLOCKS;
+
 void _sym_notify_call(uintptr_t site_id) {
+  BackendLock lock;
   g_call_stack_manager.visitCall(site_id);
 }
 
 void _sym_notify_ret(uintptr_t site_id) {
+  BackendLock lock;
   g_call_stack_manager.visitRet(site_id);
 }
 
 void _sym_notify_basic_block(uintptr_t site_id) {
+  BackendLock lock;
   g_call_stack_manager.visitBasicBlock(site_id);
 }
 
@@ -452,6 +581,7 @@ void _sym_notify_ret_expr(SymExpr) {}
 //
 
 const char *_sym_expr_to_string(SymExpr expr) {
+  BackendLock lock;
   static char buffer[4096];
 
   auto expr_string = expr->toString();
@@ -463,27 +593,54 @@ const char *_sym_expr_to_string(SymExpr expr) {
 }
 
 bool _sym_feasible(SymExpr expr) {
+  BackendLock lock;
   expr->simplify();
 
   g_solver->push();
   g_solver->add(expr->toZ3Expr());
-  bool feasible = (g_solver->check() == z3::sat);
+  statsSolverStart();
+  auto start = std::chrono::steady_clock::now();
+  auto result = g_solver->check();
+  statsSolverQuery(0,
+                   result == z3::sat     ? SolverResult::Sat
+                   : result == z3::unsat ? SolverResult::Unsat
+                                         : SolverResult::Unknown,
+                   std::chrono::steady_clock::now() - start);
+  bool feasible = (result == z3::sat);
   g_solver->pop();
 
   return feasible;
 }
 
+//
+// Persistent mode
+//
+
+void _sym_reset_backend(void) {
+  BackendLock lock;
+  allocatedExpressions.clear();
+  statsLiveExpressions(0);
+  traceReset();
+  if (g_enhanced_solver == nullptr)
+    return; // fully concrete execution
+
+  // A fresh solver forgets the path constraints and the previous input, and it
+  // stores test cases in the current output directory.
+  delete g_enhanced_solver;
+  g_enhanced_solver = new EnhancedQsymSolver{};
+  g_solver = g_enhanced_solver;
+}
+
 //
 // Garbage collection
 //
 
 void _sym_collect_garbage() {
+  BackendLock lock;
   if (allocatedExpressions.size() < g_config.garbageCollectionThreshold)
     return;
 
-#ifdef DEBUG_RUNTIME
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
+  auto start = std::chrono::steady_clock::now();
 
   auto reachableExpressions = collectReachableExpressions();
   for (auto expr_it = allocatedExpressions.begin();
@@ -494,10 +651,12 @@ void _sym_collect_garbage() {
       ++expr_it;
     }
   }
+  statsLiveExpressions(allocatedExpressions.size());
 
-#ifdef DEBUG_RUNTIME
-  auto end = std::chrono::high_resolution_clock::now();
+  auto end = std::chrono::steady_clock::now();
+  statsGarbageCollection(end - start);
 
+#ifdef DEBUG_RUNTIME
   std::cerr << "After garbage collection: " << allocatedExpressions.size()
             << " expressions remain" << std::endl
             << "\t(collection took "
@@ -16,6 +16,7 @@
 #include <RustRuntime.h>
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <cassert>
 #include <cstring>
@@ -27,10 +28,16 @@
 #include <chrono>
 #endif
 
+#include "BackendLock.h"
 #include "Config.h"
+#include "ForkServer.h"
 #include "GarbageCollection.h"
 #include "LibcWrappers.h"
 #include "Shadow.h"
+#include "Stats.h"
+
+// The Rust runtime decides whether it wants batches.
+#pragma weak _rsym_process_batch
 
 #ifndef NDEBUG
 // Helper to print pointers properly.
@@ -52,6 +59,7 @@ FILE *g_log = stderr;
 #ifndef NDEBUG
 [[maybe_unused]] void dump_known_regions() {
   std::cerr << "Known regions:" << std::endl;
+  std::lock_guard<std::mutex> lock(g_shadow_pages_mutex);
   for (const auto &[page, shadow] : g_shadow_pages) {
     std::cerr << "  " << P(page) << " shadowed by " << P(shadow) << std::endl;
   }
@@ -64,7 +72,10 @@ std::set<SymExpr> allocatedExpressions;
 
 SymExpr registerExpression(SymExpr expr) {
   assert(expr != nullptr);
-  allocatedExpressions.insert(expr);
+  // IDs usually grow monotonically (always in batched mode), so the new
+  // expression belongs at the end.
+  allocatedExpressions.emplace_hint(allocatedExpressions.end(), expr);
+  statsLiveExpressions(allocatedExpressions.size());
   return expr;
 }
 
@@ -90,10 +101,62 @@ SymExpr symexpr(RSymExpr expr, uint8_t width) {
   assert((((expr << 8) >> 8) == expr) && "expr is too large to be stored");
   return (SymExpr)((expr << 8) | width);
 }
+
+// Batched mode; see RustRuntime.h for the interface.
+
+/// The number of records that we buffer before passing them to Rust.
+constexpr size_t kBatchCapacity = 4096;
+
+/// The bit that distinguishes our IDs from those of the Rust runtime (the most
+/// significant one that fits into a SymExpr).
+constexpr RSymExpr kBatchIdBit = RSymExpr(1) << (sizeof(RSymExpr) * 8 - 9);
+
+static_assert(sizeof(RSymBatchRecord) == 48 || sizeof(RSymExpr) != 8,
+              "The layout of batch records must be stable");
+
+std::array<RSymBatchRecord, kBatchCapacity> batch;
+size_t batchSize = 0;
+RSymExpr nextBatchId = kBatchIdBit;
+
+/// Does the Rust runtime consume batches?
+bool batching() { return _rsym_process_batch != nullptr; }
+
+/// Pass the buffered records to the Rust runtime.
+///
+/// Call this before handing any expression to Rust.
+void flushBatch() {
+  if (batchSize == 0)
+    return;
+
+  _rsym_process_batch(batch.data(), batchSize);
+  batchSize = 0;
+}
+
+/// Assign an ID to a new expression and buffer its description.
+SymExpr appendToBatch(RSymOpcode opcode, uint8_t width, RSymExpr a = 0,
+                      RSymExpr b = 0, uint64_t value = 0,
+                      uint64_t value2 = 0) {
+  if (batchSize == batch.size())
+    flushBatch();
+
+  auto id = nextBatchId++;
+  auto &record = batch[batchSize++];
+  record.result = id;
+  record.operands[0] = a;
+  record.operands[1] = b;
+  record.values[0] = value;
+  record.values[1] = value2;
+  record.opcode = opcode;
+  record.width = width;
+  return registerExpression(symexpr(id, width));
+}
 } // namespace
 
 
 void _sym_initialize(void) {
+  // Not a BackendLock because we need to release the lock before starting the
+  // fork server (the children couldn't unlock it).
+  std::unique_lock lock{g_backend_mutex};
   if (g_initialized.test_and_set())
     return;
 
@@ -102,6 +165,7 @@ void _sym_initialize(void) {
 #endif
 
   loadConfig();
+  initStats();
   initLibcWrappers();
 #ifndef NDEBUG
   std::cerr << "This is SymCC running with the Rust backend" << std::endl;
@@ -112,44 +176,89 @@ void _sym_initialize(void) {
   } else {
     g_log = fopen(g_config.logFile.c_str(), "w");
   }
+
+  lock.unlock();
+  runForkServer();
 }
 
 SymExpr _sym_build_integer(uint64_t value, uint8_t bits) {
+  BackendLock lock;
+  statsExpression(TraceOp_integer);
+  if (batching())
+    return appendToBatch(RSymOp_integer, bits, 0, 0, value);
   return registerExpression(symexpr(_rsym_build_integer(value, bits), bits));
 }
 
 SymExpr _sym_build_integer128(uint64_t high, uint64_t low) {
+  BackendLock lock;
+  statsExpression(TraceOp_integer128);
+  if (batching())
+    return appendToBatch(RSymOp_integer128, 128, 0, 0, low, high);
   return registerExpression(symexpr(_rsym_build_integer128(high, low), 128));
 }
 
 SymExpr _sym_build_float(double value, int is_double) {
+  BackendLock lock;
+  statsExpression(TraceOp_float);
+  if (batching()) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return appendToBatch(RSymOp_float, is_double ? 64 : 32, 0, 0, bits,
+                         is_double != 0);
+  }
   return registerExpression(
       symexpr(_rsym_build_float(value, is_double), is_double ? 64 : 32));
 }
 
 SymExpr _sym_get_input_byte(size_t offset, uint8_t value) {
+  BackendLock lock;
+  statsExpression(TraceOp_get_input_byte);
+  statsInputByte(offset);
+  if (batching())
+    return appendToBatch(RSymOp_get_input_byte, 8, 0, 0, offset, value);
   return registerExpression(symexpr(_rsym_get_input_byte(offset, value), 8));
 }
 
 SymExpr _sym_build_null_pointer(void) {
+  BackendLock lock;
+  statsExpression(TraceOp_null_pointer);
+  if (batching())
+    return appendToBatch(RSymOp_null_pointer, sizeof(uintptr_t) * 8);
   return registerExpression(
       symexpr(_rsym_build_null_pointer(), sizeof(uintptr_t) * 8));
 }
 
 SymExpr _sym_build_true(void) {
+  BackendLock lock;
+  statsExpression(TraceOp_true);
+  if (batching())
+    return appendToBatch(RSymOp_true, 0);
   return registerExpression(symexpr(_rsym_build_true(), 0));
 }
 
 SymExpr _sym_build_false(void) {
+  BackendLock lock;
+  statsExpression(TraceOp_false);
+  if (batching())
+    return appendToBatch(RSymOp_false, 0);
   return registerExpression(symexpr(_rsym_build_false(), 0));
 }
 
 SymExpr _sym_build_bool(bool value) {
+  BackendLock lock;
+  statsExpression(TraceOp_bool);
+  if (batching())
+    return appendToBatch(RSymOp_bool, 0, 0, 0, value);
   return registerExpression(symexpr(_rsym_build_bool(value), 0));
 }
 
 #define DEF_UNARY_EXPR_BUILDER(name)                                           \
   SymExpr _sym_build_##name(SymExpr expr) {                                    \
+    BackendLock lock;                                                          \
+    statsExpression(TraceOp_##name);                                           \
+    if (batching())                                                            \
+      return appendToBatch(RSymOp_##name, symexpr_width(expr),                 \
+                           symexpr_id(expr));                                  \
     return registerExpression(                                                 \
         symexpr(_rsym_build_##name(symexpr_id(expr)), symexpr_width(expr)));   \
   }
@@ -158,6 +267,11 @@ DEF_UNARY_EXPR_BUILDER(neg)
 
 #define DEF_BINARY_BV_EXPR_BUILDER(name)                                       \
   SymExpr _sym_build_##name(SymExpr a, SymExpr b) {                            \
+    BackendLock lock;                                                          \
+    statsExpression(TraceOp_##name);                                           \
+    if (batching())                                                            \
+      return appendToBatch(RSymOp_##name, symexpr_width(a), symexpr_id(a),     \
+                           symexpr_id(b));                                     \
     return registerExpression(symexpr(                                         \
         _rsym_build_##name(symexpr_id(a), symexpr_id(b)), symexpr_width(a)));  \
   }
@@ -175,6 +289,10 @@ DEF_BINARY_BV_EXPR_BUILDER(arithmetic_shift_right)
 
 #define DEF_BINARY_BOOL_EXPR_BUILDER(name)                                     \
   SymExpr _sym_build_##name(SymExpr a, SymExpr b) {                            \
+    BackendLock lock;                                                          \
+    statsExpression(TraceOp_##name);                                           \
+    if (batching())                                                            \
+      return appendToBatch(RSymOp_##name, 0, symexpr_id(a), symexpr_id(b));    \
     return registerExpression(                                                 \
         symexpr(_rsym_build_##name(symexpr_id(a), symexpr_id(b)), 0));         \
   }
@@ -232,78 +350,135 @@ DEF_BINARY_BOOL_EXPR_BUILDER(float_unordered_not_equal)
 #undef DEF_BINARY_BOOL_EXPR_BUILDER
 
 SymExpr _sym_build_sext(SymExpr expr, uint8_t bits) {
+  BackendLock lock;
+  statsExpression(TraceOp_sext);
+  if (batching())
+    return appendToBatch(RSymOp_sext, symexpr_width(expr) + bits,
+                         symexpr_id(expr), 0, bits);
   return registerExpression(symexpr(_rsym_build_sext(symexpr_id(expr), bits),
                                     symexpr_width(expr) + bits));
 }
 
 SymExpr _sym_build_zext(SymExpr expr, uint8_t bits) {
+  BackendLock lock;
+  statsExpression(TraceOp_zext);
+  if (batching())
+    return appendToBatch(RSymOp_zext, symexpr_width(expr) + bits,
+                         symexpr_id(expr), 0, bits);
   return registerExpression(symexpr(_rsym_build_zext(symexpr_id(expr), bits),
                                     symexpr_width(expr) + bits));
 }
 
 SymExpr _sym_build_trunc(SymExpr expr, uint8_t bits) {
+  BackendLock lock;
+  statsExpression(TraceOp_trunc);
+  if (batching())
+    return appendToBatch(RSymOp_trunc, bits, symexpr_id(expr), 0, bits);
   return registerExpression(
       symexpr(_rsym_build_trunc(symexpr_id(expr), bits), bits));
 }
 
 SymExpr _sym_build_int_to_float(SymExpr expr, int is_double, int is_signed) {
+  BackendLock lock;
+  statsExpression(TraceOp_int_to_float);
+  if (batching())
+    return appendToBatch(RSymOp_int_to_float, is_double ? 64 : 32,
+                         symexpr_id(expr), 0, is_double != 0, is_signed != 0);
   return registerExpression(
       symexpr(_rsym_build_int_to_float(symexpr_id(expr), is_double, is_signed),
               is_double ? 64 : 32));
 }
 
 SymExpr _sym_build_float_to_float(SymExpr expr, int to_double) {
+  BackendLock lock;
+  statsExpression(TraceOp_float_to_float);
+  if (batching())
+    return appendToBatch(RSymOp_float_to_float, to_double ? 64 : 32,
+                         symexpr_id(expr), 0, to_double != 0);
   return registerExpression(
       symexpr(_rsym_build_float_to_float(symexpr_id(expr), to_double),
               to_double ? 64 : 32));
 }
 
 SymExpr _sym_build_bits_to_float(SymExpr expr, int to_double) {
+  BackendLock lock;
   if (expr == 0)
     return 0;
 
+  statsExpression(TraceOp_bits_to_float);
+  if (batching())
+    return appendToBatch(RSymOp_bits_to_float, to_double ? 64 : 32,
+                         symexpr_id(expr), 0, to_double != 0);
   return registerExpression(
       symexpr(_rsym_build_bits_to_float(symexpr_id(expr), to_double),
               to_double ? 64 : 32));
 }
 
 SymExpr _sym_build_float_to_bits(SymExpr expr) {
+  BackendLock lock;
   if (expr == nullptr)
     return nullptr;
+  statsExpression(TraceOp_float_to_bits);
+  if (batching())
+    return appendToBatch(RSymOp_float_to_bits, symexpr_width(expr),
+                         symexpr_id(expr));
   return registerExpression(symexpr(_rsym_build_float_to_bits(symexpr_id(expr)),
                                     symexpr_width(expr)));
 }
 
 SymExpr _sym_build_float_to_signed_integer(SymExpr expr, uint8_t bits) {
+  BackendLock lock;
+  statsExpression(TraceOp_float_to_signed_integer);
+  if (batching())
+    return appendToBatch(RSymOp_float_to_signed_integer, bits, symexpr_id(expr),
+                         0, bits);
   return registerExpression(symexpr(
       _rsym_build_float_to_signed_integer(symexpr_id(expr), bits), bits));
 }
 
 SymExpr _sym_build_float_to_unsigned_integer(SymExpr expr, uint8_t bits) {
+  BackendLock lock;
+  statsExpression(TraceOp_float_to_unsigned_integer);
+  if (batching())
+    return appendToBatch(RSymOp_float_to_unsigned_integer, bits, symexpr_id(expr),
+                         0, bits);
   return registerExpression(symexpr(
       _rsym_build_float_to_unsigned_integer(symexpr_id(expr), bits), bits));
 }
 
 SymExpr _sym_build_bool_to_bit(SymExpr expr) {
+  BackendLock lock;
+  statsExpression(TraceOp_bool_to_bit);
+  if (batching())
+    return appendToBatch(RSymOp_bool_to_bit, 1, symexpr_id(expr));
   return registerExpression(
       symexpr(_rsym_build_bool_to_bit(symexpr_id(expr)), 1));
 }
 
 void _sym_push_path_constraint(SymExpr constraint, int taken,
                                uintptr_t site_id) {
+  BackendLock lock;
   if (constraint == 0)
     return;
+  statsPathConstraint(site_id);
+  flushBatch();
   _rsym_push_path_constraint(symexpr_id(constraint), taken, site_id);
 }
 
 void _sym_concretize_pointer(SymExpr expr, const void* ptr, uintptr_t site_id) {
+  BackendLock lock;
   if (expr == 0)
     return;
+  statsConcretization(site_id);
+  flushBatch();
   _rsym_concretize_pointer(symexpr_id(expr), (uintptr_t)ptr, site_id);
 }
 void _sym_concretize_size(SymExpr expr, size_t concrete_size, uintptr_t site_id) {
+  BackendLock lock;
   if (expr == 0)
     return;
+  statsConcretization(site_id);
+  flushBatch();
   _rsym_concretize_size(symexpr_id(expr), concrete_size, site_id);
 }
 
@@ -311,6 +486,7 @@ SymExpr _sym_backend_read_memory(
     SymExpr addr_expr, SymExpr concolic_read_value,
     uint8_t* addr, size_t length, bool little_endian
 ) {
+  BackendLock lock;
   // if (addr_expr == 0 && concolic_read_value == 0) {
   //   ReadOnlyShadow shadow(addr, length);
   //   auto concrete = isConcrete(addr, length);
@@ -325,6 +501,7 @@ SymExpr _sym_backend_read_memory(
   //   }
   //   // abort();
   // }
+  flushBatch();
   auto rust_expr = _rsym_backend_read_memory(
       symexpr_id(addr_expr), symexpr_id(concolic_read_value),
       addr, length, little_endian
@@ -340,6 +517,8 @@ void _sym_backend_write_memory(
     SymExpr symbolic_addr_expr, SymExpr written_expr,
     uint8_t *concrete_addr, size_t concrete_length, bool little_endian
 ) {
+  BackendLock lock;
+  flushBatch();
   _rsym_backend_write_memory(
       symexpr_id(symbolic_addr_expr), symexpr_id(written_expr),
       concrete_addr, concrete_length, little_endian
@@ -350,6 +529,8 @@ void _sym_backend_memcpy(
     SymExpr sym_dest, SymExpr sym_src, SymExpr sym_len,
     uint8_t* dest, const uint8_t* src, size_t length
 ) {
+  BackendLock lock;
+  flushBatch();
   _rsym_backend_memcpy(
       symexpr_id(sym_dest), symexpr_id(sym_src), symexpr_id(sym_len),
       dest, src, length
@@ -359,6 +540,8 @@ void _sym_backend_memset(
     SymExpr sym_dest, SymExpr sym_val, SymExpr sym_len,
     uint8_t *memory, int value, size_t length
 ) {
+  BackendLock lock;
+  flushBatch();
   _rsym_backend_memset(
       symexpr_id(sym_dest), symexpr_id(sym_val), symexpr_id(sym_len),
       memory, value, length
@@ -368,6 +551,8 @@ void _sym_backend_memmove(
     SymExpr sym_dest, SymExpr sym_src, SymExpr sym_len,
     uint8_t *dest, const uint8_t *src, size_t length
 ) {
+  BackendLock lock;
+  flushBatch();
   _rsym_backend_memmove(
       symexpr_id(sym_dest), symexpr_id(sym_src), symexpr_id(sym_len),
       dest, src, length
@@ -376,12 +561,23 @@ void _sym_backend_memmove(
 
 
 SymExpr _sym_concat_helper(SymExpr a, SymExpr b) {
+  BackendLock lock;
+  statsExpression(TraceOp_concat_helper);
+  if (batching())
+    return appendToBatch(RSymOp_concat_helper,
+                         symexpr_width(a) + symexpr_width(b), symexpr_id(a),
+                         symexpr_id(b));
   auto result = _rsym_concat_helper(symexpr_id(a), symexpr_id(b));
   // printf("sym_concat_helper: %p..%p = %ld\n", a, b, result);
   return registerExpression(symexpr(result, symexpr_width(a) + symexpr_width(b)));
 }
 
 SymExpr _sym_extract_helper(SymExpr expr, size_t first_bit, size_t last_bit) {
+  BackendLock lock;
+  statsExpression(TraceOp_extract_helper);
+  if (batching())
+    return appendToBatch(RSymOp_extract_helper, first_bit - last_bit + 1,
+                         symexpr_id(expr), 0, first_bit, last_bit);
   return registerExpression(
       symexpr(_rsym_extract_helper(symexpr_id(expr), first_bit, last_bit),
               first_bit - last_bit + 1));
@@ -389,19 +585,33 @@ SymExpr _sym_extract_helper(SymExpr expr, size_t first_bit, size_t last_bit) {
 
 size_t _sym_bits_helper(SymExpr expr) { return symexpr_width(expr); }
 
+// We can't know what the Rust runtime does with the notifications, so we
+// request all of them. Notifications that don't involve expressions don't flush
+// the batch, so the Rust runtime may learn about expressions after the
+// surrounding calls and basic blocks.
+const uint32_t _sym_backend_notifications =
+    SYM_NOTIFY_CALLS | SYM_NOTIFY_BASIC_BLOCKS;
+
 void _sym_notify_call(uintptr_t loc) {
+  BackendLock lock;
   _rsym_notify_call(loc);
 }
 void _sym_notify_ret(uintptr_t loc) {
+  BackendLock lock;
   _rsym_notify_ret(loc);
 }
 void _sym_notify_basic_block(uintptr_t loc) {
+  BackendLock lock;
   _rsym_notify_basic_block(loc);
 }
 void _sym_notify_param_expr(uint8_t index, SymExpr expr) {
+  BackendLock lock;
+  flushBatch();
   _rsym_notify_param_expr(index, symexpr_id(expr));
 }
 void _sym_notify_ret_expr(SymExpr expr) {
+  BackendLock lock;
+  flushBatch();
   _rsym_notify_ret_expr(symexpr_id(expr));
 }
 
@@ -412,6 +622,7 @@ bool _sym_feasible(SymExpr) { return false; }
 
 extern "C" {
   void _sym_get_symbolic_exprs_for_memory(RSymExpr* out, const void *addr, size_t nbytes) {
+    BackendLock lock;
     size_t count = 0;
     ReadOnlyShadow shadow(addr, nbytes);
     for (auto expr : shadow) {
@@ -421,13 +632,29 @@ extern "C" {
   }
 }
 
+/* Persistent mode */
+void _sym_reset_backend(void) {
+  BackendLock lock;
+  // The Rust runtime only learns that the expressions are gone; it has no
+  // notion of inputs.
+  flushBatch();
+  std::vector<RSymExpr> expressions;
+  for (auto expr : allocatedExpressions)
+    expressions.push_back(symexpr_id(expr));
+  allocatedExpressions.clear();
+  statsLiveExpressions(0);
+  if (!expressions.empty())
+    _rsym_expression_unreachable(expressions.data(), expressions.size());
+}
+
 /* Garbage collection */
 void _sym_collect_garbage() {
+  BackendLock lock;
   if (allocatedExpressions.size() < g_config.garbageCollectionThreshold)
     return;
 
+  auto start = std::chrono::steady_clock::now();
 #ifndef NDEBUG
-  auto start = std::chrono::high_resolution_clock::now();
   auto startSize = allocatedExpressions.size();
 #endif
 
@@ -443,13 +670,17 @@ void _sym_collect_garbage() {
       ++expr_it;
     }
   }
+  statsLiveExpressions(allocatedExpressions.size());
   if (unreachable_expressions.size() > 0) {
+    flushBatch();
     _rsym_expression_unreachable(unreachable_expressions.data(),
                                  unreachable_expressions.size());
   }
 
+  auto end = std::chrono::steady_clock::now();
+  statsGarbageCollection(end - start);
+
 #ifndef NDEBUG
-  auto end = std::chrono::high_resolution_clock::now();
   auto endSize = allocatedExpressions.size();
 
   std::cerr << "After garbage collection: " << endSize
@@ -193,6 +193,122 @@ void _rsym_notify_ret_expr(RSymExpr expr);
  */
 void _rsym_expression_unreachable(RSymExpr *expressions, size_t num_elements);
 
+/*
+ * Batched expression building (optional)
+ *
+ * If the Rust runtime defines _rsym_process_batch, the wrapper stops calling
+ * the _rsym_build_* functions, _rsym_get_input_byte, _rsym_concat_helper and
+ * _rsym_extract_helper. Instead, it assigns the IDs of new expressions itself
+ * and appends one RSymBatchRecord per expression to a preallocated buffer,
+ * which it hands to _rsym_process_batch whenever the buffer is full and before
+ * every other call that takes expressions. The Rust runtime therefore always
+ * knows an expression by the time it sees its ID. IDs that the wrapper assigns
+ * have the most significant usable bit set (bit 55 on 64-bit systems), so they
+ * don't collide with IDs that the Rust runtime returns from
+ * _rsym_backend_read_memory.
+ */
+
+/// The operations in batch records, named after the corresponding builder.
+///
+/// Unless noted otherwise, the operands are those of the builder, and the
+/// values are unused. The numbering is part of the interface; only append.
+typedef uint16_t RSymOpcode;
+enum {
+  RSymOp_integer,     // values: value
+  RSymOp_integer128,  // values: low, high
+  RSymOp_float,       // values: bits of the value as a double, is_double
+  RSymOp_null_pointer,
+  RSymOp_true,
+  RSymOp_false,
+  RSymOp_bool,           // values: value
+  RSymOp_get_input_byte, // values: offset, value
+
+  RSymOp_neg,
+  RSymOp_add,
+  RSymOp_sub,
+  RSymOp_mul,
+  RSymOp_unsigned_div,
+  RSymOp_signed_div,
+  RSymOp_unsigned_rem,
+  RSymOp_signed_rem,
+  RSymOp_shift_left,
+  RSymOp_logical_shift_right,
+  RSymOp_arithmetic_shift_right,
+
+  RSymOp_fp_add,
+  RSymOp_fp_sub,
+  RSymOp_fp_mul,
+  RSymOp_fp_div,
+  RSymOp_fp_rem,
+  RSymOp_fp_abs,
+
+  RSymOp_not,
+  RSymOp_signed_less_than,
+  RSymOp_signed_less_equal,
+  RSymOp_signed_greater_than,
+  RSymOp_signed_greater_equal,
+  RSymOp_unsigned_less_than,
+  RSymOp_unsigned_less_equal,
+  RSymOp_unsigned_greater_than,
+  RSymOp_unsigned_greater_equal,
+  RSymOp_equal,
+  RSymOp_not_equal,
+  RSymOp_bool_and,
+  RSymOp_and,
+  RSymOp_bool_or,
+  RSymOp_or,
+  RSymOp_bool_xor,
+  RSymOp_xor,
+
+  RSymOp_float_ordered_greater_than,
+  RSymOp_float_ordered_greater_equal,
+  RSymOp_float_ordered_less_than,
+  RSymOp_float_ordered_less_equal,
+  RSymOp_float_ordered_equal,
+  RSymOp_float_ordered_not_equal,
+  RSymOp_float_ordered,
+  RSymOp_float_unordered,
+  RSymOp_float_unordered_greater_than,
+  RSymOp_float_unordered_greater_equal,
+  RSymOp_float_unordered_less_than,
+  RSymOp_float_unordered_less_equal,
+  RSymOp_float_unordered_equal,
+  RSymOp_float_unordered_not_equal,
+
+  RSymOp_sext,                      // values: bits
+  RSymOp_zext,                      // values: bits
+  RSymOp_trunc,                     // values: bits
+  RSymOp_int_to_float,              // values: is_double, is_signed
+  RSymOp_float_to_float,            // values: to_double
+  RSymOp_bits_to_float,             // values: to_double
+  RSymOp_float_to_bits,
+  RSymOp_float_to_signed_integer,   // values: bits
+  RSymOp_float_to_unsigned_integer, // values: bits
+  RSymOp_bool_to_bit,
+
+  RSymOp_concat_helper,
+  RSymOp_extract_helper, // values: first_bit, last_bit
+};
+
+/// The description of a new expression.
+typedef struct {
+  /// The ID that the wrapper assigned to the expression.
+  RSymExpr result;
+
+  /// The operand expressions, or 0 if unused.
+  RSymExpr operands[2];
+
+  /// Constant parameters of the operation, or 0 if unused.
+  uint64_t values[2];
+
+  RSymOpcode opcode;
+
+  /// The bit width of the result (0 for Booleans).
+  uint8_t width;
+} RSymBatchRecord;
+
+void _rsym_process_batch(const RSymBatchRecord *records, size_t num_records);
+
 /*
  * Shadow memory access
  */
@@ -17,19 +17,20 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <iostream>
 #include <set>
 #include <vector>
 
-#ifndef NDEBUG
-#include <chrono>
-#endif
-
+#include "BackendLock.h"
 #include "Config.h"
+#include "ForkServer.h"
 #include "GarbageCollection.h"
 #include "LibcWrappers.h"
 #include "Shadow.h"
+#include "Stats.h"
+#include "Trace.h"
 
 #ifndef NDEBUG
 // Helper to print pointers properly.
@@ -57,7 +58,7 @@ Z3_context g_context;
 Z3_ast g_rounding_mode;
 
 /// The global Z3 solver.
-Z3_solver g_solver; // TODO make thread-local
+Z3_solver g_solver; // guarded by g_backend_mutex
 
 // Some global constants for efficiency.
 Z3_ast g_null_pointer, g_true, g_false;
@@ -67,6 +68,7 @@ FILE *g_log = stderr;
 #ifndef NDEBUG
 [[maybe_unused]] void dump_known_regions() {
   std::cerr << "Known regions:" << std::endl;
+  std::lock_guard<std::mutex> lock(g_shadow_pages_mutex);
   for (const auto &[page, shadow] : g_shadow_pages) {
     std::cerr << "  " << P(page) << " shadowed by " << P(shadow) << std::endl;
   }
@@ -92,12 +94,16 @@ Z3_ast build_variable(const char *name, uint8_t bits) {
 /// The set of all expressions we have ever passed to client code.
 std::set<SymExpr> allocatedExpressions;
 
+/// The variables representing the input bytes, indexed by offset.
+std::vector<SymExpr> stdinBytes;
+
 SymExpr registerExpression(Z3_ast expr) {
   if (allocatedExpressions.count(expr) == 0) {
     // We don't know this expression yet. Record it and increase the reference
     // counter.
     allocatedExpressions.insert(expr);
     Z3_inc_ref(g_context, expr);
+    statsLiveExpressions(allocatedExpressions.size());
   }
 
   return expr;
@@ -106,6 +112,9 @@ SymExpr registerExpression(Z3_ast expr) {
 } // namespace
 
 void _sym_initialize(void) {
+  // Not a BackendLock because we need to release the lock before starting the
+  // fork server (the children couldn't unlock it).
+  std::unique_lock lock{g_backend_mutex};
   if (g_initialized.test_and_set())
     return;
 
@@ -114,6 +123,7 @@ void _sym_initialize(void) {
 #endif
 
   loadConfig();
+  initStats();
   initLibcWrappers();
   std::cerr << "This is SymCC running with the simple backend" << std::endl
             << "For anything but debugging SymCC itself, you will want to use "
@@ -153,58 +163,87 @@ void _sym_initialize(void) {
   } else {
     g_log = fopen(g_config.logFile.c_str(), "w");
   }
+
+  lock.unlock();
+  runForkServer();
 }
 
 Z3_ast _sym_build_integer(uint64_t value, uint8_t bits) {
+  BackendLock lock;
   auto *sort = Z3_mk_bv_sort(g_context, bits);
   Z3_inc_ref(g_context, (Z3_ast)sort);
   auto *result =
       registerExpression(Z3_mk_unsigned_int64(g_context, value, sort));
   Z3_dec_ref(g_context, (Z3_ast)sort);
-  return result;
+  return traceExpression(TraceOp_integer, result, {}, {value, bits});
 }
 
 Z3_ast _sym_build_integer128(uint64_t high, uint64_t low) {
-  return registerExpression(Z3_mk_concat(
+  BackendLock lock;
+  auto *result = registerExpression(Z3_mk_concat(
       g_context, _sym_build_integer(high, 64), _sym_build_integer(low, 64)));
+  return traceExpression(TraceOp_integer128, result, {}, {high, low});
 }
 
 Z3_ast _sym_build_float(double value, int is_double) {
+  BackendLock lock;
   auto *sort = FSORT(is_double);
   Z3_inc_ref(g_context, (Z3_ast)sort);
   auto *result =
       registerExpression(Z3_mk_fpa_numeral_double(g_context, value, sort));
   Z3_dec_ref(g_context, (Z3_ast)sort);
-  return result;
-}
-
-Z3_ast _sym_get_input_byte(size_t offset, uint8_t) {
-  static std::vector<SymExpr> stdinBytes;
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return traceExpression(TraceOp_float, result, {},
+                         {bits, static_cast<uint64_t>(is_double != 0)});
+}
+
+Z3_ast _sym_get_input_byte(size_t offset, uint8_t value) {
+  BackendLock lock;
+  // Threads reading input concurrently may request offsets out of order.
+  if (offset >= stdinBytes.size())
+    stdinBytes.resize(offset + 1);
+  if (stdinBytes[offset] == nullptr) {
+    auto varName = "stdin" + std::to_string(offset);
+    stdinBytes[offset] = build_variable(varName.c_str(), 8);
+  }
 
-  if (offset < stdinBytes.size())
-    return stdinBytes[offset];
+  return traceExpression(TraceOp_get_input_byte, stdinBytes[offset], {},
+                         {offset, value});
+}
 
-  auto varName = "stdin" + std::to_string(stdinBytes.size());
-  auto *var = build_variable(varName.c_str(), 8);
+Z3_ast _sym_build_null_pointer(void) {
+  BackendLock lock;
+  return traceExpression(TraceOp_null_pointer, g_null_pointer, {},
+                         {8 * sizeof(void *)});
+}
 
-  stdinBytes.resize(offset);
-  stdinBytes.push_back(var);
+Z3_ast _sym_build_true(void) {
+  BackendLock lock;
+  return traceExpression(TraceOp_true, g_true);
+}
 
-  return var;
+Z3_ast _sym_build_false(void) {
+  BackendLock lock;
+  return traceExpression(TraceOp_false, g_false);
 }
 
-Z3_ast _sym_build_null_pointer(void) { return g_null_pointer; }
-Z3_ast _sym_build_true(void) { return g_true; }
-Z3_ast _sym_build_false(void) { return g_false; }
-Z3_ast _sym_build_bool(bool value) { return value ? g_true : g_false; }
+Z3_ast _sym_build_bool(bool value) {
+  BackendLock lock;
+  return traceExpression(TraceOp_bool, value ? g_true : g_false, {}, {value});
+}
 
 Z3_ast _sym_build_neg(Z3_ast expr) {
-  return registerExpression(Z3_mk_bvneg(g_context, expr));
+  BackendLock lock;
+  auto *result = registerExpression(Z3_mk_bvneg(g_context, expr));
+  return traceExpression(TraceOp_neg, result, {expr});
 }
 
 #define DEF_BINARY_EXPR_BUILDER(name, z3_name)                                 \
   SymExpr _sym_build_##name(SymExpr a, SymExpr b) {                            \
-    return registerExpression(Z3_mk_##z3_name(g_context, a, b));               \
+    BackendLock lock;                                                          \
+    auto *result = registerExpression(Z3_mk_##z3_name(g_context, a, b));       \
+    return traceExpression(TraceOp_##name, result, {a, b});                    \
   }
 
 DEF_BINARY_EXPR_BUILDER(add, bvadd)
@@ -242,125 +281,177 @@ DEF_BINARY_EXPR_BUILDER(float_ordered_equal, fpa_eq)
 #undef DEF_BINARY_EXPR_BUILDER
 
 Z3_ast _sym_build_fp_add(Z3_ast a, Z3_ast b) {
-  return registerExpression(Z3_mk_fpa_add(g_context, g_rounding_mode, a, b));
+  BackendLock lock;
+  auto *result =
+      registerExpression(Z3_mk_fpa_add(g_context, g_rounding_mode, a, b));
+  return traceExpression(TraceOp_fp_add, result, {a, b});
 }
 
 Z3_ast _sym_build_fp_sub(Z3_ast a, Z3_ast b) {
-  return registerExpression(Z3_mk_fpa_sub(g_context, g_rounding_mode, a, b));
+  BackendLock lock;
+  auto *result =
+      registerExpression(Z3_mk_fpa_sub(g_context, g_rounding_mode, a, b));
+  return traceExpression(TraceOp_fp_sub, result, {a, b});
 }
 
 Z3_ast _sym_build_fp_mul(Z3_ast a, Z3_ast b) {
-  return registerExpression(Z3_mk_fpa_mul(g_context, g_rounding_mode, a, b));
+  BackendLock lock;
+  auto *result =
+      registerExpression(Z3_mk_fpa_mul(g_context, g_rounding_mode, a, b));
+  return traceExpression(TraceOp_fp_mul, result, {a, b});
 }
 
 Z3_ast _sym_build_fp_div(Z3_ast a, Z3_ast b) {
-  return registerExpression(Z3_mk_fpa_div(g_context, g_rounding_mode, a, b));
+  BackendLock lock;
+  auto *result =
+      registerExpression(Z3_mk_fpa_div(g_context, g_rounding_mode, a, b));
+  return traceExpression(TraceOp_fp_div, result, {a, b});
 }
 
 Z3_ast _sym_build_fp_rem(Z3_ast a, Z3_ast b) {
-  return registerExpression(Z3_mk_fpa_rem(g_context, a, b));
+  BackendLock lock;
+  auto *result = registerExpression(Z3_mk_fpa_rem(g_context, a, b));
+  return traceExpression(TraceOp_fp_rem, result, {a, b});
 }
 
 Z3_ast _sym_build_fp_abs(Z3_ast a) {
-  return registerExpression(Z3_mk_fpa_abs(g_context, a));
+  BackendLock lock;
+  auto *result = registerExpression(Z3_mk_fpa_abs(g_context, a));
+  return traceExpression(TraceOp_fp_abs, result, {a});
 }
 
 Z3_ast _sym_build_not(Z3_ast expr) {
-  return registerExpression(Z3_mk_bvnot(g_context, expr));
+  BackendLock lock;
+  auto *result = registerExpression(Z3_mk_bvnot(g_context, expr));
+  return traceExpression(TraceOp_not, result, {expr});
 }
 
 Z3_ast _sym_build_not_equal(Z3_ast a, Z3_ast b) {
-  return registerExpression(Z3_mk_not(g_context, Z3_mk_eq(g_context, a, b)));
+  BackendLock lock;
+  auto *result =
+      registerExpression(Z3_mk_not(g_context, Z3_mk_eq(g_context, a, b)));
+  return traceExpression(TraceOp_not_equal, result, {a, b});
 }
 
 Z3_ast _sym_build_bool_and(Z3_ast a, Z3_ast b) {
+  BackendLock lock;
   Z3_ast operands[] = {a, b};
-  return registerExpression(Z3_mk_and(g_context, 2, operands));
+  auto *result = registerExpression(Z3_mk_and(g_context, 2, operands));
+  return traceExpression(TraceOp_bool_and, result, {a, b});
 }
 
 Z3_ast _sym_build_bool_or(Z3_ast a, Z3_ast b) {
+  BackendLock lock;
   Z3_ast operands[] = {a, b};
-  return registerExpression(Z3_mk_or(g_context, 2, operands));
+  auto *result = registerExpression(Z3_mk_or(g_context, 2, operands));
+  return traceExpression(TraceOp_bool_or, result, {a, b});
 }
 
 Z3_ast _sym_build_float_ordered_not_equal(Z3_ast a, Z3_ast b) {
-  return registerExpression(
+  BackendLock lock;
+  auto *result = registerExpression(
       Z3_mk_not(g_context, _sym_build_float_ordered_equal(a, b)));
+  return traceExpression(TraceOp_float_ordered_not_equal, result, {a, b});
 }
 
 Z3_ast _sym_build_float_ordered(Z3_ast a, Z3_ast b) {
-  return registerExpression(
+  BackendLock lock;
+  auto *result = registerExpression(
       Z3_mk_not(g_context, _sym_build_float_unordered(a, b)));
+  return traceExpression(TraceOp_float_ordered, result, {a, b});
 }
 
 Z3_ast _sym_build_float_unordered(Z3_ast a, Z3_ast b) {
+  BackendLock lock;
   Z3_ast checks[2];
   checks[0] = Z3_mk_fpa_is_nan(g_context, a);
   checks[1] = Z3_mk_fpa_is_nan(g_context, b);
-  return registerExpression(Z3_mk_or(g_context, 2, checks));
+  auto *result = registerExpression(Z3_mk_or(g_context, 2, checks));
+  return traceExpression(TraceOp_float_unordered, result, {a, b});
 }
 
 Z3_ast _sym_build_float_unordered_greater_than(Z3_ast a, Z3_ast b) {
+  BackendLock lock;
   Z3_ast checks[3];
   checks[0] = Z3_mk_fpa_is_nan(g_context, a);
   checks[1] = Z3_mk_fpa_is_nan(g_context, b);
   checks[2] = _sym_build_float_ordered_greater_than(a, b);
-  return registerExpression(Z3_mk_or(g_context, 2, checks));
+  auto *result = registerExpression(Z3_mk_or(g_context, 2, checks));
+  return traceExpression(TraceOp_float_unordered_greater_than, result, {a, b});
 }
 
 Z3_ast _sym_build_float_unordered_greater_equal(Z3_ast a, Z3_ast b) {
+  BackendLock lock;
   Z3_ast checks[3];
   checks[0] = Z3_mk_fpa_is_nan(g_context, a);
   checks[1] = Z3_mk_fpa_is_nan(g_context, b);
   checks[2] = _sym_build_float_ordered_greater_equal(a, b);
-  return registerExpression(Z3_mk_or(g_context, 2, checks));
+  auto *result = registerExpression(Z3_mk_or(g_context, 2, checks));
+  return traceExpression(TraceOp_float_unordered_greater_equal, result,
+                         {a, b});
 }
 
 Z3_ast _sym_build_float_unordered_less_than(Z3_ast a, Z3_ast b) {
+  BackendLock lock;
   Z3_ast checks[3];
   checks[0] = Z3_mk_fpa_is_nan(g_context, a);
   checks[1] = Z3_mk_fpa_is_nan(g_context, b);
   checks[2] = _sym_build_float_ordered_less_than(a, b);
-  return registerExpression(Z3_mk_or(g_context, 2, checks));
+  auto *result = registerExpression(Z3_mk_or(g_context, 2, checks));
+  return traceExpression(TraceOp_float_unordered_less_than, result, {a, b});
 }
 
 Z3_ast _sym_build_float_unordered_less_equal(Z3_ast a, Z3_ast b) {
+  BackendLock lock;
   Z3_ast checks[3];
   checks[0] = Z3_mk_fpa_is_nan(g_context, a);
   checks[1] = Z3_mk_fpa_is_nan(g_context, b);
   checks[2] = _sym_build_float_ordered_less_equal(a, b);
-  return registerExpression(Z3_mk_or(g_context, 2, checks));
+  auto *result = registerExpression(Z3_mk_or(g_context, 2, checks));
+  return traceExpression(TraceOp_float_unordered_less_equal, result, {a, b});
 }
 
 Z3_ast _sym_build_float_unordered_equal(Z3_ast a, Z3_ast b) {
+  BackendLock lock;
   Z3_ast checks[3];
   checks[0] = Z3_mk_fpa_is_nan(g_context, a);
   checks[1] = Z3_mk_fpa_is_nan(g_context, b);
   checks[2] = _sym_build_float_ordered_equal(a, b);
-  return registerExpression(Z3_mk_or(g_context, 2, checks));
+  auto *result = registerExpression(Z3_mk_or(g_context, 2, checks));
+  return traceExpression(TraceOp_float_unordered_equal, result, {a, b});
 }
 
 Z3_ast _sym_build_float_unordered_not_equal(Z3_ast a, Z3_ast b) {
+  BackendLock lock;
   Z3_ast checks[3];
   checks[0] = Z3_mk_fpa_is_nan(g_context, a);
   checks[1] = Z3_mk_fpa_is_nan(g_context, b);
   checks[2] = _sym_build_float_ordered_not_equal(a, b);
-  return registerExpression(Z3_mk_or(g_context, 2, checks));
+  auto *result = registerExpression(Z3_mk_or(g_context, 2, checks));
+  return traceExpression(TraceOp_float_unordered_not_equal, result, {a, b});
 }
 
 Z3_ast _sym_build_sext(Z3_ast expr, uint8_t bits) {
-  return registerExpression(Z3_mk_sign_ext(g_context, bits, expr));
+  BackendLock lock;
+  auto *result = registerExpression(Z3_mk_sign_ext(g_context, bits, expr));
+  return traceExpression(TraceOp_sext, result, {expr}, {bits});
 }
 
 Z3_ast _sym_build_zext(Z3_ast expr, uint8_t bits) {
-  return registerExpression(Z3_mk_zero_ext(g_context, bits, expr));
+  BackendLock lock;
+  auto *result = registerExpression(Z3_mk_zero_ext(g_context, bits, expr));
+  return traceExpression(TraceOp_zext, result, {expr}, {bits});
 }
 
 Z3_ast _sym_build_trunc(Z3_ast expr, uint8_t bits) {
-  return registerExpression(Z3_mk_extract(g_context, bits - 1, 0, expr));
+  BackendLock lock;
+  auto *result =
+      registerExpression(Z3_mk_extract(g_context, bits - 1, 0, expr));
+  return traceExpression(TraceOp_trunc, result, {expr}, {bits});
 }
 
 Z3_ast _sym_build_int_to_float(Z3_ast value, int is_double, int is_signed) {
+  BackendLock lock;
   auto *sort = FSORT(is_double);
   Z3_inc_ref(g_context, (Z3_ast)sort);
   auto *result = registerExpression(
@@ -368,19 +459,24 @@ Z3_ast _sym_build_int_to_float(Z3_ast value, int is_double, int is_signed) {
           ? Z3_mk_fpa_to_fp_signed(g_context, g_rounding_mode, value, sort)
           : Z3_mk_fpa_to_fp_unsigned(g_context, g_rounding_mode, value, sort));
   Z3_dec_ref(g_context, (Z3_ast)sort);
-  return result;
+  return traceExpression(TraceOp_int_to_float, result, {value},
+                         {static_cast<uint64_t>(is_double != 0),
+                          static_cast<uint64_t>(is_signed != 0)});
 }
 
 Z3_ast _sym_build_float_to_float(Z3_ast expr, int to_double) {
+  BackendLock lock;
   auto *sort = FSORT(to_double);
   Z3_inc_ref(g_context, (Z3_ast)sort);
   auto *result = registerExpression(
       Z3_mk_fpa_to_fp_float(g_context, g_rounding_mode, expr, sort));
   Z3_dec_ref(g_context, (Z3_ast)sort);
-  return result;
+  return traceExpression(TraceOp_float_to_float, result, {expr},
+                         {static_cast<uint64_t>(to_double != 0)});
 }
 
 Z3_ast _sym_build_bits_to_float(Z3_ast expr, int to_double) {
+  BackendLock lock;
   if (expr == nullptr)
     return nullptr;
 
@@ -388,36 +484,58 @@ Z3_ast _sym_build_bits_to_float(Z3_ast expr, int to_double) {
   Z3_inc_ref(g_context, (Z3_ast)sort);
   auto *result = registerExpression(Z3_mk_fpa_to_fp_bv(g_context, expr, sort));
   Z3_dec_ref(g_context, (Z3_ast)sort);
-  return result;
+  return traceExpression(TraceOp_bits_to_float, result, {expr},
+                         {static_cast<uint64_t>(to_double != 0)});
 }
 
 Z3_ast _sym_build_float_to_bits(Z3_ast expr) {
+  BackendLock lock;
   if (expr == nullptr)
     return nullptr;
-  return registerExpression(Z3_mk_fpa_to_ieee_bv(g_context, expr));
+  auto *result = registerExpression(Z3_mk_fpa_to_ieee_bv(g_context, expr));
+  return traceExpression(TraceOp_float_to_bits, result, {expr});
 }
 
 Z3_ast _sym_build_float_to_signed_integer(Z3_ast expr, uint8_t bits) {
-  return registerExpression(Z3_mk_fpa_to_sbv(
+  BackendLock lock;
+  auto *result = registerExpression(Z3_mk_fpa_to_sbv(
       g_context, Z3_mk_fpa_round_toward_zero(g_context), expr, bits));
+  return traceExpression(TraceOp_float_to_signed_integer, result, {expr},
+                         {bits});
 }
 
 Z3_ast _sym_build_float_to_unsigned_integer(Z3_ast expr, uint8_t bits) {
-  return registerExpression(Z3_mk_fpa_to_ubv(
+  BackendLock lock;
+  auto *result = registerExpression(Z3_mk_fpa_to_ubv(
       g_context, Z3_mk_fpa_round_toward_zero(g_context), expr, bits));
+  return traceExpression(TraceOp_float_to_unsigned_integer, result, {expr},
+                         {bits});
 }
 
 Z3_ast _sym_build_bool_to_bit(Z3_ast expr) {
-  return registerExpression(Z3_mk_ite(g_context, expr,
-                                      _sym_build_integer(1, 1),
-                                      _sym_build_integer(0, 1)));
+  BackendLock lock;
+  auto *result = registerExpression(Z3_mk_ite(
+      g_context, expr, _sym_build_integer(1, 1), _sym_build_integer(0, 1)));
+  return traceExpression(TraceOp_bool_to_bit, result, {expr});
 }
 
-void _sym_push_path_constraint(Z3_ast constraint, int taken,
-                               uintptr_t site_id [[maybe_unused]]) {
-  if (constraint == nullptr)
-    return;
+namespace {
 
+/// Check the solver's assertions, recording the query in the statistics.
+Z3_lbool checkSolver(uintptr_t siteId) {
+  statsSolverStart();
+  auto start = std::chrono::steady_clock::now();
+  auto result = Z3_solver_check(g_context, g_solver);
+  statsSolverQuery(siteId,
+                   result == Z3_L_TRUE    ? SolverResult::Sat
+                   : result == Z3_L_FALSE ? SolverResult::Unsat
+                                          : SolverResult::Unknown,
+                   std::chrono::steady_clock::now() - start);
+  return result;
+}
+
+/// Try to negate the constraint, then add it to the path.
+void pushPathConstraint(Z3_ast constraint, int taken, uintptr_t siteId) {
   constraint = Z3_simplify(g_context, constraint);
   Z3_inc_ref(g_context, constraint);
 
@@ -447,7 +565,7 @@ void _sym_push_path_constraint(Z3_ast constraint, int taken,
   fprintf(g_log, "Trying to solve:\n%s\n",
           Z3_solver_to_string(g_context, g_solver));
 
-  Z3_lbool feasible = Z3_solver_check(g_context, g_solver);
+  Z3_lbool feasible = checkSolver(siteId);
   if (feasible == Z3_L_TRUE) {
     Z3_model model = Z3_solver_get_model(g_context, g_solver);
     Z3_model_inc_ref(g_context, model);
@@ -471,25 +589,43 @@ void _sym_push_path_constraint(Z3_ast constraint, int taken,
   Z3_dec_ref(g_context, not_constraint);
 }
 
+} // namespace
+
+void _sym_push_path_constraint(Z3_ast constraint, int taken,
+                               uintptr_t site_id) {
+  BackendLock lock;
+  if (constraint == nullptr)
+    return;
+
+  tracePathConstraint(constraint, taken, site_id);
+  pushPathConstraint(constraint, taken, site_id);
+}
+
 void _sym_concretize_pointer(SymExpr value, const void* ptr, uintptr_t site_id ) {
+  BackendLock lock;
   if (value == nullptr)
     return;
+  traceConcretization(TraceOp_concretize_pointer, value, (uintptr_t)ptr,
+                      site_id);
   SymExpr pointer_expr = _sym_build_integer((uintptr_t)ptr, 64);
   SymExpr constraint = _sym_build_equal(value, pointer_expr);
-  _sym_push_path_constraint(constraint, 1, site_id);
+  pushPathConstraint(constraint, 1, site_id);
 }
 void _sym_concretize_size(SymExpr value, size_t sz, uintptr_t site_id) {
+  BackendLock lock;
   if (value == nullptr)
     return;
+  traceConcretization(TraceOp_concretize_size, value, sz, site_id);
   SymExpr size_expr = _sym_build_integer((uintptr_t)sz, 64);
   SymExpr constraint = _sym_build_equal(value, size_expr);
-  _sym_push_path_constraint(constraint, 1, site_id);
+  pushPathConstraint(constraint, 1, site_id);
 }
 
 SymExpr _sym_backend_read_memory(
     SymExpr addr_expr, SymExpr concolic_read_value,
     uint8_t* addr, size_t length [[maybe_unused]], bool little_endian [[maybe_unused]]
 ) {
+  BackendLock lock;
   _sym_concretize_pointer(addr_expr, addr, 0);
   return concolic_read_value;
 }
@@ -498,6 +634,7 @@ void _sym_backend_write_memory(
     SymExpr symbolic_addr_expr, SymExpr written_expr [[maybe_unused]],
     uint8_t *concrete_addr, size_t concrete_length [[maybe_unused]], bool little_endian [[maybe_unused]]
 ) {
+  BackendLock lock;
   _sym_concretize_pointer(symbolic_addr_expr, concrete_addr, 0);
 }
 
@@ -505,6 +642,7 @@ void _sym_backend_memcpy(
     SymExpr sym_dest, SymExpr sym_src, SymExpr sym_len,
     uint8_t* dest, const uint8_t* src, size_t length
 ) {
+  BackendLock lock;
   _sym_concretize_pointer(sym_dest, dest, 0);
   _sym_concretize_pointer(sym_src, src, 0);
   _sym_concretize_size(sym_len, length, 0);
@@ -513,6 +651,7 @@ void _sym_backend_memset(
     SymExpr sym_dest, SymExpr sym_val [[maybe_unused]], SymExpr sym_len,
     uint8_t *memory, int value [[maybe_unused]], size_t length
 ) {
+  BackendLock lock;
   _sym_concretize_pointer(sym_dest, memory, 0);
   _sym_concretize_size(sym_len, length, 0);
   // we don't concretize the value, it's not used in addressing
@@ -521,6 +660,7 @@ void _sym_backend_memmove(
     SymExpr sym_dest, SymExpr sym_src, SymExpr sym_len,
     uint8_t *dest, const uint8_t *src, size_t length
 ) {
+  BackendLock lock;
   _sym_concretize_pointer(sym_dest, dest, 0);
   _sym_concretize_pointer(sym_src, src, 0);
   _sym_concretize_size(sym_len, length, 0);
@@ -528,15 +668,21 @@ void _sym_backend_memmove(
 
 
 SymExpr _sym_concat_helper(SymExpr a, SymExpr b) {
-  return registerExpression(Z3_mk_concat(g_context, a, b));
+  BackendLock lock;
+  auto *result = registerExpression(Z3_mk_concat(g_context, a, b));
+  return traceExpression(TraceOp_concat_helper, result, {a, b});
 }
 
 SymExpr _sym_extract_helper(SymExpr expr, size_t first_bit, size_t last_bit) {
-  return registerExpression(
+  BackendLock lock;
+  auto *result = registerExpression(
       Z3_mk_extract(g_context, first_bit, last_bit, expr));
+  return traceExpression(TraceOp_extract_helper, result, {expr},
+                         {first_bit, last_bit});
 }
 
 size_t _sym_bits_helper(SymExpr expr) {
+  BackendLock lock;
   auto *sort = Z3_get_sort(g_context, expr);
   Z3_inc_ref(g_context, (Z3_ast)sort);
   auto result = Z3_get_bv_sort_size(g_context, sort);
@@ -544,7 +690,9 @@ size_t _sym_bits_helper(SymExpr expr) {
   return result;
 }
 
-/* No call-stack tracing */
+/* No call-stack tracing, so instrumented code skips the notifications */
+const uint32_t _sym_backend_notifications = 0;
+
 void _sym_notify_call(uintptr_t) {}
 void _sym_notify_ret(uintptr_t) {}
 void _sym_notify_basic_block(uintptr_t) {}
@@ -553,29 +701,50 @@ void _sym_notify_ret_expr(SymExpr) {}
 
 /* Debugging */
 const char *_sym_expr_to_string(SymExpr expr) {
+  BackendLock lock;
   return Z3_ast_to_string(g_context, expr);
 }
 
 bool _sym_feasible(SymExpr expr) {
+  BackendLock lock;
   expr = Z3_simplify(g_context, expr);
   Z3_inc_ref(g_context, expr);
 
   Z3_solver_push(g_context, g_solver);
   Z3_solver_assert(g_context, g_solver, expr);
-  Z3_lbool feasible = Z3_solver_check(g_context, g_solver);
+  Z3_lbool feasible = checkSolver(0);
   Z3_solver_pop(g_context, g_solver, 1);
 
   Z3_dec_ref(g_context, expr);
   return (feasible == Z3_L_TRUE);
 }
 
+/* Persistent mode */
+void _sym_reset_backend(void) {
+  BackendLock lock;
+  for (auto *expr : allocatedExpressions)
+    Z3_dec_ref(g_context, expr);
+  allocatedExpressions.clear();
+  statsLiveExpressions(0);
+
+  for (auto *var : stdinBytes) {
+    if (var != nullptr)
+      Z3_dec_ref(g_context, var);
+  }
+  stdinBytes.clear();
+
+  Z3_solver_reset(g_context, g_solver);
+  traceReset();
+}
+
 /* Garbage collection */
 void _sym_collect_garbage() {
+  BackendLock lock;
   if (allocatedExpressions.size() < g_config.garbageCollectionThreshold)
     return;
 
+  auto start = std::chrono::steady_clock::now();
 #ifndef NDEBUG
-  auto start = std::chrono::high_resolution_clock::now();
   auto startSize = allocatedExpressions.size();
 #endif
 
@@ -588,9 +757,12 @@ void _sym_collect_garbage() {
       ++expr_it;
     }
   }
+  statsLiveExpressions(allocatedExpressions.size());
+
+  auto end = std::chrono::steady_clock::now();
+  statsGarbageCollection(end - start);
 
 #ifndef NDEBUG
-  auto end = std::chrono::high_resolution_clock::now();
   auto endSize = allocatedExpressions.size();
 
   std::cerr << "After garbage collection: " << endSize
@@ -0,0 +1,66 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// RUN: %symcc -O0 %s -o %t
+// RUN: echo -ne "\x04\x03\x02\x01\x08\x07\x06\x05\x0c\x0b\x0a\x09" | %t 2>&1 | %filecheck %s
+//
+// Check that we follow symbolic data through bit-counting intrinsics and
+// arithmetic with overflow check instead of concretizing the results. We
+// compile without optimization because InstCombine would otherwise turn the
+// comparisons below into comparisons of the input (e.g., popcount(x) == 32
+// into x == 0xffffffff), and SymCC wouldn't see the intrinsics at all.
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  uint32_t x[3];
+  if (read(STDIN_FILENO, x, sizeof(x)) != sizeof(x)) {
+    fprintf(stderr, "Failed to read x\n");
+    return -1;
+  }
+
+  fprintf(stderr, "%s\n", (__builtin_popcount(x[0]) == 32) ? "yes" : "no");
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // SIMPLE-DAG: stdin0 -> #xff
+  // SIMPLE-DAG: stdin1 -> #xff
+  // SIMPLE-DAG: stdin2 -> #xff
+  // SIMPLE-DAG: stdin3 -> #xff
+  // QSYM-COUNT-2: SMT
+  // ANY: no
+
+  fprintf(stderr, "%s\n", (__builtin_clz(x[1]) == 31) ? "yes" : "no");
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // SIMPLE-DAG: stdin4 -> #x01
+  // SIMPLE-DAG: stdin5 -> #x00
+  // SIMPLE-DAG: stdin6 -> #x00
+  // SIMPLE-DAG: stdin7 -> #x00
+  // QSYM-COUNT-2: SMT
+  // ANY: no
+
+  uint32_t sum;
+  fprintf(stderr, "%s\n",
+          __builtin_add_overflow(x[2], 0x10u, &sum) ? "overflow" : "fits");
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // SIMPLE-DAG: stdin9 -> #xff
+  // SIMPLE-DAG: stdin10 -> #xff
+  // SIMPLE-DAG: stdin11 -> #xff
+  // QSYM-COUNT-2: SMT
+  // ANY: fits
+
+  return 0;
+}
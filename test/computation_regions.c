@@ -0,0 +1,96 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// RUN: %symcc -O2 %s -o %t
+// RUN: echo -ne "\x05\x00\x00\x00\x07\x00\x00\x00" | %t 2>&1 | %filecheck %s
+// RUN: %symcc -O2 %s -S -emit-llvm -o - | FileCheck --check-prefix=BITCODE %s
+//
+// Consecutive computations in a basic block share a single concreteness check
+// on the inputs from outside the region. Check that the region's computations
+// still build the right expressions when only some of those inputs are
+// symbolic, in particular when the first computation's inputs are concrete and
+// the results computed inside the region are therefore, too.
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// Reading memory keeps SymCC from creating a concrete copy of combine (see
+// concrete_fast_path.c), which would share the check with the region.
+uint32_t scale = 3;
+
+__attribute__((noinline)) uint32_t combine(uint32_t a, uint32_t b) {
+  // The xor, the multiplication and the addition form a region; its inputs
+  // are the expressions of a, b and scale.
+  //
+  // BITCODE-LABEL: define {{.*}}@combine(
+  // BITCODE-COUNT-2: and i1
+  // BITCODE: br i1
+  // BITCODE-NOT: and i1
+  // BITCODE: _sym_build_xor
+  // BITCODE-NOT: and i1
+  // BITCODE: _sym_build_mul
+  // BITCODE-NOT: and i1
+  // BITCODE: _sym_build_add
+  // BITCODE: _sym_set_return_expression
+  return (a ^ 0x55) * scale + b;
+}
+
+void show(uint32_t result) {
+  fprintf(stderr, "%u %s\n", result, (result == 0x1234) ? "yes" : "no");
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t x[2];
+  if (read(STDIN_FILENO, x, sizeof(x)) != sizeof(x)) {
+    fprintf(stderr, "Failed to read x\n");
+    return -1;
+  }
+
+  show(combine(x[0], x[1]));
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // QSYM-COUNT-2: SMT
+  // ANY: 247 no
+
+  // Only the input of the first computation is symbolic.
+  show(combine(x[0], 7));
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // SIMPLE-DAG: stdin0 -> #x5a
+  // SIMPLE-DAG: stdin1 -> #x06
+  // SIMPLE-DAG: stdin2 -> #x00
+  // SIMPLE-DAG: stdin3 -> #x00
+  // QSYM-COUNT-2: SMT
+  // ANY: 247 no
+
+  // Only the input of the last computation is symbolic, so the results of the
+  // xor and the multiplication are concrete.
+  show(combine(5, x[1]));
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // SIMPLE-DAG: stdin4 -> #x44
+  // SIMPLE-DAG: stdin5 -> #x11
+  // SIMPLE-DAG: stdin6 -> #x00
+  // SIMPLE-DAG: stdin7 -> #x00
+  // QSYM-COUNT-2: SMT
+  // ANY: 247 no
+
+  // All inputs are concrete, so we skip the region.
+  show(combine(1, 2));
+  // SIMPLE-NOT: Trying to solve
+  // QSYM-NOT: SMT
+  // ANY: 254 no
+
+  return 0;
+}
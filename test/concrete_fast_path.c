@@ -0,0 +1,91 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// RUN: %symcc -O1 %s -o %t
+// RUN: echo -ne "\x05\x00\x00\x00" | %t 2>&1 | %filecheck %s
+//
+// Functions that don't read memory get a concrete copy that runs when all
+// arguments are concrete; in other functions, loops that don't read memory can
+// switch to a concrete copy when all values entering them are concrete. Check
+// that we only solve for the symbolic calls and that memory written by the
+// concrete copies doesn't keep stale expressions.
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static int result;
+
+__attribute__((noinline)) int compute(int a, int b, int *out) {
+  *out = 3 * a;
+  if (a * 2 < b)
+    return a;
+  return a + b;
+}
+
+// Reading memory rules out a copy of the whole function, but the loop doesn't
+// read memory.
+__attribute__((noinline)) int accumulate(const int *values, int n, int *out) {
+  int total = values[0];
+  for (int i = 1; i < n; i++) {
+    total = 3 * total + i;
+    out[i] = total;
+  }
+  return total;
+}
+
+int main(int argc, char *argv[]) {
+  int x;
+  if (read(STDIN_FILENO, &x, sizeof(x)) != sizeof(x)) {
+    fprintf(stderr, "Failed to read x\n");
+    return -1;
+  }
+
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // QSYM-COUNT-2: SMT
+  fprintf(stderr, "%d\n", compute(x, 7, &result));
+  // ANY: 12
+
+  // The call with concrete arguments must overwrite the symbolic shadow of
+  // result, so the following branch doesn't involve the solver.
+  fprintf(stderr, "%d\n", compute(1, 7, &result));
+  // ANY: 1
+  // SIMPLE-NOT: Trying to solve
+  // QSYM-NOT: SMT
+  if (result == 42)
+    fprintf(stderr, "unreachable\n");
+  fprintf(stderr, "%d\n", result);
+  // ANY: 3
+
+  int history[4];
+  int total = accumulate(&x, 4, history);
+  fprintf(stderr, "%d %s\n", total, (total == 42) ? "yes" : "no");
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // QSYM-COUNT-2: SMT
+  // ANY: 153 no
+
+  // With a concrete start value, the loop runs in the concrete copy, which
+  // must overwrite the symbolic shadow of history.
+  int start = 5;
+  fprintf(stderr, "%d\n", accumulate(&start, 4, history));
+  // ANY: 153
+  // SIMPLE-NOT: Trying to solve
+  // QSYM-NOT: SMT
+  if (history[3] == 42)
+    fprintf(stderr, "unreachable\n");
+  fprintf(stderr, "%d\n", history[3]);
+  // ANY: 153
+  return 0;
+}
@@ -0,0 +1,43 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+
+// RUN: %symcc -O2 %s -o %t
+// RUN: echo -ne "\x05" | env SYMCC_EXPLORE=2 %t 2>&1 | %filecheck %s
+//
+// In exploration mode, the process forks for each new input that the solver
+// finds. Only the QSYM backend writes test cases, so the simple backend just
+// runs on the original input.
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  uint8_t input;
+  if (read(STDIN_FILENO, &input, sizeof(input)) != sizeof(input)) {
+    fprintf(stderr, "Failed to read the input\n");
+    return -1;
+  }
+
+  fprintf(stderr, "%s\n", (input == 42) ? "yes" : "no");
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // SIMPLE: stdin0 -> #x2a
+  // ANY-DAG: no
+  // QSYM-DAG: yes
+
+  return 0;
+}
+// SIMPLE: Explored 1 input(s), generating 0 new test case(s)
+// QSYM: Explored 2 input(s), generating 1 new test case(s)
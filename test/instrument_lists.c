@@ -0,0 +1,62 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// RUN: echo "fun:excluded_*" > %t.denylist
+// RUN: env SYMCC_INSTRUMENT_DENYLIST=%t.denylist %symcc %s -o %t
+// RUN: echo -ne "\x01\x02\x03" | %t 2>&1 | %filecheck %s
+//
+// Check that functions excluded from instrumentation treat their values as
+// concrete without leaving stale expressions for the instrumented code.
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+__attribute__((noinline)) void excluded_overwrite(uint8_t *byte) {
+  *byte = 5;
+}
+
+__attribute__((noinline)) int instrumented_identity(int x) { return x; }
+
+__attribute__((noinline)) int excluded_increment(int x) {
+  return instrumented_identity(x + 1);
+}
+
+int main(int argc, char *argv[]) {
+  uint8_t input[3];
+  if (read(STDIN_FILENO, input, sizeof(input)) != sizeof(input)) {
+    fprintf(stderr, "Failed to read the input\n");
+    return -1;
+  }
+
+  // The excluded function has to clear the shadow of the memory it writes.
+  excluded_overwrite(&input[0]);
+  fprintf(stderr, "%s\n", (input[0] == 7) ? "yes" : "no");
+  // SIMPLE-NOT: Trying to solve
+  // ANY: no
+
+  // Neither the excluded function nor the instrumented function that it calls
+  // may return the expression that we pass for the parameter.
+  fprintf(stderr, "%s\n", (excluded_increment(input[1]) == 7) ? "yes" : "no");
+  // SIMPLE-NOT: Trying to solve
+  // ANY: no
+
+  fprintf(stderr, "%s\n", (input[2] == 7) ? "yes" : "no");
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // SIMPLE: stdin2 -> #x07
+  // QSYM-COUNT-2: SMT
+  // ANY: no
+
+  return 0;
+}
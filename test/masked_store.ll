@@ -0,0 +1,62 @@
+; RUN: %symcc -O0 %s -o %t
+; RUN: echo -ne "\x01\x02\x03\x04" | %t 2>&1 | %filecheck %s
+;
+; A masked store only overwrites the selected elements, so the others have to
+; keep their expressions. We store concrete data over the first element with a
+; constant mask and over the second and the fourth with a mask that we only
+; know at run time; the third element remains symbolic.
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+@stderr = external global i8*
+@format = private constant [16 x i8] c"element %d: %s\0A\00"
+@yes = private constant [4 x i8] c"yes\00"
+@no = private constant [3 x i8] c"no\00"
+@selection = global <4 x i8> <i8 0, i8 1, i8 0, i8 1>
+
+declare i64 @read(i32, i8*, i64)
+declare i32 @fprintf(i8*, i8*, ...)
+declare void @llvm.masked.store.v4i8.p0v4i8(<4 x i8>, <4 x i8>*, i32, <4 x i1>)
+
+define void @show(i8* %bytes, i32 %index) {
+  %address = getelementptr i8, i8* %bytes, i32 %index
+  %byte = load i8, i8* %address
+  %isMagic = icmp eq i8 %byte, 42
+  %answer = select i1 %isMagic, i8* getelementptr ([4 x i8], [4 x i8]* @yes, i32 0, i32 0), i8* getelementptr ([3 x i8], [3 x i8]* @no, i32 0, i32 0)
+  %stream = load i8*, i8** @stderr
+  %ignored = call i32 (i8*, i8*, ...) @fprintf(i8* %stream, i8* getelementptr ([16 x i8], [16 x i8]* @format, i32 0, i32 0), i32 %index, i8* %answer)
+  ret void
+}
+
+define i32 @main() {
+  %buffer = alloca <4 x i8>
+  %bytes = bitcast <4 x i8>* %buffer to i8*
+  %length = call i64 @read(i32 0, i8* %bytes, i64 4)
+
+  call void @llvm.masked.store.v4i8.p0v4i8(<4 x i8> <i8 9, i8 9, i8 9, i8 9>, <4 x i8>* %buffer, i32 1, <4 x i1> <i1 true, i1 false, i1 false, i1 false>)
+  %selection = load <4 x i8>, <4 x i8>* @selection
+  %mask = icmp ne <4 x i8> %selection, zeroinitializer
+  call void @llvm.masked.store.v4i8.p0v4i8(<4 x i8> <i8 7, i8 7, i8 7, i8 7>, <4 x i8>* %buffer, i32 1, <4 x i1> %mask)
+
+  ; SIMPLE-NOT: Trying to solve
+  ; QSYM-NOT: SMT
+  ; ANY: element 0: no
+  call void @show(i8* %bytes, i32 0)
+  ; SIMPLE-NOT: Trying to solve
+  ; QSYM-NOT: SMT
+  ; ANY: element 1: no
+  call void @show(i8* %bytes, i32 1)
+  ; SIMPLE: Trying to solve
+  ; SIMPLE: Found diverging input
+  ; SIMPLE: stdin2 -> #x2a
+  ; QSYM-COUNT-2: SMT
+  ; ANY: element 2: no
+  call void @show(i8* %bytes, i32 2)
+  ; SIMPLE-NOT: Trying to solve
+  ; QSYM-NOT: SMT
+  ; ANY: element 3: no
+  call void @show(i8* %bytes, i32 3)
+
+  ret i32 0
+}
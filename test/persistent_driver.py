@@ -0,0 +1,64 @@
+# This file is part of SymCC.
+#
+# SymCC is free software: you can redistribute it and/or modify it under the
+# terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+# WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+# A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along with
+# SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+"""Drive a program in persistent mode like the fuzzing helper does.
+
+Usage: persistent_driver.py PROGRAM INPUT...
+
+Each input is given in hex. The driver hands the inputs to the program over
+the control channel (see runtime/ControlChannel.h), one request at a time, and
+prints the status that the program reports for each of them. At the end, it
+prints the test cases that the program left in the output directory.
+"""
+
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+
+
+def main():
+    program, inputs = sys.argv[1], sys.argv[2:]
+    output_dir = os.environ.get("SYMCC_OUTPUT_DIR", tempfile.gettempdir())
+    ours, theirs = socket.socketpair()
+    env = dict(os.environ, SYMCC_CONTROL_FD=str(theirs.fileno()))
+    process = subprocess.Popen(
+        [program], env=env, pass_fds=[theirs.fileno()], stdin=subprocess.DEVNULL
+    )
+    theirs.close()
+
+    channel = ours.makefile("rwb", buffering=0)
+    with tempfile.TemporaryDirectory() as directory:
+        for index, data in enumerate(inputs):
+            input_file = os.path.join(directory, "input-%d" % index)
+            with open(input_file, "wb") as f:
+                f.write(bytes.fromhex(data))
+
+            channel.write(("%s\n%s\n" % (input_file, output_dir)).encode())
+            status = channel.readline().decode().strip()
+            print("Input %d: status %s" % (index, status), flush=True)
+
+    ours.shutdown(socket.SHUT_WR)
+    status = process.wait()
+
+    for name in sorted(os.listdir(output_dir)):
+        with open(os.path.join(output_dir, name), "rb") as f:
+            print("Test case %s: %s" % (name, f.read().hex()), flush=True)
+
+    sys.exit(status)
+
+
+if __name__ == "__main__":
+    main()
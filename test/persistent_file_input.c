@@ -0,0 +1,62 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// RUN: /bin/echo -ne "\x01" > %T/%basename_t.input
+// RUN: %symcc -O2 %s -o %t
+// RUN: rm -rf %t.out && mkdir %t.out
+// RUN: env SYMCC_OUTPUT_DIR=%t.out SYMCC_INPUT_FILE=%T/%basename_t.input %python %S/persistent_driver.py %t 05 07 2>&1 | %filecheck %s
+//
+// The driver sends a different file for each input, but the program keeps
+// opening the configured input file; it has to get the driver's file instead.
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int symcc_reset(void);
+
+int main(int argc, char *argv[]) {
+  while (symcc_reset()) {
+    int fd = open(getenv("SYMCC_INPUT_FILE"), O_RDONLY);
+    if (fd < 0) {
+      perror("failed to open the input file");
+      return -1;
+    }
+
+    uint8_t input;
+    if (read(fd, &input, sizeof(input)) != sizeof(input)) {
+      perror("failed to read from the input file");
+      return -1;
+    }
+    close(fd);
+
+    fprintf(stderr, "%d %s\n", input, (input == 42) ? "yes" : "no");
+  }
+
+  return 0;
+}
+
+// ANY-NOT: Warning
+// SIMPLE: Trying to solve
+// SIMPLE: Found diverging input
+// SIMPLE: stdin0 -> #x2a
+// QSYM-COUNT-2: SMT
+// ANY: 5 no
+// ANY-NEXT: Input 0: status 0
+// SIMPLE: Trying to solve
+// SIMPLE: Found diverging input
+// SIMPLE: stdin0 -> #x2a
+// ANY: 7 no
+// ANY-NEXT: Input 1: status 0
@@ -0,0 +1,89 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// RUN: %symcc -O2 %s -o %t
+// RUN: rm -rf %t.out && mkdir %t.out
+// RUN: env SYMCC_OUTPUT_DIR=%t.out %python %S/persistent_driver.py %t 05 07 2>&1 | %filecheck %s
+//
+// With a driver on the control channel, the persistent-mode loop runs once per
+// input. Each iteration has to start from scratch: the input is read from
+// offset 0 again, and neither the path constraints nor the shadow memory of the
+// previous iteration are left over. Without an output ring, the test cases stay
+// in the output directory across iterations.
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+int symcc_reset(void);
+
+// Kept across iterations, but only its concrete value should survive.
+uint8_t previous;
+
+int main(int argc, char *argv[]) {
+  int iterations = 0;
+
+  while (symcc_reset()) {
+    uint8_t input;
+    if (read(STDIN_FILENO, &input, sizeof(input)) != sizeof(input)) {
+      fprintf(stderr, "Failed to read the input\n");
+      return -1;
+    }
+
+    if (iterations > 0)
+      fprintf(stderr, "%s\n", (previous == 7) ? "seven" : "other");
+
+    fprintf(stderr, "%s\n", (input == 42) ? "yes" : "no");
+    previous = input;
+    iterations++;
+  }
+
+  fprintf(stderr, "%d iteration(s)\n", iterations);
+  return 0;
+}
+
+// The first input is 0x05.
+//
+// SIMPLE: Trying to solve
+// SIMPLE-NEXT: (declare-fun stdin0 () (_ BitVec 8))
+// SIMPLE-NEXT: (assert (= stdin0 #x2a))
+// SIMPLE-EMPTY:
+// SIMPLE-NEXT: Found diverging input
+// SIMPLE-NEXT: stdin0 -> #x2a
+// QSYM-COUNT-2: SMT
+// ANY: no
+// ANY-NEXT: Input 0: status 0
+//
+// The second input is 0x07. The comparison of the previous byte doesn't reach
+// the solver, and the input's byte is called stdin0 again. The solver only
+// knows the current iteration's branch; in particular, it doesn't assert that
+// the first byte was different from 42.
+//
+// SIMPLE-NOT: Trying to solve
+// ANY: other
+// SIMPLE-NEXT: Trying to solve
+// SIMPLE-NEXT: (declare-fun stdin0 () (_ BitVec 8))
+// SIMPLE-NEXT: (assert (= stdin0 #x2a))
+// SIMPLE-EMPTY:
+// SIMPLE-NEXT: Found diverging input
+// SIMPLE-NEXT: stdin0 -> #x2a
+// ANY: no
+// ANY-NEXT: Input 1: status 0
+// ANY-NEXT: 2 iteration(s)
+//
+// Only the QSYM backend writes test cases. Both iterations find the same one,
+// so the runtime drops it the second time.
+//
+// SIMPLE-NOT: Test case
+// QSYM-NEXT: Test case 000000: 2a
+// QSYM-NOT: Test case
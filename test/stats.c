@@ -0,0 +1,46 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+
+// RUN: %symcc -O2 %s -o %t
+// RUN: echo -ne "\x05\x00" | env SYMCC_STATS_FILE=%t.json %t 2>&1 | %filecheck %s
+// RUN: cat %t.json | FileCheck --check-prefix=STATS %s
+//
+// The runtime counts the input bytes that it reads and attributes the solver
+// query for the branch to its site.
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  char input[2];
+  if (read(STDIN_FILENO, input, sizeof(input)) != sizeof(input)) {
+    fprintf(stderr, "Failed to read the input\n");
+    return -1;
+  }
+
+  fprintf(stderr, "%s\n", (input[0] == '*') ? "yes" : "no");
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // SIMPLE-DAG: stdin0 -> #x2a
+  // QSYM-COUNT-1: SMT
+  // ANY: no
+
+  return 0;
+}
+// STATS: "get_input_byte": 2,
+// STATS: "shadow_pages":
+// STATS: "solver": {"queries": 1,
+// STATS: "sites": [
+// STATS-NEXT: {"site_id": {{[0-9]+}}, "path_constraints": 1, "concretizations": 0,
@@ -0,0 +1,40 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// RUN: %symcc -O2 %s -o %t
+// RUN: rm -rf %t.out && mkdir %t.out
+// RUN: echo -ne "\x05\x00" | env SYMCC_TRACE_FILE=%t.trace %t 2>&1 | %filecheck %s
+// RUN: %trace_replay -j 2 -o %t.out %t.trace 2>&1 | FileCheck --check-prefix=REPLAY %s
+// RUN: cat %t.out/000000 | FileCheck --check-prefix=INPUT %s
+//
+// The replay tool solves the recorded path constraint offline and finds the
+// input that the program is looking for.
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  char input[2];
+  if (read(STDIN_FILENO, input, sizeof(input)) != sizeof(input)) {
+    fprintf(stderr, "Failed to read the input\n");
+    return -1;
+  }
+
+  fprintf(stderr, "%s\n", (input[0] == '*') ? "yes" : "no");
+  // ANY: no
+
+  return 0;
+}
+// REPLAY: Inverted 1 of 1 path constraints
+// INPUT: *
@@ -0,0 +1,55 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// RUN: env SYMCC_LATE_INSTRUMENTATION=1 %symcc -O3 %s -o %t
+// RUN: echo -ne "\x01\x00\x00\x00\x02\x00\x00\x00\x03\x00\x00\x00\x04\x00\x00\x00" | %t 2>&1 | %filecheck %s
+//
+// Check that we follow symbolic data through vector instructions, both from
+// vector types in the source and from loops that the optimizer vectorizes
+// before we instrument the code.
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+typedef uint32_t v4u32 __attribute__((vector_size(16)));
+
+int main(int argc, char *argv[]) {
+  v4u32 x;
+  if (read(STDIN_FILENO, &x, sizeof(x)) != sizeof(x)) {
+    fprintf(stderr, "Failed to read x\n");
+    return -1;
+  }
+
+  v4u32 y = x + (v4u32){1, 2, 3, 4};
+  v4u32 z = __builtin_shufflevector(y, y, 3, 2, 1, 0);
+  fprintf(stderr, "%s\n", (z[0] == 1234) ? "yes" : "no");
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // SIMPLE-DAG: stdin12 -> #xce
+  // SIMPLE-DAG: stdin13 -> #x04
+  // QSYM-COUNT-2: SMT
+  // ANY: no
+
+  const uint8_t *bytes = (const uint8_t *)&x;
+  unsigned sum = 0;
+  for (int i = 0; i < 16; i++)
+    sum += bytes[i] ^ 0x5a;
+  fprintf(stderr, "%s\n", (sum == 3000) ? "yes" : "no");
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // QSYM-COUNT-2: SMT
+  // ANY: no
+
+  return 0;
+}
@@ -0,0 +1,364 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+//! Persistent state of the fuzzing helper.
+//!
+//! In order to resume a campaign, we record everything that we learn about
+//! the fuzzer's queue in an append-only log, and we periodically write a
+//! snapshot of the entire state and start a new log. All records are
+//! idempotent (adding to a set, or-ing into the coverage map), so replaying a
+//! log on top of a snapshot that already contains some of its records is
+//! harmless; this keeps the switch to a new snapshot simple.
+
+use crate::symcc::AflMap;
+use anyhow::{bail, ensure, Context, Result};
+use std::collections::HashSet;
+use std::ffi::OsStr;
+use std::fs::{self, File, OpenOptions};
+use std::io::{self, BufReader, BufWriter, Read, Write};
+use std::os::unix::ffi::OsStrExt;
+use std::path::{Path, PathBuf};
+
+/// The first bytes of a snapshot, identifying the format.
+const SNAPSHOT_MAGIC: &[u8; 8] = b"SYMCCJ01";
+
+const RECORD_PROCESSED: u8 = b'P';
+const RECORD_GENERATED: u8 = b'G';
+const RECORD_COVERAGE: u8 = b'C';
+
+/// The state that survives a restart of the helper.
+pub struct PersistentState {
+    /// The AFL test cases that have been analyzed.
+    pub processed_files: HashSet<PathBuf>,
+
+    /// Hashes of the contents of all test cases that SymCC has generated.
+    pub generated_testcases: HashSet<u64>,
+
+    /// The cumulative coverage of all test cases generated so far.
+    pub coverage: AflMap,
+}
+
+impl PersistentState {
+    pub fn new() -> Self {
+        PersistentState {
+            processed_files: HashSet::new(),
+            generated_testcases: HashSet::new(),
+            coverage: AflMap::new(),
+        }
+    }
+}
+
+/// The on-disk journal of the persistent state.
+pub struct Journal {
+    /// The directory containing the snapshot and the log.
+    dir: PathBuf,
+
+    /// The log of changes since the last snapshot.
+    log: File,
+}
+
+impl Journal {
+    /// Start a new journal in the given directory, which must not exist yet.
+    pub fn create(dir: impl AsRef<Path>) -> Result<Self> {
+        fs::create_dir(&dir).with_context(|| {
+            format!(
+                "Failed to create the state directory {}",
+                dir.as_ref().display()
+            )
+        })?;
+        let mut journal = Journal {
+            dir: dir.as_ref().to_path_buf(),
+            log: Journal::open_log(dir.as_ref())?,
+        };
+        journal.write_snapshot(&PersistentState::new())?;
+        Ok(journal)
+    }
+
+    /// Recover the state from the journal in the given directory.
+    pub fn resume(dir: impl AsRef<Path>) -> Result<(Self, PersistentState)> {
+        let mut state = PersistentState::new();
+        let snapshot_path = dir.as_ref().join("snapshot");
+        Journal::read_snapshot(&snapshot_path, &mut state)
+            .with_context(|| format!("Failed to read the snapshot {}", snapshot_path.display()))?;
+
+        let log_path = dir.as_ref().join("log");
+        if log_path.exists() {
+            let valid_length = Journal::replay_log(&log_path, &mut state)
+                .with_context(|| format!("Failed to replay the log {}", log_path.display()))?;
+            // Drop a truncated record at the end, so that new records don't
+            // get appended to it.
+            OpenOptions::new()
+                .write(true)
+                .open(&log_path)
+                .and_then(|log| log.set_len(valid_length))
+                .with_context(|| format!("Failed to repair the log {}", log_path.display()))?;
+        }
+
+        let journal = Journal {
+            dir: dir.as_ref().to_path_buf(),
+            log: Journal::open_log(dir.as_ref())?,
+        };
+        Ok((journal, state))
+    }
+
+    fn open_log(dir: &Path) -> Result<File> {
+        let path = dir.join("log");
+        OpenOptions::new()
+            .create(true)
+            .append(true)
+            .open(&path)
+            .with_context(|| format!("Failed to open the log {}", path.display()))
+    }
+
+    /// Record that we have analyzed an AFL test case.
+    pub fn processed(&mut self, path: &Path) -> Result<()> {
+        let mut record = vec![RECORD_PROCESSED];
+        write_bytes(&mut record, path.as_os_str().as_bytes())?;
+        self.append(&record)
+    }
+
+    /// Record the hash of a generated test case.
+    pub fn generated(&mut self, hash: u64) -> Result<()> {
+        let mut record = vec![RECORD_GENERATED];
+        record.extend_from_slice(&hash.to_le_bytes());
+        self.append(&record)
+    }
+
+    /// Record new coverage as a list of indices and bits.
+    pub fn coverage(&mut self, new_bits: &[(usize, u8)]) -> Result<()> {
+        let mut record = vec![RECORD_COVERAGE];
+        record.extend_from_slice(&(new_bits.len() as u32).to_le_bytes());
+        for (index, bits) in new_bits {
+            record.extend_from_slice(&(*index as u32).to_le_bytes());
+            record.push(*bits);
+        }
+        self.append(&record)
+    }
+
+    fn append(&mut self, record: &[u8]) -> Result<()> {
+        // A single write per record keeps records intact unless we crash in
+        // the middle; replay ignores a truncated record at the end.
+        self.log
+            .write_all(record)
+            .context("Failed to append to the state log")
+    }
+
+    /// Write a snapshot of the complete state and start a new log.
+    pub fn write_snapshot(&mut self, state: &PersistentState) -> Result<()> {
+        let tmp_path = self.dir.join("snapshot.tmp");
+        {
+            let mut out = BufWriter::new(File::create(&tmp_path).with_context(|| {
+                format!("Failed to create the snapshot {}", tmp_path.display())
+            })?);
+            out.write_all(SNAPSHOT_MAGIC)?;
+            out.write_all(state.coverage.bits())?;
+            out.write_all(&(state.processed_files.len() as u64).to_le_bytes())?;
+            for path in state.processed_files.iter() {
+                write_bytes(&mut out, path.as_os_str().as_bytes())?;
+            }
+            out.write_all(&(state.generated_testcases.len() as u64).to_le_bytes())?;
+            for hash in state.generated_testcases.iter() {
+                out.write_all(&hash.to_le_bytes())?;
+            }
+            out.into_inner()
+                .map_err(|e| e.into_error())?
+                .sync_all()
+                .context("Failed to write the snapshot")?;
+        }
+
+        fs::rename(&tmp_path, self.dir.join("snapshot"))
+            .context("Failed to replace the snapshot")?;
+        self.log.set_len(0).context("Failed to truncate the log")?;
+        Ok(())
+    }
+
+    fn read_snapshot(path: &Path, state: &mut PersistentState) -> Result<()> {
+        let mut input = BufReader::new(File::open(path)?);
+        let mut magic = [0u8; 8];
+        input.read_exact(&mut magic)?;
+        ensure!(&magic == SNAPSHOT_MAGIC, "Unknown snapshot format");
+
+        let mut bits = vec![0u8; state.coverage.bits().len()];
+        input.read_exact(&mut bits)?;
+        for (index, b) in bits.into_iter().enumerate() {
+            state.coverage.add_bits(index, b);
+        }
+
+        for _ in 0..read_u64(&mut input)? {
+            let path = read_bytes(&mut input)?;
+            state
+                .processed_files
+                .insert(PathBuf::from(OsStr::from_bytes(&path)));
+        }
+        for _ in 0..read_u64(&mut input)? {
+            state.generated_testcases.insert(read_u64(&mut input)?);
+        }
+
+        Ok(())
+    }
+
+    /// Apply the records in the log to the state, returning the length of
+    /// the log up to the end of the last complete record.
+    fn replay_log(path: &Path, state: &mut PersistentState) -> Result<u64> {
+        // The log only covers the time since the last snapshot, so it's small
+        // enough to read at once.
+        let log = fs::read(path)?;
+        let mut input = io::Cursor::new(&log[..]);
+        loop {
+            let record_start = input.position();
+            let mut kind = [0u8];
+            match input.read_exact(&mut kind) {
+                Ok(()) => {}
+                Err(e) if e.kind() == io::ErrorKind::UnexpectedEof => return Ok(record_start),
+                Err(e) => return Err(e.into()),
+            }
+
+            let result = match kind[0] {
+                RECORD_PROCESSED => read_bytes(&mut input).map(|path| {
+                    state
+                        .processed_files
+                        .insert(PathBuf::from(OsStr::from_bytes(&path)));
+                }),
+                RECORD_GENERATED => read_u64(&mut input).map(|hash| {
+                    state.generated_testcases.insert(hash);
+                }),
+                RECORD_COVERAGE => read_coverage(&mut input).map(|new_bits| {
+                    for (index, bits) in new_bits {
+                        state.coverage.add_bits(index, bits);
+                    }
+                }),
+                unknown => bail!("Unknown record type {}", unknown),
+            };
+
+            match result {
+                Ok(()) => {}
+                Err(e) if e.kind() == io::ErrorKind::UnexpectedEof => {
+                    log::warn!("Ignoring a truncated record at the end of the log");
+                    return Ok(record_start);
+                }
+                Err(e) => return Err(e.into()),
+            }
+        }
+    }
+}
+
+fn write_bytes(out: &mut impl Write, bytes: &[u8]) -> io::Result<()> {
+    out.write_all(&(bytes.len() as u32).to_le_bytes())?;
+    out.write_all(bytes)
+}
+
+fn read_u32(input: &mut impl Read) -> io::Result<u32> {
+    let mut value = [0u8; 4];
+    input.read_exact(&mut value)?;
+    Ok(u32::from_le_bytes(value))
+}
+
+fn read_u64(input: &mut impl Read) -> io::Result<u64> {
+    let mut value = [0u8; 8];
+    input.read_exact(&mut value)?;
+    Ok(u64::from_le_bytes(value))
+}
+
+fn read_bytes(input: &mut impl Read) -> io::Result<Vec<u8>> {
+    // Don't trust the length before we've seen the data: a damaged length
+    // would make us allocate up to 4 GiB.
+    let length = read_u32(input)? as u64;
+    let mut bytes = Vec::new();
+    input.take(length).read_to_end(&mut bytes)?;
+    if (bytes.len() as u64) < length {
+        return Err(io::ErrorKind::UnexpectedEof.into());
+    }
+    Ok(bytes)
+}
+
+fn read_coverage(input: &mut impl Read) -> io::Result<Vec<(usize, u8)>> {
+    let count = read_u32(input)?;
+    let mut result = Vec::new();
+    for _ in 0..count {
+        let index = read_u32(input)? as usize;
+        let mut bits = [0u8];
+        input.read_exact(&mut bits)?;
+        result.push((index, bits[0]));
+    }
+    Ok(result)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_resume() {
+        let dir = tempfile::tempdir().unwrap();
+        let journal_dir = dir.path().join("state");
+        let mut journal = Journal::create(&journal_dir).unwrap();
+        let mut state = PersistentState::new();
+
+        state
+            .processed_files
+            .insert(PathBuf::from("/queue/id:000000"));
+        journal.processed(Path::new("/queue/id:000000")).unwrap();
+        journal.write_snapshot(&state).unwrap();
+
+        journal.processed(Path::new("/queue/id:000001")).unwrap();
+        journal.generated(42).unwrap();
+        journal.coverage(&[(7, 1), (65535, 128)]).unwrap();
+        // Simulate a crash in the middle of a record.
+        journal.log.write_all(&[RECORD_GENERATED, 1, 2]).unwrap();
+        drop(journal);
+
+        let (mut journal, recovered) = Journal::resume(&journal_dir).unwrap();
+        assert_eq!(recovered.processed_files.len(), 2);
+        assert!(recovered
+            .processed_files
+            .contains(Path::new("/queue/id:000001")));
+        assert!(recovered.generated_testcases.contains(&42));
+        assert_eq!(recovered.coverage.bits()[7], 1);
+        assert_eq!(recovered.coverage.bits()[65535], 128);
+
+        // Records after the recovery must not get mixed up with the truncated
+        // one.
+        journal.generated(43).unwrap();
+        journal.processed(Path::new("/queue/id:000002")).unwrap();
+        drop(journal);
+
+        let (_, recovered) = Journal::resume(&journal_dir).unwrap();
+        assert_eq!(recovered.processed_files.len(), 3);
+        assert!(recovered
+            .processed_files
+            .contains(Path::new("/queue/id:000002")));
+        assert_eq!(recovered.generated_testcases.len(), 2);
+        assert!(recovered.generated_testcases.contains(&43));
+        assert_eq!(recovered.coverage.bits()[65535], 128);
+    }
+
+    #[test]
+    fn test_damaged_length() {
+        let dir = tempfile::tempdir().unwrap();
+        let journal_dir = dir.path().join("state");
+        let mut journal = Journal::create(&journal_dir).unwrap();
+        journal.generated(42).unwrap();
+        // A path record that claims to be almost 4 GiB long
+        journal
+            .log
+            .write_all(&[RECORD_PROCESSED, 0xff, 0xff, 0xff, 0xf0, b'/'])
+            .unwrap();
+        drop(journal);
+
+        let (_, recovered) = Journal::resume(&journal_dir).unwrap();
+        assert!(recovered.generated_testcases.contains(&42));
+        assert!(recovered.processed_files.is_empty());
+        assert_eq!(fs::metadata(journal_dir.join("log")).unwrap().len(), 9);
+    }
+}
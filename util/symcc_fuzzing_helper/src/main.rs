@@ -12,18 +12,25 @@
 // You should have received a copy of the GNU General Public License along with
 // SymCC. If not, see <https://www.gnu.org/licenses/>.
 
+mod journal;
+mod scheduler;
 mod symcc;
 
 use anyhow::{Context, Result};
 use clap::{self, StructOpt};
-use std::collections::HashSet;
+use journal::{Journal, PersistentState};
+use std::cell::RefCell;
 use std::fs;
-use std::fs::File;
+use std::fs::{File, OpenOptions};
 use std::io::Write;
+use std::os::unix::io::RawFd;
 use std::path::{Path, PathBuf};
+use std::sync::{mpsc, Arc, Mutex};
 use std::thread;
 use std::time::{Duration, Instant};
-use symcc::{AflConfig, AflMap, AflShowmapResult, SymCC, TestcaseDir};
+use symcc::{
+    AflConfig, AflForkserver, AflMap, AflQueue, AflShowmapResult, SymCC, TargetMode, TestcaseDir,
+};
 use tempfile::tempdir;
 
 const STATS_INTERVAL_SEC: u64 = 60;
@@ -50,6 +57,24 @@ struct CLI {
     #[clap(short = 'v')]
     verbose: bool,
 
+    /// Keep the target running across inputs (for programs that call
+    /// symcc_reset in a loop)
+    #[clap(short = 'p', long)]
+    persistent: bool,
+
+    /// Start a new process for each input instead of using the runtime's fork
+    /// server
+    #[clap(long)]
+    no_fork_server: bool,
+
+    /// Resume from the state of a previous run with the same name
+    #[clap(long)]
+    resume: bool,
+
+    /// Number of SymCC executions to run in parallel
+    #[clap(short = 'j', long, default_value = "1")]
+    jobs: usize,
+
     /// Program under test
     command: Vec<String>,
 }
@@ -158,11 +183,15 @@ impl Stats {
 ///
 /// This is a collection of the state we update during execution.
 struct State {
-    /// The cumulative coverage of all test cases generated so far.
-    current_bitmap: AflMap,
+    /// The processed test cases, generated test cases and coverage, which
+    /// survive restarts.
+    persistent: PersistentState,
+
+    /// The on-disk record of the persistent state.
+    journal: Journal,
 
-    /// The AFL test cases that have been analyzed so far.
-    processed_files: HashSet<PathBuf>,
+    /// The fuzzer's queue of test cases.
+    afl_queue: AflQueue,
 
     /// The place to put new and useful test cases.
     queue: TestcaseDir,
@@ -187,9 +216,35 @@ impl State {
     /// Initialize the run-time environment in the given output directory.
     ///
     /// This involves creating the output directory and all required
-    /// subdirectories.
-    fn initialize(output_dir: impl AsRef<Path>) -> Result<Self> {
+    /// subdirectories, or, when resuming, recovering the state of the previous
+    /// run from them.
+    fn initialize(output_dir: impl AsRef<Path>, afl_queue: AflQueue, resume: bool) -> Result<Self> {
         let symcc_dir = output_dir.as_ref();
+        let state_dir = symcc_dir.join("state");
+
+        if resume {
+            let (journal, persistent) = Journal::resume(&state_dir)
+                .context("Failed to recover the state of the previous run")?;
+            log::info!(
+                "Resuming after {} processed test cases",
+                persistent.processed_files.len()
+            );
+
+            return Ok(State {
+                persistent,
+                journal,
+                afl_queue,
+                queue: TestcaseDir::open(symcc_dir.join("queue"))?,
+                hangs: TestcaseDir::open(symcc_dir.join("hangs"))?,
+                crashes: TestcaseDir::open(symcc_dir.join("crashes"))?,
+                stats: Default::default(),
+                last_stats_output: Instant::now(),
+                stats_file: OpenOptions::new()
+                    .create(true)
+                    .append(true)
+                    .open(symcc_dir.join("stats"))?,
+            });
+        }
 
         fs::create_dir(&symcc_dir).with_context(|| {
             format!("Failed to create SymCC's directory {}", symcc_dir.display())
@@ -201,8 +256,9 @@ impl State {
         let stats_file = File::create(symcc_dir.join("stats"))?;
 
         Ok(State {
-            current_bitmap: AflMap::new(),
-            processed_files: HashSet::new(),
+            persistent: PersistentState::new(),
+            journal: Journal::create(&state_dir)?,
+            afl_queue,
             queue: symcc_queue,
             hangs: symcc_hangs,
             crashes: symcc_crashes,
@@ -212,14 +268,127 @@ impl State {
         })
     }
 
-    /// Run a single input through SymCC and process the new test cases it
-    /// generates.
-    fn test_input(
+    /// Pick the most promising test case from AFL's queue that hasn't been
+    /// analyzed yet.
+    ///
+    /// The queue hands out each test case only once, so other workers won't
+    /// pick it up while we're working on it.
+    fn next_input(&mut self) -> Result<Option<PathBuf>> {
+        self.afl_queue
+            .pop_best(&self.persistent.processed_files)
+            .context("Failed to check for new test cases")
+    }
+
+    /// Record that we're done with a test case from AFL's queue, and let the
+    /// scheduler learn from the execution.
+    fn finish_input(
         &mut self,
-        input: impl AsRef<Path>,
-        symcc: &SymCC,
-        afl_config: &AflConfig,
+        input: &Path,
+        result: &symcc::SymCCResult,
+        new_testcases: u64,
     ) -> Result<()> {
+        self.stats.add_execution(result);
+        self.afl_queue.record(input, result.time, new_testcases);
+        self.persistent.processed_files.insert(input.to_path_buf());
+        self.journal.processed(input)
+    }
+
+    /// Record a test case generated by SymCC.
+    ///
+    /// Return false if we've seen the same test case before.
+    fn add_generated(&mut self, hash: u64) -> Result<bool> {
+        if !self.persistent.generated_testcases.insert(hash) {
+            return Ok(false);
+        }
+
+        self.journal.generated(hash)?;
+        Ok(true)
+    }
+
+    /// Merge the coverage of a test case into the cumulative coverage.
+    ///
+    /// Return true if the test case covers anything new.
+    fn merge_coverage(&mut self, map: &AflMap) -> Result<bool> {
+        let new_bits = self.persistent.coverage.merge(map);
+        if new_bits.is_empty() {
+            return Ok(false);
+        }
+
+        self.journal.coverage(&new_bits)?;
+        Ok(true)
+    }
+
+    /// Output the statistics if it's time to do so.
+    fn maybe_log_stats(&mut self) {
+        if self.last_stats_output.elapsed().as_secs() > STATS_INTERVAL_SEC {
+            if let Err(e) = self.stats.log(&mut self.stats_file) {
+                log::error!("Failed to log run-time statistics: {}", e);
+            }
+            if let Err(e) = self.journal.write_snapshot(&self.persistent) {
+                log::error!("Failed to save the state: {}", e);
+            }
+            self.last_stats_output = Instant::now();
+        }
+    }
+}
+
+/// Wait until the fuzzer's queue may contain new test cases.
+///
+/// We return after the timeout even if we don't hear from inotify, so that
+/// callers get a chance to do periodic work.
+fn wait_for_testcases(event_fd: Option<RawFd>, timeout: Duration) {
+    match event_fd {
+        Some(fd) => {
+            let mut poll_fd = libc::pollfd {
+                fd,
+                events: libc::POLLIN,
+                revents: 0,
+            };
+            unsafe { libc::poll(&mut poll_fd, 1, timeout.as_millis() as libc::c_int) };
+        }
+        None => thread::sleep(timeout),
+    }
+}
+
+/// A worker that runs SymCC on test cases from AFL's queue.
+///
+/// All workers share the state, so they never analyze the same input twice,
+/// and they merge the coverage of the test cases they generate into a single
+/// map. Each of them has its own SymCC configuration (and, hence, its own
+/// instance of the target).
+struct Worker {
+    symcc: SymCC,
+    afl_config: Arc<AflConfig>,
+    state: Arc<Mutex<State>>,
+
+    /// The AFL-instrumented target for coverage evaluation; we fall back to
+    /// afl-showmap if it isn't available.
+    forkserver: RefCell<Option<AflForkserver>>,
+}
+
+impl Worker {
+    /// Process test cases until something goes wrong.
+    fn run(&self) -> Result<()> {
+        loop {
+            let (input, event_fd) = {
+                let mut state = self.state.lock().unwrap();
+                (state.next_input()?, state.afl_queue.event_fd())
+            };
+            match input {
+                None => {
+                    log::debug!("Waiting for new test cases...");
+                    wait_for_testcases(event_fd, Duration::from_secs(5));
+                }
+                Some(input) => self.test_input(&input)?,
+            }
+
+            self.state.lock().unwrap().maybe_log_stats();
+        }
+    }
+
+    /// Run a single input through SymCC and process the new test cases it
+    /// generates.
+    fn test_input(&self, input: impl AsRef<Path>) -> Result<()> {
         log::info!("Running on input {}", input.as_ref().display());
 
         let tmp_dir = tempdir()
@@ -228,12 +397,15 @@ impl State {
         let mut num_interesting = 0u64;
         let mut num_total = 0u64;
         let mut num_failed = 0u64;
+        let mut num_duplicate = 0u64;
+        let mut num_crash = 0u64;
 
-        let symcc_result = symcc
+        let symcc_result = self
+            .symcc
             .run(&input, tmp_dir.path().join("output"))
             .context("Failed to run SymCC")?;
         for new_test in symcc_result.test_cases.iter() {
-            let res = process_new_testcase(&new_test, &input, &tmp_dir, &afl_config, self);
+            let res = self.process_new_testcase(new_test, &input, &tmp_dir);
 
             num_total += 1;
 
@@ -242,35 +414,115 @@ impl State {
                     log::error!("Showmap failed with {}", e);
                     num_failed += 1;
                 }
-                Ok(o) => {
-                    if o == TestcaseResult::New {
-                        log::debug!("Test case is interesting");
-                        num_interesting += 1;
-                    }
+                Ok(TestcaseResult::New) => {
+                    log::debug!("Test case is interesting");
+                    num_interesting += 1;
                 }
+                Ok(TestcaseResult::Duplicate) => num_duplicate += 1,
+                Ok(TestcaseResult::Crash) => num_crash += 1,
+                Ok(_) => {}
             };
         }
 
         log::info!(
-            "Generated {} test cases ({} new, {} failed)",
+            "Generated {} test cases ({} new, {} duplicates, {} failed)",
             num_total,
             num_interesting,
+            num_duplicate,
             num_failed
         );
 
+        let mut state = self.state.lock().unwrap();
         if symcc_result.killed {
             log::info!(
                 "The target process was killed (probably timeout or out of memory); \
                  archiving to {}",
-                self.hangs.path.display()
+                state.hangs.path.display()
             );
-            symcc::copy_testcase(&input, &mut self.hangs, &input)
+            symcc::copy_testcase(&input, &mut state.hangs, &input)
                 .context("Failed to archive the test case")?;
         }
 
-        self.processed_files.insert(input.as_ref().to_path_buf());
-        self.stats.add_execution(&symcc_result);
-        Ok(())
+        state.finish_input(input.as_ref(), &symcc_result, num_interesting + num_crash)
+    }
+
+    /// Run the AFL-instrumented target on the test case.
+    fn evaluate_coverage(
+        &self,
+        testcase: &[u8],
+        tmp_dir: impl AsRef<Path>,
+    ) -> Result<AflShowmapResult> {
+        let mut forkserver = self.forkserver.borrow_mut();
+        if let Some(f) = forkserver.as_mut() {
+            match f.run(testcase) {
+                Ok(result) => return Ok(result),
+                Err(e) => {
+                    log::warn!(
+                        "The AFL forkserver failed ({}); falling back to afl-showmap",
+                        e
+                    );
+                    *forkserver = None;
+                }
+            }
+        }
+
+        let testcase_path = tmp_dir.as_ref().join("testcase");
+        fs::write(&testcase_path, testcase)
+            .context("Failed to write the test case for afl-showmap")?;
+        let testcase_bitmap_path = tmp_dir.as_ref().join("testcase_bitmap");
+        self.afl_config
+            .run_showmap(&testcase_bitmap_path, &testcase_path)
+    }
+
+    /// Check if the given test case provides new coverage, crashes, or times
+    /// out; store it in the corresponding location.
+    fn process_new_testcase(
+        &self,
+        testcase: &[u8],
+        parent: impl AsRef<Path>,
+        tmp_dir: impl AsRef<Path>,
+    ) -> Result<TestcaseResult> {
+        log::debug!("Processing a test case of {} bytes", testcase.len());
+
+        if !self
+            .state
+            .lock()
+            .unwrap()
+            .add_generated(symcc::hash_testcase(testcase))?
+        {
+            log::debug!("Test case is a duplicate");
+            return Ok(TestcaseResult::Duplicate);
+        }
+
+        let showmap_result = self
+            .evaluate_coverage(testcase, &tmp_dir)
+            .context("Failed to check whether the test case is interesting")?;
+
+        let mut state = self.state.lock().unwrap();
+        match showmap_result {
+            AflShowmapResult::Success(testcase_bitmap) => {
+                let interesting = state.merge_coverage(&testcase_bitmap)?;
+                if interesting {
+                    symcc::save_testcase(testcase, &mut state.queue, parent)
+                        .context("Failed to enqueue the new test case")?;
+
+                    Ok(TestcaseResult::New)
+                } else {
+                    Ok(TestcaseResult::Uninteresting)
+                }
+            }
+            AflShowmapResult::Hang => {
+                log::info!("Ignoring new test case because afl-showmap timed out on it");
+                Ok(TestcaseResult::Hang)
+            }
+            AflShowmapResult::Crash => {
+                log::info!("Test case crashes afl-showmap; it is probably interesting");
+                symcc::save_testcase(testcase, &mut state.crashes, &parent)?;
+                symcc::save_testcase(testcase, &mut state.queue, &parent)
+                    .context("Failed to enqueue the new test case")?;
+                Ok(TestcaseResult::Crash)
+            }
+        }
     }
 }
 
@@ -299,105 +551,86 @@ fn main() -> Result<()> {
     }
 
     let symcc_dir = options.output_dir.join(&options.name);
-    if symcc_dir.is_dir() {
+    let resume = symcc_dir.is_dir();
+    if resume && !options.resume {
         log::error!(
-            "{} already exists; we do not currently support resuming",
+            "{} already exists; pass --resume to continue the previous run",
             symcc_dir.display()
         );
         return Ok(());
     }
 
-    let symcc = SymCC::new(symcc_dir.clone(), &options.command);
-    log::debug!("SymCC configuration: {:?}", &symcc);
-    let afl_config = AflConfig::load(options.output_dir.join(&options.fuzzer_name))?;
+    let mode = if options.persistent {
+        TargetMode::Persistent
+    } else if options.no_fork_server {
+        TargetMode::Spawn
+    } else {
+        TargetMode::ForkServer
+    };
+    let afl_config = Arc::new(AflConfig::load(
+        options.output_dir.join(&options.fuzzer_name),
+    )?);
     log::debug!("AFL configuration: {:?}", &afl_config);
-    let mut state = State::initialize(symcc_dir)?;
-
-    loop {
-        match afl_config
-            .best_new_testcase(&state.processed_files)
-            .context("Failed to check for new test cases")?
-        {
-            None => {
-                log::debug!("Waiting for new test cases...");
-                thread::sleep(Duration::from_secs(5));
-            }
-            Some(input) => state.test_input(&input, &symcc, &afl_config)?,
-        }
-
-        if state.last_stats_output.elapsed().as_secs() > STATS_INTERVAL_SEC {
-            if let Err(e) = state.stats.log(&mut state.stats_file) {
-                log::error!("Failed to log run-time statistics: {}", e);
+    let afl_queue = afl_config.watch_queue()?;
+    let state = Arc::new(Mutex::new(State::initialize(
+        &symcc_dir, afl_queue, resume,
+    )?));
+
+    // Each worker needs its own place for the coverage map that SymCC uses for
+    // pruning; a single worker just uses SymCC's directory.
+    let jobs = options.jobs.max(1);
+    let (done, worker_results) = mpsc::channel();
+    for i in 0..jobs {
+        let workbench = if jobs == 1 {
+            symcc_dir.clone()
+        } else {
+            let dir = symcc_dir.join(format!("worker-{}", i));
+            fs::create_dir_all(&dir).with_context(|| {
+                format!("Failed to create the worker directory {}", dir.display())
+            })?;
+            dir
+        };
+
+        let forkserver = match afl_config.start_forkserver() {
+            Ok(f) => Some(f),
+            Err(e) => {
+                log::warn!(
+                    "Failed to start the AFL forkserver ({}); using afl-showmap",
+                    e
+                );
+                None
             }
-            state.last_stats_output = Instant::now();
-        }
+        };
+
+        let symcc = SymCC::new(workbench, &options.command, mode)?;
+        log::debug!("SymCC configuration: {:?}", &symcc);
+        let worker = Worker {
+            symcc,
+            afl_config: afl_config.clone(),
+            state: state.clone(),
+            forkserver: RefCell::new(forkserver),
+        };
+        let done = done.clone();
+        thread::Builder::new()
+            .name(format!("worker-{}", i))
+            .spawn(move || {
+                let _ = done.send(worker.run());
+            })
+            .context("Failed to start a worker thread")?;
     }
+
+    // Workers only ever stop because of an error.
+    worker_results
+        .recv()
+        .expect("All workers disappeared without a result")
 }
 
 /// The possible outcomes of test-case evaluation.
 #[derive(Debug, PartialEq, Eq)]
 enum TestcaseResult {
     Uninteresting,
+    Duplicate,
     New,
     Hang,
     Crash,
 }
-
-/// Check if the given test case provides new coverage, crashes, or times out;
-/// copy it to the corresponding location.
-fn process_new_testcase(
-    testcase: impl AsRef<Path>,
-    parent: impl AsRef<Path>,
-    tmp_dir: impl AsRef<Path>,
-    afl_config: &AflConfig,
-    state: &mut State,
-) -> Result<TestcaseResult> {
-    log::debug!("Processing test case {}", testcase.as_ref().display());
-
-    let testcase_bitmap_path = tmp_dir.as_ref().join("testcase_bitmap");
-    match afl_config
-        .run_showmap(&testcase_bitmap_path, &testcase)
-        .with_context(|| {
-            format!(
-                "Failed to check whether test case {} is interesting",
-                &testcase.as_ref().display()
-            )
-        })? {
-        AflShowmapResult::Success(testcase_bitmap) => {
-            let interesting = state.current_bitmap.merge(&testcase_bitmap);
-            if interesting {
-                symcc::copy_testcase(&testcase, &mut state.queue, parent).with_context(|| {
-                    format!(
-                        "Failed to enqueue the new test case {}",
-                        testcase.as_ref().display()
-                    )
-                })?;
-
-                Ok(TestcaseResult::New)
-            } else {
-                Ok(TestcaseResult::Uninteresting)
-            }
-        }
-        AflShowmapResult::Hang => {
-            log::info!(
-                "Ignoring new test case {} because afl-showmap timed out on it",
-                testcase.as_ref().display()
-            );
-            Ok(TestcaseResult::Hang)
-        }
-        AflShowmapResult::Crash => {
-            log::info!(
-                "Test case {} crashes afl-showmap; it is probably interesting",
-                testcase.as_ref().display()
-            );
-            symcc::copy_testcase(&testcase, &mut state.crashes, &parent)?;
-            symcc::copy_testcase(&testcase, &mut state.queue, &parent).with_context(|| {
-                format!(
-                    "Failed to enqueue the new test case {}",
-                    testcase.as_ref().display()
-                )
-            })?;
-            Ok(TestcaseResult::Crash)
-        }
-    }
-}
@@ -0,0 +1,333 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+//! Seed scheduling based on the outcome of previous executions.
+//!
+//! For each candidate from the fuzzer's queue, we estimate how many new test
+//! cases an execution of SymCC would produce and how long it would take, and
+//! we pick the candidate with the highest expected yield per second:
+//!
+//! - The cost depends mostly on the size of the input, so we keep the average
+//!   execution time per power-of-two size class. If we have analyzed the
+//!   candidate's parent in the fuzzer's queue, we also take the parent's time
+//!   (scaled by size) into account.
+//! - The yield of inputs that the fuzzer derived from the same parent tends to
+//!   be similar, so we estimate it from the siblings that we've analyzed,
+//!   shrinking toward the global average while we know few siblings.
+//! - SymCC prunes branches that it has already seen, so an input that shares a
+//!   long prefix with an analyzed input is unlikely to lead anywhere new. We
+//!   remember hashes of prefixes (of power-of-two lengths) of all analyzed
+//!   inputs.
+//!
+//! Before we know anything, this ranks inputs by size, preferring those that
+//! gave the fuzzer new coverage.
+
+use crate::symcc::hash_testcase;
+use std::collections::{HashMap, HashSet};
+use std::fs::File;
+use std::io::{self, Read};
+use std::path::Path;
+use std::time::Duration;
+
+/// The maximum length of prefixes that we compare between inputs.
+const MAX_PREFIX: usize = 1 << 16;
+
+/// The weight (in executions) of the global average in per-lineage estimates.
+const PRIOR_EXECUTIONS: f64 = 2.0;
+
+/// The assumed time for analyzing 1 KiB of input before we've measured any.
+const DEFAULT_COST_SECS: f64 = 1.0;
+
+/// A lower bound on predicted costs, so that estimates near zero don't win
+/// regardless of their yield.
+const MIN_COST_SECS: f64 = 0.01;
+
+/// A lower bound on the novelty of an input; a shared prefix doesn't mean that
+/// the execution follows the same path.
+const MIN_NOVELTY: f64 = 0.1;
+
+/// The bonus for inputs that gave the fuzzer new coverage.
+const NEW_COVERAGE_BONUS: f64 = 2.0;
+
+/// What we know about an input before analyzing it.
+#[derive(Debug)]
+pub struct Candidate {
+    /// The size of the input in bytes.
+    size: u64,
+
+    /// The ID in the fuzzer's queue.
+    id: Option<u32>,
+
+    /// The ID of the input that the fuzzer derived this one from.
+    parent: Option<u32>,
+
+    /// Did the fuzzer see new coverage with this input?
+    new_coverage: bool,
+
+    /// Hashes of the prefixes of length 1, 2, 4, ... (up to MAX_PREFIX), and
+    /// of the entire input if it's shorter than that.
+    prefixes: Vec<(usize, u64)>,
+}
+
+impl Candidate {
+    /// Gather information on a test case in the fuzzer's queue.
+    pub fn new(path: impl AsRef<Path>) -> io::Result<Self> {
+        let mut data = Vec::new();
+        let size = File::open(&path)?
+            .take(MAX_PREFIX as u64)
+            .read_to_end(&mut data)
+            .and_then(|_| path.as_ref().metadata())?
+            .len();
+
+        let name = path
+            .as_ref()
+            .file_name()
+            .map(|n| n.to_string_lossy().into_owned())
+            .unwrap_or_default();
+        let field = |key: &str| {
+            name.split(',')
+                .find_map(|f| f.strip_prefix(key))
+                .and_then(|v| v.get(..6))
+                .and_then(|v| v.parse().ok())
+        };
+
+        Ok(Candidate {
+            size,
+            id: field("id:"),
+            // Synchronized test cases refer to the other fuzzer's queue.
+            parent: if name.contains("sync:") {
+                None
+            } else {
+                field("src:")
+            },
+            new_coverage: name.ends_with("+cov"),
+            prefixes: prefix_hashes(&data),
+        })
+    }
+}
+
+/// Compute the hashes of the prefixes that we compare.
+fn prefix_hashes(data: &[u8]) -> Vec<(usize, u64)> {
+    let mut lengths: Vec<usize> = (0..)
+        .map(|i| 1 << i)
+        .take_while(|&length| length < data.len())
+        .collect();
+    lengths.push(data.len());
+    lengths
+        .into_iter()
+        .map(|length| (length, hash_testcase(&data[..length])))
+        .collect()
+}
+
+/// Accumulated outcomes of executions.
+#[derive(Debug, Default, Clone, Copy)]
+struct Outcomes {
+    executions: f64,
+    seconds: f64,
+    bytes: f64,
+    new_testcases: f64,
+}
+
+impl Outcomes {
+    fn add(&mut self, size: u64, time: Duration, new_testcases: u64) {
+        self.executions += 1.0;
+        self.seconds += time.as_secs_f64();
+        self.bytes += size as f64;
+        self.new_testcases += new_testcases as f64;
+    }
+}
+
+/// The model that we learn from executions of SymCC.
+#[derive(Debug, Default)]
+pub struct Scheduler {
+    /// Outcomes of all executions.
+    total: Outcomes,
+
+    /// Outcomes by the binary logarithm of the input size.
+    by_size: Vec<Outcomes>,
+
+    /// Outcomes of the analyzed inputs by their ID in the fuzzer's queue.
+    by_input: HashMap<u32, Outcomes>,
+
+    /// Outcomes by the ID of the inputs' parent in the fuzzer's queue.
+    by_parent: HashMap<u32, Outcomes>,
+
+    /// Prefix hashes of all analyzed inputs.
+    prefixes: HashSet<(usize, u64)>,
+}
+
+fn size_class(size: u64) -> usize {
+    (64 - size.leading_zeros()) as usize
+}
+
+impl Scheduler {
+    /// Learn from the execution of SymCC on a candidate.
+    pub fn record(&mut self, candidate: &Candidate, time: Duration, new_testcases: u64) {
+        let size = candidate.size;
+        self.total.add(size, time, new_testcases);
+
+        let class = size_class(size);
+        if self.by_size.len() <= class {
+            self.by_size.resize(class + 1, Outcomes::default());
+        }
+        self.by_size[class].add(size, time, new_testcases);
+
+        if let Some(id) = candidate.id {
+            self.by_input
+                .entry(id)
+                .or_default()
+                .add(size, time, new_testcases);
+        }
+        if let Some(parent) = candidate.parent {
+            self.by_parent
+                .entry(parent)
+                .or_default()
+                .add(size, time, new_testcases);
+        }
+
+        self.prefixes.extend(candidate.prefixes.iter().copied());
+    }
+
+    /// Predict the time that SymCC will take on the candidate, in seconds.
+    fn predicted_cost(&self, candidate: &Candidate) -> f64 {
+        let size = candidate.size as f64;
+        let by_size = match self.by_size.get(size_class(candidate.size)) {
+            Some(o) if o.executions > 0.0 => o.seconds / o.executions,
+            _ if self.total.executions > 0.0 => {
+                // Scale the global average linearly.
+                self.total.seconds / self.total.executions * (size + 1.0)
+                    / (self.total.bytes / self.total.executions + 1.0)
+            }
+            _ => DEFAULT_COST_SECS * (size + 1.0) / 1024.0,
+        };
+
+        let cost = match candidate.parent.and_then(|p| self.by_input.get(&p)) {
+            Some(parent) => {
+                let by_parent = parent.seconds * (size + 1.0) / (parent.bytes + 1.0);
+                (by_size * by_parent).sqrt()
+            }
+            None => by_size,
+        };
+        cost.max(MIN_COST_SECS)
+    }
+
+    /// Predict the number of new test cases that SymCC will generate from the
+    /// candidate.
+    fn predicted_yield(&self, candidate: &Candidate) -> f64 {
+        // Be optimistic while we haven't seen anything.
+        let global = (self.total.new_testcases + 1.0) / (self.total.executions + 1.0);
+        match candidate.parent.and_then(|p| self.by_parent.get(&p)) {
+            Some(siblings) => {
+                (siblings.new_testcases + global * PRIOR_EXECUTIONS)
+                    / (siblings.executions + PRIOR_EXECUTIONS)
+            }
+            None => global,
+        }
+    }
+
+    /// Estimate which fraction of the candidate is new to SymCC, judging by
+    /// the longest prefix that it shares with an analyzed input.
+    fn novelty(&self, candidate: &Candidate) -> f64 {
+        let full = match candidate.prefixes.last() {
+            Some(&(length, _)) if length > 0 => length,
+            _ => return 1.0,
+        };
+        let shared = candidate
+            .prefixes
+            .iter()
+            .rev()
+            .find(|prefix| self.prefixes.contains(prefix))
+            .map_or(0, |&(length, _)| length);
+        (1.0 - shared as f64 / full as f64).max(MIN_NOVELTY)
+    }
+
+    /// The expected number of new test cases per second of analysis.
+    pub fn score(&self, candidate: &Candidate) -> f64 {
+        let bonus = if candidate.new_coverage {
+            NEW_COVERAGE_BONUS
+        } else {
+            1.0
+        };
+        bonus * self.novelty(candidate) * self.predicted_yield(candidate)
+            / self.predicted_cost(candidate)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn candidate(data: &[u8], id: u32, parent: Option<u32>) -> Candidate {
+        Candidate {
+            size: data.len() as u64,
+            id: Some(id),
+            parent,
+            new_coverage: false,
+            prefixes: prefix_hashes(data),
+        }
+    }
+
+    #[test]
+    fn test_parse_candidate() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("id:000012,src:000003,op:havoc,rep:2,+cov");
+        std::fs::write(&path, "hello").unwrap();
+        let c = Candidate::new(&path).unwrap();
+        assert_eq!(
+            (c.size, c.id, c.parent, c.new_coverage),
+            (5, Some(12), Some(3), true)
+        );
+        assert_eq!(
+            c.prefixes.iter().map(|p| p.0).collect::<Vec<_>>(),
+            vec![1, 2, 4, 5]
+        );
+
+        let path = dir.path().join("id:000013,sync:symcc,src:000007");
+        std::fs::write(&path, "").unwrap();
+        let c = Candidate::new(&path).unwrap();
+        assert_eq!((c.size, c.id, c.parent), (0, Some(13), None));
+    }
+
+    #[test]
+    fn test_learned_order() {
+        let mut scheduler = Scheduler::default();
+        let small = candidate(b"abcd", 1, Some(0));
+        let large = candidate(&[b'x'; 4096], 2, Some(0));
+        assert!(scheduler.score(&small) > scheduler.score(&large));
+
+        // The small input's lineage turns out to be slow and useless, while
+        // the large input's is fast and productive.
+        for id in 10..14 {
+            scheduler.record(
+                &candidate(&[b'a', id as u8, 0, 0], id, Some(0)),
+                Duration::from_secs(60),
+                0,
+            );
+            scheduler.record(
+                &candidate(&[id as u8; 4000], id + 10, Some(5)),
+                Duration::from_millis(500),
+                3,
+            );
+        }
+        let large = candidate(&[b'y'; 4096], 2, Some(5));
+        assert!(scheduler.score(&large) > scheduler.score(&small));
+
+        // An input that shares most of its prefix with an analyzed one is less
+        // interesting than a fresh one.
+        let mut shared = vec![10u8; 4000];
+        shared.extend_from_slice(&[0; 96]);
+        assert!(scheduler.novelty(&candidate(&shared, 3, Some(5))) <= 0.5);
+        assert_eq!(scheduler.novelty(&large), 1.0);
+    }
+}
@@ -12,21 +12,45 @@
 // You should have received a copy of the GNU General Public License along with
 // SymCC. If not, see <https://www.gnu.org/licenses/>.
 
+use crate::scheduler::{Candidate, Scheduler};
 use anyhow::{bail, ensure, Context, Result};
 use regex::Regex;
+use std::cell::RefCell;
 use std::cmp;
-use std::collections::HashSet;
-use std::ffi::{OsStr, OsString};
+use std::collections::{HashMap, HashSet};
+use std::ffi::{CString, OsStr, OsString};
 use std::fs::{self, File};
-use std::io::{self, Read};
-use std::os::unix::process::ExitStatusExt;
+use std::io::{self, BufRead, BufReader, Read, Seek, SeekFrom, Write};
+use std::os::unix::ffi::OsStrExt;
+use std::os::unix::fs::FileExt;
+use std::os::unix::io::{AsRawFd, FromRawFd, RawFd};
+use std::os::unix::net::UnixStream;
+use std::os::unix::process::{CommandExt, ExitStatusExt};
 use std::path::{Path, PathBuf};
-use std::process::{Command, Stdio};
+use std::process::{Child, Command, ExitStatus, Stdio};
+use std::ptr;
+use std::slice;
 use std::str;
+use std::sync::atomic::{AtomicU64, Ordering};
 use std::time::{Duration, Instant};
 
 const TIMEOUT: u32 = 90;
 
+/// The size of AFL's coverage map.
+const MAP_SIZE: usize = 65536;
+
+/// The size of the ring buffer for test cases generated by SymCC.
+const OUTPUT_RING_SIZE: usize = 8 << 20;
+
+/// The offset of the data in the output ring (see runtime/OutputRing.h).
+const OUTPUT_RING_DATA_OFFSET: usize = 64;
+
+/// The first of the two file descriptors that AFL's forkserver uses.
+const FORKSRV_FD: RawFd = 198;
+
+/// The time limit for the AFL-instrumented target (like afl-showmap's "-t").
+const COVERAGE_TIMEOUT_MS: i32 = 5000;
+
 /// Replace the first '@@' in the given command line with the input file.
 fn insert_input_file<S: AsRef<OsStr>, P: AsRef<Path>>(
     command: &[S],
@@ -42,13 +66,33 @@ fn insert_input_file<S: AsRef<OsStr>, P: AsRef<Path>>(
 
 /// A coverage map as used by AFL.
 pub struct AflMap {
-    data: [u8; 65536],
+    data: [u8; MAP_SIZE],
 }
 
 impl AflMap {
     /// Create an empty map.
     pub fn new() -> AflMap {
-        AflMap { data: [0; 65536] }
+        AflMap {
+            data: [0; MAP_SIZE],
+        }
+    }
+
+    /// Create a map from the raw hit counts of an execution, sorting them into
+    /// buckets like afl-showmap does.
+    fn from_hit_counts(counts: &[u8]) -> AflMap {
+        let mut result = AflMap::new();
+        for (bucket, count) in result.data.iter_mut().zip(counts.iter()) {
+            *bucket = match count {
+                0..=3 => [0, 1, 2, 4][*count as usize],
+                4..=7 => 8,
+                8..=15 => 16,
+                16..=31 => 32,
+                32..=127 => 64,
+                128..=255 => 128,
+            };
+        }
+
+        result
     }
 
     /// Load a map from disk.
@@ -60,11 +104,11 @@ impl AflMap {
                 path.as_ref().display()
             )
         })?;
-        if data.len() < 65536 {
-            data.resize(65536, 0);
+        if data.len() < MAP_SIZE {
+            data.resize(MAP_SIZE, 0);
         }
         ensure!(
-            data.len() == 65536,
+            data.len() == MAP_SIZE,
             "The file to load the coverage map from has the wrong size ({})",
             data.len()
         );
@@ -76,18 +120,28 @@ impl AflMap {
 
     /// Merge with another coverage map in place.
     ///
-    /// Return true if the map has changed, i.e., if the other map yielded new
-    /// coverage.
-    pub fn merge(&mut self, other: &AflMap) -> bool {
-        let mut interesting = false;
-        for (known, new) in self.data.iter_mut().zip(other.data.iter()) {
+    /// Return the indices and bits that are new, i.e., the coverage that the
+    /// other map yielded; the result is empty if nothing has changed.
+    pub fn merge(&mut self, other: &AflMap) -> Vec<(usize, u8)> {
+        let mut new_bits = Vec::new();
+        for (index, (known, new)) in self.data.iter_mut().zip(other.data.iter()).enumerate() {
             if *known != (*known | new) {
+                new_bits.push((index, new & !*known));
                 *known |= new;
-                interesting = true;
             }
         }
 
-        interesting
+        new_bits
+    }
+
+    /// Add coverage at the given index.
+    pub fn add_bits(&mut self, index: usize, bits: u8) {
+        self.data[index] |= bits;
+    }
+
+    /// Access the raw map.
+    pub fn bits(&self) -> &[u8] {
+        &self.data
     }
 }
 
@@ -176,6 +230,40 @@ impl TestcaseDir {
             .with_context(|| format!("Failed to create directory {}", dir.path.display()))?;
         Ok(dir)
     }
+
+    /// Open an existing test-case directory, continuing the numbering of the
+    /// test cases in it.
+    pub fn open(path: impl AsRef<Path>) -> Result<TestcaseDir> {
+        let next_id = fs::read_dir(&path)
+            .with_context(|| format!("Failed to open directory {}", path.as_ref().display()))?
+            .filter_map(|entry| entry.ok())
+            .filter_map(|entry| {
+                let name = entry.file_name();
+                let name = name.to_str()?;
+                if !name.starts_with("id:") {
+                    return None;
+                }
+                name.get(3..9)?.parse::<u64>().ok()
+            })
+            .max()
+            .map_or(0, |id| id + 1);
+
+        Ok(TestcaseDir {
+            path: path.as_ref().into(),
+            current_id: next_id,
+        })
+    }
+}
+
+/// Compute a hash of the contents of a test case for deduplication.
+///
+/// We store the hashes across runs of the helper (see journal.rs), so we need
+/// an algorithm that doesn't change, unlike the standard library's default
+/// hasher; this is 64-bit FNV-1a.
+pub fn hash_testcase(testcase: &[u8]) -> u64 {
+    testcase.iter().fold(0xcbf29ce484222325, |hash, &byte| {
+        (hash ^ byte as u64).wrapping_mul(0x100000001b3)
+    })
 }
 
 /// Copy a test case to a directory, using the parent test case's name to derive
@@ -184,6 +272,22 @@ pub fn copy_testcase(
     testcase: impl AsRef<Path>,
     target_dir: &mut TestcaseDir,
     parent: impl AsRef<Path>,
+) -> Result<()> {
+    let data = fs::read(&testcase).with_context(|| {
+        format!(
+            "Failed to read the test case {}",
+            testcase.as_ref().display()
+        )
+    })?;
+    save_testcase(&data, target_dir, parent)
+}
+
+/// Store a test case in a directory, using the parent test case's name to
+/// derive the new name.
+pub fn save_testcase(
+    testcase: &[u8],
+    target_dir: &mut TestcaseDir,
+    parent: impl AsRef<Path>,
 ) -> Result<()> {
     let orig_name = parent
         .as_ref()
@@ -200,13 +304,8 @@ pub fn copy_testcase(
         let new_name = format!("id:{:06},src:{}", target_dir.current_id, &orig_id);
         let target = target_dir.path.join(new_name);
         log::debug!("Creating test case {}", target.display());
-        fs::copy(testcase.as_ref(), target).with_context(|| {
-            format!(
-                "Failed to copy the test case {} to {}",
-                testcase.as_ref().display(),
-                target_dir.path.display()
-            )
-        })?;
+        fs::write(&target, testcase)
+            .with_context(|| format!("Failed to write the test case {}", target.display()))?;
 
         target_dir.current_id += 1;
     } else {
@@ -301,28 +400,9 @@ impl AflConfig {
         })
     }
 
-    /// Return the most promising unseen test case of this fuzzer.
-    pub fn best_new_testcase(&self, seen: &HashSet<PathBuf>) -> Result<Option<PathBuf>> {
-        let best = fs::read_dir(&self.queue)
-            .with_context(|| {
-                format!(
-                    "Failed to open the fuzzer's queue at {}",
-                    self.queue.display()
-                )
-            })?
-            .collect::<io::Result<Vec<_>>>()
-            .with_context(|| {
-                format!(
-                    "Failed to read the fuzzer's queue at {}",
-                    self.queue.display()
-                )
-            })?
-            .into_iter()
-            .map(|entry| entry.path())
-            .filter(|path| path.is_file() && !seen.contains(path))
-            .max_by_key(|path| TestcaseScore::new(path));
-
-        Ok(best)
+    /// Start watching the fuzzer's queue for test cases.
+    pub fn watch_queue(&self) -> Result<AflQueue> {
+        AflQueue::new(&self.queue)
     }
 
     pub fn run_showmap(
@@ -385,6 +465,570 @@ impl AflConfig {
             unexpected => panic!("Unexpected return code {} from afl-showmap", unexpected),
         }
     }
+
+    /// Start the AFL-instrumented target as a forkserver for coverage
+    /// evaluation, keeping the current input in the given directory.
+    pub fn start_forkserver(&self) -> Result<AflForkserver> {
+        ensure!(
+            !self.use_qemu_mode,
+            "QEMU mode is only supported via afl-showmap"
+        );
+
+        let input = memfd("afl_input")?;
+        let input_file = fd_path(&input);
+        let trace_bits = SharedMemory::new(MAP_SIZE)?;
+        let (control_theirs, control) = pipe()?;
+        let (status, status_theirs) = pipe()?;
+
+        // The command line starts with AFL's separator "--".
+        let target_command = insert_input_file(&self.target_command[1..], &input_file);
+        let mut command = Command::new(&target_command[0]);
+        command
+            .args(&target_command[1..])
+            .env("__AFL_SHM_ID", trace_bits.id.to_string())
+            .stdout(Stdio::null())
+            .stderr(Stdio::null())
+            .stdin(if self.use_standard_input {
+                Stdio::from(input.try_clone()?)
+            } else {
+                Stdio::null()
+            });
+
+        inherit_fds(&mut command, vec![input.as_raw_fd()]);
+        let (control_fd, status_fd) = (control_theirs.as_raw_fd(), status_theirs.as_raw_fd());
+        unsafe {
+            command.pre_exec(move || {
+                if libc::dup2(control_fd, FORKSRV_FD) == -1
+                    || libc::dup2(status_fd, FORKSRV_FD + 1) == -1
+                {
+                    return Err(io::Error::last_os_error());
+                }
+                Ok(())
+            });
+        }
+
+        log::debug!("Starting the AFL forkserver as follows: {:?}", &command);
+        let child = command
+            .spawn()
+            .context("Failed to start the AFL-instrumented target")?;
+        drop((control_theirs, status_theirs));
+
+        let mut forkserver = AflForkserver {
+            child,
+            control,
+            status,
+            trace_bits,
+            input,
+            previous_timed_out: false,
+        };
+        let hello = forkserver
+            .read_status(COVERAGE_TIMEOUT_MS)?
+            .context("The AFL-instrumented target didn't start a forkserver")?;
+        // AFL++ may announce extensions that require an answer; we only speak
+        // the classic protocol.
+        ensure!(
+            (hello ^ 0xffffffff) >> 8 != 0x41464c
+                && (hello & 0x80000001 != 0x80000001 || hello & 0x11000000 == 0),
+            "The AFL forkserver requires protocol extensions (hello {:#x})",
+            hello
+        );
+
+        Ok(forkserver)
+    }
+}
+
+/// The test cases in a fuzzer's queue, ordered by their expected value.
+///
+/// Rescanning a large queue for every execution of SymCC is expensive, so we
+/// keep the test cases that we haven't handed out yet, and we learn about new
+/// test cases via inotify. Without inotify (or when the kernel drops events),
+/// we rescan the directory but only examine the files we don't know yet. The
+/// scheduler ranks the pending test cases by what it has learned from previous
+/// executions (see scheduler.rs); the static TestcaseScore breaks ties.
+pub struct AflQueue {
+    /// The queue directory.
+    path: PathBuf,
+
+    /// The inotify instance watching the directory, if available.
+    inotify: Option<File>,
+
+    /// Do we need to rescan the directory?
+    rescan: bool,
+
+    /// Test cases that we haven't handed out yet.
+    pending: Vec<(Candidate, TestcaseScore, PathBuf)>,
+
+    /// Test cases that are being analyzed.
+    in_flight: HashMap<PathBuf, Candidate>,
+
+    /// All test cases that we know about.
+    known: HashSet<PathBuf>,
+
+    /// The model for ranking test cases.
+    scheduler: Scheduler,
+}
+
+impl AflQueue {
+    fn new(path: impl AsRef<Path>) -> Result<Self> {
+        let path = path.as_ref().to_path_buf();
+        let inotify = match AflQueue::watch(&path) {
+            Ok(file) => Some(file),
+            Err(e) => {
+                log::warn!(
+                    "Failed to watch {} ({}); falling back to polling",
+                    path.display(),
+                    e
+                );
+                None
+            }
+        };
+
+        Ok(AflQueue {
+            path,
+            inotify,
+            rescan: true,
+            pending: Vec::new(),
+            in_flight: HashMap::new(),
+            known: HashSet::new(),
+            scheduler: Scheduler::default(),
+        })
+    }
+
+    /// Set up inotify for new files in the given directory.
+    fn watch(path: &Path) -> io::Result<File> {
+        let fd = unsafe { libc::inotify_init1(libc::IN_NONBLOCK | libc::IN_CLOEXEC) };
+        if fd == -1 {
+            return Err(io::Error::last_os_error());
+        }
+
+        let inotify = unsafe { File::from_raw_fd(fd) };
+        let path = std::ffi::CString::new(path.as_os_str().as_bytes())
+            .map_err(|e| io::Error::new(io::ErrorKind::InvalidInput, e))?;
+        if unsafe {
+            libc::inotify_add_watch(fd, path.as_ptr(), libc::IN_CLOSE_WRITE | libc::IN_MOVED_TO)
+        } == -1
+        {
+            return Err(io::Error::last_os_error());
+        }
+
+        Ok(inotify)
+    }
+
+    /// The file descriptor that becomes readable when new test cases arrive.
+    pub fn event_fd(&self) -> Option<RawFd> {
+        self.inotify.as_ref().map(|f| f.as_raw_fd())
+    }
+
+    /// Return the most promising test case that we haven't handed out yet
+    /// and that isn't in the given set.
+    ///
+    /// Call record when the analysis of the test case is done.
+    pub fn pop_best(&mut self, seen: &HashSet<PathBuf>) -> Result<Option<PathBuf>> {
+        self.update()?;
+        self.pending.retain(|(_, _, path)| !seen.contains(path));
+
+        // The scores change as we learn, so we can't keep the test cases
+        // sorted; compared to an execution of SymCC, a linear scan is cheap.
+        while !self.pending.is_empty() {
+            let scheduler = &self.scheduler;
+            let (best, _) = self
+                .pending
+                .iter()
+                .enumerate()
+                .map(|(i, (candidate, score, _))| (i, (scheduler.score(candidate), score)))
+                .max_by(|(_, a), (_, b)| a.partial_cmp(b).unwrap_or(cmp::Ordering::Equal))
+                .unwrap();
+            let (candidate, _, path) = self.pending.swap_remove(best);
+            if path.is_file() {
+                self.in_flight.insert(path.clone(), candidate);
+                return Ok(Some(path));
+            }
+        }
+
+        Ok(None)
+    }
+
+    /// Learn from the analysis of a test case that pop_best handed out.
+    pub fn record(&mut self, path: &Path, time: Duration, new_testcases: u64) {
+        if let Some(candidate) = self.in_flight.remove(path) {
+            self.scheduler.record(&candidate, time, new_testcases);
+        }
+    }
+
+    /// Learn about new test cases.
+    fn update(&mut self) -> Result<()> {
+        let mut new_files = Vec::new();
+        if let Some(inotify) = self.inotify.as_mut() {
+            let mut buffer = [0u8; 4096];
+            loop {
+                let length = match inotify.read(&mut buffer) {
+                    Ok(length) => length,
+                    Err(e) if e.kind() == io::ErrorKind::WouldBlock => break,
+                    Err(e) if e.kind() == io::ErrorKind::Interrupted => continue,
+                    Err(e) => return Err(e).context("Failed to read inotify events"),
+                };
+
+                let mut offset = 0;
+                let header_size = std::mem::size_of::<libc::inotify_event>();
+                while offset + header_size <= length {
+                    let event = unsafe {
+                        ptr::read_unaligned(buffer[offset..].as_ptr() as *const libc::inotify_event)
+                    };
+                    let name =
+                        &buffer[offset + header_size..offset + header_size + event.len as usize];
+                    offset += header_size + event.len as usize;
+
+                    if event.mask & libc::IN_Q_OVERFLOW != 0 {
+                        self.rescan = true;
+                        continue;
+                    }
+
+                    let name = match name.iter().position(|b| *b == 0) {
+                        Some(end) => &name[..end],
+                        None => name,
+                    };
+                    if !name.is_empty() {
+                        new_files.push(self.path.join(OsStr::from_bytes(name)));
+                    }
+                }
+            }
+        } else {
+            self.rescan = true;
+        }
+
+        for path in new_files {
+            self.add(path);
+        }
+
+        if self.rescan {
+            self.rescan = false;
+            let entries = fs::read_dir(&self.path)
+                .with_context(|| {
+                    format!(
+                        "Failed to open the fuzzer's queue at {}",
+                        self.path.display()
+                    )
+                })?
+                .collect::<io::Result<Vec<_>>>()
+                .with_context(|| {
+                    format!(
+                        "Failed to read the fuzzer's queue at {}",
+                        self.path.display()
+                    )
+                })?;
+            for entry in entries {
+                self.add(entry.path());
+            }
+        }
+
+        Ok(())
+    }
+
+    /// Add a test case to the pending ones unless we know it already.
+    fn add(&mut self, path: PathBuf) {
+        if self.known.contains(&path) || !path.is_file() {
+            return;
+        }
+
+        match Candidate::new(&path) {
+            Ok(candidate) => {
+                self.known.insert(path.clone());
+                self.pending
+                    .push((candidate, TestcaseScore::new(&path), path));
+            }
+            // Has the file disappeared?
+            Err(e) => log::warn!("Failed to examine test case {}: {}", path.display(), e),
+        }
+    }
+}
+
+/// Create a pipe, returning the ends for reading and writing.
+fn pipe() -> Result<(File, File)> {
+    let mut fds = [0; 2];
+    if unsafe { libc::pipe2(fds.as_mut_ptr(), libc::O_CLOEXEC) } == -1 {
+        return Err(io::Error::last_os_error()).context("Failed to create a pipe");
+    }
+
+    Ok(unsafe { (File::from_raw_fd(fds[0]), File::from_raw_fd(fds[1])) })
+}
+
+/// Create a file that lives in memory only (see memfd_create(2)).
+fn memfd(name: &str) -> Result<File> {
+    let name = CString::new(name).unwrap();
+    let fd = unsafe { libc::memfd_create(name.as_ptr(), libc::MFD_CLOEXEC) };
+    if fd == -1 {
+        return Err(io::Error::last_os_error()).context("Failed to create a memfd");
+    }
+
+    Ok(unsafe { File::from_raw_fd(fd) })
+}
+
+/// The path under which a process that inherits the file can open it.
+///
+/// Opening the path creates a new file description, so the process reads
+/// from the start no matter where we left the file offset.
+fn fd_path(file: &File) -> PathBuf {
+    PathBuf::from(format!("/proc/self/fd/{}", file.as_raw_fd()))
+}
+
+/// Let the process that the command starts inherit the given file
+/// descriptors.
+///
+/// We create all files with FD_CLOEXEC, so that each target only inherits the
+/// files that are meant for it (and not those of another worker's target).
+fn inherit_fds(command: &mut Command, fds: Vec<RawFd>) {
+    unsafe {
+        command.pre_exec(move || {
+            for &fd in fds.iter() {
+                if libc::fcntl(fd, libc::F_SETFD, 0) == -1 {
+                    return Err(io::Error::last_os_error());
+                }
+            }
+            Ok(())
+        });
+    }
+}
+
+/// A ring buffer in shared memory that receives the test cases generated by
+/// SymCC (see runtime/OutputRing.h).
+#[derive(Debug)]
+struct OutputRing {
+    /// The memory, which we pass to the target.
+    file: File,
+    /// The mapped memory.
+    data: *mut u8,
+    /// The size of the data area.
+    capacity: usize,
+}
+
+// The mapping belongs to the ring object alone.
+unsafe impl Send for OutputRing {}
+
+impl OutputRing {
+    fn new() -> Result<Self> {
+        let file = memfd("symcc_output")?;
+        file.set_len((OUTPUT_RING_DATA_OFFSET + OUTPUT_RING_SIZE) as u64)
+            .context("Failed to allocate the output ring")?;
+        let data = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                OUTPUT_RING_DATA_OFFSET + OUTPUT_RING_SIZE,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if data == libc::MAP_FAILED {
+            return Err(io::Error::last_os_error()).context("Failed to map the output ring");
+        }
+
+        let ring = OutputRing {
+            file,
+            data: data as *mut u8,
+            capacity: OUTPUT_RING_SIZE,
+        };
+        unsafe { ptr::write(ring.data as *mut u64, OUTPUT_RING_SIZE as u64) };
+        Ok(ring)
+    }
+
+    /// The counters in the header: the head is at offset 8, the tail at 16.
+    fn counter(&self, offset: usize) -> &AtomicU64 {
+        unsafe { &*(self.data.add(offset) as *const AtomicU64) }
+    }
+
+    /// Copy data out of the ring, starting at the given position.
+    fn read(&self, position: u64, buffer: &mut [u8]) {
+        let data =
+            unsafe { slice::from_raw_parts(self.data.add(OUTPUT_RING_DATA_OFFSET), self.capacity) };
+        let offset = (position % self.capacity as u64) as usize;
+        let first = cmp::min(buffer.len(), self.capacity - offset);
+        buffer[..first].copy_from_slice(&data[offset..offset + first]);
+        let rest = buffer.len() - first;
+        buffer[first..].copy_from_slice(&data[..rest]);
+    }
+
+    /// Take all test cases out of the ring.
+    fn drain(&self) -> Vec<Vec<u8>> {
+        let head = self.counter(8).load(Ordering::Acquire);
+        let mut tail = self.counter(16).load(Ordering::Relaxed);
+        let mut test_cases = Vec::new();
+        while tail < head {
+            let mut length = [0u8; 4];
+            self.read(tail, &mut length);
+            let mut test_case = vec![0u8; u32::from_ne_bytes(length) as usize];
+            self.read(tail + 4, &mut test_case);
+            tail += 4 + test_case.len() as u64;
+            test_cases.push(test_case);
+        }
+
+        self.counter(16).store(tail, Ordering::Release);
+        test_cases
+    }
+}
+
+impl Drop for OutputRing {
+    fn drop(&mut self) {
+        unsafe {
+            libc::munmap(
+                self.data as *mut libc::c_void,
+                OUTPUT_RING_DATA_OFFSET + self.capacity,
+            )
+        };
+    }
+}
+
+/// A System V shared-memory segment, like AFL uses for its coverage map.
+struct SharedMemory {
+    id: libc::c_int,
+    data: *mut u8,
+    size: usize,
+}
+
+impl SharedMemory {
+    fn new(size: usize) -> Result<Self> {
+        let id = unsafe {
+            libc::shmget(
+                libc::IPC_PRIVATE,
+                size,
+                libc::IPC_CREAT | libc::IPC_EXCL | 0o600,
+            )
+        };
+        if id < 0 {
+            return Err(io::Error::last_os_error())
+                .context("Failed to create shared memory for the coverage map");
+        }
+
+        let data = unsafe { libc::shmat(id, ptr::null(), 0) };
+        // Linux lets the target attach the segment even after it has been
+        // marked for removal, so we can make sure that it disappears with the
+        // last process using it, even if we don't exit cleanly.
+        let error = io::Error::last_os_error();
+        unsafe { libc::shmctl(id, libc::IPC_RMID, ptr::null_mut()) };
+        if data as isize == -1 {
+            return Err(error).context("Failed to attach the coverage map");
+        }
+
+        Ok(SharedMemory {
+            id,
+            data: data as *mut u8,
+            size,
+        })
+    }
+
+    fn as_mut_slice(&mut self) -> &mut [u8] {
+        unsafe { slice::from_raw_parts_mut(self.data, self.size) }
+    }
+}
+
+impl Drop for SharedMemory {
+    fn drop(&mut self) {
+        unsafe { libc::shmdt(self.data as *const libc::c_void) };
+    }
+}
+
+/// The AFL-instrumented target running as a forkserver.
+///
+/// Instead of running afl-showmap (which starts the target, writes the
+/// coverage map to a file, and exits) for every test case, we speak AFL's
+/// forkserver protocol to the target directly and read the coverage from
+/// shared memory.
+pub struct AflForkserver {
+    /// The forkserver process.
+    child: Child,
+
+    /// The pipe for requesting executions.
+    control: File,
+
+    /// The pipe for receiving the process ID and status of each execution.
+    status: File,
+
+    /// The coverage map that the target writes to.
+    trace_bits: SharedMemory,
+
+    /// The memfd with the current input (also the target's standard input if
+    /// it doesn't read from a file).
+    input: File,
+
+    /// Did we have to kill the target during the previous execution?
+    previous_timed_out: bool,
+}
+
+// The shared memory belongs to the forkserver object alone.
+unsafe impl Send for AflForkserver {}
+
+impl AflForkserver {
+    /// Run the target on the test case and collect its coverage.
+    pub fn run(&mut self, testcase: &[u8]) -> Result<AflShowmapResult> {
+        self.input.set_len(0)?;
+        self.input.seek(SeekFrom::Start(0))?;
+        self.input.write_all(testcase)?;
+        self.input.seek(SeekFrom::Start(0))?;
+        self.trace_bits.as_mut_slice().fill(0);
+
+        // The request tells the forkserver whether the previous execution
+        // timed out.
+        self.control
+            .write_all(&u32::from(self.previous_timed_out).to_ne_bytes())
+            .context("Failed to send a request to the AFL forkserver")?;
+        let pid = self
+            .read_status(COVERAGE_TIMEOUT_MS)?
+            .context("The AFL forkserver didn't start the target")?;
+        let status = match self.read_status(COVERAGE_TIMEOUT_MS)? {
+            Some(status) => status as libc::c_int,
+            None => {
+                unsafe { libc::kill(pid as libc::pid_t, libc::SIGKILL) };
+                self.read_status(-1)?;
+                self.previous_timed_out = true;
+                return Ok(AflShowmapResult::Hang);
+            }
+        };
+        self.previous_timed_out = false;
+
+        if libc::WIFSIGNALED(status) {
+            Ok(AflShowmapResult::Crash)
+        } else {
+            Ok(AflShowmapResult::Success(Box::new(
+                AflMap::from_hit_counts(self.trace_bits.as_mut_slice()),
+            )))
+        }
+    }
+
+    /// Read a 32-bit value from the forkserver, waiting at most the given
+    /// number of milliseconds (or indefinitely if the number is negative).
+    ///
+    /// Return None if the time runs out.
+    fn read_status(&mut self, timeout_ms: i32) -> Result<Option<u32>> {
+        let mut poll_fd = libc::pollfd {
+            fd: self.status.as_raw_fd(),
+            events: libc::POLLIN,
+            revents: 0,
+        };
+        loop {
+            match unsafe { libc::poll(&mut poll_fd, 1, timeout_ms) } {
+                0 => return Ok(None),
+                -1 if io::Error::last_os_error().kind() == io::ErrorKind::Interrupted => continue,
+                -1 => {
+                    return Err(io::Error::last_os_error())
+                        .context("Failed to wait for the AFL forkserver")
+                }
+                _ => break,
+            }
+        }
+
+        let mut value = [0u8; 4];
+        self.status
+            .read_exact(&mut value)
+            .context("Failed to read from the AFL forkserver")?;
+        Ok(Some(u32::from_ne_bytes(value)))
+    }
+}
+
+impl Drop for AflForkserver {
+    fn drop(&mut self) {
+        let _ = self.child.kill();
+        let _ = self.child.wait();
+    }
 }
 
 /// The run-time configuration of SymCC.
@@ -396,17 +1040,207 @@ pub struct SymCC {
     /// The cumulative bitmap for branch pruning.
     bitmap: PathBuf,
 
-    /// The place to store the current input.
+    /// The memfd with the current input.
+    input: File,
+
+    /// The path under which the target opens the current input.
     input_file: PathBuf,
 
+    /// The ring buffer that a controlled target puts its test cases in.
+    output_ring: OutputRing,
+
     /// The command to run.
     command: Vec<OsString>,
+
+    /// How we execute the target.
+    mode: TargetMode,
+
+    /// The running target if we don't start a new process per input.
+    controlled_target: RefCell<Option<ControlledTarget>>,
+}
+
+/// The ways of executing the target.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum TargetMode {
+    /// Start a new process for each input.
+    Spawn,
+    /// Let the runtime fork a new process for each input (see
+    /// runtime/ForkServer.h).
+    ForkServer,
+    /// Keep the target running across inputs (see symcc_reset).
+    Persistent,
+}
+
+/// A long-running instance of the target that we control with requests.
+///
+/// We hand inputs to the target over a control channel; after each input, the
+/// runtime reports back on the same channel (see runtime/ControlChannel.h). A
+/// fork server first tells us the process ID of the child that handles the
+/// input, and then the child's wait status.
+#[derive(Debug)]
+struct ControlledTarget {
+    /// The target process.
+    child: Child,
+
+    /// Our end of the control channel.
+    control: BufReader<UnixStream>,
+
+    /// Is the target a fork server?
+    fork_server: bool,
+}
+
+/// The possible outcomes of handing an input to a controlled target.
+enum TargetOutcome {
+    /// The input has been processed, and the target waits for the next one.
+    /// For a fork server, we also learn which signal killed the child, if any.
+    Done { signal: Option<i32> },
+    /// The target terminated (e.g., because it doesn't loop over inputs).
+    Exited(ExitStatus),
+    /// We killed the target (or the fork server's child) because it exceeded
+    /// the time limit.
+    TimedOut,
+}
+
+impl ControlledTarget {
+    /// Start the target with a control channel.
+    fn spawn(symcc: &SymCC, output_dir: &Path) -> Result<Self> {
+        let (ours, theirs) = UnixStream::pair().context("Failed to create the control channel")?;
+        let theirs_fd = theirs.as_raw_fd();
+        let fork_server = symcc.mode == TargetMode::ForkServer;
+
+        let mut command = Command::new(&symcc.command[0]);
+        command
+            .args(&symcc.command[1..])
+            .env("SYMCC_ENABLE_LINEARIZATION", "1")
+            .env("SYMCC_AFL_COVERAGE_MAP", &symcc.bitmap)
+            .env("SYMCC_OUTPUT_DIR", output_dir)
+            .env("SYMCC_CONTROL_FD", theirs_fd.to_string())
+            .stdin(Stdio::null())
+            .stdout(Stdio::null())
+            .stderr(Stdio::null());
+        if fork_server {
+            command.env("SYMCC_FORK_SERVER", "1");
+        }
+        if !symcc.use_standard_input {
+            command.env("SYMCC_INPUT_FILE", &symcc.input_file);
+        }
+        let ring_fd = symcc.output_ring.file.as_raw_fd();
+        command.env("SYMCC_OUTPUT_RING_FD", ring_fd.to_string());
+
+        // The standard library creates the socket with FD_CLOEXEC, and so do
+        // we with the memfds; let the target inherit them.
+        inherit_fds(
+            &mut command,
+            vec![theirs_fd, symcc.input.as_raw_fd(), ring_fd],
+        );
+
+        log::debug!("Starting the controlled target as follows: {:?}", &command);
+        let child = command
+            .spawn()
+            .context("Failed to start the controlled target")?;
+        Ok(ControlledTarget {
+            child,
+            control: BufReader::new(ours),
+            fork_server,
+        })
+    }
+
+    /// Read a number from the control channel.
+    ///
+    /// Return None if the target is gone.
+    fn read_number(&mut self) -> io::Result<Option<i64>> {
+        let mut line = String::new();
+        match self.control.read_line(&mut line) {
+            Ok(0) => Ok(None),
+            Err(e) if e.kind() == io::ErrorKind::ConnectionReset => Ok(None),
+            Ok(_) => line
+                .trim_end()
+                .parse()
+                .map(Some)
+                .map_err(|e| io::Error::new(io::ErrorKind::InvalidData, e)),
+            Err(e) => Err(e),
+        }
+    }
+
+    /// Let the target process the input, writing new test cases to the given
+    /// directory.
+    fn process(&mut self, input_file: &Path, output_dir: &Path) -> Result<TargetOutcome> {
+        let mut request = Vec::new();
+        for path in [input_file, output_dir].iter() {
+            request.extend_from_slice(path.as_os_str().as_bytes());
+            request.push(b'\n');
+        }
+
+        let timeout = Some(Duration::from_secs(TIMEOUT.into()));
+        if self.control.get_mut().write_all(&request).is_ok() {
+            let mut worker = None;
+            if self.fork_server {
+                self.control.get_mut().set_read_timeout(None)?;
+                worker = self
+                    .read_number()
+                    .context("Failed to read from the control channel")?;
+            }
+
+            if !self.fork_server || worker.is_some() {
+                self.control.get_mut().set_read_timeout(timeout)?;
+                match self.read_number() {
+                    // The target is gone, possibly leaving our request unread.
+                    Ok(None) => {}
+                    Ok(Some(status)) => {
+                        let status = status as libc::c_int;
+                        let signal = if self.fork_server && libc::WIFSIGNALED(status) {
+                            Some(libc::WTERMSIG(status))
+                        } else {
+                            None
+                        };
+                        return Ok(TargetOutcome::Done { signal });
+                    }
+                    Err(e)
+                        if e.kind() == io::ErrorKind::WouldBlock
+                            || e.kind() == io::ErrorKind::TimedOut =>
+                    {
+                        if let Some(pid) = worker {
+                            // Kill the child, and collect the status that the
+                            // fork server reports for it.
+                            unsafe { libc::kill(pid as libc::pid_t, libc::SIGKILL) };
+                            self.control.get_mut().set_read_timeout(None)?;
+                            if self
+                                .read_number()
+                                .context("Failed to read from the control channel")?
+                                .is_some()
+                            {
+                                return Ok(TargetOutcome::TimedOut);
+                            }
+                        } else {
+                            self.child.kill()?;
+                            self.child.wait()?;
+                            return Ok(TargetOutcome::TimedOut);
+                        }
+                    }
+                    Err(e) => return Err(e).context("Failed to read from the control channel"),
+                }
+            }
+        }
+
+        let status = self
+            .child
+            .wait()
+            .context("Failed to wait for the controlled target")?;
+        Ok(TargetOutcome::Exited(status))
+    }
+}
+
+impl Drop for ControlledTarget {
+    fn drop(&mut self) {
+        let _ = self.child.kill();
+        let _ = self.child.wait();
+    }
 }
 
 /// The result of executing SymCC.
 pub struct SymCCResult {
     /// The generated test cases.
-    pub test_cases: Vec<PathBuf>,
+    pub test_cases: Vec<Vec<u8>>,
     /// Whether the process was killed (e.g., out of memory, timeout).
     pub killed: bool,
     /// The total time taken by the execution.
@@ -417,15 +1251,24 @@ pub struct SymCCResult {
 
 impl SymCC {
     /// Create a new SymCC configuration.
-    pub fn new(output_dir: PathBuf, command: &[String]) -> Self {
-        let input_file = output_dir.join(".cur_input");
-
-        SymCC {
+    ///
+    /// We pass inputs to the target in a memfd, and a controlled target hands
+    /// back its test cases in an output ring, so that we don't create lots of
+    /// short-lived files.
+    pub fn new(output_dir: PathBuf, command: &[String], mode: TargetMode) -> Result<Self> {
+        let input = memfd("symcc_input")?;
+        let input_file = fd_path(&input);
+
+        Ok(SymCC {
             use_standard_input: !command.contains(&String::from("@@")),
             bitmap: output_dir.join("bitmap"),
             command: insert_input_file(command, &input_file),
+            input,
             input_file,
-        }
+            output_ring: OutputRing::new()?,
+            mode,
+            controlled_target: RefCell::new(None),
+        })
     }
 
     /// Try to extract the solver time from the logs produced by the Qsym
@@ -455,19 +1298,20 @@ impl SymCC {
     /// If SymCC is run with the Qsym backend, this function attempts to
     /// determine the time spent in the SMT solver and report it as part of the
     /// result. However, the mechanism that the backend uses to report solver
-    /// time is somewhat brittle.
+    /// time is somewhat brittle, and it is only available if we start a new
+    /// process per input.
     pub fn run(
         &self,
         input: impl AsRef<Path>,
         output_dir: impl AsRef<Path>,
     ) -> Result<SymCCResult> {
-        fs::copy(&input, &self.input_file).with_context(|| {
-            format!(
-                "Failed to copy the test case {} to our workbench at {}",
-                input.as_ref().display(),
-                self.input_file.display()
-            )
+        let data = fs::read(&input).with_context(|| {
+            format!("Failed to read the test case {}", input.as_ref().display())
         })?;
+        self.input.set_len(0)?;
+        self.input
+            .write_all_at(&data, 0)
+            .context("Failed to pass the test case to SymCC")?;
 
         fs::create_dir(&output_dir).with_context(|| {
             format!(
@@ -476,6 +1320,10 @@ impl SymCC {
             )
         })?;
 
+        if self.mode != TargetMode::Spawn {
+            return self.run_controlled(output_dir.as_ref());
+        }
+
         let mut analysis_command = Command::new("timeout");
         analysis_command
             .args(&["-k", "5", &TIMEOUT.to_string()])
@@ -487,31 +1335,16 @@ impl SymCC {
             .stderr(Stdio::piped()); // capture SMT logs
 
         if self.use_standard_input {
-            analysis_command.stdin(Stdio::piped());
+            analysis_command.stdin(Stdio::from(File::open(&self.input_file)?));
         } else {
             analysis_command.stdin(Stdio::null());
             analysis_command.env("SYMCC_INPUT_FILE", &self.input_file);
+            inherit_fds(&mut analysis_command, vec![self.input.as_raw_fd()]);
         }
 
         log::debug!("Running SymCC as follows: {:?}", &analysis_command);
         let start = Instant::now();
-        let mut child = analysis_command.spawn().context("Failed to run SymCC")?;
-
-        if self.use_standard_input {
-            io::copy(
-                &mut File::open(&self.input_file).with_context(|| {
-                    format!(
-                        "Failed to read the test input at {}",
-                        self.input_file.display()
-                    )
-                })?,
-                child
-                    .stdin
-                    .as_mut()
-                    .expect("Failed to pipe to the child's standard input"),
-            )
-            .context("Failed to pipe the test input to SymCC")?;
-        }
+        let child = analysis_command.spawn().context("Failed to run SymCC")?;
 
         let result = child
             .wait_with_output()
@@ -531,24 +1364,7 @@ impl SymCC {
             }
         };
 
-        let new_tests = fs::read_dir(&output_dir)
-            .with_context(|| {
-                format!(
-                    "Failed to read the generated test cases at {}",
-                    output_dir.as_ref().display()
-                )
-            })?
-            .collect::<io::Result<Vec<_>>>()
-            .with_context(|| {
-                format!(
-                    "Failed to read all test cases from {}",
-                    output_dir.as_ref().display()
-                )
-            })?
-            .iter()
-            .map(|entry| entry.path())
-            .collect();
-
+        let new_tests = self.collect_test_cases(output_dir.as_ref())?;
         let solver_time = SymCC::parse_solver_time(result.stderr);
         if solver_time.is_some() && solver_time.unwrap() > total_time {
             log::warn!("Backend reported inaccurate solver time!");
@@ -561,6 +1377,83 @@ impl SymCC {
             solver_time: solver_time.map(|t| cmp::min(t, total_time)),
         })
     }
+
+    /// Run the current input in the controlled target, starting the target
+    /// first if necessary.
+    fn run_controlled(&self, output_dir: &Path) -> Result<SymCCResult> {
+        let mut target = self.controlled_target.borrow_mut();
+        if target.is_none() {
+            *target = Some(ControlledTarget::spawn(self, output_dir)?);
+        }
+
+        let start = Instant::now();
+        let outcome = target
+            .as_mut()
+            .unwrap()
+            .process(&self.input_file, output_dir)?;
+        let total_time = start.elapsed();
+
+        let killed = match outcome {
+            TargetOutcome::Done { signal } => {
+                if let Some(signal) = signal {
+                    log::warn!("SymCC received signal {}", signal);
+                }
+                signal.is_some()
+            }
+            TargetOutcome::Exited(status) => {
+                // We'll start a new instance for the next input.
+                *target = None;
+                if let Some(signal) = status.signal() {
+                    log::warn!("SymCC received signal {}", signal);
+                    true
+                } else {
+                    log::debug!("The controlled target exited with {}", status);
+                    // A fork server only exits if something went wrong.
+                    self.mode == TargetMode::ForkServer
+                }
+            }
+            TargetOutcome::TimedOut => {
+                if self.mode == TargetMode::Persistent {
+                    *target = None;
+                }
+                true
+            }
+        };
+
+        Ok(SymCCResult {
+            test_cases: self.collect_test_cases(output_dir)?,
+            killed,
+            time: total_time,
+            solver_time: None,
+        })
+    }
+
+    /// Collect the test cases that SymCC generated, both from the output ring
+    /// and from files in the given directory.
+    fn collect_test_cases(&self, output_dir: &Path) -> Result<Vec<Vec<u8>>> {
+        let mut test_cases = self.output_ring.drain();
+        for entry in fs::read_dir(output_dir).with_context(|| {
+            format!(
+                "Failed to read the generated test cases at {}",
+                output_dir.display()
+            )
+        })? {
+            let path = entry
+                .with_context(|| {
+                    format!(
+                        "Failed to read all test cases from {}",
+                        output_dir.display()
+                    )
+                })?
+                .path();
+            test_cases.push(
+                fs::read(&path)
+                    .with_context(|| format!("Failed to read the test case {}", path.display()))?,
+            );
+        }
+
+        Ok(test_cases)
+    }
 }
 
 #[cfg(test)]
@@ -613,4 +1506,67 @@ mod tests {
             None
         );
     }
+
+    #[test]
+    fn test_queue_order() {
+        let dir = tempfile::tempdir().unwrap();
+        fs::write(dir.path().join("id:000000,orig:seed"), "aaaa").unwrap();
+        let mut queue = AflQueue::new(dir.path()).unwrap();
+        let mut seen = HashSet::new();
+
+        let first = queue.pop_best(&seen).unwrap().unwrap();
+        assert!(first.ends_with("id:000000,orig:seed"));
+        assert_eq!(queue.pop_best(&seen).unwrap(), None);
+
+        // New files show up, and the most promising one comes first.
+        fs::write(dir.path().join("id:000001,src:000000"), "bbbb").unwrap();
+        fs::write(dir.path().join("id:000002,src:000000,+cov"), "cccc").unwrap();
+        fs::write(dir.path().join("id:000003,src:000000"), "dd").unwrap();
+        seen.insert(dir.path().join("id:000003,src:000000"));
+        let order: Vec<_> = std::iter::from_fn(|| queue.pop_best(&seen).unwrap()).collect();
+        assert_eq!(
+            order,
+            vec![
+                dir.path().join("id:000002,src:000000,+cov"),
+                dir.path().join("id:000001,src:000000"),
+            ]
+        );
+    }
+
+    #[test]
+    fn test_output_ring() {
+        let ring = OutputRing::new().unwrap();
+
+        // Write records like the runtime, starting just before the end of the
+        // data area so that they wrap around.
+        let start = (ring.capacity - 6) as u64;
+        ring.counter(16).store(start, Ordering::Relaxed);
+        let mut position = start;
+        for test_case in [&b"abc"[..], &b""[..], &b"defgh"[..]].iter() {
+            let mut record = (test_case.len() as u32).to_ne_bytes().to_vec();
+            record.extend_from_slice(test_case);
+            for byte in record {
+                let offset = OUTPUT_RING_DATA_OFFSET + (position as usize % ring.capacity);
+                unsafe { *ring.data.add(offset) = byte };
+                position += 1;
+            }
+        }
+        ring.counter(8).store(position, Ordering::Release);
+
+        assert_eq!(
+            ring.drain(),
+            vec![b"abc".to_vec(), b"".to_vec(), b"defgh".to_vec()]
+        );
+        assert_eq!(ring.counter(16).load(Ordering::Relaxed), position);
+        assert!(ring.drain().is_empty());
+    }
+
+    #[test]
+    fn test_hash_testcase() {
+        // Reference values of FNV-1a; the hashes must never change because we
+        // store them.
+        assert_eq!(hash_testcase(b""), 0xcbf29ce484222325);
+        assert_eq!(hash_testcase(b"a"), 0xaf63dc4c8601ec8c);
+        assert_eq!(hash_testcase(b"foobar"), 0x85944171f73967e8);
+    }
 }